@@ -0,0 +1,75 @@
+#include "BlockCache.h"
+#include <string.h>
+
+// entry table first, block data after it
+BlockCache::BlockCache(uint8_t *memory, size_t size)
+  : entries_((entry_t *)memory),
+    block_count_(size / (sizeof(entry_t) + BLOCK_CACHE_BLOCK_SIZE)) {
+  data_ = memory + block_count_ * sizeof(entry_t);
+  clear();
+}
+
+void BlockCache::clear() {
+  memset(entries_, 0, block_count_ * sizeof(entry_t));
+  tick_ = 0;
+}
+
+void BlockCache::invalidate(uint32_t file) {
+  for (size_t i = 0; i < block_count_; i++) {
+    if (entries_[i].last_used && entries_[i].file == file) entries_[i].last_used = 0;
+  }
+}
+
+size_t BlockCache::blocks_used() const {
+  size_t used = 0;
+  for (size_t i = 0; i < block_count_; i++) {
+    if (entries_[i].last_used) used++;
+  }
+  return used;
+}
+
+// Linear scan: a few hundred entries at most, and each miss costs an SD read anyway
+const BlockCache::entry_t *BlockCache::lookup(uint32_t file, uint32_t block, read_fn fn, void *ctx) {
+  entry_t *victim = nullptr;
+  for (size_t i = 0; i < block_count_; i++) {
+    entry_t &e = entries_[i];
+    if (e.last_used && e.file == file && e.block == block) {
+      e.last_used = ++tick_;
+      hits_++;
+      return &e;
+    }
+    if (!victim || e.last_used < victim->last_used) victim = &e; // free entries (0) win
+  }
+  if (!victim) return nullptr;
+
+  misses_++;
+  if (victim->last_used) evictions_++;
+  victim->last_used = 0; // stays free if the read fails
+  uint8_t *data = data_ + (victim - entries_) * BLOCK_CACHE_BLOCK_SIZE;
+  int32_t length = fn(block, data, ctx);
+  if (length < 0) return nullptr;
+  victim->file = file;
+  victim->block = block;
+  victim->length = length > BLOCK_CACHE_BLOCK_SIZE ? BLOCK_CACHE_BLOCK_SIZE : length;
+  victim->last_used = ++tick_;
+  return victim;
+}
+
+int32_t BlockCache::read(uint32_t file, uint32_t offset, uint8_t *out, size_t length, read_fn fn, void *ctx) {
+  size_t copied = 0;
+  while (copied < length) {
+    uint32_t block = offset / BLOCK_CACHE_BLOCK_SIZE;
+    uint32_t start = offset % BLOCK_CACHE_BLOCK_SIZE;
+    const entry_t *e = lookup(file, block, fn, ctx);
+    if (!e) return -1;
+    if (e->length <= start) break; // end of file
+
+    size_t n = e->length - start;
+    if (n > length - copied) n = length - copied;
+    memcpy(out + copied, data_ + (e - entries_) * BLOCK_CACHE_BLOCK_SIZE + start, n);
+    copied += n;
+    offset += n;
+    if (e->length < BLOCK_CACHE_BLOCK_SIZE && start + n == e->length) break; // short block, end of file
+  }
+  return copied;
+}
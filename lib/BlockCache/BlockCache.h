@@ -0,0 +1,57 @@
+#pragma once
+
+// LRU cache of file blocks for SD reads.
+//
+// Files are cut into BLOCK_CACHE_BLOCK_SIZE blocks at aligned offsets, so every miss is one bulk
+// read of whole sectors. Blocks are keyed by a file id and block index, the least recently used
+// block is replaced on a miss. The caller keeps file ids unique per file, a shared id would serve
+// one file's blocks for the other. A block shorter than BLOCK_CACHE_BLOCK_SIZE is the end of the
+// file. Nothing tracks file changes: whoever writes a file must invalidate it.
+// Storage goes through a callback, so the cache runs on the SD card and on a host file alike.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BLOCK_CACHE_BLOCK_SIZE 512
+
+class BlockCache {
+ public:
+  // Reads block `block` (offset block * BLOCK_CACHE_BLOCK_SIZE) into data, returns bytes read,
+  // fewer than BLOCK_CACHE_BLOCK_SIZE at the end of the file, -1 on error
+  typedef int32_t (*read_fn)(uint32_t block, uint8_t *data, void *ctx);
+
+  // memory is owned by the caller and must outlive the cache
+  BlockCache(uint8_t *memory, size_t size);
+
+  // Copies up to length bytes from offset, returns bytes copied (short at the end of the file) or
+  // -1 when a block could not be read
+  int32_t read(uint32_t file, uint32_t offset, uint8_t *out, size_t length, read_fn fn, void *ctx);
+
+  void invalidate(uint32_t file); // after writing, truncating, renaming or removing the file
+  void clear();
+
+  uint32_t hits() const { return hits_; }
+  uint32_t misses() const { return misses_; }
+  uint32_t evictions() const { return evictions_; }
+  size_t blocks_used() const;
+  size_t capacity_blocks() const { return block_count_; }
+  void reset_stats() { hits_ = misses_ = evictions_ = 0; }
+
+ private:
+  struct entry_t {
+    uint32_t file;
+    uint32_t block;
+    uint32_t last_used; // tick of the last hit, 0 = free
+    uint16_t length;
+  };
+
+  const entry_t *lookup(uint32_t file, uint32_t block, read_fn fn, void *ctx);
+
+  entry_t *entries_;
+  uint8_t *data_;
+  size_t block_count_;
+  uint32_t tick_ = 0;
+  uint32_t hits_ = 0;
+  uint32_t misses_ = 0;
+  uint32_t evictions_ = 0;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+// Lookup for named commands by hash, for the websocket command dispatcher.
+//
+// Command names are hashed at compile time with command_hash("name") (FNV-1a, C++11 constexpr), the
+// incoming name once at run time. CommandIndex keeps the hashes sorted, so a lookup is a binary
+// search whatever the number of commands and a new command does not slow down the others. A hash can
+// match a different name, so the caller still compares the one name it found. Two commands with the
+// same hash are refused by add().
+//
+// command_arg_t describes one argument for the caller's schema check, command_stats_t counts calls
+// and handler time per command.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define COMMAND_INDEX_MAX 48
+#define COMMAND_HASH_SEED 2166136261u
+
+constexpr uint32_t command_hash_step(const char *name, uint32_t hash) {
+  return *name ? command_hash_step(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+constexpr uint32_t command_hash(const char *name) {
+  return command_hash_step(name, COMMAND_HASH_SEED);
+}
+
+inline uint32_t command_hash(const char *name, size_t length) {
+  uint32_t hash = COMMAND_HASH_SEED;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+  return hash;
+}
+
+enum command_arg_type_t { ARG_STRING, ARG_INT, ARG_NUMBER, ARG_OBJECT };
+
+struct command_arg_t {
+  const char *name;
+  command_arg_type_t type;
+  bool required;
+  int32_t min, max; // ARG_INT and ARG_NUMBER, min > max means no range
+  const char *choices; // ARG_STRING, "START|STOP", nullptr for any string
+};
+
+struct command_stats_t {
+  uint32_t calls = 0;
+  uint32_t rejected = 0; // schema check failed, the handler did not run
+  uint32_t total_us = 0;
+  uint32_t max_us = 0;
+
+  void add(uint32_t us) {
+    calls++;
+    total_us += us;
+    if (us > max_us) max_us = us;
+  }
+  uint32_t mean_us() const { return calls ? total_us / calls : 0; }
+};
+
+// true when value is one of the '|' separated choices
+inline bool command_choice_ok(const char *choices, const char *value) {
+  const char *p = choices;
+  while (*p) {
+    const char *v = value;
+    while (*p && *p != '|' && *p == *v) {
+      p++;
+      v++;
+    }
+    if ((*p == '|' || *p == '\0') && *v == '\0') return true;
+    while (*p && *p != '|') p++;
+    if (*p == '|') p++;
+  }
+  return false;
+}
+
+class CommandIndex {
+ public:
+  bool add(uint32_t hash, uint8_t index) {
+    if (count_ == COMMAND_INDEX_MAX) return false;
+    size_t at = lower_bound(hash);
+    if (at < count_ && entries_[at].hash == hash) return false;
+    for (size_t i = count_; i > at; i--) entries_[i] = entries_[i - 1];
+    entries_[at] = {hash, index};
+    count_++;
+    return true;
+  }
+
+  // caller's index for the hash, -1 when no command has it
+  int find(uint32_t hash) const {
+    size_t at = lower_bound(hash);
+    return at < count_ && entries_[at].hash == hash ? entries_[at].index : -1;
+  }
+
+  size_t size() const { return count_; }
+
+ private:
+  struct entry_t {
+    uint32_t hash;
+    uint8_t index;
+  };
+
+  size_t lower_bound(uint32_t hash) const {
+    size_t low = 0, high = count_;
+    while (low < high) {
+      size_t mid = (low + high) / 2;
+      if (entries_[mid].hash < hash) low = mid + 1;
+      else high = mid;
+    }
+    return low;
+  }
+
+  entry_t entries_[COMMAND_INDEX_MAX];
+  uint8_t count_ = 0;
+};
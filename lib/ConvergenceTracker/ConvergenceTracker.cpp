@@ -0,0 +1,107 @@
+#include "ConvergenceTracker.h"
+#include <SolutionMonitor.h>
+
+bool ConvergenceTracker::start(convergence_trigger_t trigger, uint32_t now_ms, const convergence_config_t &config) {
+  bool superseded = running_;
+  if (running_) finish(CONVERGENCE_SUPERSEDED);
+  config_ = config;
+  current_ = convergence_run_t();
+  current_.id = next_id_++;
+  current_.start_ms = now_ms;
+  current_.trigger = trigger;
+  current_.config = config;
+  running_ = true;
+  return superseded;
+}
+
+void ConvergenceTracker::finish(convergence_end_t end) {
+  current_.end = end;
+  ended_ = current_;
+  history_[head_] = current_;
+  head_ = (head_ + 1) % CONVERGENCE_HISTORY;
+  if (count_ < CONVERGENCE_HISTORY) count_++;
+  running_ = false;
+}
+
+bool ConvergenceTracker::update(uint32_t now_ms, uint8_t fix_type, uint8_t carr_soln, uint8_t corr_age, uint8_t num_sv, uint32_t h_acc) {
+  new_milestones_ = 0;
+  uint16_t age_s = solution_correction_age_s(corr_age);
+  bool fresh = corr_age != 0 && age_s <= corr_age_limit_s;
+  bool ended = false;
+
+  if (fresh && !corrections_fresh_ && corrections_lost_) { // back after a loss, time the reconvergence from here
+    ended = start(CONVERGENCE_CORRECTIONS, now_ms, config_);
+    current_.outage_ms = now_ms - lost_ms_;
+    corrections_lost_ = false;
+  } else if (!fresh && corrections_fresh_) {
+    corrections_lost_ = true;
+    lost_ms_ = now_ms;
+  }
+  corrections_fresh_ = fresh;
+
+  if (!running_) return ended;
+
+  solution_state_t state = solution_classify(fix_type, carr_soln);
+  bool reached[MILESTONE_COUNT];
+  reached[MILESTONE_3D] = fix_type >= 3 && fix_type <= 4; // 3D, GNSS + dead reckoning
+  reached[MILESTONE_CORRECTIONS] = corr_age != 0;
+  reached[MILESTONE_FIXED] = state == SOLUTION_FIXED;
+  reached[MILESTONE_FLOAT] = state == SOLUTION_FLOAT || reached[MILESTONE_FIXED];
+  reached[MILESTONE_3D] = reached[MILESTONE_3D] || reached[MILESTONE_FLOAT];
+
+  for (int i = 0; i < MILESTONE_COUNT; i++) {
+    convergence_stamp_t &stamp = current_.milestones[i];
+    if (!reached[i] || stamp.t_ms != CONVERGENCE_NOT_REACHED) continue;
+    stamp.t_ms = now_ms - current_.start_ms;
+    stamp.h_acc = h_acc;
+    stamp.corr_age_s = age_s;
+    stamp.num_sv = num_sv;
+    new_milestones_ |= 1 << i;
+  }
+  if (ended) return true; // ended() holds the superseded run, a fix on this epoch closes the new one next time
+
+  if (current_.reached(MILESTONE_FIXED)) {
+    finish(CONVERGENCE_FIXED);
+    return true;
+  }
+  if (now_ms - current_.start_ms > timeout_ms) {
+    finish(CONVERGENCE_TIMED_OUT);
+    return true;
+  }
+  return false;
+}
+
+void ConvergenceTracker::set_config(const convergence_config_t &config) {
+  config_ = config;
+  bool started = false;
+  for (int i = 0; i < MILESTONE_COUNT; i++) started |= current_.reached((convergence_milestone_t)i);
+  if (running_ && !started) current_.config = config; // set up before the receiver had anything to show
+}
+
+const convergence_run_t &ConvergenceTracker::run(size_t i) const {
+  return history_[(head_ + CONVERGENCE_HISTORY - 1 - i) % CONVERGENCE_HISTORY];
+}
+
+const char *convergence_trigger_name(convergence_trigger_t trigger) {
+  switch (trigger) {
+  case CONVERGENCE_BOOT: return "boot";
+  case CONVERGENCE_RESET: return "reset";
+  case CONVERGENCE_CORRECTIONS: return "corrections";
+  }
+  return "";
+}
+
+const char *convergence_end_name(convergence_end_t end) {
+  switch (end) {
+  case CONVERGENCE_RUNNING: return "running";
+  case CONVERGENCE_FIXED: return "fixed";
+  case CONVERGENCE_TIMED_OUT: return "timed_out";
+  case CONVERGENCE_SUPERSEDED: return "superseded";
+  }
+  return "";
+}
+
+const char *convergence_milestone_name(convergence_milestone_t milestone) {
+  const char *names[MILESTONE_COUNT] = {"fix3d", "corrections", "float", "fixed"};
+  return milestone < MILESTONE_COUNT ? names[milestone] : "";
+}
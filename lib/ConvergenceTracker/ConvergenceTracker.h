@@ -0,0 +1,92 @@
+#pragma once
+
+// Time to fix and RTK convergence, measured run by run.
+//
+// A run starts at a trigger: power on, a receiver reset, or corrections coming back after they were
+// lost (gone, or older than corr_age_limit_s). Each epoch is checked against the milestones, 3D fix,
+// corrections in use, RTK float and RTK fixed. The first epoch to reach one stamps it with the time
+// since the trigger, satellites used, correction age and hAcc. A milestone the solution skips (fixed
+// without a float epoch first) gets the stamp of the later one. The run ends at RTK fixed, after
+// timeout_ms, or when a new trigger supersedes it, and goes into a ring of the last
+// CONVERGENCE_HISTORY runs.
+//
+// The caller's config (L-band frequency, keys, rate profile) is copied into every run when it starts,
+// so runs under different configurations can be told apart and compared.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONVERGENCE_HISTORY 16
+#define CONVERGENCE_NOT_REACHED UINT32_MAX
+
+enum convergence_trigger_t { CONVERGENCE_BOOT, CONVERGENCE_RESET, CONVERGENCE_CORRECTIONS };
+enum convergence_end_t { CONVERGENCE_RUNNING, CONVERGENCE_FIXED, CONVERGENCE_TIMED_OUT, CONVERGENCE_SUPERSEDED };
+enum convergence_milestone_t { MILESTONE_3D, MILESTONE_CORRECTIONS, MILESTONE_FLOAT, MILESTONE_FIXED, MILESTONE_COUNT };
+
+struct convergence_config_t {
+  uint32_t lband_frequency; // Hz
+  uint32_t keys_crc; // of the SPARTN keys loaded
+  uint8_t rate_profile;
+};
+
+struct convergence_stamp_t {
+  uint32_t t_ms = CONVERGENCE_NOT_REACHED; // since the trigger
+  uint32_t h_acc = 0; // mm
+  uint16_t corr_age_s = 0; // upper end of the PVT age bucket, 0 for none
+  uint8_t num_sv = 0;
+};
+
+struct convergence_run_t {
+  uint32_t id = 0; // counts up from 1 since power on
+  uint32_t start_ms = 0; // caller's clock at the trigger
+  uint32_t outage_ms = 0; // corrections runs: how long they were lost
+  convergence_trigger_t trigger = CONVERGENCE_BOOT;
+  convergence_end_t end = CONVERGENCE_RUNNING;
+  convergence_config_t config = {};
+  convergence_stamp_t milestones[MILESTONE_COUNT];
+
+  bool reached(convergence_milestone_t milestone) const { return milestones[milestone].t_ms != CONVERGENCE_NOT_REACHED; }
+};
+
+class ConvergenceTracker {
+ public:
+  // Opens a run, true when it superseded one that was still open (ended() has that one)
+  bool start(convergence_trigger_t trigger, uint32_t now_ms, const convergence_config_t &config);
+  // For runs started by update(), and the open run while it has no milestone yet (the boot sequencer
+  // sets the rate profile after the boot run started)
+  void set_config(const convergence_config_t &config);
+
+  // One NAV-PVT epoch, fix_type/carr_soln/corr_age as in NAV-PVT. True when a run ended with this epoch.
+  bool update(uint32_t now_ms, uint8_t fix_type, uint8_t carr_soln, uint8_t corr_age, uint8_t num_sv, uint32_t h_acc);
+  uint8_t new_milestones() const { return new_milestones_; } // bit per milestone reached by the last update()
+
+  bool running() const { return running_; }
+  const convergence_run_t &current() const { return current_; }
+  const convergence_run_t &ended() const { return ended_; } // the run start() or update() just closed
+
+  size_t count() const { return count_; }
+  const convergence_run_t &run(size_t i) const; // 0 is the newest ended run
+
+  uint32_t timeout_ms = 30 * 60 * 1000UL;
+  uint16_t corr_age_limit_s = 30;
+
+ private:
+  void finish(convergence_end_t end);
+
+  convergence_run_t current_;
+  convergence_run_t ended_;
+  convergence_run_t history_[CONVERGENCE_HISTORY];
+  convergence_config_t config_ = {};
+  size_t count_ = 0;
+  size_t head_ = 0; // next history slot
+  uint32_t next_id_ = 1;
+  bool running_ = false;
+  uint8_t new_milestones_ = 0;
+  bool corrections_fresh_ = false;
+  bool corrections_lost_ = false;
+  uint32_t lost_ms_ = 0;
+};
+
+const char *convergence_trigger_name(convergence_trigger_t trigger);
+const char *convergence_end_name(convergence_end_t end);
+const char *convergence_milestone_name(convergence_milestone_t milestone);
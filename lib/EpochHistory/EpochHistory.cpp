@@ -0,0 +1,178 @@
+#include "EpochHistory.h"
+#include <string.h>
+
+// header field offsets
+#define H_T0 0
+#define H_LAT0 4
+#define H_LON0 8
+#define H_HEIGHT0 12
+#define H_HACC0 16
+#define H_VACC0 20
+#define H_STATUS0 24
+#define H_SV0 25
+#define H_COUNT 26
+#define H_USED 28
+
+EpochHistory::EpochHistory(uint8_t *memory, size_t size)
+  : memory_(memory), block_count_(size / HISTORY_BLOCK_SIZE) {
+  memset(&last_, 0, sizeof(last_));
+}
+
+uint8_t *EpochHistory::block(size_t ring_index) const {
+  return memory_ + ((head_ + ring_index) % block_count_) * HISTORY_BLOCK_SIZE;
+}
+
+void EpochHistory::clear() {
+  head_ = 0;
+  used_blocks_ = 0;
+  points_ = 0;
+}
+
+size_t EpochHistory::bytes_used() const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < used_blocks_; i++) {
+    bytes += HISTORY_HEADER_SIZE + get_u16le(block(i) + H_USED);
+  }
+  return bytes;
+}
+
+void EpochHistory::start_block(const history_point_t &point) {
+  if (used_blocks_ == block_count_) { // full, drop the oldest block
+    points_ -= get_u16le(block(0) + H_COUNT);
+    head_ = (head_ + 1) % block_count_;
+    used_blocks_--;
+  }
+  uint8_t *b = block(used_blocks_);
+  used_blocks_++;
+
+  put_u32le(b + H_T0, point.t_ms);
+  put_u32le(b + H_LAT0, point.lat);
+  put_u32le(b + H_LON0, point.lon);
+  put_u32le(b + H_HEIGHT0, point.height);
+  put_u32le(b + H_HACC0, point.hAcc);
+  put_u32le(b + H_VACC0, point.vAcc);
+  b[H_STATUS0] = point.status;
+  b[H_SV0] = point.numSV;
+  put_u16le(b + H_COUNT, 1);
+  put_u16le(b + H_USED, 0);
+}
+
+void EpochHistory::add(const history_point_t &point) {
+  if (block_count_ == 0) return;
+
+  uint8_t *b = used_blocks_ ? block(used_blocks_ - 1) : nullptr;
+  uint16_t used = b ? get_u16le(b + H_USED) : 0;
+  uint32_t dt = point.t_ms - last_.t_ms;
+
+  if (!b || used + HISTORY_MAX_RECORD > HISTORY_BLOCK_SIZE - HISTORY_HEADER_SIZE || dt >= (1u << 30)) {
+    start_block(point);
+  } else {
+    uint8_t *out = b + HISTORY_HEADER_SIZE + used;
+    bool status_changed = point.status != last_.status;
+    bool sv_changed = point.numSV != last_.numSV;
+    size_t n = varint_put(out, dt << 2 | status_changed | sv_changed << 1);
+    n += varint_put_signed(out + n, wrapping_delta(point.lat, last_.lat));
+    n += varint_put_signed(out + n, wrapping_delta(point.lon, last_.lon));
+    n += varint_put_signed(out + n, wrapping_delta(point.height, last_.height));
+    n += varint_put_signed(out + n, (int32_t)(point.hAcc - last_.hAcc));
+    n += varint_put_signed(out + n, (int32_t)(point.vAcc - last_.vAcc));
+    if (status_changed) out[n++] = point.status;
+    if (sv_changed) out[n++] = point.numSV;
+    put_u16le(b + H_USED, used + n);
+    put_u16le(b + H_COUNT, get_u16le(b + H_COUNT) + 1);
+  }
+
+  last_ = point;
+  points_++;
+}
+
+size_t EpochHistory::decode_block(const uint8_t *b, size_t length, point_fn fn, void *ctx) {
+  if (length < HISTORY_HEADER_SIZE) return 0;
+  history_point_t p;
+  p.t_ms = get_u32le(b + H_T0);
+  p.lat = get_u32le(b + H_LAT0);
+  p.lon = get_u32le(b + H_LON0);
+  p.height = get_u32le(b + H_HEIGHT0);
+  p.hAcc = get_u32le(b + H_HACC0);
+  p.vAcc = get_u32le(b + H_VACC0);
+  p.status = b[H_STATUS0];
+  p.numSV = b[H_SV0];
+  uint16_t count = get_u16le(b + H_COUNT);
+  size_t used = get_u16le(b + H_USED);
+  if (HISTORY_HEADER_SIZE + used > length) return 0;
+
+  fn(p, ctx);
+  const uint8_t *in = b + HISTORY_HEADER_SIZE;
+  size_t pos = 0;
+  size_t decoded = 1;
+  for (; decoded < count; decoded++) {
+    uint32_t head;
+    int32_t d[5];
+    size_t n = varint_get(in + pos, used - pos, &head);
+    if (!n) break;
+    pos += n;
+    for (int i = 0; i < 5; i++) {
+      n = varint_get_signed(in + pos, used - pos, &d[i]);
+      if (!n) return decoded;
+      pos += n;
+    }
+    p.t_ms += head >> 2;
+    p.lat = wrapping_add(p.lat, d[0]);
+    p.lon = wrapping_add(p.lon, d[1]);
+    p.height = wrapping_add(p.height, d[2]);
+    p.hAcc += d[3];
+    p.vAcc += d[4];
+    if (head & 1) {
+      if (pos >= used) break;
+      p.status = in[pos++];
+    }
+    if (head & 2) {
+      if (pos >= used) break;
+      p.numSV = in[pos++];
+    }
+    fn(p, ctx);
+  }
+  return decoded;
+}
+
+struct query_state_t {
+  uint32_t from_ms, to_ms, step_ms;
+  uint32_t next_ms;
+  bool emitted_any;
+  size_t emitted;
+  EpochHistory::point_fn fn;
+  void *ctx;
+};
+
+static void query_point(const history_point_t &point, void *ctx) {
+  query_state_t &q = *(query_state_t *)ctx;
+  if ((int32_t)(point.t_ms - q.from_ms) < 0 || (int32_t)(point.t_ms - q.to_ms) > 0) return;
+  if (q.emitted_any && (int32_t)(point.t_ms - q.next_ms) < 0) return; // down-sampled away
+  q.fn(point, q.ctx);
+  q.emitted++;
+  q.emitted_any = true;
+  q.next_ms = point.t_ms + q.step_ms;
+}
+
+size_t EpochHistory::query(uint32_t from_ms, uint32_t to_ms, uint32_t step_ms, point_fn fn, void *ctx) const {
+  query_state_t q = {from_ms, to_ms, step_ms, 0, false, 0, fn, ctx};
+
+  for (size_t i = 0; i < used_blocks_; i++) {
+    const uint8_t *b = block(i);
+    // skip blocks that end before the range: the next block starts after this one ends
+    if (i + 1 < used_blocks_ && (int32_t)(get_u32le(block(i + 1) + H_T0) - from_ms) < 0) continue;
+    if ((int32_t)(get_u32le(b + H_T0) - to_ms) > 0) break;
+    decode_block(b, HISTORY_BLOCK_SIZE, query_point, &q);
+  }
+  return q.emitted;
+}
+
+size_t EpochHistory::for_each_block(block_fn fn, void *ctx) const {
+  size_t sent = 0;
+  for (size_t i = 0; i < used_blocks_; i++) {
+    const uint8_t *b = block(i);
+    if (!fn(b, HISTORY_HEADER_SIZE + get_u16le(b + H_USED), ctx)) break;
+    sent++;
+  }
+  return sent;
+}
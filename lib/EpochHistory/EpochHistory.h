@@ -0,0 +1,71 @@
+#pragma once
+
+// Fixed-memory ring of recent epochs, delta encoded.
+//
+// The buffer is split into HISTORY_BLOCK_SIZE blocks. Each block starts with an absolute keyframe
+// (the header) followed by varint/zigzag deltas from the previous point, a stationary 1 Hz epoch
+// takes about 8 bytes. When the ring is full the oldest block is dropped. Blocks are sent to the
+// browser as-is, so the wire format is the storage format:
+//
+//   header (HISTORY_HEADER_SIZE bytes, little-endian)
+//     u32 t0_ms, i32 lat0, i32 lon0 (deg * 1e-7), i32 height0 (mm), u32 hAcc0, u32 vAcc0 (mm),
+//     u8 status0 (fixType | carrSoln << 3), u8 numSV0, u16 count (points incl. keyframe), u16 used (data bytes)
+//   data, per point after the keyframe
+//     varint (dt_ms << 2 | status_changed | sv_changed << 1)
+//     zigzag varint dlat, dlon, dheight, dhAcc, dvAcc
+//     [u8 status] [u8 numSV] when flagged
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Varint.h>
+
+#define HISTORY_BLOCK_SIZE 512
+#define HISTORY_HEADER_SIZE 30
+#define HISTORY_MAX_RECORD (VARINT_MAX_BYTES * 6 + 2)
+
+struct history_point_t {
+  uint32_t t_ms;
+  int32_t lat, lon; // deg * 1e-7
+  int32_t height; // mm
+  uint32_t hAcc, vAcc; // mm
+  uint8_t status; // fixType | carrSoln << 3
+  uint8_t numSV;
+};
+
+class EpochHistory {
+ public:
+  typedef void (*point_fn)(const history_point_t &point, void *ctx);
+  typedef bool (*block_fn)(const uint8_t *block, size_t length, void *ctx); // return false to stop
+
+  // memory is owned by the caller and must outlive the history
+  EpochHistory(uint8_t *memory, size_t size);
+
+  void add(const history_point_t &point);
+  void clear();
+
+  // Points with from_ms <= t_ms <= to_ms, at most one per step_ms (0 = all). Returns points emitted.
+  // Times compare wrap-safe, so the range has to stay within 2^31 ms of the stored points.
+  size_t query(uint32_t from_ms, uint32_t to_ms, uint32_t step_ms, point_fn fn, void *ctx) const;
+
+  // Oldest to newest, each block trimmed to header + used bytes
+  size_t for_each_block(block_fn fn, void *ctx) const;
+
+  size_t points() const { return points_; }
+  size_t blocks() const { return used_blocks_; }
+  size_t capacity_blocks() const { return block_count_; }
+  size_t bytes_used() const;
+
+  // decode one block (wire format), returns points decoded
+  static size_t decode_block(const uint8_t *block, size_t length, point_fn fn, void *ctx);
+
+ private:
+  uint8_t *block(size_t ring_index) const;
+  void start_block(const history_point_t &point);
+
+  uint8_t *memory_;
+  size_t block_count_;
+  size_t head_ = 0; // oldest block
+  size_t used_blocks_ = 0;
+  size_t points_ = 0;
+  history_point_t last_;
+};
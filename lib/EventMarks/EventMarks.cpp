@@ -0,0 +1,75 @@
+#include "EventMarks.h"
+
+bool EventRing::push(const event_mark_t &mark) {
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  uint32_t used = head - tail_.load(std::memory_order_acquire);
+  if (used >= EVENT_RING_SIZE) {
+    dropped_++;
+    return false;
+  }
+  marks_[head % EVENT_RING_SIZE] = mark;
+  head_.store(head + 1, std::memory_order_release); // publishes the mark
+  if (used + 1 > high_water_) high_water_ = used + 1;
+  return true;
+}
+
+const event_mark_t *EventRing::front() const {
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_.load(std::memory_order_acquire)) return nullptr;
+  return &marks_[tail % EVENT_RING_SIZE];
+}
+
+void EventRing::pop() {
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_.load(std::memory_order_acquire)) return;
+  tail_.store(tail + 1, std::memory_order_release); // the slot is free for the producer again
+}
+
+void PositionWindow::add(const position_sample_t &sample) {
+  if (count_ == EVENT_WINDOW_EPOCHS) {
+    for (uint8_t i = 1; i < count_; i++) samples_[i - 1] = samples_[i];
+    count_--;
+  }
+  samples_[count_++] = sample;
+}
+
+// a - b in ms across the end of the week
+static int32_t tow_diff_ms(uint32_t a, uint32_t b) {
+  int32_t diff = (int32_t)(a - b);
+  if (diff > 302400000) diff -= 604800000;
+  else if (diff < -302400000) diff += 604800000;
+  return diff;
+}
+
+static int64_t mark_offset_ns(const event_mark_t &mark, const position_sample_t &sample) {
+  return (int64_t)tow_diff_ms(mark.tow_ms, sample.tow_ms) * 1000000 + mark.tow_sub_ns;
+}
+
+event_match_t PositionWindow::match(const event_mark_t &mark, position_sample_t &position) const {
+  if (count_ == 0) return EVENT_WAIT;
+  int64_t after_newest = mark_offset_ns(mark, samples_[count_ - 1]);
+  if (after_newest > 0) return EVENT_WAIT;
+  if (after_newest == 0) {
+    position = samples_[count_ - 1];
+    return EVENT_MATCHED;
+  }
+
+  for (int i = count_ - 2; i >= 0; i--) {
+    const position_sample_t &before = samples_[i];
+    const position_sample_t &after = samples_[i + 1];
+    int64_t offset = mark_offset_ns(mark, before);
+    if (offset < 0) continue;
+
+    int32_t gap_ms = tow_diff_ms(after.tow_ms, before.tow_ms);
+    if (gap_ms <= 0 || (uint32_t)gap_ms > max_gap_ms) return EVENT_UNMATCHED;
+    double f = (double)offset / ((double)gap_ms * 1000000);
+    position.tow_ms = mark.tow_ms;
+    position.lat = before.lat + (int64_t)((after.lat - before.lat) * f);
+    position.lon = before.lon + (int64_t)((after.lon - before.lon) * f);
+    position.height = before.height + (int64_t)((after.height - before.height) * f);
+    position.h_acc = before.h_acc > after.h_acc ? before.h_acc : after.h_acc;
+    position.v_acc = before.v_acc > after.v_acc ? before.v_acc : after.v_acc;
+    return EVENT_MATCHED;
+  }
+  return EVENT_UNMATCHED; // older than the window
+}
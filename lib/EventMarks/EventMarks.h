@@ -0,0 +1,77 @@
+#pragma once
+
+// Camera shutter (EXTINT) event marks from UBX-TIM-TM2, matched to the position at the mark.
+//
+// EventRing is a single-producer single-consumer ring: the TIM-TM2 callback pushes, the SD writer
+// pops, no locks, so the callback never waits on the card even if it moves to another task. A full
+// ring drops the new mark and counts it.
+//
+// PositionWindow keeps the last few high-precision epochs (NAV-HPPOSLLH). A mark is placed between
+// the epoch before and the epoch after it by linear interpolation in time, so it can only be matched
+// once the next epoch is in. Times are GPS time of week in ms, marks carry the sub-ms part in ns.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define EVENT_RING_SIZE 64 // power of two, 3 s of marks at 20 Hz
+#define EVENT_WINDOW_EPOCHS 8
+
+struct event_mark_t {
+  uint16_t count; // TIM-TM2 rising edge counter
+  uint16_t week;
+  uint32_t tow_ms;
+  uint32_t tow_sub_ns;
+  uint32_t acc_ns; // time accuracy estimate
+  uint8_t time_base; // 0 receiver, 1 GNSS, 2 UTC
+  bool time_valid;
+  uint32_t captured_us; // when the callback saw it, for the latency numbers
+};
+
+class EventRing {
+ public:
+  // producer
+  bool push(const event_mark_t &mark);
+
+  // consumer, front() is nullptr when empty
+  const event_mark_t *front() const;
+  void pop();
+
+  uint32_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  uint32_t high_water() const { return high_water_; }
+  uint32_t dropped() const { return dropped_; }
+  void reset_stats() { high_water_ = size(); dropped_ = 0; }
+
+ private:
+  event_mark_t marks_[EVENT_RING_SIZE];
+  std::atomic<uint32_t> head_{0}; // written by the producer only
+  std::atomic<uint32_t> tail_{0}; // written by the consumer only
+  uint32_t high_water_ = 0; // producer side
+  uint32_t dropped_ = 0;
+};
+
+struct position_sample_t {
+  uint32_t tow_ms;
+  int64_t lat, lon; // deg * 1e-9
+  int64_t height; // mm * 10
+  uint32_t h_acc, v_acc; // mm * 10
+};
+
+enum event_match_t {
+  EVENT_MATCHED, // between two epochs
+  EVENT_WAIT, // after the newest epoch, try again once the next one is in
+  EVENT_UNMATCHED // before the window or in a gap longer than max_gap_ms
+};
+
+class PositionWindow {
+ public:
+  void add(const position_sample_t &sample);
+  void clear() { count_ = 0; }
+  event_match_t match(const event_mark_t &mark, position_sample_t &position) const;
+
+  uint32_t max_gap_ms = 1500; // epochs further apart than this are not interpolated between
+
+ private:
+  position_sample_t samples_[EVENT_WINDOW_EPOCHS]; // oldest first
+  uint8_t count_ = 0;
+};
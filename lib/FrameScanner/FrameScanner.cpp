@@ -0,0 +1,201 @@
+#include "FrameScanner.h"
+#include <Checksum.h>
+#include <string.h>
+
+frame_span_t frame_span_t::sub(size_t offset, size_t length) const {
+  frame_span_t out;
+  if (offset < first_length) {
+    out.first = first + offset;
+    out.first_length = first_length - offset < length ? first_length - offset : length;
+    if (length > out.first_length) {
+      out.second = second;
+      out.second_length = length - out.first_length;
+    }
+  } else {
+    out.first = second + (offset - first_length);
+    out.first_length = length;
+  }
+  return out;
+}
+
+void frame_span_t::copy_to(uint8_t *out) const {
+  memcpy(out, first, first_length);
+  if (second_length) memcpy(out + first_length, second, second_length);
+}
+
+static bool ubx_checksum_ok(const frame_span_t &frame, size_t payload_length) {
+  uint32_t a = 0, b = 0;
+  frame_span_t covered = frame.sub(2, payload_length + 4);
+  ubx_checksum_update(a, b, covered.first, covered.first_length);
+  ubx_checksum_update(a, b, covered.second, covered.second_length);
+  return (uint8_t)a == frame[payload_length + 6] && (uint8_t)b == frame[payload_length + 7];
+}
+
+static bool rtcm_crc_ok(const frame_span_t &frame, size_t payload_length) {
+  frame_span_t covered = frame.sub(0, payload_length + 3);
+  uint32_t crc = crc24q_update(0, covered.first, covered.first_length);
+  crc = crc24q_update(crc, covered.second, covered.second_length);
+  size_t end = payload_length + 3;
+  return crc == ((uint32_t)frame[end] << 16 | (uint32_t)frame[end + 1] << 8 | frame[end + 2]);
+}
+
+// Index of the next byte that could start a frame, or length
+static size_t find_sync(const frame_span_t &bytes, size_t from) {
+  size_t length = bytes.length();
+  while (from < length) {
+    const uint8_t *part = from < bytes.first_length ? bytes.first : bytes.second;
+    size_t start = from < bytes.first_length ? from : from - bytes.first_length;
+    size_t end = from < bytes.first_length ? bytes.first_length : bytes.second_length;
+    for (size_t i = start; i < end; i++) {
+      if (part[i] == UBX_SYNC_1 || part[i] == RTCM3_PREAMBLE) return from + (i - start);
+    }
+    from += end - start;
+  }
+  return length;
+}
+
+bool frame_scan(const frame_span_t &bytes, size_t max_frame, frame_t &frame, size_t &skipped, frame_stats_t &stats, bool end_of_input) {
+  size_t length = bytes.length();
+  size_t i = find_sync(bytes, 0);
+
+  while (i < length) {
+    size_t left = length - i;
+    bool incomplete = false; // a candidate cut off by the end of the bytes
+    if (bytes[i] == UBX_SYNC_1) {
+      if (left < 2) {
+        incomplete = true;
+      } else if (bytes[i + 1] == UBX_SYNC_2) {
+        if (left < 6) {
+          incomplete = true;
+        } else {
+          size_t payload_length = bytes[i + 4] | bytes[i + 5] << 8;
+          size_t frame_length = payload_length + UBX_FRAME_OVERHEAD;
+          if (frame_length > max_frame) {
+            // announces more than is worth waiting for, noise
+          } else if (left < frame_length) {
+            incomplete = true;
+          } else {
+            frame_span_t candidate = bytes.sub(i, frame_length);
+            if (ubx_checksum_ok(candidate, payload_length)) {
+              frame.protocol = FRAME_UBX;
+              frame.type = bytes[i + 2] << 8 | bytes[i + 3];
+              frame.bytes = candidate;
+              frame.payload_length = payload_length;
+              stats.ubx_frames++;
+              stats.frame_bytes += frame_length;
+              stats.skipped_bytes += i;
+              skipped = i;
+              return true;
+            }
+            stats.ubx_bad++;
+          }
+        }
+      }
+    } else {
+      if (left < 3) {
+        incomplete = true;
+      } else if ((bytes[i + 1] & 0xfc) == 0) { // 6 reserved bits
+        size_t payload_length = (bytes[i + 1] & 0x03) << 8 | bytes[i + 2];
+        size_t frame_length = payload_length + RTCM3_FRAME_OVERHEAD;
+        if (frame_length > max_frame) {
+          // as for UBX
+        } else if (left < frame_length) {
+          incomplete = true;
+        } else {
+          frame_span_t candidate = bytes.sub(i, frame_length);
+          if (rtcm_crc_ok(candidate, payload_length)) {
+            frame.protocol = FRAME_RTCM3;
+            frame.type = payload_length >= 2 ? bytes[i + 3] << 4 | bytes[i + 4] >> 4 : 0;
+            frame.bytes = candidate;
+            frame.payload_length = payload_length;
+            stats.rtcm_frames++;
+            stats.frame_bytes += frame_length;
+            stats.skipped_bytes += i;
+            skipped = i;
+            return true;
+          }
+          stats.rtcm_bad++;
+        }
+      }
+    }
+    // More bytes may complete it, keep it from here. At the end of the input nothing will, and a
+    // false sync announcing a long frame must not hide the real frames after it.
+    if (incomplete && !end_of_input) break;
+    i = find_sync(bytes, i + 1); // not a frame, resync on the next candidate
+  }
+
+  stats.skipped_bytes += i;
+  skipped = i;
+  return false;
+}
+
+FrameRing::FrameRing(uint8_t *buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+uint8_t *FrameRing::write_span(size_t &length) {
+  size_t at = head_ & (size_ - 1);
+  size_t to_end = size_ - at;
+  length = free() < to_end ? free() : to_end;
+  return buffer_ + at;
+}
+
+void FrameRing::commit(size_t length) {
+  head_ += length;
+  if (used() > high_water_) high_water_ = used();
+}
+
+size_t FrameRing::write(const uint8_t *data, size_t length) {
+  size_t written = 0;
+  while (written < length) {
+    size_t space;
+    uint8_t *out = write_span(space);
+    if (space == 0) break;
+    size_t n = length - written < space ? length - written : space;
+    memcpy(out, data + written, n);
+    commit(n);
+    written += n;
+  }
+  if (written < length) overruns_++;
+  return written;
+}
+
+frame_span_t FrameRing::span(size_t offset, size_t length) const {
+  frame_span_t out;
+  size_t at = (tail_ + offset) & (size_ - 1);
+  size_t to_end = size_ - at;
+  out.first = buffer_ + at;
+  out.first_length = length < to_end ? length : to_end;
+  if (length > out.first_length) {
+    out.second = buffer_;
+    out.second_length = length - out.first_length;
+  }
+  return out;
+}
+
+bool FrameRing::next(frame_t &frame) {
+  if (pending_) {
+    frame = pending_frame_;
+    return true;
+  }
+  size_t skipped;
+  bool found = frame_scan(span(0, used()), size_, frame, skipped, stats_);
+  tail_ += skipped; // the frame spans point into the buffer, moving the tail does not move them
+  if (found) {
+    pending_ = true;
+    pending_frame_ = frame;
+  }
+  return found;
+}
+
+void FrameRing::release(const frame_t &) {
+  if (!pending_) return;
+  pending_ = false;
+  tail_ += pending_frame_.length();
+}
+
+void FrameRing::reset() {
+  head_ = tail_ = 0;
+  pending_ = false;
+  high_water_ = 0;
+  overruns_ = 0;
+  stats_ = frame_stats_t();
+}
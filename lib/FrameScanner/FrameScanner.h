@@ -0,0 +1,101 @@
+#pragma once
+
+// Incremental UBX and RTCM3 frame scanner that works in place on the receiver bytes.
+//
+// frame_scan() looks at a span of bytes, possibly in two parts when it wraps around a ring, and
+// finds the first frame whose checksum holds: UBX (b5 62, class, id, length, Fletcher) or RTCM3
+// (d3, 10-bit length, CRC-24Q). Frames come back as spans into the caller's bytes, nothing is
+// copied. NMEA and anything else between frames is skipped and counted. A sync pattern with a bad
+// checksum only skips its first byte, so a false sync inside noise cannot swallow a real frame.
+//
+// FrameRing owns the indices of a power-of-two ring buffer the caller provides. The producer reads
+// straight into write_span() or copies with write(), the consumer takes next() and release()s the
+// frame when it is done with it (logged, relayed, served). A frame that does not fit the ring can
+// never complete, so sync patterns announcing one are treated as noise.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define UBX_SYNC_1 0xb5
+#define UBX_SYNC_2 0x62
+#define RTCM3_PREAMBLE 0xd3
+#define UBX_FRAME_OVERHEAD 8 // sync, class, id, length, checksum
+#define RTCM3_FRAME_OVERHEAD 6 // preamble, length, CRC
+#define RTCM3_PAYLOAD_MAX 1023
+
+enum frame_protocol_t { FRAME_UBX, FRAME_RTCM3 };
+
+// Bytes in at most two parts, second is the part that wrapped to the start of a ring
+struct frame_span_t {
+  const uint8_t *first = nullptr;
+  size_t first_length = 0;
+  const uint8_t *second = nullptr;
+  size_t second_length = 0;
+
+  size_t length() const { return first_length + second_length; }
+  uint8_t operator[](size_t i) const { return i < first_length ? first[i] : second[i - first_length]; }
+  frame_span_t sub(size_t offset, size_t length) const;
+  void copy_to(uint8_t *out) const; // for consumers that need one contiguous frame
+};
+
+struct frame_t {
+  frame_protocol_t protocol;
+  uint16_t type; // UBX class << 8 | id, RTCM3 message number (0 for an empty payload)
+  frame_span_t bytes; // the whole frame, sync to checksum
+  size_t payload_length;
+
+  size_t length() const { return bytes.length(); }
+  frame_span_t payload() const { return bytes.sub(protocol == FRAME_UBX ? 6 : 3, payload_length); }
+};
+
+struct frame_stats_t {
+  uint32_t ubx_frames = 0;
+  uint32_t rtcm_frames = 0;
+  uint32_t ubx_bad = 0; // sync and length looked right, checksum did not
+  uint32_t rtcm_bad = 0;
+  uint64_t skipped_bytes = 0; // noise, NMEA and the first byte of every bad frame
+  uint64_t frame_bytes = 0;
+};
+
+// Scans bytes from the start. Returns true with frame and skipped (bytes before the frame) set, or
+// false with skipped set to the bytes that can be dropped because no frame can start in them. The
+// rest may be the start of a frame that is not complete yet. max_frame caps the frame length that is
+// worth waiting for, the ring size for a ring. With end_of_input no more bytes follow: a candidate
+// cut off by the end is noise, the scan goes on after its first byte and a false result has
+// skipped everything.
+bool frame_scan(const frame_span_t &bytes, size_t max_frame, frame_t &frame, size_t &skipped, frame_stats_t &stats,
+                bool end_of_input = false);
+
+class FrameRing {
+ public:
+  FrameRing(uint8_t *buffer, size_t size); // size a power of two
+
+  // producer: contiguous free space to read into, then commit what was read
+  uint8_t *write_span(size_t &length);
+  void commit(size_t length);
+  size_t write(const uint8_t *data, size_t length); // copies what fits, returns that
+
+  // consumer: the frame stays valid until it is released, next() returns the same frame until then
+  bool next(frame_t &frame);
+  void release(const frame_t &frame);
+
+  size_t used() const { return head_ - tail_; }
+  size_t free() const { return size_ - used(); }
+  size_t size() const { return size_; }
+  size_t high_water() const { return high_water_; }
+  uint32_t overruns() const { return overruns_; } // write() calls that could not take everything
+  const frame_stats_t &stats() const { return stats_; }
+  void reset();
+
+ private:
+  frame_span_t span(size_t offset, size_t length) const;
+
+  uint8_t *buffer_;
+  size_t size_;
+  size_t head_ = 0, tail_ = 0; // free running, masked on access
+  size_t high_water_ = 0;
+  uint32_t overruns_ = 0;
+  frame_stats_t stats_;
+  bool pending_ = false; // handed out by next(), not released yet
+  frame_t pending_frame_;
+};
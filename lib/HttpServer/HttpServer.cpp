@@ -0,0 +1,651 @@
+#include "HttpServer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#if defined(ESP_PLATFORM)
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xa
+
+static void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static bool would_block() {
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static const char *status_text(int code) {
+  switch (code) {
+  case 101: return "Switching Protocols";
+  case 200: return "OK";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 413: return "Payload Too Large";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error";
+  case 503: return "Service Unavailable";
+  default: return "";
+  }
+}
+
+std::string http_request_t::header(const char *name) const {
+  size_t name_length = strlen(name);
+  for (size_t line = 0; line < headers.size();) {
+    size_t end = headers.find("\r\n", line);
+    if (end == std::string::npos) end = headers.size();
+    if (end - line > name_length && headers[line + name_length] == ':' && strncasecmp(headers.c_str() + line, name, name_length) == 0) {
+      size_t value = headers.find_first_not_of(' ', line + name_length + 1);
+      size_t value_end = headers.find_last_not_of(' ', end - 1);
+      return value < end ? headers.substr(value, value_end + 1 - value) : "";
+    }
+    line = end + 2;
+  }
+  return "";
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+std::string http_request_t::arg(const char *name) const {
+  size_t name_length = strlen(name);
+  for (size_t start = 0; start < query.size();) {
+    size_t end = query.find('&', start);
+    if (end == std::string::npos) end = query.size();
+    if (end - start >= name_length && query.compare(start, name_length, name) == 0 && (end - start == name_length || query[start + name_length] == '=')) {
+      std::string value;
+      for (size_t i = start + name_length + 1; i < end; i++) {
+        if (query[i] == '+') {
+          value += ' ';
+        } else if (query[i] == '%' && i + 2 < end && hex_value(query[i + 1]) >= 0 && hex_value(query[i + 2]) >= 0) {
+          value += (char)(hex_value(query[i + 1]) << 4 | hex_value(query[i + 2]));
+          i += 2;
+        } else {
+          value += query[i];
+        }
+      }
+      return value;
+    }
+    start = end + 1;
+  }
+  return "";
+}
+
+HttpServer::HttpServer(clock_ms_fn now_ms) : now_ms_(now_ms) {}
+
+HttpServer::~HttpServer() {
+  stop();
+}
+
+bool HttpServer::begin(uint16_t port) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) return false;
+  int yes = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd_, HTTP_MAX_CONNECTIONS) != 0) {
+    stop();
+    return false;
+  }
+  set_nonblocking(listen_fd_);
+
+  socklen_t length = sizeof(addr);
+  getsockname(listen_fd_, (struct sockaddr *)&addr, &length);
+  port_ = ntohs(addr.sin_port);
+  return true;
+}
+
+void HttpServer::stop() {
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections_[i].state != FREE) close_connection(i);
+  }
+  if (listen_fd_ >= 0) close(listen_fd_);
+  listen_fd_ = -1;
+}
+
+void HttpServer::on(const char *path, handler_fn handler) {
+  if (route_count_ < HTTP_MAX_ROUTES) routes_[route_count_++] = {path, handler};
+}
+
+void HttpServer::on_not_found(handler_fn handler) {
+  not_found_ = handler;
+}
+
+void HttpServer::on_ws_event(const char *path, ws_event_fn handler) {
+  ws_path_ = path;
+  ws_event_ = handler;
+}
+
+void HttpServer::service() {
+  if (listen_fd_ < 0) return;
+  accept_connections();
+
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    connection_t &c = connections_[i];
+    if (c.state == FREE) continue;
+
+    read_connection(i);
+    if (c.state == READING) {
+      while (c.state == READING && handle_request(i)) {}
+    } else if (c.state == WEBSOCKET) {
+      handle_frames(i);
+    }
+    if (c.state == FREE) continue;
+    write_connection(i);
+    if (c.state == FREE) continue;
+
+    uint32_t now = now_ms_(); // after the reads and writes that stamp the connection
+    if (c.state == WEBSOCKET) {
+      if (now - c.last_heard_ms > HTTP_WS_TIMEOUT_MS) {
+        stats_.timeouts++;
+        close_connection(i);
+      } else if (now - c.last_ping_ms > HTTP_WS_PING_MS) {
+        queue_frame(i, WS_OP_PING, nullptr, 0);
+        c.last_ping_ms = now;
+      }
+    } else if (now - c.last_heard_ms > HTTP_IDLE_TIMEOUT_MS && now - c.last_sent_ms > HTTP_IDLE_TIMEOUT_MS) {
+      stats_.timeouts++; // idle keep-alive, a request that never finished or a reader that stopped
+      close_connection(i);
+    }
+  }
+}
+
+void HttpServer::accept_connections() {
+  for (;;) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) return;
+    set_nonblocking(fd);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    int slot = -1;
+    for (int pass = 0; pass < 2 && slot < 0; pass++) {
+      for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (connections_[i].state == FREE) {
+          slot = i;
+          break;
+        }
+      }
+      if (slot < 0 && !evict_idle()) break;
+    }
+    if (slot < 0) {
+      reject(fd, 503);
+      continue;
+    }
+
+    connection_t &c = connections_[slot];
+    c.fd = fd;
+    c.state = READING;
+    c.last_heard_ms = c.last_sent_ms = now_ms_();
+    stats_.accepted++;
+  }
+}
+
+// A keep-alive connection is only idle when neither its buffers nor its socket hold anything: a
+// request that arrived since the last read is still waiting in the socket and must not be dropped.
+bool HttpServer::evict_idle() {
+  int oldest = -1;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    const connection_t &c = connections_[i];
+    if (c.state != READING || !c.in.empty() || !c.out.empty()) continue;
+    char byte;
+    if (recv(c.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) > 0) continue;
+    if (oldest < 0 || (int32_t)(c.last_heard_ms - connections_[oldest].last_heard_ms) < 0) oldest = i;
+  }
+  if (oldest < 0) return false;
+  close_connection(oldest);
+  return true;
+}
+
+// best effort, the socket is new and its send buffer empty
+void HttpServer::reject(int fd, int code) {
+  char response[128];
+  int length = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", code, status_text(code));
+  ::send(fd, response, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+  close(fd);
+  stats_.rejected++;
+}
+
+void HttpServer::read_connection(uint8_t i) {
+  connection_t &c = connections_[i];
+  // stop reading once a whole request or frame is buffered, TCP pushes back on the client
+  size_t limit = c.state == WEBSOCKET ? HTTP_WS_MAX_MESSAGE + 14 : HTTP_MAX_REQUEST + HTTP_MAX_BODY;
+  char buffer[512];
+  while (c.in.size() < limit || c.state == CLOSING) {
+    ssize_t n = recv(c.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n > 0) {
+      if (c.state != CLOSING) c.in.append(buffer, n);
+      c.last_heard_ms = now_ms_();
+      continue;
+    }
+    if (n < 0 && would_block()) return;
+    if (n < 0 && errno == EINTR) continue;
+    close_connection(i); // closed by the peer or reset
+    return;
+  }
+}
+
+void HttpServer::write_connection(uint8_t i) {
+  connection_t &c = connections_[i];
+  for (;;) {
+    if (c.out.empty()) {
+      if (!c.stream) break;
+      char chunk[HTTP_STREAM_CHUNK + 12];
+      size_t want = HTTP_STREAM_CHUNK;
+      if (c.stream_left >= 0 && c.stream_left < (int64_t)want) want = c.stream_left;
+      size_t length = c.stream((uint8_t *)chunk + 8, want);
+      if (length == 0) {
+        c.stream = nullptr;
+        if (c.chunked) queue(i, "0\r\n\r\n");
+        if (c.stream_left > 0) c.keep_alive = false; // shorter than announced, only the close ends it
+        continue;
+      } else if (!c.chunked) {
+        if (c.stream_left > 0) c.stream_left -= length;
+        queue(i, std::string(chunk + 8, length));
+      } else {
+        char size_line[9];
+        int n = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned)length);
+        memcpy(chunk + 8 - n, size_line, n); // size line right in front of the data
+        memcpy(chunk + 8 + length, "\r\n", 2);
+        queue(i, std::string(chunk + 8 - n, n + length + 2));
+      }
+    }
+
+    const std::string &front = c.out.front();
+    ssize_t n = ::send(c.fd, front.data() + c.out_offset, front.size() - c.out_offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0) {
+      c.out_offset += n;
+      c.out_bytes -= n;
+      c.last_sent_ms = now_ms_();
+      if (c.out_offset == front.size()) {
+        c.out.pop_front();
+        c.out_offset = 0;
+      }
+      continue;
+    }
+    if (n < 0 && would_block()) return;
+    if (n < 0 && errno == EINTR) continue;
+    close_connection(i);
+    return;
+  }
+
+  if (c.state == WRITING) { // response fully handed to TCP
+    if (c.keep_alive) {
+      c.state = READING;
+    } else {
+      close_connection(i);
+    }
+  } else if (c.state == CLOSING) {
+    close_connection(i);
+  }
+}
+
+bool HttpServer::handle_request(uint8_t i) {
+  connection_t &c = connections_[i];
+  size_t header_end = c.in.find("\r\n\r\n");
+  if (header_end == std::string::npos) {
+    if (c.in.size() > HTTP_MAX_REQUEST) {
+      stats_.rejected++;
+      c.state = WRITING;
+      c.keep_alive = false;
+      c.responded = false;
+      http_request_t request;
+      request.connection = i;
+      send(request, 431, "text/plain", "");
+    }
+    return false;
+  }
+
+  http_request_t request;
+  request.connection = i;
+  size_t line_end = c.in.find("\r\n");
+  size_t method_end = c.in.find(' ');
+  size_t target_end = method_end < line_end ? c.in.find(' ', method_end + 1) : std::string::npos;
+  bool valid = method_end < line_end && target_end < line_end;
+  std::string version = valid ? c.in.substr(target_end + 1, line_end - target_end - 1) : "";
+  if (valid) {
+    request.method = c.in.substr(0, method_end);
+    std::string target = c.in.substr(method_end + 1, target_end - method_end - 1);
+    size_t question = target.find('?');
+    request.path = target.substr(0, question);
+    request.query = question == std::string::npos ? "" : target.substr(question + 1);
+    request.headers = c.in.substr(line_end + 2, header_end + 2 - line_end - 2);
+  }
+
+  size_t body_length = valid ? strtoul(request.header("Content-Length").c_str(), nullptr, 10) : 0;
+  if (!valid || body_length > HTTP_MAX_BODY || version.compare(0, 5, "HTTP/") != 0) {
+    stats_.rejected++;
+    c.in.clear();
+    c.state = WRITING;
+    c.keep_alive = false;
+    c.responded = false;
+    send(request, valid ? 413 : 400, "text/plain", "");
+    return false;
+  }
+  if (c.in.size() < header_end + 4 + body_length) return false; // body still arriving
+  request.body = c.in.substr(header_end + 4, body_length);
+  c.in.erase(0, header_end + 4 + body_length);
+  stats_.requests++;
+
+  std::string connection = request.header("Connection");
+  c.keep_alive = version == "HTTP/1.0" ? strcasecmp(connection.c_str(), "keep-alive") == 0 : strcasecmp(connection.c_str(), "close") != 0;
+  c.http10 = version == "HTTP/1.0";
+  c.head = request.method == "HEAD";
+  c.responded = false;
+  c.state = WRITING;
+
+  if (strcasecmp(request.header("Upgrade").c_str(), "websocket") == 0 && upgrade(i, request)) return true;
+
+  handler_fn handler = not_found_;
+  for (uint8_t r = 0; r < route_count_; r++) {
+    if (routes_[r].path == request.path) handler = routes_[r].handler;
+  }
+  if (handler) handler(request);
+  if (!c.responded) {
+    send(request, handler ? 500 : 404, "text/plain", handler ? "No response" : "Not found");
+  }
+  return true;
+}
+
+bool HttpServer::upgrade(uint8_t i, const http_request_t &request) {
+  connection_t &c = connections_[i];
+  std::string key = request.header("Sec-WebSocket-Key");
+  if (!ws_event_ || request.path != ws_path_ || key.empty()) return false; // answered as a plain request
+
+  queue(i, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " + http_ws_accept_key(key) + "\r\n\r\n");
+  c.state = WEBSOCKET;
+  c.responded = true;
+  c.last_ping_ms = now_ms_();
+  c.ws_message.clear();
+  c.ws_opcode = 0;
+  ws_event_(i, HTTP_WS_CONNECTED, nullptr, 0);
+  return true;
+}
+
+bool HttpServer::handle_frames(uint8_t i) {
+  connection_t &c = connections_[i];
+  while (c.state == WEBSOCKET) {
+    const uint8_t *p = (const uint8_t *)c.in.data();
+    size_t available = c.in.size();
+    if (available < 2) return true;
+
+    bool fin = p[0] & 0x80;
+    uint8_t opcode = p[0] & 0x0f;
+    bool masked = p[1] & 0x80;
+    uint64_t length = p[1] & 0x7f;
+    size_t pos = 2;
+    if (length == 126) {
+      if (available < 4) return true;
+      length = (uint64_t)p[2] << 8 | p[3];
+      pos = 4;
+    } else if (length == 127) {
+      if (available < 10) return true;
+      length = 0;
+      for (int b = 0; b < 8; b++) length = length << 8 | p[2 + b];
+      pos = 10;
+    }
+
+    uint16_t error = 0;
+    if (!masked) error = 1002; // clients must mask
+    if (length > HTTP_WS_MAX_MESSAGE || c.ws_message.size() + length > HTTP_WS_MAX_MESSAGE) error = 1009;
+    if (error) {
+      uint8_t code[2] = {(uint8_t)(error >> 8), (uint8_t)error};
+      queue_frame(i, WS_OP_CLOSE, (const char *)code, 2);
+      c.state = CLOSING;
+      ws_event_(i, HTTP_WS_DISCONNECTED, nullptr, 0);
+      return false;
+    }
+    if (available < pos + 4 + length) return true;
+
+    const uint8_t *mask = p + pos;
+    std::string payload(length, '\0');
+    for (size_t b = 0; b < length; b++) payload[b] = p[pos + 4 + b] ^ mask[b % 4];
+    c.in.erase(0, pos + 4 + length);
+
+    switch (opcode) {
+    case WS_OP_CLOSE:
+      queue_frame(i, WS_OP_CLOSE, payload.data(), payload.size() < 2 ? payload.size() : 2); // echo the status code
+      c.state = CLOSING;
+      ws_event_(i, HTTP_WS_DISCONNECTED, nullptr, 0);
+      return false;
+    case WS_OP_PING:
+      queue_frame(i, WS_OP_PONG, payload.data(), payload.size());
+      break;
+    case WS_OP_PONG:
+      break;
+    case WS_OP_TEXT:
+    case WS_OP_BINARY:
+    case WS_OP_CONTINUATION: {
+      if ((opcode == WS_OP_CONTINUATION) == (c.ws_opcode == 0)) { // continuation without a start, or a new message mid-way
+        uint8_t code[2] = {1002 >> 8, 1002 & 0xff};
+        queue_frame(i, WS_OP_CLOSE, (const char *)code, 2);
+        c.state = CLOSING;
+        ws_event_(i, HTTP_WS_DISCONNECTED, nullptr, 0);
+        return false;
+      }
+      if (opcode != WS_OP_CONTINUATION) c.ws_opcode = opcode;
+      c.ws_message += payload;
+      if (!fin) break;
+
+      std::string message;
+      message.swap(c.ws_message); // the handler may close this connection
+      http_ws_event_t type = c.ws_opcode == WS_OP_TEXT ? HTTP_WS_TEXT : HTTP_WS_BINARY;
+      c.ws_opcode = 0;
+      stats_.ws_messages++;
+      size_t message_length = message.size();
+      message.push_back('\0'); // handlers may treat text as a C string
+      ws_event_(i, type, (uint8_t *)&message[0], message_length);
+      break;
+    }
+    default:
+      break; // reserved opcodes are ignored
+    }
+  }
+  return true;
+}
+
+void HttpServer::queue(uint8_t i, std::string data) {
+  connection_t &c = connections_[i];
+  c.out_bytes += data.size();
+  c.out.push_back(std::move(data));
+}
+
+void HttpServer::queue_frame(uint8_t i, uint8_t opcode, const char *data, size_t length) {
+  std::string frame;
+  frame.reserve(length + 10);
+  frame += (char)(0x80 | opcode); // always a single final frame, servers do not mask
+  if (length < 126) {
+    frame += (char)length;
+  } else if (length < 65536) {
+    frame += (char)126;
+    frame += (char)(length >> 8);
+    frame += (char)length;
+  } else {
+    frame += (char)127;
+    for (int b = 7; b >= 0; b--) frame += (char)((uint64_t)length >> (8 * b));
+  }
+  frame.append(data, length);
+  queue(i, std::move(frame));
+}
+
+void HttpServer::send_head(const http_request_t &request, int code, const char *content_type, const char *extra_headers) {
+  connection_t &c = connections_[request.connection];
+  char head[256];
+  snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n%sConnection: %s\r\n\r\n",
+           code, status_text(code), content_type, extra_headers, c.keep_alive ? "keep-alive" : "close");
+  queue(request.connection, head);
+  c.responded = true;
+}
+
+void HttpServer::send(const http_request_t &request, int code, const char *content_type, const char *body, size_t length) {
+  connection_t &c = connections_[request.connection];
+  if (c.responded || c.state != WRITING) return;
+  char content_length[40];
+  snprintf(content_length, sizeof(content_length), "Content-Length: %u\r\n", (unsigned)length);
+  send_head(request, code, content_type, content_length);
+  if (!c.head && length > 0) queue(request.connection, std::string(body, length));
+}
+
+void HttpServer::send(const http_request_t &request, int code, const char *content_type, const char *body) {
+  send(request, code, content_type, body, strlen(body));
+}
+
+void HttpServer::send_stream(const http_request_t &request, int code, const char *content_type, stream_fn fill, int64_t length) {
+  connection_t &c = connections_[request.connection];
+  if (c.responded || c.state != WRITING) return;
+  char framing[48] = "";
+  c.stream_left = length;
+  c.chunked = length < 0 && !c.http10;
+  if (length >= 0) {
+    snprintf(framing, sizeof(framing), "Content-Length: %llu\r\n", (unsigned long long)length);
+  } else if (c.chunked) {
+    snprintf(framing, sizeof(framing), "Transfer-Encoding: chunked\r\n");
+  } else {
+    c.keep_alive = false; // HTTP/1.0 has no chunked encoding, the close ends the body
+  }
+  send_head(request, code, content_type, framing);
+  if (!c.head) c.stream = fill;
+}
+
+http_send_result_t HttpServer::ws_send(uint8_t client, const char *data, size_t length, bool binary) {
+  if (!ws_connected(client)) return HTTP_SEND_FAILED;
+  if (connections_[client].out_bytes > HTTP_WS_QUEUE_LIMIT) return HTTP_SEND_BLOCKED;
+  queue_frame(client, binary ? WS_OP_BINARY : WS_OP_TEXT, data, length);
+  write_connection(client); // most messages fit the socket buffer and leave right away
+  return HTTP_SEND_OK;
+}
+
+void HttpServer::ws_close(uint8_t client) {
+  if (!ws_connected(client)) return;
+  uint8_t code[2] = {1000 >> 8, 1000 & 0xff};
+  queue_frame(client, WS_OP_CLOSE, (const char *)code, 2);
+  connections_[client].state = CLOSING;
+  ws_event_(client, HTTP_WS_DISCONNECTED, nullptr, 0);
+}
+
+bool HttpServer::ws_connected(uint8_t client) const {
+  return client < HTTP_MAX_CONNECTIONS && connections_[client].state == WEBSOCKET;
+}
+
+uint8_t HttpServer::ws_client_count() const {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (connections_[i].state == WEBSOCKET) count++;
+  }
+  return count;
+}
+
+size_t HttpServer::queued_bytes(uint8_t connection) const {
+  return connection < HTTP_MAX_CONNECTIONS ? connections_[connection].out_bytes : 0;
+}
+
+void HttpServer::close_connection(uint8_t i) {
+  connection_t &c = connections_[i];
+  bool was_websocket = c.state == WEBSOCKET;
+  if (c.fd >= 0) close(c.fd);
+  c = connection_t();
+  if (was_websocket && ws_event_) ws_event_(i, HTTP_WS_DISCONNECTED, nullptr, 0);
+}
+
+// SHA-1 and base64, only for the websocket handshake
+static uint32_t rol(uint32_t value, int bits) {
+  return value << bits | value >> (32 - bits);
+}
+
+void http_sha1(const uint8_t *data, size_t length, uint8_t digest[20]) {
+  uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+  uint64_t bit_length = (uint64_t)length * 8;
+  size_t padded = ((length + 8) / 64 + 1) * 64;
+
+  for (size_t block = 0; block < padded; block += 64) {
+    uint32_t w[80];
+    for (int t = 0; t < 16; t++) {
+      uint32_t word = 0;
+      for (int b = 0; b < 4; b++) {
+        size_t index = block + t * 4 + b;
+        uint8_t byte = index < length ? data[index] : index == length ? 0x80 : 0;
+        if (index >= padded - 8) byte = bit_length >> (8 * (padded - 1 - index));
+        word = word << 8 | byte;
+      }
+      w[t] = word;
+    }
+    for (int t = 16; t < 80; t++) w[t] = rol(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int t = 0; t < 80; t++) {
+      uint32_t f, k;
+      if (t < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      } else if (t < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (t < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      uint32_t temp = rol(a, 5) + f + e + k + w[t];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+  for (int i = 0; i < 20; i++) digest[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+std::string http_base64(const uint8_t *data, size_t length) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t n = (uint32_t)data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+    out += alphabet[n >> 18 & 63];
+    out += alphabet[n >> 12 & 63];
+    out += i + 1 < length ? alphabet[n >> 6 & 63] : '=';
+    out += i + 2 < length ? alphabet[n & 63] : '=';
+  }
+  return out;
+}
+
+std::string http_ws_accept_key(const std::string &client_key) {
+  std::string source = client_key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  uint8_t digest[20];
+  http_sha1((const uint8_t *)source.data(), source.size(), digest);
+  return http_base64(digest, sizeof(digest));
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+// Event-driven HTTP/1.1 and websocket server on non-blocking BSD sockets.
+//
+// service() is called from loop() and never waits: it accepts, reads whatever has arrived, runs
+// route handlers for complete requests and writes as much queued output as the socket takes.
+// A slow browser only ever fills its own queue. Connections are kept alive between requests,
+// responses come from a buffer or from a stream callback (Content-Length when the size is known,
+// chunked otherwise, close-delimited for HTTP/1.0 clients), and a request with
+// "Upgrade: websocket" turns its connection into a websocket on the same port.
+//
+// The socket calls are plain BSD sockets, lwIP on the ESP32 and the OS on a desktop, so the same
+// code serves the board and the host load test (src/host/http_load).
+//
+// Websocket client numbers are connection slots, 0 .. HTTP_MAX_CONNECTIONS - 1.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#define HTTP_MAX_CONNECTIONS 8 // lwIP has 10 sockets by default, one is the listener
+#define HTTP_MAX_ROUTES 16
+#define HTTP_MAX_REQUEST 2048 // request line + headers
+#define HTTP_MAX_BODY 4096
+#define HTTP_IDLE_TIMEOUT_MS 10000 // keep-alive connection without a request
+#define HTTP_STREAM_CHUNK 1024 // bytes asked from a stream callback at a time
+#define HTTP_WS_MAX_MESSAGE 4096
+#define HTTP_WS_QUEUE_LIMIT (16 * 1024) // queued bytes before ws_send() reports blocked
+#define HTTP_WS_PING_MS 15000
+#define HTTP_WS_TIMEOUT_MS 45000 // nothing heard, not even a pong
+
+enum http_ws_event_t {
+  HTTP_WS_CONNECTED,
+  HTTP_WS_DISCONNECTED,
+  HTTP_WS_TEXT,
+  HTTP_WS_BINARY
+};
+
+enum http_send_result_t {
+  HTTP_SEND_OK,
+  HTTP_SEND_BLOCKED, // too much queued for this client already, retry later
+  HTTP_SEND_FAILED   // not a websocket connection (any more)
+};
+
+struct http_request_t {
+  uint8_t connection;
+  std::string method;
+  std::string path; // without the query
+  std::string query;
+  std::string body;
+  std::string headers; // raw header lines, see header()
+
+  std::string header(const char *name) const; // case-insensitive, "" when missing
+  std::string arg(const char *name) const; // query parameter, percent-decoded
+};
+
+struct http_stats_t {
+  uint32_t accepted;
+  uint32_t requests;
+  uint32_t rejected; // no free slot or malformed request
+  uint32_t timeouts;
+  uint32_t ws_messages;
+};
+
+class HttpServer {
+ public:
+  typedef void (*handler_fn)(const http_request_t &request);
+  typedef void (*ws_event_fn)(uint8_t client, http_ws_event_t type, uint8_t *payload, size_t length);
+  typedef uint32_t (*clock_ms_fn)();
+  typedef std::function<size_t(uint8_t *buffer, size_t size)> stream_fn; // 0 ends the stream
+
+  explicit HttpServer(clock_ms_fn now_ms);
+  ~HttpServer();
+
+  bool begin(uint16_t port); // 0 picks a free port, see port()
+  void stop();
+  uint16_t port() const { return port_; }
+
+  void on(const char *path, handler_fn handler);
+  void on_not_found(handler_fn handler);
+  void on_ws_event(const char *path, ws_event_fn handler); // upgrade requests to other paths get 404
+
+  // Accept, read, dispatch and write without blocking
+  void service();
+
+  // From inside a handler, once per request. The body is copied.
+  void send(const http_request_t &request, int code, const char *content_type, const char *body, size_t length);
+  void send(const http_request_t &request, int code, const char *content_type, const char *body);
+  // Streamed response, fill is called from service() whenever the socket can take more. length < 0
+  // when the size is not known up front: chunked, or until the close for an HTTP/1.0 client.
+  void send_stream(const http_request_t &request, int code, const char *content_type, stream_fn fill, int64_t length = -1);
+
+  http_send_result_t ws_send(uint8_t client, const char *data, size_t length, bool binary);
+  void ws_close(uint8_t client);
+  bool ws_connected(uint8_t client) const;
+  uint8_t ws_client_count() const;
+
+  size_t queued_bytes(uint8_t connection) const;
+  const http_stats_t &stats() const { return stats_; }
+
+ private:
+  enum state_t { FREE, READING, WRITING, WEBSOCKET, CLOSING };
+
+  struct connection_t {
+    int fd = -1;
+    state_t state = FREE;
+    std::string in;
+    std::deque<std::string> out;
+    size_t out_offset = 0; // sent from out.front()
+    size_t out_bytes = 0;
+    stream_fn stream;
+    int64_t stream_left = -1; // body bytes still owed after Content-Length, -1 without one
+    bool chunked = false;
+    bool http10 = false;
+    bool keep_alive = false;
+    bool responded = false;
+    bool head = false;
+    uint32_t last_heard_ms = 0; // last byte received
+    uint32_t last_sent_ms = 0; // last byte the socket took
+    uint32_t last_ping_ms = 0;
+    std::string ws_message; // reassembled fragments
+    uint8_t ws_opcode = 0;
+  };
+
+  struct route_t {
+    std::string path;
+    handler_fn handler;
+  };
+
+  void accept_connections();
+  void read_connection(uint8_t i);
+  void write_connection(uint8_t i);
+  bool handle_request(uint8_t i); // false when the buffer does not hold a whole request yet
+  bool upgrade(uint8_t i, const http_request_t &request);
+  bool handle_frames(uint8_t i);
+  void queue(uint8_t i, std::string data);
+  void queue_frame(uint8_t i, uint8_t opcode, const char *data, size_t length);
+  void send_head(const http_request_t &request, int code, const char *content_type, const char *extra_headers);
+  void reject(int fd, int code);
+  void close_connection(uint8_t i);
+  bool evict_idle(); // frees the slot of the longest idle keep-alive connection
+
+  connection_t connections_[HTTP_MAX_CONNECTIONS];
+  route_t routes_[HTTP_MAX_ROUTES];
+  uint8_t route_count_ = 0;
+  handler_fn not_found_ = nullptr;
+  std::string ws_path_;
+  ws_event_fn ws_event_ = nullptr;
+  clock_ms_fn now_ms_;
+  int listen_fd_ = -1;
+  uint16_t port_ = 0;
+  http_stats_t stats_ = {};
+};
+
+// helpers, also used by the host load test
+std::string http_ws_accept_key(const std::string &client_key);
+void http_sha1(const uint8_t *data, size_t length, uint8_t digest[20]);
+std::string http_base64(const uint8_t *data, size_t length);
@@ -0,0 +1,62 @@
+#pragma once
+
+// Latency histogram with quarter-octave buckets, about 19% resolution from 1 us to ~70 minutes.
+// Fixed size and no allocation, cheap enough to record every SD write.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LATENCY_BUCKETS 128
+
+class LatencyStats {
+ public:
+  void add(uint32_t us) {
+    buckets_[bucket(us)]++;
+    count_++;
+    if (us > max_) max_ = us;
+    sum_ += us;
+  }
+
+  void clear() { *this = LatencyStats(); }
+
+  // Upper bound of the bucket holding the given percentile (0-100)
+  uint32_t percentile(float p) const {
+    if (count_ == 0) return 0;
+    uint64_t rank = (uint64_t)(count_ * p / 100.0f);
+    if (rank >= count_) rank = count_ - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+      seen += buckets_[i];
+      if (seen > rank) {
+        uint32_t upper = bucket_upper(i);
+        return upper < max_ ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+  uint32_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+ private:
+  // 4 buckets per power of two: the top bit picks the octave, the next two bits the quarter
+  static int bucket(uint32_t us) {
+    if (us < 4) return us;
+    int top = 31 - __builtin_clz(us);
+    int b = top * 4 + ((us >> (top - 2)) & 3) - 4;
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+  }
+
+  static uint32_t bucket_upper(int b) {
+    if (b < 4) return b;
+    int top = (b + 4) / 4;
+    uint64_t upper = ((uint64_t)(4 + (b + 4) % 4 + 1) << (top - 2)) - 1;
+    return upper > 0xffffffff ? 0xffffffff : (uint32_t)upper;
+  }
+
+  uint32_t buckets_[LATENCY_BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint32_t max_ = 0;
+  uint64_t sum_ = 0;
+};
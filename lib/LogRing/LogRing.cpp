@@ -0,0 +1,104 @@
+#include "LogRing.h"
+#include <stdio.h>
+
+LogRing::LogRing(clock_us_fn now_us) : now_us_(now_us) {
+  for (uint32_t i = 0; i < LOG_RING_SIZE; i++) records_[i].seq.store(0, std::memory_order_relaxed);
+}
+
+log_record_t *LogRing::reserve(uint8_t level, const char *tag, const char *format) {
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  do {
+    if (head - tail_.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+  } while (!head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+  uint32_t used = head + 1 - tail_.load(std::memory_order_relaxed);
+  uint32_t high = high_water_.load(std::memory_order_relaxed);
+  while (used > high && !high_water_.compare_exchange_weak(high, used, std::memory_order_relaxed)) {}
+
+  log_record_t &record = records_[head & (LOG_RING_SIZE - 1)];
+  record.position = head;
+  record.t_us = now_us_ ? now_us_() : 0;
+  record.tag = tag;
+  record.format = format;
+  record.level = level;
+  record.arg_count = 0;
+  record.text_used = 0;
+  return &record;
+}
+
+void LogRing::commit(log_record_t *record) {
+  record->seq.store(record->position + 1, std::memory_order_release);
+}
+
+const log_record_t *LogRing::front() const {
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  const log_record_t &record = records_[tail & (LOG_RING_SIZE - 1)];
+  if (record.seq.load(std::memory_order_acquire) != tail + 1) return nullptr;
+  return &record;
+}
+
+void LogRing::pop() {
+  tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  written_++;
+}
+
+const char *log_level_name(uint8_t level) {
+  const char *names[] = {"none", "error", "warn", "info", "debug"};
+  return level <= LOG_LEVEL_DEBUG ? names[level] : "";
+}
+
+char log_level_letter(uint8_t level) {
+  return level <= LOG_LEVEL_DEBUG ? "-EWID"[level] : '?';
+}
+
+// One conversion of the format with the stored argument, length modifiers dropped since the
+// argument has already been widened to what the conversion expects
+static int format_arg(char *out, size_t size, const char *spec, size_t spec_length, const log_record_t &record, uint8_t arg) {
+  char clean[16];
+  size_t n = 0;
+  for (size_t i = 0; i < spec_length && n < sizeof(clean) - 1; i++) {
+    if (!strchr("hlzjtLq", spec[i])) clean[n++] = spec[i];
+  }
+  clean[n] = '\0';
+  if (arg >= record.arg_count) return snprintf(out, size, "?");
+
+  const log_arg_t &value = record.args[arg];
+  switch (spec[spec_length - 1]) {
+  case 'd': case 'i': case 'c': return snprintf(out, size, clean, (int)value.i);
+  case 'u': case 'x': case 'X': case 'o': return snprintf(out, size, clean, (unsigned)value.u);
+  case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': return snprintf(out, size, clean, value.d);
+  case 's': return snprintf(out, size, clean, value.u < record.text_used ? record.text + value.u : "");
+  }
+  return 0;
+}
+
+size_t log_format(const log_record_t &record, char *out, size_t size) {
+  if (size == 0) return 0;
+  int n = snprintf(out, size, "%4lu.%06lu %c %s: ", (unsigned long)(record.t_us / 1000000), (unsigned long)(record.t_us % 1000000),
+                   log_level_letter(record.level), record.tag);
+  size_t length = n < 0 ? 0 : (size_t)n < size ? n : size - 1;
+  uint8_t arg = 0;
+
+  for (const char *p = record.format; *p && length < size - 1; p++) {
+    if (*p != '%') {
+      out[length++] = *p;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[length++] = '%';
+      p++;
+      continue;
+    }
+    const char *end = p + 1;
+    while (*end && !strchr("diucxXofFeEgGs", *end)) end++;
+    if (!*end) break; // unterminated conversion
+    n = format_arg(out + length, size - length, p, end - p + 1, record, arg++);
+    length += n < 0 ? 0 : (size_t)n < size - length ? n : size - length - 1;
+    p = end;
+  }
+  out[length] = '\0';
+  return length;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+// Leveled, tagged log records with deferred formatting.
+//
+// LOG_E/LOG_W/LOG_I/LOG_D(tag, format, args...) store the format pointer, the tag and up to
+// LOG_MAX_ARGS raw arguments in a fixed-size record in a lock-free ring, nothing is formatted at the
+// call. A few hundred ns per call on the ESP32, so the hot paths can keep their logging. Whoever drains
+// the ring calls log_format() on each record and decides where the line goes.
+//
+// The format and the tag must outlive the record (string literals). %s arguments are copied into the
+// record, LOG_TEXT_SIZE bytes for all of them together, longer text is cut. Length modifiers (l, h, z)
+// are accepted and ignored, integers are kept as 32 bits, floats as double.
+//
+// Levels above LOG_LEVEL (a build flag, -DLOG_LEVEL=LOG_LEVEL_WARN) compile to nothing, arguments
+// included. The ring takes any number of producers and one consumer; a full ring drops the new record
+// and counts it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 128 // power of two, records
+#define LOG_MAX_ARGS 4
+#define LOG_TEXT_SIZE 40 // %s arguments of one record, with their terminators
+
+union log_arg_t {
+  log_arg_t() : d(0) {}
+  log_arg_t(int v) : i(v) {}
+  log_arg_t(long v) : i((int32_t)v) {}
+  log_arg_t(unsigned v) : u(v) {}
+  log_arg_t(unsigned long v) : u((uint32_t)v) {}
+  log_arg_t(double v) : d(v) {}
+
+  int32_t i;
+  uint32_t u; // also the offset of a %s argument in the record's text
+  double d;
+};
+
+struct log_record_t {
+  std::atomic<uint32_t> seq; // position + 1 once the record is complete
+  uint32_t position; // in the ring, set by reserve()
+  uint32_t t_us;
+  const char *tag;
+  const char *format;
+  uint8_t level;
+  uint8_t arg_count;
+  uint8_t text_used;
+  log_arg_t args[LOG_MAX_ARGS];
+  char text[LOG_TEXT_SIZE];
+};
+
+class LogRing {
+ public:
+  typedef uint32_t (*clock_us_fn)();
+
+  explicit LogRing(clock_us_fn now_us);
+
+  // producers: reserve, fill the args, commit. reserve() is nullptr when the ring is full.
+  log_record_t *reserve(uint8_t level, const char *tag, const char *format);
+  void commit(log_record_t *record);
+
+  // consumer: front() is nullptr when empty or the oldest record is still being written
+  const log_record_t *front() const;
+  void pop();
+
+  uint32_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  uint32_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint32_t written() const { return written_; }
+  void reset_stats() { high_water_ = size(); dropped_ = 0; }
+
+ private:
+  clock_us_fn now_us_;
+  log_record_t records_[LOG_RING_SIZE];
+  std::atomic<uint32_t> head_{0}; // next position to reserve
+  std::atomic<uint32_t> tail_{0}; // written by the consumer only
+  std::atomic<uint32_t> high_water_{0};
+  std::atomic<uint32_t> dropped_{0};
+  uint32_t written_ = 0; // consumer side
+};
+
+// "  12.345678 W tag: text" into out, always terminated. Returns the length, cut to size - 1.
+size_t log_format(const log_record_t &record, char *out, size_t size);
+const char *log_level_name(uint8_t level); // "error", "warn", "info", "debug"
+char log_level_letter(uint8_t level);
+
+// Argument packing, one overload per kind of value
+inline void log_pack(log_record_t &) {}
+
+template <typename T, typename... Rest>
+inline void log_pack(log_record_t &record, T value, Rest... rest);
+
+inline void log_pack_text(log_record_t &record, const char *text) {
+  size_t room = LOG_TEXT_SIZE - record.text_used;
+  record.args[record.arg_count++].u = record.text_used;
+  if (room == 0) return; // the formatter prints nothing for it
+  size_t length = strnlen(text ? text : "", room - 1);
+  memcpy(record.text + record.text_used, text ? text : "", length);
+  record.text[record.text_used + length] = '\0';
+  record.text_used += length + 1;
+}
+
+template <typename... Rest>
+inline void log_pack(log_record_t &record, const char *value, Rest... rest) {
+  if (record.arg_count < LOG_MAX_ARGS) log_pack_text(record, value);
+  log_pack(record, rest...);
+}
+
+template <typename... Rest>
+inline void log_pack(log_record_t &record, char *value, Rest... rest) {
+  log_pack(record, (const char *)value, rest...);
+}
+
+template <typename T, typename... Rest>
+inline void log_pack(log_record_t &record, T value, Rest... rest) {
+  if (record.arg_count < LOG_MAX_ARGS) record.args[record.arg_count++] = log_arg_t(value);
+  log_pack(record, rest...);
+}
+
+template <typename... Args>
+inline void log_write(LogRing &ring, uint8_t level, const char *tag, const char *format, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  log_record_t *record = ring.reserve(level, tag, format);
+  if (!record) return;
+  log_pack(*record, args...);
+  ring.commit(record);
+}
+
+extern LogRing log_ring; // defined by the application with its clock
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(tag, ...) log_write(log_ring, LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#else
+#define LOG_E(tag, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(tag, ...) log_write(log_ring, LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#else
+#define LOG_W(tag, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(tag, ...) log_write(log_ring, LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#else
+#define LOG_I(tag, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(tag, ...) log_write(log_ring, LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#else
+#define LOG_D(tag, ...) do {} while (0)
+#endif
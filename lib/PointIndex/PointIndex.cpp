@@ -0,0 +1,106 @@
+#include "PointIndex.h"
+#include <algorithm>
+#include <math.h>
+
+#define DEG_1E7_TO_RAD (M_PI / 180e7)
+#define WGS84_A 6378137.0
+#define WGS84_E2 6.69437999014e-3
+
+PointIndex::PointIndex(index_point_t *points, size_t capacity) : points_(points), capacity_(capacity) {}
+
+bool PointIndex::add(int32_t lat, int32_t lon, int32_t height, uint32_t ref) {
+  if (count_ == capacity_) return false;
+  points_[count_++] = {lat, lon, height, ref};
+  return true;
+}
+
+void PointIndex::clear() {
+  count_ = 0;
+  lon_scale_ = 1;
+}
+
+void PointIndex::build() {
+  if (count_ == 0) return;
+  int32_t low = points_[0].lat, high = points_[0].lat;
+  for (size_t i = 1; i < count_; i++) {
+    low = std::min(low, points_[i].lat);
+    high = std::max(high, points_[i].lat);
+  }
+  lon_scale_ = cos(((double)low + high) / 2 * DEG_1E7_TO_RAD);
+  build_range(0, count_, 0);
+}
+
+// The median of the range sits in the middle, smaller keys before it, larger after
+void PointIndex::build_range(size_t begin, size_t end, int axis) {
+  if (end - begin < 2) return;
+  size_t mid = begin + (end - begin) / 2;
+  std::nth_element(points_ + begin, points_ + mid, points_ + end, [axis](const index_point_t &a, const index_point_t &b) {
+    return axis == 0 ? a.lat < b.lat : a.lon < b.lon;
+  });
+  build_range(begin, mid, axis ^ 1);
+  build_range(mid + 1, end, axis ^ 1);
+}
+
+float PointIndex::distance2(const index_point_t &p, int32_t lat, int32_t lon) const {
+  float dy = (float)((int64_t)p.lat - lat);
+  float dx = (float)((int64_t)p.lon - lon) * lon_scale_;
+  return dx * dx + dy * dy;
+}
+
+void PointIndex::search(size_t begin, size_t end, int axis, int32_t lat, int32_t lon, int &best, float &best_d2) const {
+  if (begin >= end) return;
+  size_t mid = begin + (end - begin) / 2;
+  const index_point_t &p = points_[mid];
+  visited_++;
+  float d2 = distance2(p, lat, lon);
+  if (d2 < best_d2) {
+    best_d2 = d2;
+    best = mid;
+  }
+
+  float split = axis == 0 ? (float)((int64_t)lat - p.lat) : (float)((int64_t)lon - p.lon) * lon_scale_;
+  bool below = split < 0;
+  if (below) search(begin, mid, axis ^ 1, lat, lon, best, best_d2);
+  else search(mid + 1, end, axis ^ 1, lat, lon, best, best_d2);
+  if (split * split < best_d2) { // the other side can still hold something closer
+    if (below) search(mid + 1, end, axis ^ 1, lat, lon, best, best_d2);
+    else search(begin, mid, axis ^ 1, lat, lon, best, best_d2);
+  }
+}
+
+int PointIndex::nearest(int32_t lat, int32_t lon) const {
+  visited_ = 0;
+  int best = -1;
+  float best_d2 = INFINITY;
+  search(0, count_, 0, lat, lon, best, best_d2);
+  return best;
+}
+
+int PointIndex::find_ref(uint32_t ref) const {
+  for (size_t i = 0; i < count_; i++) {
+    if (points_[i].ref == ref) return i;
+  }
+  return -1;
+}
+
+static void to_ecef(int32_t lat, int32_t lon, int32_t height_mm, double &x, double &y, double &z) {
+  double phi = lat * DEG_1E7_TO_RAD, lambda = lon * DEG_1E7_TO_RAD, h = height_mm / 1000.0;
+  double sin_phi = sin(phi), cos_phi = cos(phi);
+  double n = WGS84_A / sqrt(1 - WGS84_E2 * sin_phi * sin_phi);
+  x = (n + h) * cos_phi * cos(lambda);
+  y = (n + h) * cos_phi * sin(lambda);
+  z = (n * (1 - WGS84_E2) + h) * sin_phi;
+}
+
+void point_offset(int32_t from_lat, int32_t from_lon, int32_t from_height_mm, int32_t to_lat, int32_t to_lon, int32_t to_height_mm, double &east,
+                  double &north, double &up) {
+  double x0, y0, z0, x1, y1, z1;
+  to_ecef(from_lat, from_lon, from_height_mm, x0, y0, z0);
+  to_ecef(to_lat, to_lon, to_height_mm, x1, y1, z1);
+  double dx = x1 - x0, dy = y1 - y0, dz = z1 - z0;
+  double phi = from_lat * DEG_1E7_TO_RAD, lambda = from_lon * DEG_1E7_TO_RAD;
+  double sin_phi = sin(phi), cos_phi = cos(phi), sin_lambda = sin(lambda), cos_lambda = cos(lambda);
+  east = -sin_lambda * dx + cos_lambda * dy;
+  north = -sin_phi * cos_lambda * dx - sin_phi * sin_lambda * dy + cos_phi * dz;
+  up = cos_phi * cos_lambda * dx + cos_phi * sin_lambda * dy + sin_phi * dz;
+}
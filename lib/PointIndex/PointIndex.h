@@ -0,0 +1,55 @@
+#pragma once
+
+// Nearest-point lookup over a fixed set of target points, for stakeout.
+//
+// Points keep the coordinates the survey file has, lat/lon in deg * 1e-7, in an implicit k-d tree:
+// build() reorders the caller's array around medians, alternating latitude and longitude, so the
+// index costs nothing on top of the 16-byte points and nearest() allocates nothing and visits about
+// log2(n) points plus the few near the splits. The search compares distances on a plane with
+// longitude scaled by cos(latitude) at the points' centre, which picks the right point across a site
+// of tens of kilometres. point_offset() then gives the exact east/north/up to the chosen point.
+//
+// Each point carries its height and the caller's ref (for stakeout, where its name is), so the record
+// of a new target is in memory when the nearest point changes. Only lat/lon take part in the search.
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct index_point_t {
+  int32_t lat, lon; // deg * 1e-7
+  int32_t height; // mm, ellipsoid
+  uint32_t ref;
+};
+
+class PointIndex {
+ public:
+  PointIndex(index_point_t *points, size_t capacity);
+
+  bool add(int32_t lat, int32_t lon, int32_t height, uint32_t ref); // false when full
+  void build(); // after the last add, before nearest()
+  void clear();
+
+  int nearest(int32_t lat, int32_t lon) const; // index of the nearest point, -1 when empty
+  int find_ref(uint32_t ref) const; // index of the point with this ref, -1 when none (linear)
+
+  const index_point_t &point(size_t i) const { return points_[i]; }
+  size_t size() const { return count_; }
+  size_t capacity() const { return capacity_; }
+  uint32_t visited() const { return visited_; } // points looked at by the last nearest()
+
+ private:
+  void build_range(size_t begin, size_t end, int axis);
+  void search(size_t begin, size_t end, int axis, int32_t lat, int32_t lon, int &best, float &best_d2) const;
+  float distance2(const index_point_t &p, int32_t lat, int32_t lon) const;
+
+  index_point_t *points_;
+  size_t capacity_;
+  size_t count_ = 0;
+  float lon_scale_ = 1; // cos(latitude) at the centre
+  mutable uint32_t visited_ = 0;
+};
+
+// East/north/up in meters from one position to another, on the WGS84 ellipsoid at the first one.
+// Exact to well under a millimetre for the few hundred meters of a stakeout.
+void point_offset(int32_t from_lat, int32_t from_lon, int32_t from_height_mm, int32_t to_lat, int32_t to_lon, int32_t to_height_mm, double &east,
+                  double &north, double &up);
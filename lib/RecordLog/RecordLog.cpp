@@ -0,0 +1,92 @@
+#include "RecordLog.h"
+#include <Checksum.h>
+#include <Varint.h>
+#include <string.h>
+
+#define R_MAGIC 0
+#define R_TYPE 2
+#define R_LENGTH 3
+#define R_SEQ 4
+#define R_PAYLOAD 8
+#define R_CRC (RECORD_SIZE - 4)
+
+RecordLog::RecordLog(const record_log_io_t &io, uint32_t capacity_records, uint16_t flush_every)
+  : flush_every(flush_every), io_(io), capacity_(capacity_records) {}
+
+bool RecordLog::check(const uint8_t *record, uint32_t expected_seq) {
+  return get_u16le(record + R_MAGIC) == RECORD_MAGIC
+      && get_u32le(record + R_SEQ) == expected_seq
+      && record[R_LENGTH] <= RECORD_PAYLOAD_MAX
+      && get_u32le(record + R_CRC) == crc32_update(0, record, R_CRC);
+}
+
+// The log is valid up to the first record that is blank, torn or out of sequence. The first
+// record sets the starting sequence, so a log can continue numbering from an older file.
+record_log_result_t RecordLog::recover() {
+  uint8_t chunk[RECORD_SCAN_CHUNK];
+  count_ = 0;
+  unflushed_ = 0;
+
+  while (count_ < capacity_) {
+    uint32_t records = capacity_ - count_;
+    if (records > RECORD_SCAN_CHUNK / RECORD_SIZE) records = RECORD_SCAN_CHUNK / RECORD_SIZE;
+    if (!io_.read(count_ * RECORD_SIZE, chunk, records * RECORD_SIZE, io_.ctx)) return RECORD_LOG_IO_ERROR;
+
+    for (uint32_t i = 0; i < records; i++) {
+      const uint8_t *record = chunk + i * RECORD_SIZE;
+      if (count_ == 0) first_seq_ = get_u32le(record + R_SEQ);
+      if (!check(record, first_seq_ + count_)) {
+        if (count_ == 0) first_seq_ = 0;
+        next_seq_ = first_seq_ + count_;
+        return RECORD_LOG_OK;
+      }
+      count_++;
+    }
+  }
+  next_seq_ = first_seq_ + count_;
+  return RECORD_LOG_OK;
+}
+
+record_log_result_t RecordLog::append(uint8_t type, const void *payload, size_t length) {
+  if (length > RECORD_PAYLOAD_MAX) return RECORD_LOG_TOO_LONG;
+  if (count_ >= capacity_) return RECORD_LOG_FULL;
+
+  uint8_t record[RECORD_SIZE];
+  memset(record, 0, sizeof(record));
+  put_u16le(record + R_MAGIC, RECORD_MAGIC);
+  record[R_TYPE] = type;
+  record[R_LENGTH] = length;
+  put_u32le(record + R_SEQ, next_seq_);
+  memcpy(record + R_PAYLOAD, payload, length);
+  put_u32le(record + R_CRC, crc32_update(0, record, R_CRC));
+
+  if (!io_.write(count_ * RECORD_SIZE, record, RECORD_SIZE, io_.ctx)) return RECORD_LOG_IO_ERROR;
+  count_++;
+  next_seq_++;
+  if (++unflushed_ >= flush_every && !sync()) return RECORD_LOG_IO_ERROR;
+  return RECORD_LOG_OK;
+}
+
+bool RecordLog::sync() {
+  if (unflushed_ == 0) return true;
+  unflushed_ = 0;
+  return io_.flush(io_.ctx);
+}
+
+uint32_t RecordLog::for_each(record_fn fn, void *ctx) const {
+  uint8_t chunk[RECORD_SCAN_CHUNK];
+  uint32_t visited = 0;
+  while (visited < count_) {
+    uint32_t records = count_ - visited;
+    if (records > RECORD_SCAN_CHUNK / RECORD_SIZE) records = RECORD_SCAN_CHUNK / RECORD_SIZE;
+    if (!io_.read(visited * RECORD_SIZE, chunk, records * RECORD_SIZE, io_.ctx)) break;
+
+    for (uint32_t i = 0; i < records; i++) {
+      const uint8_t *r = chunk + i * RECORD_SIZE;
+      record_t record = {r[R_TYPE], r[R_LENGTH], get_u32le(r + R_SEQ), r + R_PAYLOAD};
+      visited++;
+      if (!fn(record, ctx)) return visited;
+    }
+  }
+  return visited;
+}
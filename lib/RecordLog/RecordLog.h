@@ -0,0 +1,76 @@
+#pragma once
+
+// Crash-safe log of fixed-size records in a preallocated file.
+//
+// The file is created once at full size (zero filled), so appends only overwrite sectors the
+// file system has already allocated: no FAT or directory updates on the write path and no
+// allocation latency spikes. Each record carries a sequence number and a CRC-32. After a power
+// cut recover() scans forward to the last record that checks out and continues after it, a
+// record torn by the cut is simply overwritten.
+//
+//   record (RECORD_SIZE bytes, little-endian)
+//     u16 magic, u8 type, u8 length, u32 seq, payload[RECORD_PAYLOAD_MAX], u32 crc32
+//
+// Storage goes through callbacks so the same code runs on the SD card and on a host file.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RECORD_SIZE 64
+#define RECORD_PAYLOAD_MAX (RECORD_SIZE - 12)
+#define RECORD_MAGIC 0x4c52 // "RL"
+#define RECORD_SCAN_CHUNK 512 // recover() reads this much at a time
+
+enum record_log_result_t {
+  RECORD_LOG_OK,
+  RECORD_LOG_FULL,
+  RECORD_LOG_TOO_LONG,
+  RECORD_LOG_IO_ERROR
+};
+
+struct record_log_io_t {
+  bool (*read)(uint32_t offset, uint8_t *data, size_t length, void *ctx);
+  bool (*write)(uint32_t offset, const uint8_t *data, size_t length, void *ctx);
+  bool (*flush)(void *ctx); // make written records durable
+  void *ctx;
+};
+
+struct record_t {
+  uint8_t type;
+  uint8_t length;
+  uint32_t seq;
+  const uint8_t *payload;
+};
+
+class RecordLog {
+ public:
+  typedef bool (*record_fn)(const record_t &record, void *ctx); // return false to stop
+
+  // capacity_records must match the preallocated file size / RECORD_SIZE.
+  // flush_every = 1 flushes after every record, larger values trade durability for write time.
+  RecordLog(const record_log_io_t &io, uint32_t capacity_records, uint16_t flush_every = 1);
+
+  // Finds the end of the log, call once before appending
+  record_log_result_t recover();
+
+  record_log_result_t append(uint8_t type, const void *payload, size_t length);
+  bool sync(); // flush records written since the last flush
+
+  // Valid records oldest to newest, returns records visited
+  uint32_t for_each(record_fn fn, void *ctx) const;
+
+  uint32_t count() const { return count_; }
+  uint32_t capacity() const { return capacity_; }
+  uint32_t next_seq() const { return next_seq_; }
+  uint16_t flush_every = 1;
+
+  static bool check(const uint8_t *record, uint32_t expected_seq);
+
+ private:
+  record_log_io_t io_;
+  uint32_t capacity_;
+  uint32_t count_ = 0; // records in the log, the next one goes to count_ * RECORD_SIZE
+  uint32_t first_seq_ = 0;
+  uint32_t next_seq_ = 0;
+  uint16_t unflushed_ = 0;
+};
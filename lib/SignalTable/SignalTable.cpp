@@ -0,0 +1,216 @@
+#include "SignalTable.h"
+#include <string.h>
+
+static uint32_t signal_key(uint8_t gnss_id, uint8_t sv_id, uint8_t sig_id) {
+  return 1u << 24 | (uint32_t)gnss_id << 16 | (uint32_t)sv_id << 8 | sig_id;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+SignalTable::SignalTable() {
+  clear();
+}
+
+void SignalTable::clear() {
+  if (rows_ > 0) seq_++;
+  memset(key_, 0, sizeof(key_));
+  clear_changes();
+  rows_ = 0;
+}
+
+void SignalTable::clear_changes() {
+  bool marked = removed_count_ > 0 || removed_overflow_;
+  for (int w = 0; w < SIGNAL_TABLE_CAPACITY / 32; w++) marked |= dirty_[w] != 0;
+  if (marked) seq_++;
+  memset(dirty_, 0, sizeof(dirty_));
+  removed_count_ = 0;
+  removed_overflow_ = false;
+}
+
+int SignalTable::find(uint32_t key) const {
+  for (int i = 0; i < SIGNAL_TABLE_CAPACITY; i++) {
+    if (key_[i] == key) return i;
+  }
+  return -1;
+}
+
+int SignalTable::insert(uint32_t key, uint32_t now_ms) {
+  int i = find(0);
+  if (i < 0) {
+    overflows_++;
+    return -1;
+  }
+  key_[i] = key;
+  cno_[i] = 0;
+  elev_[i] = SIGNAL_ELEV_UNKNOWN;
+  azim_[i] = 0;
+  quality_[i] = 0;
+  flags_[i] = 0;
+  corr_source_[i] = 0;
+  seen_ms_[i] = now_ms;
+  rows_++;
+  mark(i);
+
+  // a satellite-only row a NAV-SIG row takes over from
+  if ((key & 0xff) != SIGNAL_SATELLITE_ONLY) {
+    int sat = find((key & ~0xffu) | SIGNAL_SATELLITE_ONLY);
+    if (sat >= 0) {
+      elev_[i] = elev_[sat];
+      azim_[i] = azim_[sat];
+      flags_[i] = flags_[sat] & SIGNAL_FLAG_SV_USED;
+      remove(sat);
+    } else {
+      for (int j = 0; j < SIGNAL_TABLE_CAPACITY; j++) { // another signal of the same satellite
+        if (j != i && (key_[j] >> 8) == (key >> 8)) {
+          elev_[i] = elev_[j];
+          azim_[i] = azim_[j];
+          flags_[i] = flags_[j] & SIGNAL_FLAG_SV_USED;
+          break;
+        }
+      }
+    }
+  }
+  return i;
+}
+
+void SignalTable::remove(int i) {
+  if (removed_count_ < SIGNAL_TABLE_CAPACITY) removed_[removed_count_++] = key_[i];
+  else removed_overflow_ = true;
+  key_[i] = 0;
+  dirty_[i / 32] &= ~(1u << (i % 32));
+  rows_--;
+}
+
+void SignalTable::update_signal(uint8_t gnss_id, uint8_t sv_id, uint8_t sig_id, uint8_t cno, uint8_t quality, uint8_t health,
+                                uint8_t flags, uint8_t corr_source, uint32_t now_ms) {
+  uint32_t key = signal_key(gnss_id, sv_id, sig_id);
+  int i = find(key);
+  if (i < 0) i = insert(key, now_ms);
+  if (i < 0) return;
+
+  uint8_t q = (quality & 0x0f) | health << 4;
+  flags = (flags & ~SIGNAL_FLAG_SV_USED) | (flags_[i] & SIGNAL_FLAG_SV_USED); // svUsed comes from NAV-SAT
+  if (cno_[i] != cno || quality_[i] != q || flags_[i] != flags || corr_source_[i] != corr_source) mark(i);
+  cno_[i] = cno;
+  quality_[i] = q;
+  flags_[i] = flags;
+  corr_source_[i] = corr_source;
+  seen_ms_[i] = now_ms;
+}
+
+void SignalTable::update_satellite(uint8_t gnss_id, uint8_t sv_id, uint8_t cno, int8_t elev, int16_t azim, uint8_t quality,
+                                   uint8_t health, bool used, uint32_t now_ms) {
+  uint32_t sat = signal_key(gnss_id, sv_id, 0) >> 8;
+  bool found = false;
+  for (int i = 0; i < SIGNAL_TABLE_CAPACITY; i++) {
+    if (key_[i] >> 8 != sat) continue;
+    found = true;
+    uint8_t flags = (flags_[i] & ~SIGNAL_FLAG_SV_USED) | (used ? SIGNAL_FLAG_SV_USED : 0);
+    if (elev_[i] != elev || azim_[i] != azim || flags_[i] != flags) mark(i);
+    elev_[i] = elev;
+    azim_[i] = azim;
+    flags_[i] = flags;
+    if ((key_[i] & 0xff) == SIGNAL_SATELLITE_ONLY) { // nothing else keeps it fresh
+      uint8_t q = (quality & 0x0f) | health << 4;
+      if (cno_[i] != cno || quality_[i] != q) mark(i);
+      cno_[i] = cno;
+      quality_[i] = q;
+      seen_ms_[i] = now_ms;
+    }
+  }
+  if (found) return;
+
+  int i = insert(signal_key(gnss_id, sv_id, SIGNAL_SATELLITE_ONLY), now_ms);
+  if (i < 0) return;
+  cno_[i] = cno;
+  elev_[i] = elev;
+  azim_[i] = azim;
+  quality_[i] = (quality & 0x0f) | health << 4;
+  flags_[i] = used ? SIGNAL_FLAG_SV_USED : 0;
+}
+
+void SignalTable::expire(uint32_t now_ms, uint32_t max_age_ms) {
+  for (int i = 0; i < SIGNAL_TABLE_CAPACITY; i++) {
+    if (key_[i] != 0 && now_ms - seen_ms_[i] > max_age_ms) remove(i);
+  }
+}
+
+size_t SignalTable::write_row(uint8_t *out, int i) const {
+  out[0] = key_[i] >> 16;
+  out[1] = key_[i] >> 8;
+  out[2] = key_[i];
+  out[3] = cno_[i];
+  out[4] = (uint8_t)elev_[i];
+  out[5] = quality_[i];
+  put_u16(out + 6, (uint16_t)azim_[i]);
+  out[8] = flags_[i];
+  out[9] = corr_source_[i];
+  return SIGNAL_ROW_BYTES;
+}
+
+size_t SignalTable::encode_changes(uint8_t *out, size_t size) {
+  uint16_t changed = 0;
+  for (int w = 0; w < SIGNAL_TABLE_CAPACITY / 32; w++) changed += __builtin_popcount(dirty_[w]);
+  if (changed == 0 && removed_count_ == 0 && !removed_overflow_) return 0;
+  size_t length = SIGNAL_MSG_HEADER + changed * SIGNAL_ROW_BYTES + removed_count_ * SIGNAL_REMOVED_BYTES;
+  if (length > size || removed_overflow_) { // the full table replaces the state, it never needs more than SIGNAL_MSG_MAX
+    if (SIGNAL_MSG_HEADER + (size_t)rows_ * SIGNAL_ROW_BYTES > size) return 0;
+    clear_changes(); // advances seq
+    return encode_full(out, size);
+  }
+
+  seq_++;
+  out[0] = 'S';
+  out[1] = SIGNAL_MSG_CHANGES;
+  put_u16(out + 2, seq_);
+  put_u16(out + 4, changed);
+  put_u16(out + 6, removed_count_);
+  size_t pos = SIGNAL_MSG_HEADER;
+  for (int w = 0; w < SIGNAL_TABLE_CAPACITY / 32; w++) {
+    for (uint32_t bits = dirty_[w]; bits; bits &= bits - 1) {
+      pos += write_row(out + pos, w * 32 + __builtin_ctz(bits));
+    }
+    dirty_[w] = 0;
+  }
+  for (uint16_t r = 0; r < removed_count_; r++) {
+    out[pos++] = removed_[r] >> 16;
+    out[pos++] = removed_[r] >> 8;
+    out[pos++] = removed_[r];
+    out[pos++] = 0;
+  }
+  removed_count_ = 0;
+  return pos;
+}
+
+size_t SignalTable::encode_full(uint8_t *out, size_t size) const {
+  size_t length = SIGNAL_MSG_HEADER + rows_ * SIGNAL_ROW_BYTES;
+  if (length > size) return 0;
+  out[0] = 'S';
+  out[1] = SIGNAL_MSG_FULL;
+  put_u16(out + 2, seq_);
+  put_u16(out + 4, rows_);
+  put_u16(out + 6, 0);
+  size_t pos = SIGNAL_MSG_HEADER;
+  for (int i = 0; i < SIGNAL_TABLE_CAPACITY; i++) {
+    if (key_[i] != 0) pos += write_row(out + pos, i);
+  }
+  return pos;
+}
+
+bool SignalTable::row(uint16_t index, signal_row_t &out) const {
+  if (index >= SIGNAL_TABLE_CAPACITY || key_[index] == 0) return false;
+  out.gnss_id = key_[index] >> 16;
+  out.sv_id = key_[index] >> 8;
+  out.sig_id = key_[index];
+  out.cno = cno_[index];
+  out.elev = elev_[index];
+  out.azim = azim_[index];
+  out.quality = quality_[index] & 0x0f;
+  out.health = quality_[index] >> 4;
+  out.flags = flags_[index];
+  out.corr_source = corr_source_[index];
+  return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// Satellite and signal tracking table fed from NAV-SAT and NAV-SIG.
+//
+// One row per signal, keyed by gnssId/svId/sigId, columns in separate fixed arrays so the key scan
+// touches one array and nothing is allocated. NAV-SIG fills the signal columns, NAV-SAT adds elevation,
+// azimuth and use flags to every row of its satellite (a satellite without NAV-SIG gets a row with
+// sigId SIGNAL_SATELLITE_ONLY). Rows not refreshed for max_age_ms are dropped by expire().
+//
+// Each changed or dropped row is marked, encode_changes() writes just those and clears the marks,
+// encode_full() writes the whole table for new subscribers and clients that lost a message. When the
+// changes do not fit the buffer, or more rows were dropped than can be remembered, encode_changes()
+// writes a full message instead and clears the marks the same way, so a SIGNAL_MSG_MAX buffer always
+// takes the result.
+//
+// seq numbers states of the table. A change message advances it, and so does clearing marks without
+// sending them (folded into a full table, or nobody subscribed): a client that still has the older
+// state must not take the next change message on top of it. encode_full() never advances seq, it
+// stamps the current one, so a full table sent to one client repeats what the others already have.
+//
+//   message (little-endian)
+//     u8 'S', u8 type (SIGNAL_MSG_FULL / SIGNAL_MSG_CHANGES), u16 seq, u16 rows, u16 removed
+//     rows    u8 gnssId, u8 svId, u8 sigId, u8 cno (dBHz), i8 elev (deg, -128 unknown),
+//             u8 quality | health << 4, u16 azim (deg), u8 flags (SIGNAL_FLAG_*), u8 corrSource
+//     removed u8 gnssId, u8 svId, u8 sigId, u8 0
+//
+// Changes apply to the state of seq - 1, removals first, then rows. A full message replaces everything.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIGNAL_TABLE_CAPACITY 128 // the ZED-F9P tracks up to 184 signals, 92 fit in one NAV-SIG
+#define SIGNAL_SATELLITE_ONLY 0xff // sigId of a row that only NAV-SAT has reported
+#define SIGNAL_ELEV_UNKNOWN -128
+#define SIGNAL_MSG_HEADER 8
+#define SIGNAL_ROW_BYTES 10
+#define SIGNAL_REMOVED_BYTES 4
+#define SIGNAL_MSG_MAX (SIGNAL_MSG_HEADER + SIGNAL_TABLE_CAPACITY * SIGNAL_ROW_BYTES) // a full table
+#define SIGNAL_MSG_FULL 1
+#define SIGNAL_MSG_CHANGES 2
+
+#define SIGNAL_FLAG_SV_USED 0x01 // NAV-SAT svUsed
+#define SIGNAL_FLAG_PR_USED 0x02 // NAV-SIG pseudorange used
+#define SIGNAL_FLAG_CR_USED 0x04 // carrier range used
+#define SIGNAL_FLAG_DO_USED 0x08 // doppler used
+#define SIGNAL_FLAG_CORR_USED 0x10 // any correction applied to this signal
+
+struct signal_row_t {
+  uint8_t gnss_id, sv_id, sig_id;
+  uint8_t cno;
+  int8_t elev;
+  int16_t azim;
+  uint8_t quality, health, flags, corr_source;
+};
+
+class SignalTable {
+ public:
+  SignalTable();
+
+  void update_signal(uint8_t gnss_id, uint8_t sv_id, uint8_t sig_id, uint8_t cno, uint8_t quality, uint8_t health,
+                     uint8_t flags, uint8_t corr_source, uint32_t now_ms);
+  void update_satellite(uint8_t gnss_id, uint8_t sv_id, uint8_t cno, int8_t elev, int16_t azim, uint8_t quality,
+                        uint8_t health, bool used, uint32_t now_ms);
+  void expire(uint32_t now_ms, uint32_t max_age_ms);
+  void clear();
+
+  // Both return the message length, 0 when it does not fit (or, for changes, nothing changed)
+  size_t encode_changes(uint8_t *out, size_t size);
+  size_t encode_full(uint8_t *out, size_t size) const;
+  void clear_changes(); // forget the marks (advancing seq if there were any), for a full table sent instead or nobody to send them to
+
+  uint16_t rows() const { return rows_; }
+  bool row(uint16_t index, signal_row_t &out) const; // index over the whole capacity, false for a free slot
+  uint32_t overflows() const { return overflows_; } // signals dropped for a full table
+  uint16_t seq() const { return seq_; }
+
+ private:
+  int find(uint32_t key) const;
+  int insert(uint32_t key, uint32_t now_ms);
+  void remove(int i);
+  void mark(int i) { dirty_[i / 32] |= 1u << (i % 32); }
+  size_t write_row(uint8_t *out, int i) const;
+
+  // 0 is a free slot, valid keys have bit 24 set
+  uint32_t key_[SIGNAL_TABLE_CAPACITY];
+  uint8_t cno_[SIGNAL_TABLE_CAPACITY];
+  int8_t elev_[SIGNAL_TABLE_CAPACITY];
+  int16_t azim_[SIGNAL_TABLE_CAPACITY];
+  uint8_t quality_[SIGNAL_TABLE_CAPACITY]; // quality | health << 4
+  uint8_t flags_[SIGNAL_TABLE_CAPACITY];
+  uint8_t corr_source_[SIGNAL_TABLE_CAPACITY];
+  uint32_t seen_ms_[SIGNAL_TABLE_CAPACITY];
+  uint32_t dirty_[SIGNAL_TABLE_CAPACITY / 32];
+  uint32_t removed_[SIGNAL_TABLE_CAPACITY]; // keys dropped since the last encode_changes()
+  uint16_t removed_count_ = 0;
+  bool removed_overflow_ = false; // more dropped than removed_ holds, only a full table says which
+  uint16_t rows_ = 0;
+  uint16_t seq_ = 0;
+  uint32_t overflows_ = 0;
+};
@@ -0,0 +1,74 @@
+#include "SolutionMonitor.h"
+
+bool SolutionMonitor::update(uint8_t fix_type, uint8_t carr_soln, uint32_t h_acc, uint8_t corr_age, solution_event_t &event) {
+  solution_state_t state = solution_classify(fix_type, carr_soln);
+
+  if (corr_age != 0) corrections_seen_ = true;
+
+  uint8_t flags = 0;
+  if (state >= SOLUTION_FLOAT) {
+    // 20% hysteresis so hAcc hovering at the limit does not toggle the warning
+    uint32_t limit = flags_ & SOLUTION_HACC_HIGH ? hacc_limit_mm * 4 / 5 : hacc_limit_mm;
+    if (h_acc > limit) flags |= SOLUTION_HACC_HIGH;
+    // age code 0 after corrections were coming in means they stopped altogether
+    uint16_t age_s = corr_age ? solution_correction_age_s(corr_age) : corrections_seen_ ? 0xffff : 0;
+    if (age_s > corr_age_limit_s) flags |= SOLUTION_CORRECTIONS_STALE;
+  }
+
+  bool worse = state < state_ || (flags & ~flags_);
+  bool better = state > state_ || (flags_ & ~flags);
+
+  if (worse) {
+    better_epochs_ = 0;
+    if (!alert_) {
+      alert_ = true;
+      alert_from_ = state_;
+    }
+  } else if (better && ++better_epochs_ >= recover_epochs) {
+    better_epochs_ = 0;
+    if (alert_ && state >= alert_from_ && flags == 0) alert_ = false;
+  } else {
+    if (!better) better_epochs_ = 0;
+    return false;
+  }
+
+  event.from = state_;
+  event.to = state;
+  event.from_flags = flags_;
+  event.to_flags = flags;
+  event.degraded = worse;
+  state_ = state;
+  flags_ = flags;
+  return true;
+}
+
+void SolutionMonitor::reset() {
+  state_ = SOLUTION_NONE;
+  flags_ = 0;
+  better_epochs_ = 0;
+  corrections_seen_ = false;
+  alert_ = false;
+  alert_from_ = SOLUTION_NONE;
+}
+
+solution_state_t solution_classify(uint8_t fix_type, uint8_t carr_soln) {
+  if (carr_soln == 2) return SOLUTION_FIXED;
+  if (carr_soln == 1) return SOLUTION_FLOAT;
+  if (fix_type >= 2 && fix_type <= 4) return SOLUTION_FIX;
+  return SOLUTION_NONE;
+}
+
+const char *solution_state_name(solution_state_t state) {
+  switch (state) {
+  case SOLUTION_FIX: return "fix";
+  case SOLUTION_FLOAT: return "float";
+  case SOLUTION_FIXED: return "fixed";
+  default: return "none";
+  }
+}
+
+uint16_t solution_correction_age_s(uint8_t code) {
+  // NAV-PVT flags3 lastCorrectionAge: 1 = 0-1 s, 2 = 1-2 s, 3 = 2-5 s ... 12 = 120 s or more
+  static const uint16_t upper_s[] = {0, 1, 2, 5, 10, 15, 20, 30, 45, 60, 90, 120, 0xffff};
+  return code < sizeof(upper_s) / sizeof(upper_s[0]) ? upper_s[code] : 0xffff;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Transition detector for the receiver's solution state, fed one NAV-PVT epoch at a time.
+//
+// Each epoch is classified as none / fix / float / fixed, plus two warnings that only count while a
+// carrier solution is held: horizontal accuracy above hacc_limit_mm, and corrections older than
+// corr_age_limit_s. A drop (lower state or a new warning) is reported on the epoch it is seen, a
+// recovery only after recover_epochs better epochs in a row, so a solution flapping between float
+// and fixed raises one alert instead of one per epoch.
+//
+// alert() stays set from a drop until the solution is back to at least the state it dropped from,
+// with no warnings. The surveying code uses it to hold or flag points averaged meanwhile.
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum solution_state_t {
+  SOLUTION_NONE, // no fix, dead reckoning only or time only
+  SOLUTION_FIX, // 2D/3D without carrier phase
+  SOLUTION_FLOAT,
+  SOLUTION_FIXED
+};
+
+#define SOLUTION_HACC_HIGH 0x01
+#define SOLUTION_CORRECTIONS_STALE 0x02
+
+struct solution_event_t {
+  solution_state_t from, to;
+  uint8_t from_flags, to_flags;
+  bool degraded; // false for a recovery
+};
+
+class SolutionMonitor {
+ public:
+  // fix_type and carr_soln as in NAV-PVT, corr_age is the PVT lastCorrectionAge code (0 = none).
+  // Returns true and fills event when the reported state changed.
+  bool update(uint8_t fix_type, uint8_t carr_soln, uint32_t h_acc, uint8_t corr_age, solution_event_t &event);
+  void reset();
+  void clear_alert() { alert_ = false; } // accept the current solution, e.g. float is good enough here
+
+  solution_state_t state() const { return state_; }
+  uint8_t flags() const { return flags_; }
+  bool alert() const { return alert_; }
+  solution_state_t alert_from() const { return alert_from_; } // state held before the drop
+
+  // thresholds
+  uint32_t hacc_limit_mm = 50;
+  uint16_t corr_age_limit_s = 30;
+  uint8_t recover_epochs = 3;
+
+ private:
+  solution_state_t state_ = SOLUTION_NONE;
+  uint8_t flags_ = 0;
+  uint8_t better_epochs_ = 0;
+  bool corrections_seen_ = false;
+  bool alert_ = false;
+  solution_state_t alert_from_ = SOLUTION_NONE;
+};
+
+solution_state_t solution_classify(uint8_t fix_type, uint8_t carr_soln); // NAV-PVT fixType and carrSoln
+const char *solution_state_name(solution_state_t state);
+uint16_t solution_correction_age_s(uint8_t code); // upper end of the PVT age bucket, 0 for none
@@ -0,0 +1,84 @@
+#pragma once
+
+// Survey data formats shared by the firmware and the host tools.
+//
+// Record log payloads (RecordLog.h), little-endian as the ESP32 lays them out:
+//   SURVEY_RECORD_POINT      survey_record_t, one saved point
+//   SURVEY_RECORD_RTK_EVENT  rtk_event_record_t, a solution state transition (SolutionMonitor.h)
+//
+// Text survey file: the datum line, then one "name lon lat elevation" line per point with lon and
+// lat in deg * 1e-7 and elevation in mm.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <RecordLog.h>
+
+#define SURVEY_RECORD_POINT 1
+#define SURVEY_RECORD_RTK_EVENT 2
+#define RTK_EVENT_DEGRADED 0
+#define RTK_EVENT_RECOVERED 1
+#define RTK_EVENT_SAVED_IN_ALERT 2 // point saved by hand while the alert was up
+
+struct survey_record_t {
+  uint32_t file_id; // survey_file_id() of the survey file it was saved to
+  char name[16];
+  int32_t lon, lat; // deg * 1e-7
+  int32_t elevation; // mm
+  uint32_t hAcc; // mm
+};
+
+struct rtk_event_record_t {
+  uint32_t file_id;
+  char point[16]; // point being occupied or saved, empty otherwise
+  uint32_t uptime_ms;
+  uint32_t iTOW; // ms
+  uint16_t year;
+  uint8_t month, day, hour, minute, second;
+  uint8_t kind;
+  uint8_t from_state, to_state, from_flags, to_flags;
+  uint8_t corr_age; // s, 0xff when unknown or older than 254 s
+  uint32_t hAcc; // mm
+};
+static_assert(sizeof(rtk_event_record_t) <= RECORD_PAYLOAD_MAX, "rtk event record too long");
+
+// FNV-1a of the survey file path on the card, e.g. "/survey01.txt"
+inline uint32_t survey_file_id(const char *path, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ (uint8_t)path[i]) * 16777619u;
+  return hash;
+}
+
+struct survey_text_point_t {
+  char name[16];
+  int32_t lon, lat, elevation;
+};
+
+// One line of a text survey file, false for the datum line, blank or damaged lines
+inline bool survey_parse_line(const char *line, size_t length, survey_text_point_t &point) {
+  char buffer[96];
+  if (length == 0 || length >= sizeof(buffer)) return false;
+  for (size_t i = 0; i < length; i++) buffer[i] = line[i];
+  buffer[length] = '\0';
+
+  char *end = buffer;
+  while (*end && *end != ' ') end++;
+  size_t name_length = end - buffer;
+  if (name_length == 0 || name_length >= sizeof(point.name) || *end != ' ') return false;
+  for (size_t i = 0; i < name_length; i++) point.name[i] = buffer[i];
+  point.name[name_length] = '\0';
+
+  char *next;
+  long values[3];
+  for (int i = 0; i < 3; i++) {
+    values[i] = strtol(end, &next, 10);
+    if (next == end) return false;
+    end = next;
+  }
+  while (*end == ' ' || *end == '\r') end++;
+  if (*end) return false;
+  point.lon = values[0];
+  point.lat = values[1];
+  point.elevation = values[2];
+  return true;
+}
@@ -0,0 +1,90 @@
+#include "TelemetryDelta.h"
+#include <stdio.h>
+
+TelemetryDelta::TelemetryDelta(uint8_t topic, const char *const *names, uint8_t count, uint32_t keyframe_ms)
+  : topic_(topic), names_(names), count_(count < TELEMETRY_MAX_FIELDS ? count : TELEMETRY_MAX_FIELDS), keyframe_ms_(keyframe_ms) {
+  clear_all();
+}
+
+static void append_json_string(std::string &out, const char *text) {
+  out += '"';
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+      out += *c;
+    } else if ((uint8_t)*c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      out += escaped;
+    } else {
+      out += *c;
+    }
+  }
+  out += '"';
+}
+
+void TelemetryDelta::set(uint8_t field, const char *text) {
+  if (field >= count_) return;
+  std::string &value = current_[field];
+  value.clear();
+  append_json_string(value, text);
+}
+
+void TelemetryDelta::set(uint8_t field, double value) {
+  if (field >= count_) return;
+  char number[24];
+  if (value != value) snprintf(number, sizeof(number), "null"); // NaN is not JSON
+  else snprintf(number, sizeof(number), "%.10g", value);
+  current_[field] = number;
+}
+
+void TelemetryDelta::clear(uint8_t field) {
+  if (field < count_) current_[field] = "null";
+}
+
+void TelemetryDelta::clear_all() {
+  for (uint8_t i = 0; i < count_; i++) current_[i] = "null";
+}
+
+std::string TelemetryDelta::update(uint32_t now_ms) {
+  if (keyframe_due_ || now_ms - last_keyframe_ms_ >= keyframe_ms_) {
+    for (uint8_t i = 0; i < count_; i++) sent_[i] = current_[i];
+    seq_++;
+    keyframe_due_ = false;
+    last_keyframe_ms_ = now_ms;
+    return keyframe();
+  }
+
+  std::string patch;
+  for (uint8_t i = 0; i < count_; i++) {
+    if (current_[i] == sent_[i]) continue;
+    patch += patch.empty() ? "" : ",";
+    patch += std::to_string(i);
+    patch += ',';
+    patch += current_[i];
+    sent_[i] = current_[i];
+  }
+  if (patch.empty()) return "";
+  seq_++;
+  return "{\"t\":" + std::to_string(topic_) + ",\"q\":" + std::to_string(seq_) + ",\"d\":[" + patch + "]}";
+}
+
+std::string TelemetryDelta::keyframe() const {
+  if (seq_ == 0) return "";
+  std::string names, values;
+  for (uint8_t i = 0; i < count_; i++) {
+    if (i > 0) {
+      names += ',';
+      values += ',';
+    }
+    append_json_string(names, names_[i]);
+    values += sent_[i];
+  }
+  return "{\"t\":" + std::to_string(topic_) + ",\"q\":" + std::to_string(seq_) + ",\"k\":[" + names + "],\"v\":[" + values + "]}";
+}
+
+void TelemetryDelta::reset() {
+  clear_all();
+  for (uint8_t i = 0; i < count_; i++) sent_[i] = "null";
+  keyframe_due_ = true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Last-sent state of one telemetry topic, so only changed fields go over the websocket.
+//
+// Fields are set every pass, update() compares them with what the browser already has and returns a
+// patch with just the changes, or nothing. Every message carries a sequence number, a keyframe with
+// the whole state goes out every keyframe_ms and on request, for late joiners and for clients that
+// lost a patch (WsOutbox coalesces telemetry, a newer patch replaces one still queued).
+//
+//   keyframe  {"t":topic,"q":seq,"k":["name",...],"v":[value,...]}
+//   patch     {"t":topic,"q":seq,"d":[field,value,field,value,...]}
+//
+// A patch applies to state seq - 1. A cleared field is null.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define TELEMETRY_MAX_FIELDS 24
+
+class TelemetryDelta {
+ public:
+  // names must outlive the tracker, count is clamped to TELEMETRY_MAX_FIELDS
+  TelemetryDelta(uint8_t topic, const char *const *names, uint8_t count, uint32_t keyframe_ms);
+
+  void set(uint8_t field, const char *text); // JSON string
+  void set(uint8_t field, double value); // JSON number
+  void clear(uint8_t field);
+  void clear_all();
+
+  // Patch with the changes since the last call, or a keyframe when one is due. "" when nothing changed.
+  std::string update(uint32_t now_ms);
+  std::string keyframe() const; // current state as last sent, "" before the first update
+  void reset(); // forget everything, the next update is a keyframe
+
+  uint8_t topic() const { return topic_; }
+  uint32_t seq() const { return seq_; }
+
+ private:
+  uint8_t topic_;
+  const char *const *names_;
+  uint8_t count_;
+  uint32_t keyframe_ms_;
+  uint32_t last_keyframe_ms_ = 0;
+  uint32_t seq_ = 0;
+  bool keyframe_due_ = true;
+  std::string current_[TELEMETRY_MAX_FIELDS]; // JSON value text, "null" when cleared
+  std::string sent_[TELEMETRY_MAX_FIELDS];
+};
@@ -0,0 +1,148 @@
+#include "TrackLog.h"
+#include <Checksum.h>
+#include <string.h>
+
+// header field offsets
+#define T_MAGIC 0
+#define T_SEQ 4
+#define T_WEEK 8
+#define T_COUNT 10
+#define T_TOW0 12
+#define T_LAT0 16
+#define T_LON0 20
+#define T_HEIGHT0 24
+#define T_HACC0 28
+#define T_STATUS0 32
+#define T_SV0 33
+#define T_USED 34
+
+#define TRACK_DATA_SIZE (TRACK_CRC_OFFSET - TRACK_HEADER_SIZE)
+#define TRACK_MAX_DT_MS (1u << 30)
+
+TrackWriter::TrackWriter(write_fn write, void *ctx) : write_(write), ctx_(ctx) {
+  memset(&last_, 0, sizeof(last_));
+}
+
+void TrackWriter::reset(uint32_t first_seq) {
+  open_ = false;
+  seq_ = first_seq;
+  first_seq_ = first_seq;
+  points_ = 0;
+  failed_writes_ = 0;
+}
+
+void TrackWriter::start_block(const track_point_t &point) {
+  memset(block_, 0, sizeof(block_));
+  put_u32le(block_ + T_MAGIC, TRACK_MAGIC);
+  put_u32le(block_ + T_SEQ, seq_);
+  put_u16le(block_ + T_WEEK, point.week);
+  put_u32le(block_ + T_TOW0, point.tow_ms);
+  put_u32le(block_ + T_LAT0, point.lat);
+  put_u32le(block_ + T_LON0, point.lon);
+  put_u32le(block_ + T_HEIGHT0, point.height);
+  put_u32le(block_ + T_HACC0, point.hAcc);
+  block_[T_STATUS0] = point.status;
+  block_[T_SV0] = point.numSV;
+  used_ = 0;
+  count_ = 1;
+  open_ = true;
+}
+
+bool TrackWriter::add(const track_point_t &point) {
+  bool ok = true;
+  // dt is only meaningful within one week, a new week or a step back in time gets a new anchor
+  uint32_t dt = point.tow_ms - last_.tow_ms;
+  if (open_ && (used_ + TRACK_MAX_RECORD > TRACK_DATA_SIZE || point.week != last_.week || dt >= TRACK_MAX_DT_MS)) {
+    ok = flush();
+  }
+
+  if (!open_) {
+    start_block(point);
+  } else {
+    uint8_t *out = block_ + TRACK_HEADER_SIZE + used_;
+    bool status_changed = point.status != last_.status || point.numSV != last_.numSV;
+    size_t n = varint_put(out, dt << 1 | status_changed);
+    n += varint_put_signed(out + n, wrapping_delta(point.lat, last_.lat));
+    n += varint_put_signed(out + n, wrapping_delta(point.lon, last_.lon));
+    n += varint_put_signed(out + n, wrapping_delta(point.height, last_.height));
+    n += varint_put_signed(out + n, (int32_t)(point.hAcc - last_.hAcc));
+    if (status_changed) {
+      out[n++] = point.status;
+      out[n++] = point.numSV;
+    }
+    used_ += n;
+    count_++;
+  }
+  last_ = point;
+  points_++;
+  return ok;
+}
+
+bool TrackWriter::flush() {
+  if (!open_) return true;
+  put_u16le(block_ + T_COUNT, count_);
+  put_u16le(block_ + T_USED, used_);
+  put_u32le(block_ + TRACK_CRC_OFFSET, crc32_update(0, block_, TRACK_CRC_OFFSET));
+  open_ = false;
+  seq_++;
+  if (!write_(block_, TRACK_BLOCK_SIZE, ctx_)) {
+    failed_writes_++;
+    return false;
+  }
+  return true;
+}
+
+track_block_result_t track_decode_block(const uint8_t *block, track_point_fn fn, void *ctx, uint32_t *seq, uint16_t *count) {
+  uint32_t magic = get_u32le(block + T_MAGIC);
+  if (magic != TRACK_MAGIC) {
+    bool erased = true;
+    for (size_t i = 0; i < TRACK_BLOCK_SIZE && erased; i++) erased = block[i] == 0x00 || block[i] == 0xff;
+    return erased ? TRACK_BLOCK_EMPTY : TRACK_BLOCK_BAD_MAGIC;
+  }
+  if (get_u32le(block + TRACK_CRC_OFFSET) != crc32_update(0, block, TRACK_CRC_OFFSET)) return TRACK_BLOCK_BAD_CRC;
+
+  uint16_t points = get_u16le(block + T_COUNT);
+  uint16_t used = get_u16le(block + T_USED);
+  if (used > TRACK_DATA_SIZE) return TRACK_BLOCK_BAD_CRC; // consistent CRC over an impossible header
+  if (seq) *seq = get_u32le(block + T_SEQ);
+  if (count) *count = points;
+
+  track_point_t p;
+  p.week = get_u16le(block + T_WEEK);
+  p.tow_ms = get_u32le(block + T_TOW0);
+  p.lat = get_u32le(block + T_LAT0);
+  p.lon = get_u32le(block + T_LON0);
+  p.height = get_u32le(block + T_HEIGHT0);
+  p.hAcc = get_u32le(block + T_HACC0);
+  p.status = block[T_STATUS0];
+  p.numSV = block[T_SV0];
+  if (points == 0) return TRACK_BLOCK_OK;
+  if (fn) fn(p, ctx);
+
+  const uint8_t *in = block + TRACK_HEADER_SIZE;
+  const uint8_t *end = in + used;
+  for (uint16_t i = 1; i < points; i++) {
+    uint32_t head;
+    int32_t d[4];
+    size_t n = varint_get(in, end - in, &head);
+    if (!n) return TRACK_BLOCK_OK;
+    in += n;
+    for (int k = 0; k < 4; k++) {
+      n = varint_get_signed(in, end - in, &d[k]);
+      if (!n) return TRACK_BLOCK_OK;
+      in += n;
+    }
+    p.tow_ms += head >> 1;
+    p.lat = wrapping_add(p.lat, d[0]);
+    p.lon = wrapping_add(p.lon, d[1]);
+    p.height = wrapping_add(p.height, d[2]);
+    p.hAcc += d[3];
+    if (head & 1) {
+      if (end - in < 2) return TRACK_BLOCK_OK;
+      p.status = *in++;
+      p.numSV = *in++;
+    }
+    if (fn) fn(p, ctx);
+  }
+  return TRACK_BLOCK_OK;
+}
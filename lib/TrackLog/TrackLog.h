@@ -0,0 +1,84 @@
+#pragma once
+
+// Compact binary track log for the SD card.
+//
+// The file is a sequence of TRACK_BLOCK_SIZE blocks, always written whole so every write is one
+// aligned sector. Each block is self-contained: an absolute anchor point in the header, zigzag
+// varint deltas after it, and a CRC-32 in the last 4 bytes. A damaged block costs only its own
+// points, the reader picks up again at the next block.
+//
+//   header (TRACK_HEADER_SIZE bytes, little-endian)
+//     u32 magic 'TRK1', u32 seq, u16 week, u16 count (points incl. anchor), u32 tow0_ms,
+//     i32 lat0, i32 lon0 (deg * 1e-7), i32 height0 (mm), u32 hAcc0 (mm),
+//     u8 status0 (fixType | carrSoln << 3), u8 numSV0, u16 used (data bytes)
+//   data, per point after the anchor
+//     varint (dt_ms << 1 | status_changed)
+//     zigzag varint dlat, dlon, dheight, dhAcc
+//     [u8 status, u8 numSV] when flagged
+//   zero padding, u32 crc32 of everything before it
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Varint.h>
+
+#define TRACK_BLOCK_SIZE 512
+#define TRACK_HEADER_SIZE 36
+#define TRACK_CRC_OFFSET (TRACK_BLOCK_SIZE - 4)
+#define TRACK_MAGIC 0x314b5254 // "TRK1"
+#define TRACK_MAX_RECORD (VARINT_MAX_BYTES * 5 + 2)
+
+struct track_point_t {
+  uint16_t week; // GPS week
+  uint32_t tow_ms; // GPS time of week
+  int32_t lat, lon; // deg * 1e-7
+  int32_t height; // mm above ellipsoid
+  uint32_t hAcc; // mm
+  uint8_t status; // fixType | carrSoln << 3
+  uint8_t numSV;
+};
+
+enum track_block_result_t {
+  TRACK_BLOCK_OK,
+  TRACK_BLOCK_EMPTY, // erased or never written
+  TRACK_BLOCK_BAD_MAGIC,
+  TRACK_BLOCK_BAD_CRC
+};
+
+class TrackWriter {
+ public:
+  typedef bool (*write_fn)(const uint8_t *block, size_t length, void *ctx); // false when the write failed
+
+  TrackWriter(write_fn write, void *ctx = nullptr);
+
+  // Buffers the point, writes the block out when the next one would not fit
+  bool add(const track_point_t &point);
+  // Writes the open block even if it is not full, the next point starts a new block
+  bool flush();
+  // Block numbers restart at first_seq, e.g. to continue an existing file
+  void reset(uint32_t first_seq = 0);
+
+  uint32_t blocks_written() const { return seq_ - first_seq_; }
+  uint32_t points() const { return points_; }
+  uint32_t failed_writes() const { return failed_writes_; }
+
+ private:
+  void start_block(const track_point_t &point);
+
+  uint8_t block_[TRACK_BLOCK_SIZE];
+  bool open_ = false;
+  uint16_t used_ = 0;
+  uint16_t count_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t first_seq_ = 0;
+  uint32_t points_ = 0;
+  uint32_t failed_writes_ = 0;
+  track_point_t last_;
+  write_fn write_;
+  void *ctx_;
+};
+
+typedef void (*track_point_fn)(const track_point_t &point, void *ctx);
+
+// Checks and decodes one block, points are only emitted for a valid block.
+// seq and count are optional outputs.
+track_block_result_t track_decode_block(const uint8_t *block, track_point_fn fn, void *ctx, uint32_t *seq = nullptr, uint16_t *count = nullptr);
@@ -0,0 +1,67 @@
+#pragma once
+
+// LEB128 varints with zigzag mapping for signed deltas. Shared by the epoch history and the track log.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VARINT_MAX_BYTES 5 // 32 bit values
+
+inline uint32_t zigzag_encode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t zigzag_decode(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Returns bytes written, out needs VARINT_MAX_BYTES of room.
+inline size_t varint_put(uint8_t *out, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+// Returns bytes read, 0 when the input ends mid-varint or the varint is too long.
+inline size_t varint_get(const uint8_t *in, size_t available, uint32_t *value) {
+  uint32_t result = 0;
+  for (size_t n = 0; n < available && n < VARINT_MAX_BYTES; n++) {
+    result |= (uint32_t)(in[n] & 0x7f) << (7 * n);
+    if ((in[n] & 0x80) == 0) {
+      *value = result;
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+// Deltas of int32 fields taken modulo 2^32: a longitude step across the antimeridian is larger
+// than int32, wrapped it stays small and the decoder adds it back with the same wrap.
+inline int32_t wrapping_delta(int32_t to, int32_t from) {
+  return (int32_t)((uint32_t)to - (uint32_t)from);
+}
+
+inline int32_t wrapping_add(int32_t value, int32_t delta) {
+  return (int32_t)((uint32_t)value + (uint32_t)delta);
+}
+
+inline size_t varint_put_signed(uint8_t *out, int32_t value) {
+  return varint_put(out, zigzag_encode(value));
+}
+
+inline size_t varint_get_signed(const uint8_t *in, size_t available, int32_t *value) {
+  uint32_t raw;
+  size_t n = varint_get(in, available, &raw);
+  if (n) *value = zigzag_decode(raw);
+  return n;
+}
+
+// little-endian fixed width helpers for headers
+inline void put_u16le(uint8_t *out, uint16_t v) { out[0] = v; out[1] = v >> 8; }
+inline void put_u32le(uint8_t *out, uint32_t v) { out[0] = v; out[1] = v >> 8; out[2] = v >> 16; out[3] = v >> 24; }
+inline uint16_t get_u16le(const uint8_t *in) { return in[0] | (uint16_t)in[1] << 8; }
+inline uint32_t get_u32le(const uint8_t *in) { return in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24; }
@@ -0,0 +1,213 @@
+#include "WsOutbox.h"
+
+WsOutbox::WsOutbox(send_fn send, evict_fn evict, clock_us_fn now_us, void *ctx)
+  : send_(send), evict_(evict), now_us_(now_us), ctx_(ctx) {
+  for (int i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+    clear(clients_[i]);
+  }
+}
+
+void WsOutbox::clear(client_t &c) {
+  for (int i = 0; i < WS_OUTBOX_CRITICAL_DEPTH; i++) c.critical[i].payload.reset();
+  for (int i = 0; i < WS_OUTBOX_TOPICS; i++) c.telemetry[i].payload.reset();
+  c.critical_head = 0;
+  c.critical_count = 0;
+  c.stats = ws_client_stats_t();
+}
+
+void WsOutbox::client_connected(uint8_t client) {
+  if (client >= WS_OUTBOX_MAX_CLIENTS) return;
+  clear(clients_[client]);
+  clients_[client].stats.connected = true;
+}
+
+void WsOutbox::client_disconnected(uint8_t client) {
+  if (client >= WS_OUTBOX_MAX_CLIENTS) return;
+  clear(clients_[client]);
+}
+
+bool WsOutbox::connected(uint8_t client) const {
+  return client < WS_OUTBOX_MAX_CLIENTS && clients_[client].stats.connected;
+}
+
+size_t WsOutbox::pending(uint8_t client) const {
+  if (client >= WS_OUTBOX_MAX_CLIENTS) return 0;
+  const client_t &c = clients_[client];
+  size_t count = c.critical_count;
+  for (int i = 0; i < WS_OUTBOX_TOPICS; i++) {
+    if (c.telemetry[i].payload) count++;
+  }
+  return count;
+}
+
+const ws_client_stats_t &WsOutbox::stats(uint8_t client) const {
+  return clients_[client < WS_OUTBOX_MAX_CLIENTS ? client : 0].stats;
+}
+
+void WsOutbox::send(uint8_t client, ws_priority_t priority, uint8_t topic, const char *data, size_t length, bool binary) {
+  send(client, priority, topic, std::make_shared<const std::string>(data, length), binary);
+}
+
+void WsOutbox::send(uint8_t client, ws_priority_t priority, uint8_t topic, const ws_payload_t &payload, bool binary) {
+  if (!connected(client)) return;
+  client_t &c = clients_[client];
+  uint32_t now = now_us_();
+
+  if (priority == WS_TELEMETRY) {
+    entry_t &slot = c.telemetry[topic % WS_OUTBOX_TOPICS];
+    if (slot.payload) {
+      c.stats.coalesced++; // keep the original queue time so lag still shows how stale the topic is
+    } else {
+      slot.queued_us = now;
+    }
+    slot.payload = payload;
+    slot.binary = binary;
+    return;
+  }
+
+  if (c.critical_count == WS_OUTBOX_CRITICAL_DEPTH) {
+    evict(client, "critical queue full"); // never drop, the client is too slow to keep
+    return;
+  }
+  entry_t &entry = c.critical[(c.critical_head + c.critical_count) % WS_OUTBOX_CRITICAL_DEPTH];
+  entry.payload = payload;
+  entry.queued_us = now;
+  entry.binary = binary;
+  c.critical_count++;
+}
+
+void WsOutbox::broadcast(ws_priority_t priority, uint8_t topic, const char *data, size_t length, bool binary) {
+  ws_payload_t payload;
+  for (uint8_t i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+    if (!clients_[i].stats.connected) continue;
+    if (!payload) payload = std::make_shared<const std::string>(data, length);
+    send(i, priority, topic, payload, binary);
+  }
+}
+
+void WsOutbox::broadcast(ws_priority_t priority, uint8_t topic, const ws_payload_t &payload, bool binary) {
+  for (uint8_t i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+    if (clients_[i].stats.connected) send(i, priority, topic, payload, binary);
+  }
+}
+
+uint32_t WsOutbox::oldest_queued_us(const client_t &c, uint32_t now) const {
+  uint32_t oldest = now;
+  if (c.critical_count > 0) oldest = c.critical[c.critical_head].queued_us;
+  for (int i = 0; i < WS_OUTBOX_TOPICS; i++) {
+    if (c.telemetry[i].payload && (int32_t)(c.telemetry[i].queued_us - oldest) < 0) oldest = c.telemetry[i].queued_us;
+  }
+  return oldest;
+}
+
+// Sends one message for the client: critical messages first, then the stalest telemetry topic.
+// Returns false when nothing went out.
+bool WsOutbox::send_next(uint8_t client, uint32_t now) {
+  client_t &c = clients_[client];
+  entry_t *entry = nullptr;
+  bool critical = c.critical_count > 0;
+
+  if (critical) {
+    entry = &c.critical[c.critical_head];
+  } else {
+    for (int i = 0; i < WS_OUTBOX_TOPICS; i++) {
+      if (c.telemetry[i].payload && (!entry || (int32_t)(c.telemetry[i].queued_us - entry->queued_us) < 0)) {
+        entry = &c.telemetry[i];
+      }
+    }
+  }
+  if (!entry) return false;
+
+  // the transport may re-enter send() for this client, a telemetry message leaves its slot first
+  // so a newer one queued from inside the callback is kept rather than reset below
+  entry_t taken = *entry;
+  if (!critical) entry->payload.reset();
+  ws_send_result_t result = send_(client, taken.payload->data(), taken.payload->size(), taken.binary, ctx_);
+  uint32_t took = now_us_() - now;
+
+  if (result == WS_SEND_FAILED) {
+    evict(client, "send failed");
+    return false;
+  }
+  if (!c.stats.connected) return false; // evicted from inside the transport
+
+  c.stats.last_send_us = took;
+  if (took > c.stats.max_send_us) c.stats.max_send_us = took;
+  c.stats.slow_sends = took > slow_send_us ? c.stats.slow_sends + 1 : 0;
+  if (c.stats.slow_sends >= max_slow_sends) {
+    evict(client, "sends too slow");
+    return false;
+  }
+
+  if (result == WS_SEND_BLOCKED) {
+    c.stats.blocked++;
+    if (!critical) {
+      if (entry->payload) {
+        c.stats.coalesced++; // replaced while the transport had it, the newer message goes next
+        entry->queued_us = taken.queued_us;
+      } else {
+        *entry = taken;
+      }
+    }
+    return false;
+  }
+
+  if (critical) {
+    entry->payload.reset();
+    c.critical_head = (c.critical_head + 1) % WS_OUTBOX_CRITICAL_DEPTH;
+    c.critical_count--;
+  }
+  c.stats.sent++;
+  return true;
+}
+
+void WsOutbox::service(uint32_t budget_us) {
+  uint32_t start = now_us_();
+
+  // lag bookkeeping and eviction of clients that stopped draining
+  for (uint8_t i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+    client_t &c = clients_[i];
+    if (!c.stats.connected) continue;
+    c.stats.lag_ms = (start - oldest_queued_us(c, start)) / 1000;
+    if (c.stats.lag_ms > c.stats.max_lag_ms) c.stats.max_lag_ms = c.stats.lag_ms;
+    if (c.stats.lag_ms > max_lag_ms) evict(i, "lagging");
+  }
+
+  bool progress = true;
+  while (progress && now_us_() - start < budget_us) {
+    progress = false;
+    for (uint8_t n = 0; n < WS_OUTBOX_MAX_CLIENTS; n++) {
+      uint8_t i = (next_client_ + n) % WS_OUTBOX_MAX_CLIENTS;
+      if (!clients_[i].stats.connected) continue;
+      if (send_next(i, now_us_())) progress = true;
+      if (now_us_() - start >= budget_us) {
+        next_client_ = (i + 1) % WS_OUTBOX_MAX_CLIENTS; // whoever is next starts the following pass
+        return;
+      }
+    }
+  }
+}
+
+void WsOutbox::evict(uint8_t client, const char *reason) {
+  clear(clients_[client]);
+  if (evict_) evict_(client, reason, ctx_);
+}
+
+WsPayloadPool::WsPayloadPool(size_t capacity) {
+  for (int i = 0; i < WS_PAYLOAD_POOL_SIZE; i++) {
+    payloads_[i] = std::make_shared<std::string>();
+    payloads_[i]->reserve(capacity);
+  }
+}
+
+ws_payload_t WsPayloadPool::make(const char *data, size_t length) {
+  for (int i = 0; i < WS_PAYLOAD_POOL_SIZE; i++) {
+    std::shared_ptr<std::string> &payload = payloads_[i];
+    if (payload.use_count() == 1 && length <= payload->capacity()) { // only the pool has it
+      payload->assign(data, length);
+      return payload;
+    }
+  }
+  allocations_++;
+  return std::make_shared<const std::string>(data, length);
+}
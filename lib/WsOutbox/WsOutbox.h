@@ -0,0 +1,116 @@
+#pragma once
+
+// Per-client outbound queues for the websocket server.
+//
+// Messages are queued per client and drained by service() under a time budget, so a client on a bad
+// link only ever delays itself. Critical messages (alerts, survey results, replies) are never dropped:
+// a client that cannot keep up with them is evicted instead. Telemetry is coalesced per topic, a newer
+// value replaces the one still waiting. The transport is a callback so the same queues work with any
+// websocket server.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#define WS_OUTBOX_MAX_CLIENTS 8
+#define WS_OUTBOX_CRITICAL_DEPTH 16 // critical messages waiting per client before it is evicted
+#define WS_OUTBOX_TOPICS 12 // telemetry topics, one coalescing slot each
+
+enum ws_priority_t {
+  WS_TELEMETRY, // latest value wins, stale ones are dropped
+  WS_CRITICAL   // delivered in order or the client is evicted
+};
+
+enum ws_send_result_t {
+  WS_SEND_OK,
+  WS_SEND_BLOCKED, // transport has no room right now, retry on a later pass
+  WS_SEND_FAILED   // connection is gone
+};
+
+typedef std::shared_ptr<const std::string> ws_payload_t; // one copy shared by every client it goes to
+
+struct ws_client_stats_t {
+  bool connected;
+  uint32_t sent;
+  uint32_t coalesced; // telemetry replaced before it went out
+  uint32_t blocked; // sends the transport pushed back
+  uint32_t lag_ms; // age of the oldest message still waiting
+  uint32_t max_lag_ms;
+  uint32_t last_send_us;
+  uint32_t max_send_us;
+  uint8_t slow_sends; // consecutive sends slower than slow_send_us
+};
+
+class WsOutbox {
+ public:
+  typedef ws_send_result_t (*send_fn)(uint8_t client, const char *data, size_t length, bool binary, void *ctx);
+  typedef void (*evict_fn)(uint8_t client, const char *reason, void *ctx);
+  typedef uint32_t (*clock_us_fn)();
+
+  WsOutbox(send_fn send, evict_fn evict, clock_us_fn now_us, void *ctx = nullptr);
+
+  void client_connected(uint8_t client);
+  void client_disconnected(uint8_t client);
+
+  void send(uint8_t client, ws_priority_t priority, uint8_t topic, const char *data, size_t length, bool binary = false);
+  void send(uint8_t client, ws_priority_t priority, uint8_t topic, const ws_payload_t &payload, bool binary = false);
+  void broadcast(ws_priority_t priority, uint8_t topic, const char *data, size_t length, bool binary = false);
+  void broadcast(ws_priority_t priority, uint8_t topic, const ws_payload_t &payload, bool binary = false);
+
+  // Drain queues round-robin until everything is sent or budget_us is spent.
+  void service(uint32_t budget_us);
+
+  bool connected(uint8_t client) const;
+  size_t pending(uint8_t client) const;
+  const ws_client_stats_t &stats(uint8_t client) const;
+
+  // eviction policy
+  uint32_t max_lag_ms = 5000;
+  uint32_t slow_send_us = 200000;
+  uint8_t max_slow_sends = 3;
+
+ private:
+  struct entry_t {
+    ws_payload_t payload;
+    uint32_t queued_us;
+    bool binary;
+  };
+
+  struct client_t {
+    entry_t critical[WS_OUTBOX_CRITICAL_DEPTH];
+    uint8_t critical_head;
+    uint8_t critical_count;
+    entry_t telemetry[WS_OUTBOX_TOPICS];
+    ws_client_stats_t stats;
+  };
+
+  bool send_next(uint8_t client, uint32_t now);
+  void evict(uint8_t client, const char *reason);
+  void clear(client_t &c);
+  uint32_t oldest_queued_us(const client_t &c, uint32_t now) const;
+
+  client_t clients_[WS_OUTBOX_MAX_CLIENTS];
+  uint8_t next_client_ = 0;
+  send_fn send_;
+  evict_fn evict_;
+  clock_us_fn now_us_;
+  void *ctx_;
+};
+
+// Payloads for a message that goes out every epoch. make() refills one that no client queue holds any
+// more, keeping its capacity, so once the pool is warm a broadcast of it allocates nothing. With every
+// payload still queued (more than WS_PAYLOAD_POOL_SIZE - 1 clients behind) it allocates one and counts it.
+#define WS_PAYLOAD_POOL_SIZE (WS_OUTBOX_MAX_CLIENTS + 1) // a stale copy per client plus the new one
+
+class WsPayloadPool {
+ public:
+  explicit WsPayloadPool(size_t capacity); // bytes reserved per payload
+
+  ws_payload_t make(const char *data, size_t length);
+  uint32_t allocations() const { return allocations_; } // make() calls the pool could not serve
+
+ private:
+  std::shared_ptr<std::string> payloads_[WS_PAYLOAD_POOL_SIZE];
+  uint32_t allocations_ = 0;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+// One NAV-PVT epoch as the firmware's consumers see it. Its own header so the host tools that
+// compile main.cpp as a separate unit (src/host/Firmware.h) share the layout.
+
+#include <stdint.h>
+
+struct gnss_epoch_t {
+  uint32_t iTOW; // ms
+  int32_t lat, lon; // deg * 1e-7
+  int32_t height, hMSL; // mm
+  uint32_t hAcc, vAcc; // mm
+  int32_t gSpeed; // mm/s
+  int32_t headMot; // deg * 1e-5
+  uint16_t pDOP; // * 0.01
+  uint8_t fixType;
+  uint8_t carrSoln; // 0 none, 1 float, 2 fixed
+  uint8_t numSV;
+  uint8_t corr_age; // PVT lastCorrectionAge code, 0 = no corrections
+  uint16_t year;
+  uint8_t month, day, hour, minute, second;
+  bool date_valid, time_valid;
+  unsigned long received_ms;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// What the host tools drive in the firmware. src/main.cpp is compiled on its own in their envs
+// (build_src_filter), these declarations match its definitions.
+
+#include <Arduino.h>
+#include <SD.h>
+#include <EventMarks.h>
+#include <HttpServer.h>
+#include <PointIndex.h>
+#include <SignalTable.h>
+#include <SparkFun_u-blox_GNSS_v3.h>
+#include <TelemetryDelta.h>
+#include <WsOutbox.h>
+#include "../GnssEpoch.h"
+
+extern SFE_UBLOX_GNSS HAM_GNSS; // the stub ZED-F9P, host_pvt() and friends feed its callbacks
+extern HttpServer http;
+extern WsOutbox ws_outbox;
+extern TelemetryDelta position_telemetry;
+
+void setup();
+void loop();
+bool gnss_ready();
+int find_rate_profile(const char *name);
+bool set_rate_profile(uint8_t profile);
+
+// pages
+String Send_Index_HTML();
+String Send_Start_Survey_HTML();
+String Send_Survey_Log_HTML();
+String Send_GNSS_Info_HTML();
+String Send_Device_Files_HTML();
+String WebsiteBaseCSS();
+
+// epochs and survey
+extern gnss_epoch_t latest_epoch;
+extern bool survey_in_progress;
+extern String datum;
+extern String working_directory;
+void epoch_ws_telemetry(const gnss_epoch_t &epoch);
+void handle_survey_observation_in_progress();
+void save_survey_observation(String gcp_index);
+bool survey_file_empty();
+
+// signal table
+extern SignalTable signal_table;
+extern uint8_t signal_message[SIGNAL_MSG_MAX];
+
+// camera event marks
+extern EventRing event_ring;
+extern uint32_t event_marks_unmatched;
+extern uint32_t event_marks_missed;
+bool start_event_marks();
+void stop_event_marks();
+void service_event_marks(bool final);
+
+// stakeout
+extern PointIndex *stakeout_index;
+bool load_stakeout(const String &path);
+void stop_stakeout();
+void epoch_stakeout(const gnss_epoch_t &epoch);
+
+// files and commands
+void update_listed_files_WebSocket(const String dirName);
+void show_file_contents(const String dirName);
+void webSocketEvent(uint8_t num, http_ws_event_t type, uint8_t *payload, size_t length);
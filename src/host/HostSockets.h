@@ -0,0 +1,52 @@
+#pragma once
+
+// Client side of the host load tools (http_load, ws_load): loopback connections to the server under
+// test and keep-alive GETs on them.
+
+#include <string>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// -1 when nothing listens on the port
+inline int connect_to(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// One GET on a keep-alive connection, false when the server closed it or answered with an error
+inline bool fetch(int fd, const char *path, std::string &buffer) {
+  char request[128];
+  int length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+  if (send(fd, request, length, MSG_NOSIGNAL) != length) return false;
+
+  buffer.clear();
+  size_t header_end = std::string::npos, total = 0;
+  char chunk[4096];
+  while (header_end == std::string::npos || buffer.size() < total) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) return false;
+    buffer.append(chunk, n);
+    if (header_end == std::string::npos && (header_end = buffer.find("\r\n\r\n")) != std::string::npos) {
+      const char *content_length = strcasestr(buffer.c_str(), "Content-Length:");
+      total = header_end + 4 + (content_length ? strtoul(content_length + 15, nullptr, 10) : 0);
+    }
+  }
+  return buffer.compare(0, 12, "HTTP/1.1 200") == 0;
+}
@@ -0,0 +1,436 @@
+// Host benchmarks for the firmware's hot paths: page generation, JSON telemetry and replies, survey
+// saves, directory listings, websocket command parsing, the NAV-SAT/NAV-SIG signal table, camera
+// event marks and the stakeout lookup.
+//
+//   pio run -e bench
+//   .pio/build/bench/program [results.json] [--quick]
+//
+// The firmware is built as its own unit against src/host/shim, which keeps the ESP32 String growth pattern and
+// counts every heap allocation. Each result has ns/op, allocations/op, peak heap above the live heap
+// at the start of the op, and bytes produced (page size or websocket payload). Serial is muted and
+// delay() is skipped, so the numbers are CPU and allocator cost only. Websocket output goes through the
+// real HttpServer to a client socket on localhost and its bytes are counted on arrival, framing included. Absolute times are the host's,
+// compare them between commits, not with the board.
+
+#include "../Firmware.h"
+#include <HostHeap.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct bench_result_t {
+  std::string name;
+  std::string params; // JSON object text
+  uint32_t iterations;
+  double ns_per_op;
+  double allocs_per_op;
+  size_t peak_heap_bytes;
+  double bytes_per_op;
+};
+
+static std::vector<bench_result_t> results;
+static uint32_t scale = 1; // --quick divides iteration counts
+static int ws_client_fd = -1;
+static uint8_t ws_client = 0; // the server's client number for it
+static size_t ws_bytes_received = 0;
+
+static uint64_t now_ns() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Sends whatever the op queued, untimed, so the bench client is never evicted for a full queue
+static void drain() {
+  static const uint8_t pong[6] = {0x8a, 0x80, 0, 0, 0, 0}; // unsolicited, keeps the server's timeout from firing on skipped delays
+  send(ws_client_fd, pong, sizeof(pong), MSG_NOSIGNAL);
+  char buffer[16384];
+  do {
+    ws_outbox.service(UINT32_MAX);
+    http.service();
+    ssize_t n;
+    while ((n = recv(ws_client_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) ws_bytes_received += n;
+  } while (ws_outbox.pending(ws_client) > 0 || http.queued_bytes(ws_client) > 0);
+}
+
+// op returns the bytes it produced itself (a page), websocket bytes are counted on top
+static void run(const char *name, const std::string &params, uint32_t iterations, const std::function<size_t()> &op) {
+  iterations = std::max<uint32_t>(iterations / scale, 3);
+  for (uint32_t i = 0; i < iterations / 10 + 1; i++) { // first-use allocations, file cache
+    op();
+    drain();
+  }
+
+  const host_heap_stats_t &heap = host_heap_stats();
+  uint64_t total_ns = 0, allocations = 0;
+  size_t peak = 0, bytes = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    size_t ws_bytes = ws_bytes_received;
+    uint64_t allocations_before = heap.allocations;
+    size_t live_before = heap.live_bytes;
+    host_heap_reset_peak();
+
+    uint64_t start = now_ns();
+    size_t produced = op();
+    total_ns += now_ns() - start;
+
+    allocations += heap.allocations - allocations_before;
+    peak = std::max(peak, heap.peak_bytes - live_before);
+    drain();
+    bytes += produced + ws_bytes_received - ws_bytes;
+  }
+
+  bench_result_t result = {name, params, iterations, (double)total_ns / iterations, (double)allocations / iterations, peak, (double)bytes / iterations};
+  printf("%-34s %-22s %12.0f %10.1f %10zu %10.0f\n", name, params.c_str(), result.ns_per_op, result.allocs_per_op, result.peak_heap_bytes, result.bytes_per_op);
+  results.push_back(result);
+}
+
+static std::string size_param(const char *key, size_t value) {
+  return "{\"" + std::string(key) + "\":" + std::to_string(value) + "}";
+}
+
+static void bench_pages() {
+  struct page_t {
+    const char *name;
+    String (*build)();
+  } pages[] = {
+    {"Send_Index_HTML", Send_Index_HTML},
+    {"Send_Start_Survey_HTML", Send_Start_Survey_HTML},
+    {"Send_Survey_Log_HTML", Send_Survey_Log_HTML},
+    {"Send_GNSS_Info_HTML", Send_GNSS_Info_HTML},
+    {"Send_Device_Files_HTML", Send_Device_Files_HTML},
+    {"WebsiteBaseCSS", WebsiteBaseCSS},
+  };
+  for (const page_t &page : pages) {
+    run(page.name, "{}", 2000, [&]() { return (size_t)page.build().length(); });
+  }
+}
+
+static void bench_telemetry() {
+  survey_in_progress = false;
+  run("epoch_ws_telemetry", "{}", 20000, []() {
+    epoch_ws_telemetry(latest_epoch);
+    return (size_t)0;
+  });
+
+  run("dispatch_epoch", "{}", 20000, []() { // every consumer at the current profile's decimation
+    HAM_GNSS.host.pvt.iTOW += 1000;
+    HAM_GNSS.host_pvt();
+    return (size_t)0;
+  });
+
+  survey_in_progress = true;
+  HAM_GNSS.host.survey_active = true;
+  HAM_GNSS.host.survey_valid = false;
+  run("handle_survey_observation_in_progress", "{}", 5000, []() { // one NAV-SVIN report
+    HAM_GNSS.host_nav_svin();
+    handle_survey_observation_in_progress();
+    return (size_t)0;
+  });
+  survey_in_progress = false;
+  HAM_GNSS.host.survey_active = false;
+}
+
+// A full sky: 40 satellites in NAV-SAT, 92 signals in NAV-SIG, C/N0 moving a little every epoch
+static void bench_signals() {
+  UBX_NAV_SAT_data_t &sat = HAM_GNSS.host.nav_sat;
+  UBX_NAV_SIG_data_t &sig = HAM_GNSS.host.nav_sig;
+  sat.header.numSvs = 40;
+  for (int i = 0; i < 40; i++) {
+    sat.blocks[i] = {};
+    sat.blocks[i].gnssId = i / 10 * 2; // GPS, Galileo, GLONASS, ...
+    sat.blocks[i].svId = i % 10 + 1;
+    sat.blocks[i].elev = 10 + i;
+    sat.blocks[i].azim = i * 9;
+    sat.blocks[i].flags.bits.svUsed = 1;
+  }
+  sig.header.numSigs = UBX_NAV_SIG_MAX_BLOCKS;
+  for (int i = 0; i < UBX_NAV_SIG_MAX_BLOCKS; i++) {
+    sig.blocks[i] = {};
+    sig.blocks[i].gnssId = sat.blocks[i % 40].gnssId;
+    sig.blocks[i].svId = sat.blocks[i % 40].svId;
+    sig.blocks[i].sigId = i / 40 * 3;
+    sig.blocks[i].sigFlags.bits.prUsed = 1;
+  }
+
+  uint32_t epoch = 0;
+  run("nav_sat_sig_ingest", size_param("signals", UBX_NAV_SIG_MAX_BLOCKS), 5000, [&]() {
+    epoch++;
+    for (int i = 0; i < UBX_NAV_SIG_MAX_BLOCKS; i++) sig.blocks[i].cno = 30 + (i + epoch) % 4 / 3; // a quarter change
+    HAM_GNSS.host_nav_sat();
+    HAM_GNSS.host_nav_sig();
+    return signal_table.encode_changes(signal_message, sizeof(signal_message));
+  });
+  run("signal_table_full", size_param("signals", signal_table.rows()), 5000, []() {
+    return signal_table.encode_full(signal_message, sizeof(signal_message));
+  });
+}
+
+// Camera marks at 20 Hz against 20 Hz HPPOSLLH epochs: capture, interpolation and the CSV write
+static void bench_event_marks() {
+  if (!start_event_marks()) return;
+  UBX_NAV_HPPOSLLH_data_t &hp = HAM_GNSS.host.hpposllh;
+  UBX_TIM_TM2_data_t &tm2 = HAM_GNSS.host.tim_tm2;
+  hp = {};
+  hp.iTOW = HAM_GNSS.host.pvt.iTOW;
+  hp.lat = HAM_GNSS.host.pvt.lat;
+  hp.lon = HAM_GNSS.host.pvt.lon;
+  hp.height = HAM_GNSS.host.pvt.height;
+  hp.hAcc = 140;
+  hp.vAcc = 210;
+  tm2 = {};
+  tm2.flags.bits.newRisingEdge = 1;
+  tm2.flags.bits.time = 1;
+  tm2.flags.bits.timeBase = 1;
+  tm2.wnR = 2312;
+  HAM_GNSS.host_hpposllh();
+
+  run("event_marks", size_param("marks_per_s", 20), 20000, [&]() {
+    tm2.count++;
+    tm2.towMsR = hp.iTOW + 17; // mid-epoch, placed once the next epoch is in
+    tm2.towSubMsR = 250000;
+    HAM_GNSS.host_tim_tm2();
+    hp.iTOW += 50;
+    hp.lat += 3;
+    hp.lon += 5;
+    HAM_GNSS.host_hpposllh();
+    service_event_marks(false);
+    return (size_t)0;
+  });
+  if (event_ring.dropped() || event_marks_unmatched || event_marks_missed) {
+    fprintf(stderr, "event marks lost: %u dropped, %u unmatched, %u missed\n", event_ring.dropped(), event_marks_unmatched, event_marks_missed);
+  }
+  stop_event_marks();
+}
+
+static void fill_file(const String &path, size_t size) {
+  File file = SD.open(path, FILE_WRITE);
+  file.print(datum);
+  char line[64];
+  for (int i = 1; file.size() < size; i++) {
+    snprintf(line, sizeof(line), "GCP%d -1223456789 374567890 %d\n", i, 12000 + i % 1000);
+    file.print(line);
+  }
+  file.close();
+}
+
+static void bench_save_survey() {
+  String saved_directory = working_directory;
+  for (size_t size : {1024u, 10240u, 102400u, 1048576u, 10485760u}) {
+    working_directory = "/bench_save_" + String((unsigned)size) + ".txt";
+    fill_file(working_directory, size);
+    int index = 1;
+    run("save_survey_observation", size_param("file_bytes", size), 200, [&]() {
+      save_survey_observation(String(index++));
+      return (size_t)0;
+    });
+    SD.remove(working_directory);
+  }
+  working_directory = saved_directory;
+}
+
+static void bench_file_listing() {
+  for (int entries : {10, 100, 1000, 10000}) {
+    String dir = "/bench_list_" + String(entries);
+    SD.mkdir(dir);
+    for (int i = 0; i < entries; i++) {
+      char name[32];
+      snprintf(name, sizeof(name), "/point_%05d.txt", i);
+      File file = SD.open(dir + name, FILE_WRITE);
+      file.close();
+    }
+    run("update_listed_files_WebSocket", size_param("entries", entries), std::max(20000 / entries, 5), [&]() {
+      update_listed_files_WebSocket(dir);
+      return (size_t)0;
+    });
+  }
+}
+
+// Viewing the same file again and the per-save empty check, both served by the SD read cache
+static void bench_file_view() {
+  String path = "/bench_view.txt";
+  fill_file(path, 4096);
+  run("show_file_contents", size_param("file_bytes", 4096), 2000, [&]() {
+    show_file_contents(path);
+    return (size_t)0;
+  });
+  String saved_directory = working_directory;
+  working_directory = path;
+  run("survey_file_empty", "{}", 20000, []() { return (size_t)survey_file_empty(); });
+  working_directory = saved_directory;
+  SD.remove(path);
+}
+
+// Nearest of 100k loaded points and the offsets to it, every epoch while the rover walks a site
+static void bench_stakeout() {
+  String path = "/bench_stakeout.txt";
+  File file = SD.open(path, FILE_WRITE);
+  file.print(datum);
+  char line[64];
+  for (int i = 0; i < 100000; i++) { // a 316 x 316 grid, about 1.1 m apart
+    snprintf(line, sizeof(line), "GCP%d %d %d %d\n", i + 1, -1223456789 + i % 316 * 125, 374567890 + i / 316 * 100, 12000 + i % 1000);
+    file.print(line);
+  }
+  file.close();
+  if (!load_stakeout(path)) return;
+
+  gnss_epoch_t epoch = latest_epoch;
+  uint32_t step = 0;
+  run("epoch_stakeout", size_param("points", stakeout_index->size()), 20000, [&]() {
+    step++;
+    epoch.lat = 374567890 + step * 37 % 31600;
+    epoch.lon = -1223456789 + step * 53 % 39500;
+    epoch_stakeout(epoch);
+    return (size_t)0;
+  });
+  stop_stakeout();
+  SD.remove(path);
+}
+
+static void bench_commands() {
+  struct command_t {
+    const char *label;
+    const char *json;
+  } commands[] = {
+    {"message", "{\"cmd\":\"message\",\"message\":\"hello\",\"date\":\"2024-05-01T12:00:00Z\"}"},
+    {"set_target_accuracy", "{\"cmd\":\"set_target_accuracy\",\"value\":0.5}"},
+    {"history", "{\"cmd\":\"history\",\"from_s\":600,\"to_s\":0,\"step_s\":10}"},
+    {"rate_profile", "{\"cmd\":\"rate_profile\",\"name\":\"survey\"}"},
+    {"unknown", "{\"cmd\":\"unknown_command\"}"}, // one hash lookup, rejected
+    {"bad_args", "{\"cmd\":\"history\",\"from_s\":\"600\"}"}, // schema rejects it, the handler does not run
+    {"no_cmd", "{\"survey\":\"START\"}"},
+  };
+  for (const command_t &command : commands) {
+    std::string buffer;
+    run("webSocketEvent", std::string("{\"command\":\"") + command.label + "\"}", 5000, [&]() {
+      buffer.assign(command.json, strlen(command.json) + 1); // deserializeJson parses a uint8_t* in place
+      webSocketEvent(ws_client, HTTP_WS_TEXT, (uint8_t *)&buffer[0], buffer.size() - 1);
+      return (size_t)0;
+    });
+  }
+}
+
+static bool write_results(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) return false;
+  fprintf(out, "[\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const bench_result_t &r = results[i];
+    fprintf(out, "  {\"name\":\"%s\",\"params\":%s,\"iterations\":%u,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"peak_heap_bytes\":%zu,\"bytes_per_op\":%.1f}%s\n",
+            r.name.c_str(), r.params.c_str(), r.iterations, r.ns_per_op, r.allocs_per_op, r.peak_heap_bytes, r.bytes_per_op, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "]\n");
+  return fclose(out) == 0;
+}
+
+// The firmware's server, moved to a free port, with one websocket client connected to it
+static bool connect_ws_client() {
+  http.stop();
+  if (!http.begin(0)) return false;
+  ws_client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(http.port());
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(ws_client_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) return false;
+  const char *upgrade = "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+  if (send(ws_client_fd, upgrade, strlen(upgrade), 0) != (ssize_t)strlen(upgrade)) return false;
+
+  for (int i = 0; i < 1000 && http.ws_client_count() == 0; i++) {
+    http.service();
+    usleep(1000);
+  }
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (http.ws_connected(i)) ws_client = i;
+  }
+  return http.ws_client_count() == 1;
+}
+
+// setup(), then loop() through the boot sequencer until the first epoch finishes it
+static bool boot_firmware() {
+  UBX_NAV_PVT_data_t &pvt = HAM_GNSS.host.pvt;
+  pvt.iTOW = 302400000;
+  pvt.year = 2024;
+  pvt.month = 5;
+  pvt.day = 1;
+  pvt.hour = 12;
+  pvt.valid.all = 0x03;
+  pvt.fixType = 3;
+  pvt.flags.bits.carrSoln = 2;
+  pvt.numSV = 24;
+  pvt.lat = 374567890;
+  pvt.lon = -1223456789;
+  pvt.height = 12345;
+  pvt.hMSL = 45678;
+  pvt.hAcc = 14;
+  pvt.vAcc = 21;
+  pvt.pDOP = 120;
+  HAM_GNSS.host.high_res_lat = pvt.lat;
+  HAM_GNSS.host.high_res_lon = pvt.lon;
+
+  setup();
+  for (int i = 0; i < 10 && !gnss_ready(); i++) {
+    delay(600); // past the sequencer's retry spacing
+    loop();
+    if (gnss_ready()) HAM_GNSS.host_pvt(); // receivers configured, the first epoch ends the boot
+  }
+  return gnss_ready();
+}
+
+int main(int argc, char **argv) {
+  const char *output = "bench_results.json";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) scale = 10;
+    else output = argv[i];
+  }
+
+  char sd_root[] = "/tmp/ham_gnss_bench_XXXXXX";
+  if (!mkdtemp(sd_root)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  host_sd_root(sd_root);
+  host_serial_quiet(true);
+  host_skip_delays(true);
+
+  if (!boot_firmware()) {
+    fprintf(stderr, "firmware did not finish booting against the stub receivers\n");
+    return 1;
+  }
+  if (!connect_ws_client()) {
+    fprintf(stderr, "websocket client could not connect to the firmware's server\n");
+    return 1;
+  }
+  drain();
+
+  printf("%-34s %-22s %12s %10s %10s %10s\n", "benchmark", "params", "ns/op", "allocs/op", "peak B", "bytes/op");
+  bench_pages();
+  bench_telemetry();
+  bench_signals();
+  bench_event_marks();
+  bench_stakeout();
+  bench_commands();
+  bench_file_listing();
+  bench_file_view();
+  bench_save_survey();
+  close(ws_client_fd);
+
+  std::string cleanup = std::string("rm -rf ") + sd_root;
+  if (system(cleanup.c_str()) != 0) fprintf(stderr, "could not remove %s\n", sd_root);
+
+  if (!write_results(output)) {
+    fprintf(stderr, "could not write %s\n", output);
+    return 1;
+  }
+  printf("%zu results written to %s\n", results.size(), output);
+  return 0;
+}
@@ -0,0 +1,433 @@
+// Throughput and robustness of lib/FrameScanner on the host.
+//
+//   pio run -e frame_bench
+//   .pio/build/frame_bench/program [megabytes]              MB/s of checksums, scan and ring
+//   .pio/build/frame_bench/program --fuzz corpus [runs]     mutate the corpus, check every result
+//   .pio/build/frame_bench/program --write-corpus corpus    regenerate the seed files
+//
+// The stream is what a base station puts out over I2C: NAV-PVT, NAV-HPPOSLLH and NAV-SAT, RTCM3
+// MSM4 and 1005/1230, NMEA between them. The seeds in src/host/frame_bench/corpus are short cuts of
+// it plus the awkward cases: false syncs, truncated and corrupted frames, maximum lengths.
+//
+// Built with -DFRAME_FUZZER and clang -fsanitize=fuzzer,address the same checks run under libFuzzer:
+//   clang++ -std=gnu++17 -DFRAME_FUZZER -fsanitize=fuzzer,address -Ilib/Checksum -Ilib/FrameScanner
+//     src/host/frame_bench/main.cpp lib/FrameScanner/FrameScanner.cpp -o frame_fuzz
+//   ./frame_fuzz src/host/frame_bench/corpus
+
+#include <FrameScanner.h>
+#include <Checksum.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::vector<uint8_t> bytes_t;
+
+static double now_s() {
+  using namespace std::chrono;
+  return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t random_state = 12345;
+static uint32_t random_next() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+// Byte at a time, the way the frames were checked before
+static void reference_fletcher(const uint8_t *data, size_t length, uint8_t &a, uint8_t &b) {
+  a = b = 0;
+  for (size_t i = 0; i < length; i++) {
+    a += data[i];
+    b += a;
+  }
+}
+
+static uint32_t reference_crc24q(const uint8_t *data, size_t length) {
+  uint32_t crc = 0;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint32_t)data[i] << 16;
+    for (int bit = 0; bit < 8; bit++) {
+      crc <<= 1;
+      if (crc & 0x1000000) crc ^= 0x1864cfb;
+    }
+  }
+  return crc & 0xffffff;
+}
+
+static void add_ubx(bytes_t &out, uint8_t cls, uint8_t id, const bytes_t &payload) {
+  size_t start = out.size();
+  out.insert(out.end(), {UBX_SYNC_1, UBX_SYNC_2, cls, id, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8)});
+  out.insert(out.end(), payload.begin(), payload.end());
+  uint8_t a, b;
+  reference_fletcher(out.data() + start + 2, payload.size() + 4, a, b);
+  out.push_back(a);
+  out.push_back(b);
+}
+
+static void add_rtcm(bytes_t &out, uint16_t type, size_t payload_length) {
+  size_t start = out.size();
+  out.insert(out.end(), {RTCM3_PREAMBLE, (uint8_t)(payload_length >> 8), (uint8_t)payload_length});
+  for (size_t i = 0; i < payload_length; i++) out.push_back(random_next());
+  if (payload_length >= 2) {
+    out[start + 3] = type >> 4;
+    out[start + 4] = (type << 4) | (out[start + 4] & 0x0f);
+  }
+  uint32_t crc = reference_crc24q(out.data() + start, payload_length + 3);
+  out.insert(out.end(), {(uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc});
+}
+
+static bytes_t random_payload(size_t length) {
+  bytes_t payload(length);
+  for (auto &b : payload) b = random_next();
+  return payload;
+}
+
+// One second of base station output
+static void add_epoch(bytes_t &out) {
+  add_ubx(out, 0x01, 0x07, random_payload(92)); // NAV-PVT
+  add_ubx(out, 0x01, 0x14, random_payload(36)); // NAV-HPPOSLLH
+  add_ubx(out, 0x01, 0x35, random_payload(8 + 12 * 30)); // NAV-SAT
+  add_rtcm(out, 1005, 19);
+  add_rtcm(out, 1074, 180 + random_next() % 100);
+  add_rtcm(out, 1084, 150 + random_next() % 80);
+  add_rtcm(out, 1094, 180 + random_next() % 100);
+  add_rtcm(out, 1124, 200 + random_next() % 120);
+  if (random_next() % 10 == 0) add_rtcm(out, 1230, 6);
+  const char *nmea = "$GNGGA,120000.00,3727.40734,N,12220.74073,W,4,12,0.55,12.3,M,-32.1,M,1.0,0000*5A\r\n";
+  out.insert(out.end(), nmea, nmea + strlen(nmea));
+}
+
+static bytes_t make_stream(size_t bytes) {
+  bytes_t out;
+  out.reserve(bytes + 4096);
+  while (out.size() < bytes) add_epoch(out);
+  return out;
+}
+
+static bool frame_ok(const frame_t &frame) {
+  bytes_t copy(frame.length());
+  frame.bytes.copy_to(copy.data());
+  size_t n = copy.size();
+  if (frame.protocol == FRAME_UBX) {
+    uint8_t a, b;
+    reference_fletcher(copy.data() + 2, n - 4, a, b);
+    return copy[0] == UBX_SYNC_1 && copy[1] == UBX_SYNC_2 && a == copy[n - 2] && b == copy[n - 1];
+  }
+  uint32_t crc = reference_crc24q(copy.data(), n - 3);
+  return copy[0] == RTCM3_PREAMBLE && crc == ((uint32_t)copy[n - 3] << 16 | copy[n - 2] << 8 | copy[n - 1]);
+}
+
+struct scan_result_t {
+  std::vector<bytes_t> frames;
+  frame_stats_t stats;
+  size_t left = 0; // unconsumed tail, an incomplete frame
+};
+
+static scan_result_t scan_linear(const uint8_t *data, size_t length, size_t max_frame, bool end_of_input = false) {
+  scan_result_t result;
+  size_t offset = 0;
+  while (true) {
+    frame_span_t span;
+    span.first = data + offset;
+    span.first_length = length - offset;
+    frame_t frame;
+    size_t skipped;
+    bool found = frame_scan(span, max_frame, frame, skipped, result.stats, end_of_input);
+    offset += skipped;
+    if (!found) break;
+    if (!frame_ok(frame)) abort();
+    result.frames.emplace_back(frame.bytes.first, frame.bytes.first + frame.length());
+    offset += frame.length();
+  }
+  result.left = length - offset;
+  return result;
+}
+
+static scan_result_t scan_ring(const uint8_t *data, size_t length, size_t ring_size, size_t max_chunk) {
+  scan_result_t result;
+  bytes_t buffer(ring_size);
+  FrameRing ring(buffer.data(), ring_size);
+  size_t offset = 0;
+  while (true) {
+    size_t chunk = 1 + random_next() % max_chunk;
+    if (chunk > length - offset) chunk = length - offset;
+    offset += ring.write(data + offset, chunk);
+    frame_t frame;
+    while (ring.next(frame)) {
+      if (!frame_ok(frame)) abort();
+      bytes_t copy(frame.length());
+      frame.bytes.copy_to(copy.data());
+      result.frames.push_back(copy);
+      ring.release(frame);
+    }
+    if (offset == length) break;
+  }
+  result.stats = ring.stats();
+  result.left = ring.used();
+  return result;
+}
+
+// Linear scan and ring in random chunks must find the same frames, every frame must pass the
+// reference checksum, every byte must be a frame, skipped or the incomplete tail. Scanned as the end
+// of the input there is no tail: the same frames come first, and frames a cut-off false sync held
+// back may follow.
+static bool check_input(const uint8_t *data, size_t length) {
+  const size_t ring_size = 2048;
+  scan_result_t linear = scan_linear(data, length, ring_size);
+  scan_result_t ring = scan_ring(data, length, ring_size, 300);
+  if (linear.frames != ring.frames || linear.left != ring.left) return false;
+  const frame_stats_t &s = linear.stats;
+  if (s.skipped_bytes + s.frame_bytes + linear.left != length) return false;
+  if (s.ubx_frames + s.rtcm_frames != linear.frames.size()) return false;
+  const frame_stats_t &r = ring.stats;
+  if (r.skipped_bytes != s.skipped_bytes || r.ubx_bad != s.ubx_bad || r.rtcm_bad != s.rtcm_bad) return false;
+
+  scan_result_t whole = scan_linear(data, length, ring_size, true);
+  if (whole.left != 0 || whole.frames.size() < linear.frames.size()) return false;
+  if (!std::equal(linear.frames.begin(), linear.frames.end(), whole.frames.begin())) return false;
+  return whole.stats.skipped_bytes + whole.stats.frame_bytes == length;
+}
+
+#ifdef FRAME_FUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t length) {
+  if (!check_input(data, length)) abort();
+  return 0;
+}
+#else
+
+static void report(const char *name, size_t bytes, double seconds) {
+  printf("%-34s %9.1f MB/s\n", name, bytes / seconds / 1e6);
+}
+
+static void bench(size_t megabytes) {
+  bytes_t stream = make_stream(megabytes << 20);
+  size_t n = stream.size();
+  printf("%zu bytes of receiver output\n", n);
+
+  double start = now_s();
+  uint8_t ra, rb;
+  reference_fletcher(stream.data(), n, ra, rb);
+  report("fletcher, byte at a time", n, now_s() - start);
+
+  start = now_s();
+  uint32_t a = 0, b = 0;
+  ubx_checksum_update(a, b, stream.data(), n);
+  report("fletcher, four bytes per step", n, now_s() - start);
+  if ((uint8_t)a != ra || (uint8_t)b != rb) printf("FLETCHER MISMATCH\n");
+
+  start = now_s();
+  uint32_t reference = reference_crc24q(stream.data(), n);
+  report("crc-24q, bitwise", n, now_s() - start);
+
+  start = now_s();
+  uint32_t crc = crc24q_update(0, stream.data(), n);
+  report("crc-24q, byte table", n, now_s() - start);
+  if (crc != reference) printf("CRC-24Q MISMATCH\n");
+
+  // frames copied out one by one into a message buffer, the way the receiver library hands them over
+  start = now_s();
+  frame_stats_t stats;
+  static uint8_t message[0x10000 + UBX_FRAME_OVERHEAD];
+  size_t offset = 0;
+  while (true) {
+    frame_span_t span;
+    span.first = stream.data() + offset;
+    span.first_length = n - offset;
+    frame_t frame;
+    size_t skipped;
+    bool found = frame_scan(span, sizeof(message), frame, skipped, stats);
+    offset += skipped;
+    if (!found) break;
+    frame.bytes.copy_to(message);
+    offset += frame.length();
+  }
+  report("scan, frames copied out", n, now_s() - start);
+
+  start = now_s();
+  frame_stats_t zero_copy;
+  offset = 0;
+  while (true) {
+    frame_span_t span;
+    span.first = stream.data() + offset;
+    span.first_length = n - offset;
+    frame_t frame;
+    size_t skipped;
+    bool found = frame_scan(span, sizeof(message), frame, skipped, zero_copy);
+    offset += skipped;
+    if (!found) break;
+    offset += frame.length();
+  }
+  report("scan in place", n, now_s() - start);
+  printf("  %u ubx, %u rtcm3, %llu bytes skipped, %u + %u bad\n", zero_copy.ubx_frames, zero_copy.rtcm_frames,
+      (unsigned long long)zero_copy.skipped_bytes, zero_copy.ubx_bad, zero_copy.rtcm_bad);
+
+  for (size_t chunk : {32, 255}) { // I2C reads of the receiver
+    uint8_t buffer[4096];
+    FrameRing ring(buffer, sizeof(buffer));
+    start = now_s();
+    offset = 0;
+    while (offset < n) {
+      size_t take = n - offset < chunk ? n - offset : chunk;
+      offset += ring.write(stream.data() + offset, take);
+      frame_t frame;
+      while (ring.next(frame)) ring.release(frame);
+    }
+    char name[40];
+    snprintf(name, sizeof(name), "4 KB ring, %zu byte reads", chunk);
+    report(name, n, now_s() - start);
+    if (ring.stats().ubx_frames != zero_copy.ubx_frames || ring.stats().rtcm_frames != zero_copy.rtcm_frames) {
+      printf("RING MISMATCH\n");
+    }
+  }
+}
+
+static std::vector<bytes_t> read_corpus(const std::string &dir) {
+  std::vector<bytes_t> corpus;
+  DIR *d = opendir(dir.c_str());
+  if (!d) return corpus;
+  while (struct dirent *entry = readdir(d)) {
+    if (entry->d_name[0] == '.') continue;
+    FILE *f = fopen((dir + "/" + entry->d_name).c_str(), "rb");
+    if (!f) continue;
+    bytes_t data;
+    uint8_t block[4096];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), f)) > 0) data.insert(data.end(), block, block + n);
+    fclose(f);
+    corpus.push_back(data);
+  }
+  closedir(d);
+  return corpus;
+}
+
+static void mutate(bytes_t &data, const std::vector<bytes_t> &corpus) {
+  int edits = 1 + random_next() % 4;
+  for (int e = 0; e < edits; e++) {
+    size_t at = data.empty() ? 0 : random_next() % data.size();
+    switch (random_next() % 7) {
+    case 0: if (!data.empty()) data[at] ^= 1 << (random_next() % 8); break;
+    case 1: if (!data.empty()) data[at] = random_next(); break;
+    case 2: data.insert(data.begin() + at, (uint8_t)random_next()); break;
+    case 3: if (!data.empty()) data.erase(data.begin() + at, data.begin() + std::min(data.size(), at + 1 + random_next() % 16)); break;
+    case 4: { // sync bytes are what the scanner keys on
+      static const uint8_t syncs[] = {UBX_SYNC_1, UBX_SYNC_2, RTCM3_PREAMBLE, 0x00, 0x03, 0xff};
+      data.insert(data.begin() + at, syncs[random_next() % sizeof(syncs)]);
+      break;
+    }
+    case 5: { // splice in part of another seed
+      const bytes_t &other = corpus[random_next() % corpus.size()];
+      if (other.empty()) break;
+      size_t from = random_next() % other.size();
+      size_t length = std::min(other.size() - from, (size_t)(1 + random_next() % 512));
+      data.insert(data.begin() + at, other.begin() + from, other.begin() + from + length);
+      break;
+    }
+    case 6: if (data.size() > at + 2) data.resize(at + 2); break; // truncate
+    }
+  }
+}
+
+static int fuzz(const std::string &dir, long runs) {
+  std::vector<bytes_t> corpus = read_corpus(dir);
+  if (corpus.empty()) {
+    printf("no seeds in %s\n", dir.c_str());
+    return 1;
+  }
+  for (const bytes_t &seed : corpus) {
+    if (!check_input(seed.data(), seed.size())) {
+      printf("seed failed\n");
+      return 1;
+    }
+  }
+  double start = now_s();
+  for (long run = 0; run < runs; run++) {
+    bytes_t data = corpus[random_next() % corpus.size()];
+    mutate(data, corpus);
+    if (!check_input(data.data(), data.size())) {
+      std::string path = "frame_fuzz_failure.bin";
+      FILE *f = fopen(path.c_str(), "wb");
+      if (f) {
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+      }
+      printf("run %ld failed, input saved to %s\n", run, path.c_str());
+      return 1;
+    }
+  }
+  printf("%zu seeds, %ld mutated runs ok in %.1f s\n", corpus.size(), runs, now_s() - start);
+  return 0;
+}
+
+static void write_seed(const std::string &dir, const char *name, const bytes_t &data) {
+  FILE *f = fopen((dir + "/" + name).c_str(), "wb");
+  if (!f) return;
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+}
+
+static void write_corpus(const std::string &dir) {
+  bytes_t data;
+  add_epoch(data);
+  write_seed(dir, "epoch.bin", data);
+
+  data.clear();
+  add_ubx(data, 0x05, 0x01, {}); // ACK-ACK style empty payloads
+  add_rtcm(data, 0, 0);
+  add_rtcm(data, 1230, 1);
+  write_seed(dir, "empty_payloads.bin", data);
+
+  data.clear();
+  add_rtcm(data, 1077, RTCM3_PAYLOAD_MAX);
+  write_seed(dir, "rtcm_max_length.bin", data);
+
+  data.clear();
+  add_ubx(data, 0x02, 0x15, random_payload(1900)); // RXM-RAWX sized, close to the fuzz ring
+  write_seed(dir, "ubx_long.bin", data);
+
+  data.clear(); // sync patterns in noise, one real frame after them
+  data.insert(data.end(), {UBX_SYNC_1, UBX_SYNC_2, 0x01, 0x07, 0xff, 0xff, UBX_SYNC_1, RTCM3_PREAMBLE, 0x00, 0x05, RTCM3_PREAMBLE});
+  add_ubx(data, 0x01, 0x07, random_payload(92));
+  write_seed(dir, "false_syncs.bin", data);
+
+  data.clear(); // bad checksum, then a good frame that starts inside the bad one's length
+  add_ubx(data, 0x01, 0x14, random_payload(36));
+  data[20] ^= 0x40;
+  add_rtcm(data, 1005, 19);
+  data[data.size() - 1] ^= 1;
+  add_rtcm(data, 1005, 19);
+  write_seed(dir, "corrupted.bin", data);
+
+  data.clear(); // cut mid frame
+  add_epoch(data);
+  data.resize(data.size() * 2 / 3);
+  write_seed(dir, "truncated.bin", data);
+
+  data.clear();
+  for (int i = 0; i < 3; i++) add_epoch(data);
+  write_seed(dir, "three_epochs.bin", data);
+
+  data.clear(); // a false RTCM3 sync in NMEA announcing more than is left, real frames after it
+  add_ubx(data, 0x01, 0x07, random_payload(92));
+  const char nmea[] = "$GPTXT,\xd3\x03\xff,01*00\r\n";
+  data.insert(data.end(), nmea, nmea + sizeof(nmea) - 1);
+  for (int i = 0; i < 3; i++) add_ubx(data, 0x01, 0x07, random_payload(92));
+  write_seed(dir, "false_sync_at_end.bin", data);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2 && strcmp(argv[1], "--fuzz") == 0) return fuzz(argv[2], argc > 3 ? atol(argv[3]) : 100000);
+  if (argc > 2 && strcmp(argv[1], "--write-corpus") == 0) {
+    write_corpus(argv[2]);
+    return 0;
+  }
+  bench(argc > 1 ? atoi(argv[1]) : 64);
+  return 0;
+}
+#endif
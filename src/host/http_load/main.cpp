@@ -0,0 +1,165 @@
+// Load test for lib/HttpServer on host sockets.
+//
+//   pio run -e http_load
+//   .pio/build/http_load/program [seconds] [clients]
+//
+// The server runs its service() loop in one thread, like loop() on the board, with the firmware's
+// connection limit. Each client thread keeps one connection alive and fetches pages back to back.
+// Reports requests/s and latency percentiles for small and page-sized responses, then repeats the
+// page run while one more client starts a large download and stops reading it, which should only
+// ever cost that client.
+//
+// Clients default to HTTP_MAX_CONNECTIONS, the stalled run included, so every client has a slot.
+// A request's latency runs from its first attempt to its response, reconnects and retries included.
+// Within the slot limit a retry means the server dropped a live connection and the run fails (exit
+// status 1). With more clients than slots the server evicts idle keep-alive connections and
+// retries are expected, they are reported and only show in the latency.
+
+#include "../HostSockets.h"
+#include <HttpServer.h>
+#include <LatencyStats.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint32_t now_ms() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t now_us() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static HttpServer http(now_ms);
+static std::string page; // about the size of the firmware's index page
+
+static void handle_ping(const http_request_t &request) {
+  http.send(request, 200, "text/plain", "pong");
+}
+
+static void handle_page(const http_request_t &request) {
+  http.send(request, 200, "text/html", page.data(), page.size());
+}
+
+static void handle_download(const http_request_t &request) {
+  size_t left = 64 * 1024 * 1024;
+  http.send_stream(request, 200, "application/octet-stream", [left](uint8_t *buffer, size_t size) mutable {
+    size_t n = size < left ? size : left;
+    memset(buffer, 'x', n);
+    left -= n;
+    return n;
+  });
+}
+
+struct run_result_t {
+  uint32_t requests;
+  uint32_t failures; // closed or rejected, the client reconnects
+  double seconds;
+  LatencyStats latency;
+};
+
+static run_result_t run_clients(const char *path, int clients, double seconds) {
+  std::vector<std::vector<uint32_t>> samples(clients);
+  std::vector<uint32_t> failures(clients, 0);
+  std::atomic<bool> running(true);
+  std::vector<std::thread> threads;
+
+  uint32_t start = now_us();
+  for (int c = 0; c < clients; c++) {
+    threads.emplace_back([&, c]() {
+      std::string buffer;
+      int fd = -1;
+      bool retrying = false;
+      uint32_t begin = 0;
+      while (running) {
+        if (!retrying) begin = now_us();
+        if (fd < 0) fd = connect_to(http.port());
+        if (fd >= 0 && fetch(fd, path, buffer)) {
+          samples[c].push_back(now_us() - begin);
+          retrying = false;
+          continue;
+        }
+        failures[c]++;
+        if (fd >= 0) close(fd);
+        fd = -1;
+        retrying = true; // the time to the response keeps counting
+        usleep(1000);
+      }
+      if (fd >= 0) close(fd);
+    });
+  }
+  usleep((useconds_t)(seconds * 1e6));
+  running = false;
+  for (std::thread &t : threads) t.join();
+
+  run_result_t result = {};
+  result.seconds = (now_us() - start) / 1e6;
+  for (int c = 0; c < clients; c++) {
+    for (uint32_t us : samples[c]) result.latency.add(us);
+    result.failures += failures[c];
+  }
+  result.requests = result.latency.count();
+  return result;
+}
+
+static void report(const char *name, const run_result_t &r) { // latency includes retries
+  printf("%-28s %8.0f %8u %8u %8u %8u %8u\n", name, r.requests / r.seconds, r.latency.percentile(50), r.latency.percentile(90),
+         r.latency.percentile(99), r.latency.max(), r.failures);
+}
+
+int main(int argc, char **argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 5;
+  int clients = argc > 2 ? atoi(argv[2]) : HTTP_MAX_CONNECTIONS;
+  if (seconds <= 0 || clients < 2) {
+    fprintf(stderr, "usage: %s [seconds] [clients, 2 or more]\n", argv[0]);
+    return 2;
+  }
+
+  page.assign(12 * 1024, 'p');
+  http.on("/ping", handle_ping);
+  http.on("/page", handle_page);
+  http.on("/download", handle_download);
+  if (!http.begin(0)) {
+    perror("listen");
+    return 1;
+  }
+
+  std::atomic<bool> serving(true);
+  std::thread server([&]() {
+    while (serving) http.service();
+  });
+
+  printf("%d clients, %d server connections, %.0f s per run\n", clients, HTTP_MAX_CONNECTIONS, seconds);
+  printf("%-28s %8s %8s %8s %8s %8s %8s\n", "run", "req/s", "p50 us", "p90 us", "p99 us", "max us", "retries");
+  uint32_t retries = 0;
+  run_result_t result = run_clients("/ping", clients, seconds);
+  report("small response", result);
+  retries += result.failures;
+  result = run_clients("/page", clients, seconds);
+  report("12 KB page", result);
+  retries += result.failures;
+
+  // a client that asks for a big download and never reads it
+  int stalled = connect_to(http.port());
+  const char *request = "GET /download HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  send(stalled, request, strlen(request), MSG_NOSIGNAL);
+  usleep(100000);
+  result = run_clients("/page", clients - 1, seconds);
+  report("12 KB page, stalled reader", result);
+  retries += result.failures;
+  close(stalled);
+
+  serving = false;
+  server.join();
+  const http_stats_t &stats = http.stats();
+  printf("server: %u accepted, %u requests, %u rejected, %u timed out\n", stats.accepted, stats.requests, stats.rejected, stats.timeouts);
+  if (retries > 0 && clients <= HTTP_MAX_CONNECTIONS) {
+    fprintf(stderr, "FAIL %u retries with every client inside the connection limit\n", retries);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,571 @@
+// Batch analysis of device logs copied off the SD card.
+//
+//   pio run -e log_analyze
+//   .pio/build/log_analyze/program [--threads N] [--datum wgs84|nad83] [--epoch 2024.5] [--window-mb 64] DIR... > report.json
+//
+// Every file under DIR is picked up by its format: track logs (.trk, TrackLog.h), survey record logs
+// (.rec, RecordLog.h and SurveyRecords.h), text survey files (.txt) and raw receiver captures (.ubx, UBX
+// and RTCM3 frames are checked, NAV-PVT is used). Files are spread over worker threads and read through a sliding memory-mapped window, so
+// memory stays at one window per thread whatever the file sizes. Per-file results are aggregates
+// (point sums, fix state runs, RTK events) merged once all workers are done.
+//
+// The JSON report has per-file counts, per-point statistics over every occupation of a point name,
+// fix quality totals with a timeline, and the RTK transitions from the record logs. With --datum nad83
+// point means are also given in NAD83(2011), see to_nad83(). Progress and damage go to stderr.
+
+#include <TrackLog.h>
+#include <RecordLog.h>
+#include <SurveyRecords.h>
+#include <SolutionMonitor.h>
+#include <FrameScanner.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GPS_UNIX_OFFSET 315964800 // 1980-01-06 in unix time
+#define GPS_LEAP_SECONDS 18
+#define TIMELINE_GAP_S 2.0 // epochs further apart than this start a new timeline segment
+#define TIMELINE_MAX_SEGMENTS 20000 // per file, state totals stay exact past it
+#define REPORT_MAX_SEGMENTS 10000
+
+enum file_type_t { FILE_TRACK, FILE_RECORDS, FILE_SURVEY_TEXT, FILE_UBX };
+const char *file_type_names[] = {"track", "records", "survey_text", "ubx"};
+
+struct point_stats_t { // running mean and squared deviations, merged with Chan's formula
+  uint64_t n = 0;
+  double lat = 0, lon = 0, height = 0; // deg, deg, m
+  double m2_lat = 0, m2_lon = 0, m2_height = 0;
+  double sum_hacc = 0; // m, from records only
+  uint64_t n_hacc = 0;
+
+  void add(double la, double lo, double h) {
+    n++;
+    double d_lat = la - lat, d_lon = lo - lon, d_h = h - height;
+    lat += d_lat / n;
+    lon += d_lon / n;
+    height += d_h / n;
+    m2_lat += d_lat * (la - lat);
+    m2_lon += d_lon * (lo - lon);
+    m2_height += d_h * (h - height);
+  }
+
+  void merge(const point_stats_t &o) {
+    if (o.n == 0) return;
+    double total = n + o.n;
+    double d_lat = o.lat - lat, d_lon = o.lon - lon, d_h = o.height - height;
+    m2_lat += o.m2_lat + d_lat * d_lat * n * o.n / total;
+    m2_lon += o.m2_lon + d_lon * d_lon * n * o.n / total;
+    m2_height += o.m2_height + d_h * d_h * n * o.n / total;
+    lat += d_lat * o.n / total;
+    lon += d_lon * o.n / total;
+    height += d_h * o.n / total;
+    n += o.n;
+    sum_hacc += o.sum_hacc;
+    n_hacc += o.n_hacc;
+  }
+};
+
+struct segment_t {
+  double start, end; // unix time
+  solution_state_t state;
+  uint32_t source; // file index
+};
+
+struct timeline_t {
+  std::vector<segment_t> segments;
+  double seconds[4] = {};
+  uint64_t epochs = 0;
+  bool truncated = false;
+  double last_time = 0;
+  solution_state_t last_state = SOLUTION_NONE;
+
+  void add(double time, solution_state_t state, uint32_t source) {
+    epochs++;
+    bool joined = epochs > 1 && time >= last_time && time - last_time <= TIMELINE_GAP_S;
+    if (joined) seconds[last_state] += time - last_time; // the previous state held until now
+    last_time = time;
+    if (joined && state == last_state) {
+      if (!truncated) segments.back().end = time;
+      return;
+    }
+    last_state = state;
+    if (segments.size() >= TIMELINE_MAX_SEGMENTS) {
+      truncated = true;
+      return;
+    }
+    if (!truncated) segments.push_back({time, time, state, source});
+  }
+};
+
+struct file_result_t {
+  std::string path;
+  std::string card_path; // as the firmware names it, "/" + path under DIR
+  file_type_t type;
+  uint64_t bytes = 0;
+  uint64_t units = 0; // blocks, records, lines or frames
+  uint64_t bad = 0;
+  std::map<std::string, point_stats_t> points;
+  std::vector<uint32_t> record_file_ids; // survey files covered by this record log
+  timeline_t timeline;
+  std::vector<rtk_event_record_t> events;
+  bool failed = false;
+};
+
+// Read-only mapping of one window of a file at a time
+class mapped_file_t {
+ public:
+  ~mapped_file_t() {
+    unmap();
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool open_file(const char *path) {
+    fd_ = open(path, O_RDONLY);
+    struct stat st;
+    if (fd_ < 0 || fstat(fd_, &st) != 0) return false;
+    size_ = st.st_size;
+    return true;
+  }
+
+  // Maps up to length bytes at offset, returns the bytes available there
+  size_t map(uint64_t offset, size_t length, const uint8_t **data) {
+    unmap();
+    if (offset >= size_) return 0;
+    if (length > size_ - offset) length = size_ - offset;
+    static const uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = offset / page * page;
+    map_length_ = length + (offset - start);
+    map_ = mmap(nullptr, map_length_, PROT_READ, MAP_PRIVATE, fd_, start);
+    if (map_ == MAP_FAILED) {
+      map_ = nullptr;
+      return 0;
+    }
+    madvise(map_, map_length_, MADV_SEQUENTIAL);
+    *data = (const uint8_t *)map_ + (offset - start);
+    return length;
+  }
+
+  uint64_t size() const { return size_; }
+
+ private:
+  void unmap() {
+    if (map_) munmap(map_, map_length_);
+    map_ = nullptr;
+  }
+
+  int fd_ = -1;
+  uint64_t size_ = 0;
+  void *map_ = nullptr;
+  size_t map_length_ = 0;
+};
+
+static size_t window_bytes = 64u << 20;
+
+// Walks the file window by window. consume() returns how many bytes it finished with, the next
+// window starts there so a frame or line cut by the window end is seen whole next time.
+template <typename consume_fn>
+static bool scan_file(file_result_t &result, consume_fn consume) {
+  mapped_file_t file;
+  if (!file.open_file(result.path.c_str())) return false;
+  result.bytes = file.size();
+  uint64_t offset = 0;
+  while (offset < file.size()) {
+    const uint8_t *data;
+    size_t length = file.map(offset, window_bytes, &data);
+    if (length == 0) return false;
+    bool last = offset + length >= file.size();
+    size_t used = consume(data, length, last);
+    if (used == 0) { // nothing complete in a whole window, skip a byte rather than stall
+      result.bad++;
+      used = 1;
+    }
+    offset += used;
+  }
+  return true;
+}
+
+static double unix_time_gps(uint16_t week, uint32_t tow_ms) {
+  return GPS_UNIX_OFFSET + week * 604800.0 + tow_ms / 1000.0 - GPS_LEAP_SECONDS;
+}
+
+// Track logs
+struct track_ctx_t {
+  file_result_t *result;
+  uint32_t index;
+};
+
+static void track_point(const track_point_t &p, void *ctx) {
+  track_ctx_t &t = *(track_ctx_t *)ctx;
+  t.result->timeline.add(unix_time_gps(p.week, p.tow_ms), solution_classify(p.status & 0x07, p.status >> 3), t.index);
+}
+
+static void analyze_track(file_result_t &result, uint32_t index) {
+  track_ctx_t ctx = {&result, index};
+  result.failed = !scan_file(result, [&](const uint8_t *data, size_t length, bool last) {
+    size_t blocks = length / TRACK_BLOCK_SIZE;
+    for (size_t i = 0; i < blocks; i++) {
+      uint32_t seq;
+      track_block_result_t r = track_decode_block(data + i * TRACK_BLOCK_SIZE, track_point, &ctx, &seq);
+      if (r == TRACK_BLOCK_OK) result.units++;
+      else if (r != TRACK_BLOCK_EMPTY) result.bad++;
+    }
+    if (last && length % TRACK_BLOCK_SIZE) result.bad++; // torn final block
+    return last ? length : blocks * TRACK_BLOCK_SIZE;
+  });
+}
+
+// Survey record logs, RecordLog reads through the mapping
+struct record_view_t {
+  const uint8_t *data;
+  size_t length;
+};
+
+static bool record_view_read(uint32_t offset, uint8_t *data, size_t length, void *ctx) {
+  record_view_t &view = *(record_view_t *)ctx;
+  if (offset + length > view.length) return false;
+  memcpy(data, view.data + offset, length);
+  return true;
+}
+
+static bool record_view_write(uint32_t, const uint8_t *, size_t, void *) { return false; }
+static bool record_view_flush(void *) { return false; }
+
+static bool record_visit(const record_t &record, void *ctx) {
+  file_result_t &result = *(file_result_t *)ctx;
+  result.units++;
+  if (record.type == SURVEY_RECORD_POINT && record.length == sizeof(survey_record_t)) {
+    survey_record_t point;
+    memcpy(&point, record.payload, sizeof(point));
+    point.name[sizeof(point.name) - 1] = '\0';
+    point_stats_t &stats = result.points[point.name];
+    stats.add(point.lat * 1e-7, point.lon * 1e-7, point.elevation / 1000.0);
+    stats.sum_hacc += point.hAcc / 1000.0;
+    stats.n_hacc++;
+    if (std::find(result.record_file_ids.begin(), result.record_file_ids.end(), point.file_id) == result.record_file_ids.end()) {
+      result.record_file_ids.push_back(point.file_id);
+    }
+  } else if (record.type == SURVEY_RECORD_RTK_EVENT && record.length == sizeof(rtk_event_record_t)) {
+    rtk_event_record_t event;
+    memcpy(&event, record.payload, sizeof(event));
+    event.point[sizeof(event.point) - 1] = '\0';
+    result.events.push_back(event);
+  }
+  return true;
+}
+
+static void analyze_records(file_result_t &result) {
+  mapped_file_t file;
+  const uint8_t *data = nullptr;
+  if (!file.open_file(result.path.c_str())) {
+    result.failed = true;
+    return;
+  }
+  result.bytes = file.size();
+  if (file.size() > 0xffffffffu || file.map(0, file.size(), &data) != file.size()) { // logs are 256 KB
+    result.failed = true;
+    return;
+  }
+  record_view_t view = {data, (size_t)file.size()};
+  record_log_io_t io = {record_view_read, record_view_write, record_view_flush, &view};
+  RecordLog log(io, file.size() / RECORD_SIZE);
+  if (log.recover() != RECORD_LOG_OK) {
+    result.failed = true;
+    return;
+  }
+  log.for_each(record_visit, &result);
+}
+
+// Text survey files
+static void analyze_survey_text(file_result_t &result) {
+  result.failed = !scan_file(result, [&](const uint8_t *data, size_t length, bool last) {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (data[i] != '\n') continue;
+      survey_text_point_t point;
+      result.units++;
+      if (survey_parse_line((const char *)data + start, i - start, point)) {
+        result.points[point.name].add(point.lat * 1e-7, point.lon * 1e-7, point.elevation / 1000.0);
+      } else if (result.units > 1 && i > start) { // the first line is the datum
+        result.bad++;
+      }
+      start = i + 1;
+    }
+    return last ? length : start;
+  });
+}
+
+// Raw receiver captures, UBX and RTCM3 frames count as units and NAV-PVT drives the timeline. NMEA
+// and other noise between frames is skipped.
+static uint16_t get_u16(const uint8_t *p) { return p[0] | p[1] << 8; }
+static uint32_t get_u32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+static double pvt_unix_time(const uint8_t *pvt) {
+  struct tm t = {};
+  t.tm_year = get_u16(pvt + 4) - 1900;
+  t.tm_mon = pvt[6] - 1;
+  t.tm_mday = pvt[7];
+  t.tm_hour = pvt[8];
+  t.tm_min = pvt[9];
+  t.tm_sec = pvt[10];
+  return timegm(&t) + (int32_t)get_u32(pvt + 16) * 1e-9;
+}
+
+static void analyze_ubx(file_result_t &result, uint32_t index) {
+  frame_stats_t stats;
+  result.failed = !scan_file(result, [&](const uint8_t *data, size_t length, bool last) {
+    size_t i = 0;
+    while (true) {
+      frame_span_t span;
+      span.first = data + i;
+      span.first_length = length - i;
+      frame_t frame;
+      size_t skipped;
+      bool found = frame_scan(span, 0xffff + UBX_FRAME_OVERHEAD, frame, skipped, stats, last);
+      i += skipped;
+      if (!found) break; // the rest is an unfinished frame, it continues in the next window (or was noise in the last)
+      result.units++;
+      const uint8_t *p = frame.bytes.first + 6;
+      if (frame.protocol == FRAME_UBX && frame.type == 0x0107 && frame.payload_length >= 92 && (p[11] & 0x03) == 0x03) { // NAV-PVT with valid date and time
+        result.timeline.add(pvt_unix_time(p), solution_classify(p[20], p[21] >> 6), index);
+      }
+      i += frame.length();
+    }
+    return i;
+  });
+  result.bad = stats.ubx_bad + stats.rtcm_bad;
+}
+
+// Datum transform. WGS84 (G2139) is taken as ITRF2014 ~ ITRF2008 at the centimetre level, then the
+// NGS ITRF2008 -> NAD83(2011) 14-parameter Helmert at the given epoch.
+struct geodetic_t {
+  double lat, lon, height; // deg, deg, m
+};
+
+static void to_ecef(const geodetic_t &g, double inv_f, double xyz[3]) {
+  const double a = 6378137.0, f = 1 / inv_f, e2 = f * (2 - f);
+  double lat = g.lat * M_PI / 180, lon = g.lon * M_PI / 180;
+  double n = a / sqrt(1 - e2 * sin(lat) * sin(lat));
+  xyz[0] = (n + g.height) * cos(lat) * cos(lon);
+  xyz[1] = (n + g.height) * cos(lat) * sin(lon);
+  xyz[2] = (n * (1 - e2) + g.height) * sin(lat);
+}
+
+static geodetic_t from_ecef(const double xyz[3], double inv_f) {
+  const double a = 6378137.0, f = 1 / inv_f, e2 = f * (2 - f);
+  double p = sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]);
+  double lat = atan2(xyz[2], p * (1 - e2)), n = a, height = 0;
+  for (int i = 0; i < 6; i++) {
+    n = a / sqrt(1 - e2 * sin(lat) * sin(lat));
+    height = p / cos(lat) - n;
+    lat = atan2(xyz[2], p * (1 - e2 * n / (n + height)));
+  }
+  return {lat * 180 / M_PI, atan2(xyz[1], xyz[0]) * 180 / M_PI, height};
+}
+
+static geodetic_t to_nad83(const geodetic_t &g, double epoch) {
+  const double mas = M_PI / 180 / 3600000, dt = epoch - 1997.0;
+  double tx = 0.99343 + 0.00079 * dt, ty = -1.90331 - 0.00060 * dt, tz = -0.52655 - 0.00134 * dt;
+  double rx = (25.91467 + 0.06667 * dt) * mas, ry = (9.42645 - 0.75744 * dt) * mas, rz = (11.59935 - 0.05133 * dt) * mas;
+  double s = (1.71504 - 0.10201 * dt) * 1e-9;
+  double x[3], y[3];
+  to_ecef(g, 298.257223563, x);
+  y[0] = tx + (1 + s) * x[0] + rz * x[1] - ry * x[2];
+  y[1] = ty - rz * x[0] + (1 + s) * x[1] + rx * x[2];
+  y[2] = tz + ry * x[0] - rx * x[1] + (1 + s) * x[2];
+  return from_ecef(y, 298.257222101); // GRS80
+}
+
+// Report
+static void json_string(FILE *out, const char *text) {
+  fputc('"', out);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);
+    else if ((uint8_t)*c < 0x20) fprintf(out, "\\u%04x", *c);
+    else fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+static std::vector<file_result_t> files;
+static std::string current_root; // for collect_file(), nftw() has no context pointer
+
+static int collect_file(const char *path, const struct stat *, int flag, struct FTW *) {
+  if (flag != FTW_F) return 0;
+  const char *dot = strrchr(path, '.');
+  if (!dot) return 0;
+  file_result_t result;
+  if (strcasecmp(dot, ".trk") == 0) result.type = FILE_TRACK;
+  else if (strcasecmp(dot, ".rec") == 0) result.type = FILE_RECORDS;
+  else if (strcasecmp(dot, ".txt") == 0) result.type = FILE_SURVEY_TEXT;
+  else if (strcasecmp(dot, ".ubx") == 0) result.type = FILE_UBX;
+  else return 0;
+  result.path = path;
+  size_t skip = current_root.size() + (current_root.back() == '/' ? 0 : 1);
+  result.card_path = "/" + result.path.substr(std::min(result.path.size(), skip));
+  files.push_back(result);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool nad83 = false;
+  time_t now = time(nullptr);
+  double epoch = 1970 + now / (365.25 * 86400);
+  std::vector<std::string> roots;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--datum") == 0 && i + 1 < argc) nad83 = strcasecmp(argv[++i], "nad83") == 0;
+    else if (strcmp(argv[i], "--epoch") == 0 && i + 1 < argc) epoch = atof(argv[++i]);
+    else if (strcmp(argv[i], "--window-mb") == 0 && i + 1 < argc) window_bytes = (size_t)std::max(1, atoi(argv[++i])) << 20;
+    else roots.push_back(argv[i]);
+  }
+  if (roots.empty()) {
+    fprintf(stderr, "usage: %s [--threads N] [--datum wgs84|nad83] [--epoch YEAR] [--window-mb MB] DIR...\n", argv[0]);
+    return 2;
+  }
+  for (const std::string &root : roots) {
+    current_root = root;
+    if (nftw(root.c_str(), collect_file, 16, FTW_PHYS) != 0) perror(root.c_str());
+  }
+
+  // biggest first so one large capture does not start last and hold up the end
+  std::vector<uint32_t> order(files.size());
+  for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+  for (file_result_t &f : files) {
+    struct stat st;
+    if (stat(f.path.c_str(), &st) == 0) f.bytes = st.st_size;
+  }
+  std::sort(order.begin(), order.end(), [](uint32_t a, uint32_t b) { return files[a].bytes > files[b].bytes; });
+
+  std::atomic<size_t> next{0};
+  std::mutex progress;
+  size_t done = 0;
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < std::min<size_t>(threads, files.size()); t++) {
+    workers.emplace_back([&]() {
+      size_t job;
+      while ((job = next.fetch_add(1)) < order.size()) {
+        uint32_t index = order[job];
+        file_result_t &result = files[index];
+        switch (result.type) {
+        case FILE_TRACK: analyze_track(result, index); break;
+        case FILE_RECORDS: analyze_records(result); break;
+        case FILE_SURVEY_TEXT: analyze_survey_text(result); break;
+        case FILE_UBX: analyze_ubx(result, index); break;
+        }
+        std::lock_guard<std::mutex> lock(progress);
+        done++;
+        fprintf(stderr, "[%zu/%zu] %s: %s, %llu units, %llu bad%s\n", done, files.size(), result.path.c_str(), file_type_names[result.type],
+                (unsigned long long)result.units, (unsigned long long)result.bad, result.failed ? ", could not be read" : "");
+      }
+    });
+  }
+  for (std::thread &w : workers) w.join();
+
+  // Points: record logs are authoritative, a text file they already cover is not counted again
+  std::vector<uint32_t> covered;
+  for (const file_result_t &f : files) covered.insert(covered.end(), f.record_file_ids.begin(), f.record_file_ids.end());
+  std::map<std::string, point_stats_t> points;
+  for (const file_result_t &f : files) {
+    if (f.type == FILE_SURVEY_TEXT && std::find(covered.begin(), covered.end(), survey_file_id(f.card_path.c_str(), f.card_path.size())) != covered.end()) continue;
+    for (const auto &p : f.points) points[p.first].merge(p.second);
+  }
+
+  // Timeline: every file's segments in time order, touching runs of the same state joined
+  timeline_t total;
+  std::vector<segment_t> segments;
+  bool truncated = false;
+  for (const file_result_t &f : files) {
+    for (int s = 0; s < 4; s++) total.seconds[s] += f.timeline.seconds[s];
+    total.epochs += f.timeline.epochs;
+    truncated |= f.timeline.truncated;
+    segments.insert(segments.end(), f.timeline.segments.begin(), f.timeline.segments.end());
+  }
+  std::sort(segments.begin(), segments.end(), [](const segment_t &a, const segment_t &b) { return a.start < b.start; });
+  std::vector<segment_t> merged;
+  uint32_t fixed_drops = 0;
+  for (const segment_t &s : segments) {
+    if (!merged.empty() && merged.back().state == s.state && s.start - merged.back().end <= TIMELINE_GAP_S) {
+      merged.back().end = std::max(merged.back().end, s.end);
+      continue;
+    }
+    if (!merged.empty() && merged.back().state == SOLUTION_FIXED && s.state < SOLUTION_FIXED && s.start - merged.back().end <= TIMELINE_GAP_S) fixed_drops++;
+    merged.push_back(s);
+  }
+
+  FILE *out = stdout;
+  fprintf(out, "{\n  \"files\": [");
+  for (size_t i = 0; i < files.size(); i++) {
+    const file_result_t &f = files[i];
+    fprintf(out, "%s\n    {\"path\": ", i ? "," : "");
+    json_string(out, f.path.c_str());
+    fprintf(out, ", \"type\": \"%s\", \"bytes\": %llu, \"units\": %llu, \"bad\": %llu, \"failed\": %s}", file_type_names[f.type],
+            (unsigned long long)f.bytes, (unsigned long long)f.units, (unsigned long long)f.bad, f.failed ? "true" : "false");
+  }
+
+  fprintf(out, "\n  ],\n  \"datum\": \"%s\",\n  \"points\": [", nad83 ? "NAD83(2011)" : "WGS84");
+  size_t n = 0;
+  for (const auto &p : points) {
+    const point_stats_t &s = p.second;
+    double sd_n = s.n > 1 ? sqrt(s.m2_lat / (s.n - 1)) * M_PI / 180 * 6378137.0 : 0;
+    double sd_e = s.n > 1 ? sqrt(s.m2_lon / (s.n - 1)) * M_PI / 180 * 6378137.0 * cos(s.lat * M_PI / 180) : 0;
+    double sd_u = s.n > 1 ? sqrt(s.m2_height / (s.n - 1)) : 0;
+    fprintf(out, "%s\n    {\"name\": ", n++ ? "," : "");
+    json_string(out, p.first.c_str());
+    fprintf(out, ", \"occupations\": %llu, \"lat\": %.9f, \"lon\": %.9f, \"height_m\": %.4f, \"sd_n_m\": %.4f, \"sd_e_m\": %.4f, \"sd_u_m\": %.4f",
+            (unsigned long long)s.n, s.lat, s.lon, s.height, sd_n, sd_e, sd_u);
+    if (s.n_hacc) fprintf(out, ", \"mean_hacc_m\": %.4f", s.sum_hacc / s.n_hacc);
+    if (nad83) {
+      geodetic_t g = to_nad83({s.lat, s.lon, s.height}, epoch);
+      fprintf(out, ", \"nad83\": {\"lat\": %.9f, \"lon\": %.9f, \"height_m\": %.4f, \"epoch\": %.2f}", g.lat, g.lon, g.height, epoch);
+    }
+    fprintf(out, "}");
+  }
+
+  double tracked = total.seconds[0] + total.seconds[1] + total.seconds[2] + total.seconds[3];
+  fprintf(out, "\n  ],\n  \"fix_quality\": {\"epochs\": %llu, \"seconds\": {", (unsigned long long)total.epochs);
+  for (int s = 0; s < 4; s++) fprintf(out, "%s\"%s\": %.1f", s ? ", " : "", solution_state_name((solution_state_t)s), total.seconds[s]);
+  fprintf(out, "}, \"fixed_fraction\": %.4f, \"fixed_drops\": %u, \"timeline_truncated\": %s,\n    \"timeline\": [",
+          tracked > 0 ? total.seconds[SOLUTION_FIXED] / tracked : 0, fixed_drops, truncated || merged.size() > REPORT_MAX_SEGMENTS ? "true" : "false");
+  for (size_t i = 0; i < merged.size() && i < REPORT_MAX_SEGMENTS; i++) {
+    const segment_t &s = merged[i];
+    fprintf(out, "%s\n      {\"start\": %.3f, \"end\": %.3f, \"state\": \"%s\", \"file\": %u}", i ? "," : "", s.start, s.end, solution_state_name(s.state), s.source);
+  }
+
+  const char *kinds[] = {"degraded", "recovered", "saved_in_alert"};
+  fprintf(out, "\n    ]\n  },\n  \"rtk_events\": [");
+  n = 0;
+  for (const file_result_t &f : files) {
+    for (const rtk_event_record_t &e : f.events) {
+      fprintf(out, "%s\n    {\"time\": \"", n++ ? "," : "");
+      if (e.year) fprintf(out, "%04u-%02u-%02uT%02u:%02u:%02uZ", e.year, e.month, e.day, e.hour, e.minute, e.second);
+      fprintf(out, "\", \"kind\": \"%s\", \"from\": \"%s\", \"to\": \"%s\", \"flags\": %u, \"hAcc_m\": %.3f, \"point\": ",
+              e.kind < 3 ? kinds[e.kind] : "unknown", solution_state_name((solution_state_t)e.from_state),
+              solution_state_name((solution_state_t)e.to_state), e.to_flags, e.hAcc / 1000.0);
+      json_string(out, e.point);
+      fprintf(out, "}");
+    }
+  }
+  fprintf(out, "\n  ]\n}\n");
+
+  uint64_t bad = 0;
+  for (const file_result_t &f : files) bad += f.bad + f.failed;
+  fprintf(stderr, "%zu files, %zu points, %llu epochs, %.1f%% fixed, %llu damaged units\n", files.size(), points.size(),
+          (unsigned long long)total.epochs, tracked > 0 ? 100 * total.seconds[SOLUTION_FIXED] / tracked : 0.0, (unsigned long long)bad);
+  return bad ? 3 : 0;
+}
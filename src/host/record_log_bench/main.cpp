@@ -0,0 +1,154 @@
+// Write latency of survey record storage on the host file system, as a stand-in for the SD card.
+//
+//   pio run -e record_log_bench
+//   .pio/build/record_log_bench/program [directory] [records]
+//
+// Compares the old rewrite-the-whole-file save, plain appends, and RecordLog in a preallocated
+// file at a few flush cadences, then cuts a record in half and checks recovery.
+
+#include <RecordLog.h>
+#include <LatencyStats.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint32_t now_us() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool file_read(uint32_t offset, uint8_t *data, size_t length, void *ctx) {
+  return pread(*(int *)ctx, data, length, offset) == (ssize_t)length;
+}
+
+static bool file_write(uint32_t offset, const uint8_t *data, size_t length, void *ctx) {
+  return pwrite(*(int *)ctx, data, length, offset) == (ssize_t)length;
+}
+
+static bool file_flush(void *ctx) {
+  return fdatasync(*(int *)ctx) == 0;
+}
+
+static void report(const char *name, const LatencyStats &stats) {
+  printf("%-28s %8u %8u %8u %10u\n", name, stats.percentile(50), stats.percentile(99), stats.max(), stats.count());
+}
+
+static std::string survey_line(int i) {
+  char line[64];
+  snprintf(line, sizeof(line), "GCP%d -1223456789 374567890 12345\n", i);
+  return line;
+}
+
+// what write_to_file() used to do: read everything, write everything back
+static void bench_rewrite(const std::string &path, int records) {
+  LatencyStats stats;
+  std::string content;
+  unlink(path.c_str());
+  for (int i = 0; i < records; i++) {
+    uint32_t start = now_us();
+    content += survey_line(i);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (write(fd, content.data(), content.size()) != (ssize_t)content.size()) break;
+    fdatasync(fd);
+    close(fd);
+    stats.add(now_us() - start);
+  }
+  report("rewrite whole file", stats);
+}
+
+static void bench_append(const std::string &path, int records) {
+  LatencyStats stats;
+  unlink(path.c_str());
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  for (int i = 0; i < records; i++) {
+    uint32_t start = now_us();
+    std::string line = survey_line(i);
+    if (write(fd, line.data(), line.size()) != (ssize_t)line.size()) break;
+    fdatasync(fd); // the file grows, so this also commits allocation and size
+    stats.add(now_us() - start);
+  }
+  close(fd);
+  report("append + sync", stats);
+}
+
+static int open_preallocated(const std::string &path, uint32_t capacity) {
+  unlink(path.c_str());
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  std::vector<uint8_t> zeros(capacity * RECORD_SIZE, 0);
+  if (write(fd, zeros.data(), zeros.size()) != (ssize_t)zeros.size()) return -1;
+  fsync(fd);
+  return fd;
+}
+
+static void bench_record_log(const std::string &path, int records, uint16_t flush_every) {
+  LatencyStats stats;
+  int fd = open_preallocated(path, records);
+  record_log_io_t io = {file_read, file_write, file_flush, &fd};
+  RecordLog log(io, records, flush_every);
+  log.recover();
+  for (int i = 0; i < records; i++) {
+    std::string line = survey_line(i);
+    uint32_t start = now_us();
+    if (log.append(1, line.data(), line.size()) != RECORD_LOG_OK) break;
+    stats.add(now_us() - start);
+  }
+  log.sync();
+  close(fd);
+  char name[40];
+  snprintf(name, sizeof(name), "record log, flush every %u", flush_every);
+  report(name, stats);
+}
+
+static bool count_record(const record_t &, void *ctx) {
+  (*(uint32_t *)ctx)++;
+  return true;
+}
+
+// Half-written last record must be dropped, the log continues with the same sequence number
+static bool check_recovery(const std::string &path) {
+  const uint32_t capacity = 256, written = 100;
+  int fd = open_preallocated(path, capacity);
+  record_log_io_t io = {file_read, file_write, file_flush, &fd};
+  {
+    RecordLog log(io, capacity);
+    log.recover();
+    for (uint32_t i = 0; i < written; i++) log.append(1, "point", 5);
+  }
+  uint8_t torn[RECORD_SIZE / 2];
+  memset(torn, 0xa5, sizeof(torn));
+  pwrite(fd, torn, sizeof(torn), (written - 1) * RECORD_SIZE + RECORD_SIZE / 2);
+
+  RecordLog log(io, capacity);
+  log.recover();
+  bool ok = log.count() == written - 1 && log.next_seq() == written - 1;
+  ok = ok && log.append(1, "again", 5) == RECORD_LOG_OK;
+  RecordLog reopened(io, capacity);
+  reopened.recover();
+  uint32_t visited = 0;
+  reopened.for_each(count_record, &visited);
+  ok = ok && reopened.count() == written && visited == written;
+  close(fd);
+  printf("recovery after torn record: %s (%u records)\n", ok ? "ok" : "FAILED", reopened.count());
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  int records = argc > 2 ? atoi(argv[2]) : 2000;
+  std::string path = dir + "/record_log_bench.tmp";
+
+  printf("%-28s %8s %8s %8s %10s\n", "us per save", "p50", "p99", "max", "records");
+  bench_rewrite(path, records);
+  bench_append(path, records);
+  bench_record_log(path, records, 1);
+  bench_record_log(path, records, 8);
+  bench_record_log(path, records, 64);
+  bool ok = check_recovery(path);
+  unlink(path.c_str());
+  return ok ? 0 : 1;
+}
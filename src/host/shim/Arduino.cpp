@@ -0,0 +1,127 @@
+#include "Arduino.h"
+#include "HostHeap.h"
+#include <chrono>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t length = strlen(src);
+  if (size) {
+    size_t n = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return length;
+}
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+static bool serial_quiet = false;
+
+static const auto start_time = std::chrono::steady_clock::now();
+static bool skip_delays = false;
+static uint64_t skipped_us = 0; // added to the clock so skipped delays still look like elapsed time
+
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count() + skipped_us;
+}
+
+unsigned long millis() { return esp_timer_get_time() / 1000; }
+unsigned long micros() { return esp_timer_get_time(); }
+
+void delay(unsigned long ms) { delayMicroseconds(ms * 1000); }
+
+void delayMicroseconds(unsigned int us) {
+  if (skip_delays) {
+    skipped_us += us;
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+void host_skip_delays(bool skip) {
+  skip_delays = skip;
+}
+
+uint64_t host_skipped_delay_us() {
+  return skipped_us;
+}
+void yield() { std::this_thread::yield(); }
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+int digitalRead(uint8_t pin) { return LOW; }
+int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {}
+void detachInterrupt(uint8_t pin) {}
+
+long random(long max) { return max > 0 ? rand() % max : 0; }
+long random(long min, long max) { return min < max ? min + rand() % (max - min) : min; }
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (length < 0) return 0;
+  return write(buf, (size_t)length < sizeof(buf) ? length : sizeof(buf) - 1);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = read();
+    if (c < 0) break;
+    buffer[n++] = c;
+  }
+  return n;
+}
+
+String Stream::readString() {
+  String result;
+  for (int c = read(); c >= 0; c = read()) result += (char)c;
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  for (int c = read(); c >= 0 && c != terminator; c = read()) result += (char)c;
+  return result;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (!serial_quiet) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (!serial_quiet) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+void host_serial_quiet(bool quiet) {
+  serial_quiet = quiet;
+}
+
+uint32_t EspClass::getFreeHeap() { return 320 * 1024 - host_heap_stats().live_bytes; }
+uint32_t EspClass::getMinFreeHeap() { return 320 * 1024 - host_heap_stats().peak_bytes; }
+uint32_t EspClass::getHeapSize() { return 320 * 1024; }
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  return caps & MALLOC_CAP_SPIRAM ? nullptr : malloc(size); // no PSRAM on the host
+}
+
+void heap_caps_free(void *ptr) {
+  free(ptr);
+}
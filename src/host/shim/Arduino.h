@@ -0,0 +1,137 @@
+#pragma once
+
+// Just enough of the ESP32 Arduino core to build src/main.cpp on a desktop, for benchmarks and
+// host tools. Hardware calls are no-ops, time comes from the host clock and the SD card maps
+// to a directory (see SD.h). Not a simulator: receivers only answer what host tests set up.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include "WString.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 38
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t u_int16_t;
+
+#define PROGMEM
+#define F(x) (x)
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define LED_BUILTIN 2
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print(String(value, base)); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &value) { return print(value) + println(); }
+  template <typename T> size_t println(const T &value, int format) { return print(value, format) + println(); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() { return -1; }
+  void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  String readString();
+  String readStringUntil(char terminator);
+
+ protected:
+  unsigned long timeout_ = 1000;
+};
+
+// Serial goes to stdout, host_serial_quiet() mutes it for benchmarks
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int availableForWrite() { return 4096; } // stdout never pushes back
+  size_t setTxBufferSize(size_t size) { return size; }
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+void host_serial_quiet(bool quiet);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// Benchmarks time the code, not the waits: delay() returns at once and the clock jumps ahead instead
+void host_skip_delays(bool skip);
+uint64_t host_skipped_delay_us();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+inline void noInterrupts() {}
+inline void interrupts() {}
+void detachInterrupt(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize();
+  uint32_t getMaxAllocHeap();
+  uint32_t getFreePsram() { return 0; }
+  uint32_t getPsramSize() { return 0; }
+  void restart() { exit(0); }
+};
+extern EspClass ESP;
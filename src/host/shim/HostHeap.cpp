@@ -0,0 +1,89 @@
+#include "HostHeap.h"
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+
+static host_heap_stats_t stats;
+static bool threaded = false;
+static std::mutex stats_mutex;
+
+// Locks the counters only once a program said it allocates from more than one thread
+struct stats_lock_t {
+  stats_lock_t() {
+    if (threaded) stats_mutex.lock();
+  }
+  ~stats_lock_t() {
+    if (threaded) stats_mutex.unlock();
+  }
+};
+
+static void *tracked_alloc(size_t size) {
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr) return nullptr;
+  stats_lock_t lock;
+  stats.allocations++;
+  stats.live_bytes += malloc_usable_size(ptr);
+  if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+  return ptr;
+}
+
+void host_heap_free(void *ptr) {
+  if (!ptr) return;
+  stats_lock_t lock;
+  stats.frees++;
+  stats.live_bytes -= malloc_usable_size(ptr);
+  free(ptr);
+}
+
+void *host_heap_realloc(void *ptr, size_t size) {
+  if (!ptr) return tracked_alloc(size);
+  if (size == 0) {
+    host_heap_free(ptr);
+    return nullptr;
+  }
+  size_t before = malloc_usable_size(ptr);
+  void *grown = realloc(ptr, size);
+  if (!grown) return nullptr;
+  stats_lock_t lock;
+  stats.allocations++;
+  stats.frees++;
+  stats.live_bytes += malloc_usable_size(grown) - before;
+  if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+  return grown;
+}
+
+const host_heap_stats_t &host_heap_stats() {
+  return stats;
+}
+
+void host_heap_threaded(bool on) {
+  threaded = on;
+}
+
+void host_heap_reset_peak() {
+  stats.peak_bytes = stats.live_bytes;
+}
+
+void *operator new(size_t size) {
+  void *ptr = tracked_alloc(size);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return tracked_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return tracked_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept { host_heap_free(ptr); }
+void operator delete[](void *ptr) noexcept { host_heap_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { host_heap_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { host_heap_free(ptr); }
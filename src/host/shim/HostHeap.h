@@ -0,0 +1,21 @@
+#pragma once
+
+// Heap accounting for host builds. Every operator new and every String buffer goes through
+// here, so benchmarks can report allocations per operation and peak heap.
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct host_heap_stats_t {
+  uint64_t allocations; // new, malloc-style and growing reallocs
+  uint64_t frees;
+  size_t live_bytes;
+  size_t peak_bytes; // since the last host_heap_reset_peak()
+};
+
+void *host_heap_realloc(void *ptr, size_t size); // size 0 frees, like realloc
+void host_heap_free(void *ptr);
+
+const host_heap_stats_t &host_heap_stats();
+void host_heap_reset_peak();
+void host_heap_threaded(bool on); // before starting threads that allocate, the counters then take a lock
@@ -0,0 +1,63 @@
+#include "Preferences.h"
+#include <map>
+#include <string>
+
+static std::map<std::string, std::string> &store() {
+  static std::map<std::string, std::string> values;
+  return values;
+}
+
+bool Preferences::begin(const char *name, bool read_only, const char *partition) {
+  namespace_ = name;
+  return true;
+}
+
+static std::string full_key(const String &ns, const char *key) {
+  return std::string(ns.c_str()) + "/" + key;
+}
+
+bool Preferences::clear() {
+  std::string prefix = full_key(namespace_, "");
+  auto &values = store();
+  for (auto it = values.begin(); it != values.end();) {
+    it = it->first.compare(0, prefix.size(), prefix) == 0 ? values.erase(it) : std::next(it);
+  }
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  return store().erase(full_key(namespace_, key)) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  return store().count(full_key(namespace_, key)) > 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+  store()[full_key(namespace_, key)] = std::string((const char *)value, length);
+  return length;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  auto it = store().find(full_key(namespace_, key));
+  return it == store().end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t length) {
+  auto it = store().find(full_key(namespace_, key));
+  if (it == store().end() || it->second.size() > length) return 0;
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+bool Preferences::get(const char *key, void *value, size_t length) {
+  auto it = store().find(full_key(namespace_, key));
+  if (it == store().end() || it->second.size() != length) return false;
+  memcpy(value, it->second.data(), length);
+  return true;
+}
+
+String Preferences::getString(const char *key, const String &value) {
+  auto it = store().find(full_key(namespace_, key));
+  return it == store().end() ? value : String(it->second.c_str());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// NVS in memory, starts empty on every run
+
+#include "Arduino.h"
+
+class Preferences {
+ public:
+  bool begin(const char *name, bool read_only = false, const char *partition = nullptr);
+  void end() {}
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putUChar(const char *key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUShort(const char *key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong64(const char *key, uint64_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putFloat(const char *key, float value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putBool(const char *key, bool value) { return putUChar(key, value); }
+  size_t putString(const char *key, const char *value) { return putBytes(key, value, strlen(value) + 1); }
+  size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+  size_t putBytes(const char *key, const void *value, size_t length);
+
+  uint8_t getUChar(const char *key, uint8_t value = 0) { get(key, &value, sizeof(value)); return value; }
+  uint16_t getUShort(const char *key, uint16_t value = 0) { get(key, &value, sizeof(value)); return value; }
+  uint32_t getUInt(const char *key, uint32_t value = 0) { get(key, &value, sizeof(value)); return value; }
+  uint32_t getULong(const char *key, uint32_t value = 0) { get(key, &value, sizeof(value)); return value; }
+  uint64_t getULong64(const char *key, uint64_t value = 0) { get(key, &value, sizeof(value)); return value; }
+  float getFloat(const char *key, float value = 0) { get(key, &value, sizeof(value)); return value; }
+  bool getBool(const char *key, bool value = false) { return getUChar(key, value); }
+  String getString(const char *key, const String &value = String());
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buffer, size_t length);
+
+ private:
+  bool get(const char *key, void *value, size_t length); // only when the stored size matches
+  String namespace_;
+};
@@ -0,0 +1,156 @@
+#include "SD.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SDFS SD;
+static std::string sd_root = "./sd";
+
+struct host_file_t {
+  std::string path; // as the firmware sees it, "/dir/name"
+  std::string name;
+  FILE *fp = nullptr;
+  DIR *dir = nullptr;
+
+  ~host_file_t() {
+    if (fp) fclose(fp);
+    if (dir) closedir(dir);
+  }
+};
+
+void host_sd_root(const char *directory) {
+  sd_root = directory;
+}
+
+static std::string host_path(const char *path) {
+  std::string p = path ? path : "/";
+  if (p.empty() || p[0] != '/') p = "/" + p;
+  return sd_root + p;
+}
+
+bool SDFS::begin(uint8_t ss_pin, SPIClass &spi, uint32_t frequency, const char *mountpoint, uint8_t max_files, bool format_if_empty) {
+  ::mkdir(sd_root.c_str(), 0755);
+  struct stat st;
+  return stat(sd_root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+File SDFS::open(const char *path, const char *mode, bool create) {
+  std::string full = host_path(path);
+  auto file = std::make_shared<host_file_t>();
+  file->path = path && path[0] == '/' ? path : std::string("/") + (path ? path : "");
+  size_t slash = file->path.find_last_of('/');
+  file->name = file->path.substr(slash + 1);
+
+  struct stat st;
+  if (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    file->dir = opendir(full.c_str());
+    return file->dir ? File(file) : File();
+  }
+  std::string fmode = std::string(mode) + "b";
+  file->fp = fopen(full.c_str(), fmode.c_str());
+  return file->fp ? File(file) : File();
+}
+
+bool SDFS::exists(const char *path) {
+  struct stat st;
+  return stat(host_path(path).c_str(), &st) == 0;
+}
+
+bool SDFS::remove(const char *path) {
+  return ::remove(host_path(path).c_str()) == 0;
+}
+
+bool SDFS::rename(const char *from, const char *to) {
+  return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+bool SDFS::mkdir(const char *path) {
+  return ::mkdir(host_path(path).c_str(), 0755) == 0;
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  return file_ && file_->fp ? fwrite(buffer, 1, size, file_->fp) : 0;
+}
+
+int File::available() {
+  if (!file_ || !file_->fp) return 0;
+  long remaining = (long)size() - (long)position();
+  return remaining > 0 ? remaining : 0;
+}
+
+int File::read() {
+  return file_ && file_->fp ? fgetc(file_->fp) : -1;
+}
+
+int File::peek() {
+  if (!file_ || !file_->fp) return -1;
+  int c = fgetc(file_->fp);
+  if (c != EOF) ungetc(c, file_->fp);
+  return c;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  return file_ && file_->fp ? fread(buffer, 1, size, file_->fp) : 0;
+}
+
+void File::flush() {
+  if (file_ && file_->fp) {
+    fflush(file_->fp);
+    fdatasync(fileno(file_->fp)); // f_sync() on the card
+  }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+  return file_ && file_->fp && fseek(file_->fp, position, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+
+size_t File::position() const {
+  return file_ && file_->fp ? ftell(file_->fp) : 0;
+}
+
+size_t File::size() const {
+  if (!file_ || !file_->fp) return 0;
+  fflush(file_->fp);
+  struct stat st;
+  return fstat(fileno(file_->fp), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close() {
+  file_.reset();
+}
+
+File::operator bool() const {
+  return file_ && (file_->fp || file_->dir);
+}
+
+const char *File::name() const {
+  return file_ ? file_->name.c_str() : "";
+}
+
+const char *File::path() const {
+  return file_ ? file_->path.c_str() : "";
+}
+
+bool File::isDirectory() const {
+  return file_ && file_->dir;
+}
+
+File File::openNextFile(const char *mode) {
+  if (!file_ || !file_->dir) return File();
+  while (struct dirent *entry = readdir(file_->dir)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+    std::string child = file_->path == "/" ? "/" + std::string(entry->d_name) : file_->path + "/" + entry->d_name;
+    return SD.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (file_ && file_->dir) rewinddir(file_->dir);
+}
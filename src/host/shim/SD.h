@@ -0,0 +1,62 @@
+#pragma once
+
+// SD card on the host file system. Paths are relative to a root directory, "./sd" unless
+// host_sd_root() picks another one.
+
+#include "Arduino.h"
+#include "SPI.h"
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct host_file_t;
+
+class File : public Stream {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<host_file_t> file) : file_(file) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buffer, size_t size);
+  void flush() override;
+  bool seek(uint32_t position, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  const char *name() const;
+  const char *path() const;
+  bool isDirectory() const;
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory();
+
+ private:
+  std::shared_ptr<host_file_t> file_;
+};
+
+class SDFS {
+ public:
+  bool begin(uint8_t ss_pin, SPIClass &spi, uint32_t frequency, const char *mountpoint = "/sd", uint8_t max_files = 5, bool format_if_empty = false);
+  File open(const char *path, const char *mode = FILE_READ, bool create = false);
+  File open(const String &path, const char *mode = FILE_READ, bool create = false) { return open(path.c_str(), mode, create); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+};
+extern SDFS SD;
+
+void host_sd_root(const char *directory);
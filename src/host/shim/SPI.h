@@ -0,0 +1,5 @@
+#pragma once
+#include "Arduino.h"
+
+class SPIClass {};
+extern SPIClass SPI;
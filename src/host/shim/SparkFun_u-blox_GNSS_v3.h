@@ -0,0 +1,467 @@
+#pragma once
+
+// Stand-in for the SparkFun u-blox GNSS v3 library. Nothing talks to a receiver: getters answer from
+// the public `host` state, configuration calls succeed and are counted, and callbacks are kept so
+// a host program can feed epochs in with host_pvt().
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define COM_TYPE_UBX 1
+#define COM_TYPE_NMEA 2
+#define COM_TYPE_RTCM3 4
+#define COM_TYPE_SPARTN 8
+#define COM_PORT_I2C 0
+#define SFE_UBLOX_DGNSS_MODE_FIXED 3
+#define VAL_LAYER_RAM 1
+#define VAL_LAYER_BBR 2
+#define VAL_LAYER_FLASH 4
+#define VAL_LAYER_RAM_BBR 3
+#define VAL_LAYER_ALL 7
+#define kUBLOXGNSSDefaultMaxWait 1100
+
+const uint32_t UBLOX_CFG_PMP_CENTER_FREQUENCY = 0x40b10011;
+const uint32_t UBLOX_CFG_PMP_SEARCH_WINDOW = 0x30b10012;
+const uint32_t UBLOX_CFG_PMP_USE_SERVICE_ID = 0x10b10016;
+const uint32_t UBLOX_CFG_PMP_SERVICE_ID = 0x30b10017;
+const uint32_t UBLOX_CFG_PMP_DATA_RATE = 0x30b10013;
+const uint32_t UBLOX_CFG_PMP_USE_DESCRAMBLER = 0x10b10014;
+const uint32_t UBLOX_CFG_PMP_DESCRAMBLER_INIT = 0x30b10015;
+const uint32_t UBLOX_CFG_PMP_USE_PRESCRAMBLING = 0x10b10019;
+const uint32_t UBLOX_CFG_PMP_UNIQUE_WORD = 0x50b1001a;
+const uint32_t UBLOX_CFG_UART2_BAUDRATE = 0x40530001;
+const uint32_t UBLOX_CFG_UART2OUTPROT_UBX = 0x10760001;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_RXM_PMP_UART2 = 0x2091031f;
+const uint32_t UBLOX_CFG_SPARTN_USE_SOURCE = 0x20a70001;
+const uint32_t UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1005_I2C = 0x209102bd;
+const uint32_t UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1074_I2C = 0x2091035e;
+const uint32_t UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1094_I2C = 0x20910368;
+const uint32_t UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1124_I2C = 0x2091036d;
+const uint32_t UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1230_I2C = 0x20910303;
+const uint32_t UBLOX_CFG_I2CINPROT_UBX = 0x10710001;
+const uint32_t UBLOX_CFG_I2CINPROT_NMEA = 0x10710002;
+const uint32_t UBLOX_CFG_I2CINPROT_RTCM3X = 0x10710004;
+const uint32_t UBLOX_CFG_I2CINPROT_SPARTN = 0x10710005;
+const uint32_t UBLOX_CFG_NAVHPG_DGNSSMODE = 0x20140011;
+const uint32_t UBLOX_CFG_RATE_MEAS = 0x30210001;
+const uint32_t UBLOX_CFG_RATE_NAV = 0x30210002;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_PVT_I2C = 0x20910006;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_HPPOSLLH_I2C = 0x20910033;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_SAT_I2C = 0x20910015;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_SIG_I2C = 0x20910345;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_SVIN_I2C = 0x20910088;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_MON_HW_I2C = 0x209101b4;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_TIM_TM2_I2C = 0x20910178;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_RXM_COR_I2C = 0x209102b6;
+const uint32_t UBLOX_CFG_TXREADY_ENABLED = 0x10a20001;
+const uint32_t UBLOX_CFG_TXREADY_POLARITY = 0x10a20002;
+const uint32_t UBLOX_CFG_TXREADY_PIN = 0x20a20003;
+const uint32_t UBLOX_CFG_TXREADY_THRESHOLD = 0x30a20004;
+const uint32_t UBLOX_CFG_TXREADY_INTERFACE = 0x20a20005;
+const uint32_t UBLOX_CFG_MSGOUT_UBX_NAV_TIMEGPS_I2C = 0x20910047;
+
+// only the messages and fields the firmware reads, same layout as the library
+
+typedef struct {
+  uint8_t sync1;
+  uint8_t sync2;
+  uint8_t cls;
+  uint8_t ID;
+  uint8_t lengthLSB;
+  uint8_t lengthMSB;
+  uint8_t payload[528];
+  uint8_t checksumA;
+  uint8_t checksumB;
+} UBX_RXM_PMP_message_data_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t ebno;
+  uint8_t reserved0[2];
+  union {
+    uint32_t all;
+    struct {
+      uint32_t protocol : 5;
+      uint32_t errStatus : 2;
+      uint32_t msgUsed : 2;
+      uint32_t correctionId : 16;
+      uint32_t msgTypeValid : 1;
+      uint32_t msgSubTypeValid : 1;
+      uint32_t msgInputHandle : 1;
+      uint32_t msgEncrypted : 2;
+      uint32_t msgDecrypted : 2;
+    } bits;
+  } statusInfo;
+  uint16_t msgType;
+  uint16_t msgSubType;
+} UBX_RXM_COR_data_t;
+
+typedef struct {
+  uint32_t iTOW;
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t min;
+  uint8_t sec;
+  union {
+    uint8_t all;
+    struct {
+      uint8_t validDate : 1;
+      uint8_t validTime : 1;
+      uint8_t fullyResolved : 1;
+      uint8_t validMag : 1;
+    } bits;
+  } valid;
+  uint32_t tAcc;
+  int32_t nano;
+  uint8_t fixType;
+  union {
+    uint8_t all;
+    struct {
+      uint8_t gnssFixOK : 1;
+      uint8_t diffSoln : 1;
+      uint8_t psmState : 3;
+      uint8_t headVehValid : 1;
+      uint8_t carrSoln : 2;
+    } bits;
+  } flags;
+  union {
+    uint8_t all;
+  } flags2;
+  uint8_t numSV;
+  int32_t lon;
+  int32_t lat;
+  int32_t height;
+  int32_t hMSL;
+  uint32_t hAcc;
+  uint32_t vAcc;
+  int32_t velN;
+  int32_t velE;
+  int32_t velD;
+  int32_t gSpeed;
+  int32_t headMot;
+  uint32_t sAcc;
+  uint32_t headAcc;
+  uint16_t pDOP;
+  union {
+    uint8_t all;
+    struct {
+      uint8_t invalidLlh : 1;
+      uint8_t lastCorrectionAge : 4;
+    } bits;
+  } flags3;
+  uint8_t reserved0[5];
+  int32_t headVeh;
+  int16_t magDec;
+  uint16_t magAcc;
+} UBX_NAV_PVT_data_t;
+
+#define UBX_NAV_SAT_MAX_BLOCKS 255
+#define UBX_NAV_SIG_MAX_BLOCKS 92
+
+typedef struct {
+  uint32_t iTOW;
+  uint8_t version;
+  uint8_t numSvs;
+  uint8_t reserved0[2];
+} UBX_NAV_SAT_header_t;
+
+typedef struct {
+  uint8_t gnssId;
+  uint8_t svId;
+  uint8_t cno;
+  int8_t elev;
+  int16_t azim;
+  int16_t prRes;
+  union {
+    uint32_t all;
+    struct {
+      uint32_t qualityInd : 3;
+      uint32_t svUsed : 1;
+      uint32_t health : 2;
+      uint32_t diffCorr : 1;
+    } bits;
+  } flags;
+} UBX_NAV_SAT_block_t;
+
+typedef struct {
+  UBX_NAV_SAT_header_t header;
+  UBX_NAV_SAT_block_t blocks[UBX_NAV_SAT_MAX_BLOCKS];
+} UBX_NAV_SAT_data_t;
+
+typedef struct {
+  uint32_t iTOW;
+  uint8_t version;
+  uint8_t numSigs;
+  uint8_t reserved0[2];
+} UBX_NAV_SIG_header_t;
+
+typedef struct {
+  uint8_t gnssId;
+  uint8_t svId;
+  uint8_t sigId;
+  uint8_t freqId;
+  int16_t prRes;
+  uint8_t cno;
+  uint8_t qualityInd;
+  uint8_t corrSource;
+  uint8_t ionoModel;
+  union {
+    uint16_t all;
+    struct {
+      uint16_t health : 2;
+      uint16_t prSmoothed : 1;
+      uint16_t prUsed : 1;
+      uint16_t crUsed : 1;
+      uint16_t doUsed : 1;
+      uint16_t prCorrUsed : 1;
+      uint16_t crCorrUsed : 1;
+      uint16_t doCorrUsed : 1;
+    } bits;
+  } sigFlags;
+  uint8_t reserved1[4];
+} UBX_NAV_SIG_block_t;
+
+typedef struct {
+  UBX_NAV_SIG_header_t header;
+  UBX_NAV_SIG_block_t blocks[UBX_NAV_SIG_MAX_BLOCKS];
+} UBX_NAV_SIG_data_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t reserved1[3];
+  uint32_t iTOW;
+  uint32_t dur; // s
+  int32_t meanX;
+  int32_t meanY;
+  int32_t meanZ;
+  int8_t meanXHP;
+  int8_t meanYHP;
+  int8_t meanZHP;
+  uint8_t reserved2;
+  uint32_t meanAcc; // 0.1 mm
+  uint32_t obs;
+  int8_t valid;
+  int8_t active;
+  uint8_t reserved3[2];
+} UBX_NAV_SVIN_data_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t reserved0[2];
+  union {
+    uint8_t all;
+    struct {
+      uint8_t invalidLlh : 1;
+    } bits;
+  } flags;
+  uint32_t iTOW;
+  int32_t lon;
+  int32_t lat;
+  int32_t height;
+  int32_t hMSL;
+  int8_t lonHp;
+  int8_t latHp;
+  int8_t heightHp;
+  int8_t hMSLHp;
+  uint32_t hAcc;
+  uint32_t vAcc;
+} UBX_NAV_HPPOSLLH_data_t;
+
+typedef struct {
+  uint8_t ch;
+  union {
+    uint8_t all;
+    struct {
+      uint8_t mode : 1;
+      uint8_t run : 1;
+      uint8_t newFallingEdge : 1;
+      uint8_t timeBase : 2;
+      uint8_t utc : 1;
+      uint8_t time : 1;
+      uint8_t newRisingEdge : 1;
+    } bits;
+  } flags;
+  uint16_t count;
+  uint16_t wnR;
+  uint16_t wnF;
+  uint32_t towMsR;
+  uint32_t towSubMsR;
+  uint32_t towMsF;
+  uint32_t towSubMsF;
+  uint32_t accEst;
+} UBX_TIM_TM2_data_t;
+
+typedef struct {
+  uint32_t pinSel;
+  uint32_t pinBank;
+  uint32_t pinDir;
+  uint32_t pinVal;
+  uint16_t noisePerMS;
+  uint16_t agcCnt;
+  uint8_t aStatus; // 0 init, 1 unknown, 2 OK, 3 short, 4 open
+  uint8_t aPower;
+  uint8_t flags;
+  uint8_t reserved1;
+  uint32_t usedMask;
+  uint8_t VP[17];
+  uint8_t jamInd;
+  uint8_t reserved2[2];
+  uint32_t pinIrq;
+  uint32_t pullH;
+  uint32_t pullL;
+} UBX_MON_HW_data_t;
+
+typedef struct {
+  uint8_t cls;
+  uint8_t id;
+  uint16_t len;
+  uint16_t counter;
+  uint16_t startingSpot;
+  uint8_t *payload;
+} ubxPacket;
+
+// what the getters report
+struct host_receiver_t {
+  bool present = true;
+  const char *module_name = "ZED-F9P";
+  const char *firmware_type = "HPG";
+  uint8_t firmware_high = 1, firmware_low = 32;
+  uint8_t protocol_high = 27, protocol_low = 31;
+  UBX_NAV_PVT_data_t pvt = {};
+  UBX_NAV_SAT_data_t nav_sat = {};
+  UBX_NAV_SIG_data_t nav_sig = {};
+  UBX_NAV_HPPOSLLH_data_t hpposllh = {};
+  UBX_TIM_TM2_data_t tim_tm2 = {};
+  int32_t high_res_lat = 0, high_res_lon = 0; // deg * 1e-7
+  uint8_t antenna_status = 2;
+  uint16_t measurement_rate = 1000;
+  bool survey_active = false, survey_valid = false;
+  uint16_t survey_observation_time = 0; // s
+  float survey_mean_accuracy = 0; // m
+  uint32_t cfg_writes = 0, raw_bytes_pushed = 0;
+};
+
+class SFE_UBLOX_GNSS {
+ public:
+  host_receiver_t host;
+
+  bool begin(uint8_t address = 0x42, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait, bool assumeSuccess = false) { return host.present; }
+  bool begin(TwoWire &wire, uint8_t address = 0x42, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait, bool assumeSuccess = false) { return host.present; }
+  bool isConnected(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.present; }
+  void enableDebugging(Stream &debugPort) {}
+  bool checkUblox(uint8_t requestedClass = 0, uint8_t requestedID = 0) { return host.present; }
+  void checkCallbacks() {}
+  bool pushRawData(uint8_t *data, size_t length, bool stop = true) { host.raw_bytes_pushed += length; return host.present; }
+
+  bool newCfgValset(uint8_t layer = VAL_LAYER_RAM_BBR) { return host.present; }
+  bool addCfgValset(uint32_t key, uint64_t value) { return host.present; }
+  bool sendCfgValset(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { host.cfg_writes++; return host.present; }
+  bool setVal32(uint32_t key, uint32_t value, uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { host.cfg_writes++; return host.present; }
+  bool setVal8(uint32_t key, uint8_t value, uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { host.cfg_writes++; return host.present; }
+  // nothing is stored in the stub's BBR, a boot always reconfigures
+  bool newCfgValget(uint8_t layer = VAL_LAYER_RAM) { return host.present; }
+  bool addCfgValget(uint32_t key) { return host.present; }
+  bool sendCfgValget(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return false; }
+  ubxPacket *getCfgValget() { return &packet_cfg_; }
+  bool extractConfigValueByKey(ubxPacket *msg, const uint32_t key, void *value, size_t maxWidth) { return false; }
+  bool getVal8(uint32_t key, uint8_t *value, uint8_t layer = VAL_LAYER_RAM, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return false; }
+  bool getVal16(uint32_t key, uint16_t *value, uint8_t layer = VAL_LAYER_RAM, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return false; }
+  bool getVal32(uint32_t key, uint32_t *value, uint8_t layer = VAL_LAYER_RAM, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return false; }
+  bool getVal64(uint32_t key, uint64_t *value, uint8_t layer = VAL_LAYER_RAM, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return false; }
+  bool setDynamicSPARTNKeys(uint8_t keyLengthBytes1, uint16_t validFromWno1, uint32_t validFromTow1, const char *key1,
+                            uint8_t keyLengthBytes2, uint16_t validFromWno2, uint32_t validFromTow2, const char *key2) { return host.present; }
+  bool setDynamicSPARTNKey(uint8_t keyLengthBytes, uint16_t validFromWno, uint32_t validFromTow, const char *key) { return host.present; }
+  void softwareResetGNSSOnly() {}
+  bool setMeasurementRate(uint16_t rate, uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { host.measurement_rate = rate; return host.present; }
+  bool setNavigationRate(uint16_t rate, uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.present; }
+  bool setAutoPVTcallbackPtr(void (*callback)(UBX_NAV_PVT_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { pvt_callback_ = callback; return host.present; }
+  bool setAutoNAVSATcallbackPtr(void (*callback)(UBX_NAV_SAT_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { sat_callback_ = callback; return host.present; }
+  bool setAutoNAVSIGcallbackPtr(void (*callback)(UBX_NAV_SIG_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { sig_callback_ = callback; return host.present; }
+  bool setAutoNAVSVINcallbackPtr(void (*callback)(UBX_NAV_SVIN_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { svin_callback_ = callback; return host.present; }
+  bool setAutoMONHWcallbackPtr(void (*callback)(UBX_MON_HW_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { mon_hw_callback_ = callback; return host.present; }
+  bool setAutoHPPOSLLHcallbackPtr(void (*callback)(UBX_NAV_HPPOSLLH_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { hpposllh_callback_ = callback; return host.present; }
+  bool setAutoTIMTM2callbackPtr(void (*callback)(UBX_TIM_TM2_data_t *), uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { tm2_callback_ = callback; return host.present; }
+
+  int32_t getLatitude(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.lat; }
+  int32_t getLongitude(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.lon; }
+  int32_t getAltitude(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.height; }
+  int32_t getAltitudeMSL(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.hMSL; }
+  int32_t getMeanSeaLevel(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.hMSL; }
+  int32_t getElipsoid(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.height; }
+  int32_t getHighResLatitude(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.high_res_lat; }
+  int32_t getHighResLongitude(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.high_res_lon; }
+  uint8_t getFixType(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.fixType; }
+  uint8_t getCarrierSolutionType(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.flags.bits.carrSoln; }
+  int32_t getHeading(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.headMot; }
+  uint8_t getSIV(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.numSV; }
+  uint16_t getPDOP(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.pDOP; }
+  uint32_t getPositionAccuracy(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return sqrt((double)host.pvt.hAcc * host.pvt.hAcc + (double)host.pvt.vAcc * host.pvt.vAcc); }
+  uint32_t getHorizontalAccuracy(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.hAcc; }
+  uint32_t getVerticalAccuracy(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.pvt.vAcc; }
+  uint16_t getMeasurementRate(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.measurement_rate; }
+  uint8_t getAntennaStatus(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.antenna_status; }
+
+  bool getSurveyStatus(uint16_t maxWait = 2000) { return host.present; }
+  bool getSurveyInActive(uint16_t maxWait = 2000) { return host.survey_active; }
+  bool getSurveyInValid(uint16_t maxWait = 2000) { return host.survey_valid; }
+  uint16_t getSurveyInObservationTime(uint16_t maxWait = 2000) { return host.survey_observation_time; }
+  float getSurveyInMeanAccuracy(uint16_t maxWait = 2000) { return host.survey_mean_accuracy; }
+  bool enableSurveyMode(uint16_t observationTime, float requiredAccuracy, uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) {
+    host.survey_active = true;
+    host.survey_valid = false;
+    return host.present;
+  }
+  bool disableSurveyMode(uint8_t layer = VAL_LAYER_RAM_BBR, uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) {
+    host.survey_active = false;
+    return host.present;
+  }
+
+  const char *getModuleName(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.module_name; }
+  const char *getFirmwareType(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.firmware_type; }
+  uint8_t getFirmwareVersionHigh(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.firmware_high; }
+  uint8_t getFirmwareVersionLow(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.firmware_low; }
+  uint8_t getProtocolVersionHigh(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.protocol_high; }
+  uint8_t getProtocolVersionLow(uint16_t maxWait = kUBLOXGNSSDefaultMaxWait) { return host.protocol_low; }
+
+  // host side: deliver host.pvt to the registered callback, as checkCallbacks() would
+  void host_pvt() {
+    if (pvt_callback_) pvt_callback_(&host.pvt);
+  }
+  void host_nav_sat() {
+    if (sat_callback_) sat_callback_(&host.nav_sat);
+  }
+  void host_nav_sig() {
+    if (sig_callback_) sig_callback_(&host.nav_sig);
+  }
+  void host_nav_svin() { // from the survey_* values
+    UBX_NAV_SVIN_data_t svin = {};
+    svin.dur = host.survey_observation_time;
+    svin.meanAcc = host.survey_mean_accuracy * 10000;
+    svin.valid = host.survey_valid;
+    svin.active = host.survey_active;
+    if (svin_callback_) svin_callback_(&svin);
+  }
+  void host_mon_hw() { // host.antenna_status as aStatus
+    UBX_MON_HW_data_t hw = {};
+    hw.aStatus = host.antenna_status;
+    if (mon_hw_callback_) mon_hw_callback_(&hw);
+  }
+  void host_hpposllh() {
+    if (hpposllh_callback_) hpposllh_callback_(&host.hpposllh);
+  }
+  void host_tim_tm2() {
+    if (tm2_callback_) tm2_callback_(&host.tim_tm2);
+  }
+
+ private:
+  ubxPacket packet_cfg_ = {};
+  void (*pvt_callback_)(UBX_NAV_PVT_data_t *) = nullptr;
+  void (*sat_callback_)(UBX_NAV_SAT_data_t *) = nullptr;
+  void (*sig_callback_)(UBX_NAV_SIG_data_t *) = nullptr;
+  void (*svin_callback_)(UBX_NAV_SVIN_data_t *) = nullptr;
+  void (*mon_hw_callback_)(UBX_MON_HW_data_t *) = nullptr;
+  void (*hpposllh_callback_)(UBX_NAV_HPPOSLLH_data_t *) = nullptr;
+  void (*tm2_callback_)(UBX_TIM_TM2_data_t *) = nullptr;
+};
@@ -0,0 +1,12 @@
+// Globals of the no-op hardware shims
+#include "Wire.h"
+#include "SPI.h"
+#include "WiFi.h"
+
+TwoWire Wire;
+SPIClass SPI;
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+  return String(octets_[0]) + "." + String(octets_[1]) + "." + String(octets_[2]) + "." + String(octets_[3]);
+}
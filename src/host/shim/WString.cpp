@@ -0,0 +1,297 @@
+#include "WString.h"
+#include "HostHeap.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void format_unsigned(String &out, unsigned long long value, unsigned char base) {
+  char buf[8 * sizeof(value) + 1];
+  char *p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  if (base < 2) base = 10;
+  do {
+    unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  out = p;
+}
+
+static void format_signed(String &out, long long value, unsigned char base) {
+  if (value < 0 && base == 10) {
+    format_unsigned(out, -(unsigned long long)value, base);
+    String minus("-");
+    minus.concat(out);
+    out = minus;
+  } else {
+    format_unsigned(out, (unsigned long long)value, base);
+  }
+}
+
+static void format_double(String &out, double value, unsigned int decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, value); // dtostrf() on the device
+  out = buf;
+}
+
+String::String(const char *cstr) {
+  sso_[0] = '\0';
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const char *cstr, unsigned int length) {
+  sso_[0] = '\0';
+  if (cstr) copy(cstr, length);
+}
+
+String::String(const String &str) {
+  sso_[0] = '\0';
+  copy(str.buffer(), str.len_);
+}
+
+String::String(String &&str) {
+  sso_[0] = '\0';
+  move(str);
+}
+
+String::String(char c) {
+  sso_[0] = '\0';
+  copy(&c, 1);
+}
+
+String::String(unsigned char value, unsigned char base) { sso_[0] = '\0'; format_unsigned(*this, value, base); }
+String::String(int value, unsigned char base) { sso_[0] = '\0'; format_signed(*this, value, base); }
+String::String(unsigned int value, unsigned char base) { sso_[0] = '\0'; format_unsigned(*this, value, base); }
+String::String(long value, unsigned char base) { sso_[0] = '\0'; format_signed(*this, value, base); }
+String::String(unsigned long value, unsigned char base) { sso_[0] = '\0'; format_unsigned(*this, value, base); }
+String::String(long long value, unsigned char base) { sso_[0] = '\0'; format_signed(*this, value, base); }
+String::String(unsigned long long value, unsigned char base) { sso_[0] = '\0'; format_unsigned(*this, value, base); }
+String::String(float value, unsigned int decimals) { sso_[0] = '\0'; format_double(*this, value, decimals); }
+String::String(double value, unsigned int decimals) { sso_[0] = '\0'; format_double(*this, value, decimals); }
+
+String::~String() {
+  invalidate();
+}
+
+void String::invalidate() {
+  if (heap_) host_heap_free(ptr_);
+  heap_ = false;
+  len_ = 0;
+  sso_[0] = '\0';
+}
+
+void String::setLength(unsigned int length) {
+  len_ = length;
+  buffer()[length] = '\0';
+}
+
+// Grows to exactly size, like the ESP32 core's changeBuffer()
+bool String::reserve(unsigned int size) {
+  if (size <= capacity()) return true;
+  char *grown;
+  if (heap_) {
+    grown = (char *)host_heap_realloc(ptr_, size + 1);
+  } else {
+    grown = (char *)host_heap_realloc(nullptr, size + 1);
+    if (grown) memcpy(grown, sso_, len_ + 1);
+  }
+  if (!grown) return false;
+  ptr_ = grown;
+  cap_ = size;
+  heap_ = true;
+  return true;
+}
+
+bool String::copy(const char *cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return false;
+  }
+  memmove(buffer(), cstr, length);
+  setLength(length);
+  return true;
+}
+
+void String::move(String &rhs) {
+  invalidate();
+  if (rhs.heap_) {
+    ptr_ = rhs.ptr_;
+    cap_ = rhs.cap_;
+    heap_ = true;
+    len_ = rhs.len_;
+  } else {
+    memcpy(sso_, rhs.sso_, rhs.len_ + 1);
+    len_ = rhs.len_;
+  }
+  rhs.heap_ = false;
+  rhs.len_ = 0;
+  rhs.sso_[0] = '\0';
+}
+
+String &String::operator=(const String &rhs) {
+  if (this != &rhs) copy(rhs.buffer(), rhs.len_);
+  return *this;
+}
+
+String &String::operator=(String &&rhs) {
+  if (this != &rhs) move(rhs);
+  return *this;
+}
+
+String &String::operator=(const char *cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+  return *this;
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+  if (!cstr) return false;
+  if (length == 0) return true;
+  unsigned int new_length = len_ + length;
+  if (cstr >= buffer() && cstr < buffer() + len_) { // appending part of ourselves
+    String copy_of(cstr, length);
+    return concat(copy_of.buffer(), length);
+  }
+  if (!reserve(new_length)) return false;
+  memcpy(buffer() + len_, cstr, length);
+  setLength(new_length);
+  return true;
+}
+
+bool String::concat(const String &str) { return concat(str.buffer(), str.len_); }
+bool String::concat(const char *cstr) { return cstr && concat(cstr, strlen(cstr)); }
+bool String::concat(char c) { return concat(&c, 1); }
+bool String::concat(unsigned char value) { return concat(String(value)); }
+bool String::concat(int value) { return concat(String(value)); }
+bool String::concat(unsigned int value) { return concat(String(value)); }
+bool String::concat(long value) { return concat(String(value)); }
+bool String::concat(unsigned long value) { return concat(String(value)); }
+bool String::concat(long long value) { return concat(String(value)); }
+bool String::concat(unsigned long long value) { return concat(String(value)); }
+bool String::concat(float value) { return concat(String(value)); }
+bool String::concat(double value) { return concat(String(value)); }
+
+int String::compareTo(const String &str) const { return strcmp(buffer(), str.buffer()); }
+bool String::equals(const String &str) const { return len_ == str.len_ && memcmp(buffer(), str.buffer(), len_) == 0; }
+bool String::equals(const char *cstr) const { return cstr ? strcmp(buffer(), cstr) == 0 : len_ == 0; }
+bool String::operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+bool String::equalsIgnoreCase(const String &str) const { return len_ == str.len_ && strcasecmp(buffer(), str.buffer()) == 0; }
+bool String::startsWith(const String &prefix) const { return prefix.len_ <= len_ && memcmp(buffer(), prefix.buffer(), prefix.len_) == 0; }
+bool String::endsWith(const String &suffix) const {
+  return suffix.len_ <= len_ && memcmp(buffer() + len_ - suffix.len_, suffix.buffer(), suffix.len_) == 0;
+}
+
+char String::charAt(unsigned int index) const { return index < len_ ? buffer()[index] : 0; }
+void String::setCharAt(unsigned int index, char c) { if (index < len_) buffer()[index] = c; }
+char String::operator[](unsigned int index) const { return charAt(index); }
+char &String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len_) return dummy = 0;
+  return buffer()[index];
+}
+
+void String::toCharArray(char *buf, unsigned int size, unsigned int index) const {
+  if (!size || !buf) return;
+  unsigned int n = index < len_ ? len_ - index : 0;
+  if (n > size - 1) n = size - 1;
+  memcpy(buf, buffer() + (index < len_ ? index : len_), n);
+  buf[n] = '\0';
+}
+
+int String::indexOf(char ch, unsigned int from) const {
+  if (from >= len_) return -1;
+  const char *found = (const char *)memchr(buffer() + from, ch, len_ - from);
+  return found ? found - buffer() : -1;
+}
+
+int String::indexOf(const String &str, unsigned int from) const {
+  if (from > len_) return -1;
+  const char *found = strstr(buffer() + from, str.buffer());
+  return found ? found - buffer() : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  const char *found = strrchr(buffer(), ch);
+  return found ? found - buffer() : -1;
+}
+
+int String::lastIndexOf(const String &str) const {
+  int found = -1;
+  for (int at = indexOf(str); at != -1; at = indexOf(str, at + 1)) found = at;
+  return found;
+}
+
+String String::substring(unsigned int from) const { return substring(from, len_); }
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int t = from;
+    from = to;
+    to = t;
+  }
+  if (from >= len_) return String();
+  if (to > len_) to = len_;
+  return String(buffer() + from, to - from);
+}
+
+void String::replace(char find, char replace) {
+  for (unsigned int i = 0; i < len_; i++) {
+    if (buffer()[i] == find) buffer()[i] = replace;
+  }
+}
+
+void String::replace(const String &find, const String &replace) {
+  if (find.len_ == 0) return;
+  String result;
+  unsigned int from = 0;
+  for (int at = indexOf(find); at != -1; at = indexOf(find, from)) {
+    result.concat(buffer() + from, at - from);
+    result.concat(replace);
+    from = at + find.len_;
+  }
+  result.concat(buffer() + from, len_ - from);
+  *this = static_cast<String &&>(result);
+}
+
+void String::remove(unsigned int index) { remove(index, (unsigned int)-1); }
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len_) return;
+  if (count > len_ - index) count = len_ - index;
+  memmove(buffer() + index, buffer() + index + count, len_ - index - count);
+  setLength(len_ - count);
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len_; i++) buffer()[i] = tolower((unsigned char)buffer()[i]);
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len_; i++) buffer()[i] = toupper((unsigned char)buffer()[i]);
+}
+
+void String::trim() {
+  unsigned int begin = 0, end = len_;
+  while (begin < end && isspace((unsigned char)buffer()[begin])) begin++;
+  while (end > begin && isspace((unsigned char)buffer()[end - 1])) end--;
+  memmove(buffer(), buffer() + begin, end - begin);
+  setLength(end - begin);
+}
+
+long String::toInt() const { return atol(buffer()); }
+float String::toFloat() const { return atof(buffer()); }
+double String::toDouble() const { return atof(buffer()); }
+
+String operator+(String lhs, const String &rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, const char *rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, char rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, int rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, unsigned int rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, long rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, unsigned long rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, long long rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, unsigned long long rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, float rhs) { lhs.concat(rhs); return lhs; }
+String operator+(String lhs, double rhs) { lhs.concat(rhs); return lhs; }
+String operator+(const char *lhs, const String &rhs) { String sum(lhs); sum.concat(rhs); return sum; }
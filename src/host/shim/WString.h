@@ -0,0 +1,133 @@
+#pragma once
+
+// Arduino String for host builds. Follows the ESP32 core's allocation behaviour (small string
+// buffer, exact-size realloc on growth) so allocation counts on the host match the device.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WSTRING_SSO_SIZE 15 // what the ESP32 core fits inline on a 32 bit target
+
+class String {
+ public:
+  String(const char *cstr = "");
+  String(const char *cstr, unsigned int length);
+  String(const String &str);
+  String(String &&str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimals = 2);
+  explicit String(double value, unsigned int decimals = 2);
+  ~String();
+
+  String &operator=(const String &rhs);
+  String &operator=(String &&rhs);
+  String &operator=(const char *cstr);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len_; }
+  bool isEmpty() const { return len_ == 0; }
+  const char *c_str() const { return buffer(); }
+  char *begin() { return buffer(); }
+  char *end() { return buffer() + len_; }
+
+  bool concat(const String &str);
+  bool concat(const char *cstr);
+  bool concat(const char *cstr, unsigned int length);
+  bool concat(char c);
+  bool concat(unsigned char value);
+  bool concat(int value);
+  bool concat(unsigned int value);
+  bool concat(long value);
+  bool concat(unsigned long value);
+  bool concat(long long value);
+  bool concat(unsigned long long value);
+  bool concat(float value);
+  bool concat(double value);
+
+  template <typename T> String &operator+=(const T &rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  bool equals(const String &str) const;
+  bool equals(const char *cstr) const;
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const;
+  int compareTo(const String &str) const;
+  bool equalsIgnoreCase(const String &str) const;
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const;
+  char &operator[](unsigned int index);
+  void toCharArray(char *buf, unsigned int size, unsigned int index = 0) const;
+
+  int indexOf(char ch, unsigned int from = 0) const;
+  int indexOf(const String &str, unsigned int from = 0) const;
+  int lastIndexOf(char ch) const;
+  int lastIndexOf(const String &str) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+
+  void replace(char find, char replace);
+  void replace(const String &find, const String &replace);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+  void clear() { setLength(0); }
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+ private:
+  bool heap() const { return heap_; }
+  char *buffer() { return heap_ ? ptr_ : sso_; }
+  const char *buffer() const { return heap_ ? ptr_ : sso_; }
+  unsigned int capacity() const { return heap_ ? cap_ : WSTRING_SSO_SIZE - 1; }
+  void setLength(unsigned int length);
+  void invalidate();
+  bool copy(const char *cstr, unsigned int length);
+  void move(String &rhs);
+
+  union {
+    char sso_[WSTRING_SSO_SIZE];
+    struct {
+      char *ptr_;
+      unsigned int cap_;
+    };
+  };
+  unsigned int len_ = 0;
+  bool heap_ = false;
+};
+
+// Arduino chains these through StringSumHelper, taking the left side by value gives the same
+// single growing temporary
+String operator+(String lhs, const String &rhs);
+String operator+(String lhs, const char *rhs);
+String operator+(String lhs, char rhs);
+String operator+(String lhs, int rhs);
+String operator+(String lhs, unsigned int rhs);
+String operator+(String lhs, long rhs);
+String operator+(String lhs, unsigned long rhs);
+String operator+(String lhs, long long rhs);
+String operator+(String lhs, unsigned long long rhs);
+String operator+(String lhs, float rhs);
+String operator+(String lhs, double rhs);
+String operator+(const char *lhs, const String &rhs);
+
+typedef char __FlashStringHelper;
@@ -0,0 +1,22 @@
+#pragma once
+#include "Arduino.h"
+
+class IPAddress {
+ public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets_{a, b, c, d} {}
+  uint8_t operator[](int index) const { return octets_[index]; }
+  String toString() const;
+
+ private:
+  uint8_t octets_[4];
+};
+
+class WiFiClass {
+ public:
+  bool softAP(const char *ssid, const char *password = nullptr, int channel = 1, int hidden = 0, int max_connections = 4) { return true; }
+  bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) { return true; }
+  IPAddress softAPIP() { return IPAddress(127, 0, 0, 1); }
+  uint8_t softAPgetStationNum() { return 0; }
+};
+extern WiFiClass WiFi;
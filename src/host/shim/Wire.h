@@ -0,0 +1,10 @@
+#pragma once
+#include "Arduino.h"
+
+class TwoWire {
+ public:
+  bool begin() { return true; }
+  bool begin(int sda, int scl, uint32_t frequency = 0) { return true; }
+  void setClock(uint32_t frequency) {}
+};
+extern TwoWire Wire;
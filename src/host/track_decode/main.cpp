@@ -0,0 +1,80 @@
+// Converts a binary track log (TrackLog.h) from the SD card to CSV or GeoJSON.
+//
+//   pio run -e track_decode
+//   .pio/build/track_decode/program TRACK.TRK > track.csv
+//   .pio/build/track_decode/program --geojson TRACK.TRK > track.geojson
+//
+// Damaged blocks are reported on stderr and skipped, the rest of the file still decodes.
+
+#include <TrackLog.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GPS_UNIX_OFFSET 315964800 // 1980-01-06 in unix time
+#define GPS_LEAP_SECONDS 18
+
+struct output_t {
+  FILE *out;
+  bool geojson;
+  unsigned long points;
+};
+
+double unix_time(const track_point_t &p) {
+  return GPS_UNIX_OFFSET + p.week * 604800.0 + p.tow_ms / 1000.0 - GPS_LEAP_SECONDS;
+}
+
+void write_point(const track_point_t &p, void *ctx) {
+  output_t &o = *(output_t *)ctx;
+  if (o.geojson) {
+    fprintf(o.out, "%s\n    {\"type\": \"Feature\", \"geometry\": {\"type\": \"Point\", \"coordinates\": [%.7f, %.7f, %.3f]}, "
+            "\"properties\": {\"time\": %.3f, \"hAcc\": %.3f, \"fixType\": %d, \"carrSoln\": %d, \"numSV\": %d}}",
+            o.points ? "," : "", p.lon * 1e-7, p.lat * 1e-7, p.height / 1000.0,
+            unix_time(p), p.hAcc / 1000.0, p.status & 0x07, p.status >> 3, p.numSV);
+  } else {
+    fprintf(o.out, "%u,%.3f,%.3f,%.7f,%.7f,%.3f,%.3f,%d,%d,%d\n", p.week, p.tow_ms / 1000.0, unix_time(p),
+            p.lat * 1e-7, p.lon * 1e-7, p.height / 1000.0, p.hAcc / 1000.0, p.status & 0x07, p.status >> 3, p.numSV);
+  }
+  o.points++;
+}
+
+int main(int argc, char **argv) {
+  output_t o = {stdout, false, 0};
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--geojson") == 0) o.geojson = true;
+    else path = argv[i];
+  }
+  if (!path) {
+    fprintf(stderr, "usage: %s [--geojson] TRACK.TRK\n", argv[0]);
+    return 2;
+  }
+  FILE *in = fopen(path, "rb");
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+
+  if (o.geojson) fprintf(o.out, "{\"type\": \"FeatureCollection\", \"features\": [");
+  else fprintf(o.out, "week,tow_s,unix_time,lat,lon,height_m,hacc_m,fix_type,carr_soln,num_sv\n");
+
+  uint8_t block[TRACK_BLOCK_SIZE];
+  unsigned long index = 0, bad = 0;
+  uint32_t seq, expected_seq = 0;
+  while (fread(block, 1, TRACK_BLOCK_SIZE, in) == TRACK_BLOCK_SIZE) {
+    track_block_result_t result = track_decode_block(block, write_point, &o, &seq);
+    if (result == TRACK_BLOCK_OK) {
+      if (index > 0 && seq != expected_seq) fprintf(stderr, "block %lu: sequence %u, expected %u\n", index, seq, expected_seq);
+      expected_seq = seq + 1;
+    } else if (result != TRACK_BLOCK_EMPTY) {
+      fprintf(stderr, "block %lu: %s, skipped\n", index, result == TRACK_BLOCK_BAD_CRC ? "bad CRC" : "not a track block");
+      bad++;
+      expected_seq++;
+    }
+    index++;
+  }
+  fclose(in);
+
+  if (o.geojson) fprintf(o.out, "\n]}\n");
+  fprintf(stderr, "%lu blocks, %lu points, %lu skipped\n", index, o.points, bad);
+  return bad ? 3 : 0;
+}
@@ -0,0 +1,491 @@
+// Load test for the firmware's websocket and page serving with several phones connected.
+//
+//   pio run -e ws_load
+//   .pio/build/ws_load/program [--clients 5] [--pages 2] [--seconds 20] [--profile rover]
+//                              [--max-p99-ms 50] [--max-drop-pct 1] [--max-page-p99-ms 250]
+//                              [--max-cpu-per-client-pct 0] [--json ws_load.json]
+//
+// The firmware runs in the main thread against the stub receivers, loop() back to back like on the
+// board, and gets a PVT epoch at the rate profile's measurement rate. Each websocket client is a
+// thread on a raw socket: it subscribes to the signal table, follows the position telemetry and asks
+// for the root directory listing and a file view every few seconds. Page clients fetch the pages
+// back to back on keep-alive connections. All of them share the firmware's HTTP_MAX_CONNECTIONS.
+//
+// Fan-out latency is from the epoch going into the dispatcher to a client reading the position
+// message it produced, matched on the telemetry sequence number. A sequence number a client never
+// saw is a dropped message, the outbox coalescing a patch for a client that fell behind counts the
+// same. Server CPU is the main thread's CPU time, an idle run without clients is taken off and the
+// rest divided by the number of clients.
+//
+// Exit status 0 when every threshold holds, 1 when one does not, 2 when the run could not start.
+// A threshold of 0 is not checked. Times are the host's, compare runs on the same machine.
+
+#include "../Firmware.h"
+#include "../HostSockets.h"
+#include <HostHeap.h>
+#include <LatencyStats.h>
+#include <SD.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <time.h>
+
+#define SENT_SLOTS 4096 // position messages remembered for matching, a few minutes at 20 Hz
+#define COMMAND_INTERVAL_MS 2000 // per client, alternating directory listing and file view
+#define LOOP_SLEEP_US 200 // between loop() passes, the host has other threads to run
+#define IDLE_SECONDS 2.0
+
+struct load_options_t {
+  int clients = 5;
+  int pages = 2;
+  double seconds = 20;
+  const char *profile = "rover";
+  double max_p99_ms = 50;
+  double max_drop_pct = 1;
+  double max_page_p99_ms = 250;
+  double max_cpu_per_client_pct = 0;
+  const char *json = nullptr;
+};
+
+struct ws_client_result_t {
+  std::vector<uint32_t> fanout_us;
+  std::vector<uint32_t> command_us;
+  uint32_t received = 0; // position messages with a new sequence number
+  uint32_t missed = 0; // sequence numbers skipped between them
+  uint64_t bytes = 0;
+  uint32_t binary = 0; // signal table messages
+  bool connected = false;
+  bool closed = false; // the server closed the connection during the run
+};
+
+struct page_client_result_t {
+  std::vector<uint32_t> latency_us;
+  uint32_t failures = 0;
+};
+
+// Dispatch time of each position message, (seq << 32 | us) in slot seq % SENT_SLOTS
+static std::atomic<uint64_t> sent[SENT_SLOTS];
+
+static uint32_t now_us() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t thread_cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Client frames must be masked, the key does not matter
+static bool ws_send_frame(int fd, uint8_t opcode, const std::string &payload) {
+  static const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+  std::string frame;
+  frame += (char)(0x80 | opcode);
+  if (payload.size() < 126) {
+    frame += (char)(0x80 | payload.size());
+  } else {
+    frame += (char)(0x80 | 126);
+    frame += (char)(payload.size() >> 8);
+    frame += (char)(payload.size() & 0xff);
+  }
+  frame.append((const char *)mask, 4);
+  for (size_t i = 0; i < payload.size(); i++) frame += (char)(payload[i] ^ mask[i % 4]);
+  return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == (ssize_t)frame.size();
+}
+
+static int ws_connect(uint16_t port, std::string &rest) {
+  int fd = connect_to(port);
+  if (fd < 0) return -1;
+  const char *upgrade = "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+  if (send(fd, upgrade, strlen(upgrade), MSG_NOSIGNAL) != (ssize_t)strlen(upgrade)) {
+    close(fd);
+    return -1;
+  }
+  rest.clear();
+  char chunk[4096];
+  size_t header_end;
+  while ((header_end = rest.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      close(fd);
+      return -1;
+    }
+    rest.append(chunk, n);
+  }
+  if (rest.compare(0, 12, "HTTP/1.1 101") != 0) {
+    close(fd);
+    return -1;
+  }
+  rest.erase(0, header_end + 4); // frames that came in with the handshake
+  return fd;
+}
+
+static void handle_text(const std::string &message, uint32_t at, uint32_t &command_sent, ws_client_result_t &r, bool &have_seq, uint32_t &last_seq) {
+  if (message.compare(0, 11, "{\"t\":0,\"q\":") == 0) { // WS_TOPIC_POSITION, keyframe or patch
+    uint32_t seq = strtoul(message.c_str() + 11, nullptr, 10);
+    if (have_seq && seq <= last_seq) return; // a keyframe on request repeats the last sequence number
+    if (have_seq) r.missed += seq - last_seq - 1;
+    have_seq = true;
+    last_seq = seq;
+    r.received++;
+    uint64_t slot = sent[seq % SENT_SLOTS].load(std::memory_order_acquire);
+    if (slot >> 32 == seq) r.fanout_us.push_back(at - (uint32_t)slot);
+    return;
+  }
+  // file replies are broadcast, the first one after a request answers it as far as this client can tell
+  if (command_sent && (message.find("\"update_view\":\"file_list\"") != std::string::npos ||
+                       message.find("\"update_view\":\"show_file_content\"") != std::string::npos)) {
+    r.command_us.push_back(at - command_sent);
+    command_sent = 0;
+  }
+}
+
+// Splits frames off the front of in, answers pings, false on a close frame
+static bool handle_frames(int fd, std::string &in, uint32_t at, uint32_t &command_sent, ws_client_result_t &r, bool &have_seq, uint32_t &last_seq) {
+  for (;;) {
+    const uint8_t *p = (const uint8_t *)in.data();
+    size_t available = in.size();
+    if (available < 2) return true;
+    uint8_t opcode = p[0] & 0x0f;
+    uint64_t length = p[1] & 0x7f;
+    size_t pos = 2;
+    if (length == 126) {
+      if (available < 4) return true;
+      length = (uint64_t)p[2] << 8 | p[3];
+      pos = 4;
+    } else if (length == 127) {
+      if (available < 10) return true;
+      length = 0;
+      for (int b = 0; b < 8; b++) length = length << 8 | p[2 + b];
+      pos = 10;
+    }
+    if (available < pos + length) return true;
+    std::string payload = in.substr(pos, length);
+    in.erase(0, pos + length);
+
+    switch (opcode) {
+    case 0x1:
+      handle_text(payload, at, command_sent, r, have_seq, last_seq);
+      break;
+    case 0x2:
+      r.binary++;
+      break;
+    case 0x8:
+      return false;
+    case 0x9:
+      ws_send_frame(fd, 0xa, payload);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static void run_ws_client(int index, uint16_t port, const std::atomic<bool> &running, ws_client_result_t &r) {
+  std::string in;
+  int fd = ws_connect(port, in);
+  if (fd < 0) return;
+  r.connected = true;
+  ws_send_frame(fd, 0x1, "{\"cmd\":\"signals\",\"action\":\"SUBSCRIBE\"}");
+
+  bool have_seq = false;
+  uint32_t last_seq = 0, command_sent = 0, commands = 0;
+  uint32_t next_command = now_us() + 1000u * (500 + index * COMMAND_INTERVAL_MS / 8); // staggered
+  char chunk[16384];
+  while (running) {
+    uint32_t now = now_us();
+    if ((int32_t)(now - next_command) >= 0) {
+      const char *command = commands++ % 2 ? "{\"cmd\":\"show_file\",\"path\":\"/ws_load_view.txt\"}" : "{\"cmd\":\"open_dir\",\"path\":\"/\"}";
+      if (!ws_send_frame(fd, 0x1, command)) break;
+      command_sent = now;
+      next_command = now + 1000u * COMMAND_INTERVAL_MS;
+    }
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 20) <= 0) continue;
+    ssize_t n = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n <= 0) {
+      r.closed = true;
+      break;
+    }
+    r.bytes += n;
+    in.append(chunk, n);
+    if (!handle_frames(fd, in, now_us(), command_sent, r, have_seq, last_seq)) {
+      r.closed = true;
+      break;
+    }
+  }
+  close(fd);
+}
+
+static void run_page_client(int index, uint16_t port, const std::atomic<bool> &running, page_client_result_t &r) {
+  static const char *paths[] = {"/", "/start_survey", "/device_files", "/gnss_info"};
+  std::string buffer;
+  int fd = -1;
+  for (uint32_t i = index; running; i++) {
+    if (fd < 0) fd = connect_to(port);
+    uint32_t begin = now_us();
+    if (fd >= 0 && fetch(fd, paths[i % 4], buffer)) {
+      r.latency_us.push_back(now_us() - begin);
+      continue;
+    }
+    r.failures++;
+    if (fd >= 0) close(fd);
+    fd = -1;
+    usleep(1000);
+  }
+  if (fd >= 0) close(fd);
+}
+
+// setup(), then loop() through the boot sequencer until the first epoch finishes it
+static bool boot_firmware() {
+  UBX_NAV_PVT_data_t &pvt = HAM_GNSS.host.pvt;
+  pvt.iTOW = 302400000;
+  pvt.year = 2024;
+  pvt.month = 5;
+  pvt.day = 1;
+  pvt.hour = 12;
+  pvt.valid.all = 0x03;
+  pvt.fixType = 3;
+  pvt.flags.bits.carrSoln = 2;
+  pvt.numSV = 24;
+  pvt.lat = 374567890;
+  pvt.lon = -1223456789;
+  pvt.height = 12345;
+  pvt.hMSL = 45678;
+  pvt.hAcc = 14;
+  pvt.vAcc = 21;
+  pvt.pDOP = 120;
+  HAM_GNSS.host.high_res_lat = pvt.lat;
+  HAM_GNSS.host.high_res_lon = pvt.lon;
+
+  setup();
+  for (int i = 0; i < 10 && !gnss_ready(); i++) {
+    delay(600); // past the sequencer's retry spacing
+    loop();
+    if (gnss_ready()) HAM_GNSS.host_pvt(); // receivers configured, the first epoch ends the boot
+  }
+  return gnss_ready();
+}
+
+// 24 satellites with one signal each, C/N0 moving so the signal stream has rows to send
+static void feed_signals(uint32_t epoch) {
+  UBX_NAV_SAT_data_t &sat = HAM_GNSS.host.nav_sat;
+  UBX_NAV_SIG_data_t &sig = HAM_GNSS.host.nav_sig;
+  sat.header.numSvs = 24;
+  sig.header.numSigs = 24;
+  for (int i = 0; i < 24; i++) {
+    sat.blocks[i] = {};
+    sat.blocks[i].gnssId = i / 8 * 2;
+    sat.blocks[i].svId = i % 8 + 1;
+    sat.blocks[i].elev = 10 + i * 3;
+    sat.blocks[i].azim = i * 15;
+    sat.blocks[i].cno = 30 + (i + epoch) % 8;
+    sat.blocks[i].flags.bits.svUsed = 1;
+    sig.blocks[i] = {};
+    sig.blocks[i].gnssId = sat.blocks[i].gnssId;
+    sig.blocks[i].svId = sat.blocks[i].svId;
+    sig.blocks[i].cno = sat.blocks[i].cno;
+    sig.blocks[i].sigFlags.bits.prUsed = 1;
+  }
+  HAM_GNSS.host_nav_sat();
+  HAM_GNSS.host_nav_sig();
+}
+
+// The board's main loop for the given time, epochs at the profile's rate. Returns CPU time used, us.
+static uint64_t serve(double seconds, uint16_t meas_rate_ms) {
+  UBX_NAV_PVT_data_t &pvt = HAM_GNSS.host.pvt;
+  uint64_t cpu_start = thread_cpu_us();
+  uint32_t start = now_us(), next_epoch = start, next_signals = start, epochs = 0;
+  while (now_us() - start < seconds * 1e6) {
+    loop();
+    uint32_t now = now_us();
+    if ((int32_t)(now - next_epoch) >= 0) {
+      pvt.iTOW += meas_rate_ms;
+      pvt.lat += 7; // moving, so every epoch has a patch to send
+      pvt.lon += 3;
+      uint32_t seq = position_telemetry.seq();
+      HAM_GNSS.host_pvt();
+      if (position_telemetry.seq() != seq) {
+        seq = position_telemetry.seq();
+        sent[seq % SENT_SLOTS].store((uint64_t)seq << 32 | now, std::memory_order_release);
+      }
+      next_epoch += 1000u * meas_rate_ms;
+      epochs++;
+    }
+    if ((int32_t)(now - next_signals) >= 0) {
+      feed_signals(epochs);
+      next_signals += 1000000;
+    }
+    usleep(LOOP_SLEEP_US);
+  }
+  return thread_cpu_us() - cpu_start;
+}
+
+static void add_all(LatencyStats &stats, const std::vector<uint32_t> &samples) {
+  for (uint32_t us : samples) stats.add(us);
+}
+
+static bool check(const char *name, double value, double limit, bool &pass) {
+  if (limit <= 0 || value <= limit) return true;
+  fprintf(stderr, "FAIL %s %.2f above %.2f\n", name, value, limit);
+  pass = false;
+  return false;
+}
+
+static bool parse_options(int argc, char **argv, load_options_t &o) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) return false;
+    if (strcmp(arg, "--clients") == 0) o.clients = atoi(value);
+    else if (strcmp(arg, "--pages") == 0) o.pages = atoi(value);
+    else if (strcmp(arg, "--seconds") == 0) o.seconds = atof(value);
+    else if (strcmp(arg, "--profile") == 0) o.profile = value;
+    else if (strcmp(arg, "--max-p99-ms") == 0) o.max_p99_ms = atof(value);
+    else if (strcmp(arg, "--max-drop-pct") == 0) o.max_drop_pct = atof(value);
+    else if (strcmp(arg, "--max-page-p99-ms") == 0) o.max_page_p99_ms = atof(value);
+    else if (strcmp(arg, "--max-cpu-per-client-pct") == 0) o.max_cpu_per_client_pct = atof(value);
+    else if (strcmp(arg, "--json") == 0) o.json = value;
+    else return false;
+    i++;
+  }
+  return o.clients > 0 && o.pages >= 0 && o.clients + o.pages <= HTTP_MAX_CONNECTIONS && o.clients <= WS_OUTBOX_MAX_CLIENTS && o.seconds > 0;
+}
+
+int main(int argc, char **argv) {
+  load_options_t o;
+  if (!parse_options(argc, argv, o)) {
+    fprintf(stderr, "usage: %s [--clients N] [--pages N] [--seconds S] [--profile NAME] [--max-p99-ms X] [--max-drop-pct X]\n"
+                    "       [--max-page-p99-ms X] [--max-cpu-per-client-pct X] [--json FILE]\n"
+                    "clients + pages at most %d, the server's connection limit\n",
+            argv[0], HTTP_MAX_CONNECTIONS);
+    return 2;
+  }
+  int profile = find_rate_profile(o.profile);
+  if (profile < 0) {
+    fprintf(stderr, "unknown rate profile %s\n", o.profile);
+    return 2;
+  }
+
+  char sd_root[] = "/tmp/ham_gnss_ws_load_XXXXXX";
+  if (!mkdtemp(sd_root)) {
+    perror("mkdtemp");
+    return 2;
+  }
+  host_sd_root(sd_root);
+  host_serial_quiet(true);
+  host_skip_delays(true);
+  if (!boot_firmware()) {
+    fprintf(stderr, "firmware did not finish booting against the stub receivers\n");
+    return 2;
+  }
+  host_skip_delays(false); // from here on the firmware runs in real time
+  set_rate_profile(profile);
+  uint16_t meas_rate_ms = HAM_GNSS.host.measurement_rate; // CFG-RATE-MEAS as the profile set it
+
+  File view = SD.open("/ws_load_view.txt", FILE_WRITE);
+  for (int i = 1; view.size() < 4096; i++) view.print("GCP" + String(i) + " -1223456789 374567890 12345\n");
+  view.close();
+
+  http.stop();
+  if (!http.begin(0)) {
+    perror("listen");
+    return 2;
+  }
+  uint16_t port = http.port();
+
+  uint64_t idle_cpu_us = serve(IDLE_SECONDS, meas_rate_ms);
+
+  host_heap_threaded(true); // the client threads allocate too
+  std::atomic<bool> running(true);
+  std::vector<ws_client_result_t> ws_results(o.clients);
+  std::vector<page_client_result_t> page_results(o.pages);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < o.clients; c++) threads.emplace_back(run_ws_client, c, port, std::cref(running), std::ref(ws_results[c]));
+  for (int c = 0; c < o.pages; c++) threads.emplace_back(run_page_client, c, port, std::cref(running), std::ref(page_results[c]));
+
+  uint64_t load_cpu_us = serve(o.seconds, meas_rate_ms);
+  uint32_t coalesced = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (ws_outbox.connected(i)) coalesced += ws_outbox.stats(i).coalesced;
+  }
+  running = false;
+  for (int i = 0; i < 50; i++) { // the clients leave within a poll interval
+    loop();
+    usleep(1000);
+  }
+  for (std::thread &t : threads) t.join();
+
+  LatencyStats fanout, command, page;
+  uint32_t received = 0, missed = 0, binary = 0, connected = 0, closed = 0, page_failures = 0;
+  uint64_t bytes = 0;
+  for (const ws_client_result_t &r : ws_results) {
+    add_all(fanout, r.fanout_us);
+    add_all(command, r.command_us);
+    received += r.received;
+    missed += r.missed;
+    binary += r.binary;
+    bytes += r.bytes;
+    connected += r.connected;
+    closed += r.closed;
+  }
+  for (const page_client_result_t &r : page_results) {
+    add_all(page, r.latency_us);
+    page_failures += r.failures;
+  }
+  double drop_pct = received + missed ? 100.0 * missed / (received + missed) : 100;
+  double idle_cpu_pct = 100.0 * idle_cpu_us / (IDLE_SECONDS * 1e6);
+  double load_cpu_pct = 100.0 * load_cpu_us / (o.seconds * 1e6);
+  double cpu_per_client_pct = (load_cpu_pct - idle_cpu_pct) / o.clients;
+  double pages_per_s = page.count() / o.seconds;
+
+  printf("%d websocket clients, %d page clients, %.0f s, profile %s (%u ms epochs)\n", o.clients, o.pages, o.seconds, o.profile, meas_rate_ms);
+  printf("%-22s %8s %8s %8s %8s %8s\n", "latency", "count", "p50 us", "p99 us", "max us", "");
+  printf("%-22s %8u %8u %8u %8u\n", "position fan-out", fanout.count(), fanout.percentile(50), fanout.percentile(99), fanout.max());
+  printf("%-22s %8u %8u %8u %8u\n", "file commands", command.count(), command.percentile(50), command.percentile(99), command.max());
+  printf("%-22s %8u %8u %8u %8u %6.1f/s\n", "pages", page.count(), page.percentile(50), page.percentile(99), page.max(), pages_per_s);
+  printf("position messages: %u received, %u dropped (%.2f%%), %u coalesced by the outbox\n", received, missed, drop_pct, coalesced);
+  printf("signal table messages: %u, websocket bytes: %llu\n", binary, (unsigned long long)bytes);
+  printf("clients: %u connected, %u closed by the server, %u page retries\n", connected, closed, page_failures);
+  printf("server CPU: %.1f%% idle, %.1f%% loaded, %.2f%% per client\n", idle_cpu_pct, load_cpu_pct, cpu_per_client_pct);
+
+  bool pass = true;
+  check("position fan-out p99 ms", fanout.percentile(99) / 1000.0, o.max_p99_ms, pass);
+  check("dropped position messages %", drop_pct, o.max_drop_pct, pass);
+  check("page p99 ms", page.percentile(99) / 1000.0, o.max_page_p99_ms, pass);
+  check("server CPU per client %", cpu_per_client_pct, o.max_cpu_per_client_pct, pass);
+  if (connected < (uint32_t)o.clients || closed > 0) {
+    fprintf(stderr, "FAIL %u of %d websocket clients connected, %u closed by the server\n", connected, o.clients, closed);
+    pass = false;
+  }
+
+  if (o.json) {
+    FILE *out = fopen(o.json, "w");
+    if (out) {
+      fprintf(out, "{\"clients\":%d,\"pages\":%d,\"seconds\":%.1f,\"profile\":\"%s\",\n", o.clients, o.pages, o.seconds, o.profile);
+      fprintf(out, " \"fanout_us\":{\"count\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u},\n", fanout.count(), fanout.percentile(50), fanout.percentile(99), fanout.max());
+      fprintf(out, " \"command_us\":{\"count\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u},\n", command.count(), command.percentile(50), command.percentile(99), command.max());
+      fprintf(out, " \"page_us\":{\"count\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"per_s\":%.1f,\"retries\":%u},\n", page.count(), page.percentile(50), page.percentile(99),
+              page.max(), pages_per_s, page_failures);
+      fprintf(out, " \"position_received\":%u,\"position_dropped\":%u,\"drop_pct\":%.3f,\"coalesced\":%u,\"signal_messages\":%u,\"ws_bytes\":%llu,\n", received, missed,
+              drop_pct, coalesced, binary, (unsigned long long)bytes);
+      fprintf(out, " \"connected\":%u,\"closed\":%u,\"cpu_idle_pct\":%.2f,\"cpu_load_pct\":%.2f,\"cpu_per_client_pct\":%.3f,\"pass\":%s}\n", connected, closed,
+              idle_cpu_pct, load_cpu_pct, cpu_per_client_pct, pass ? "true" : "false");
+      if (fclose(out) != 0) fprintf(stderr, "could not write %s\n", o.json);
+    } else {
+      fprintf(stderr, "could not write %s\n", o.json);
+    }
+  }
+
+  http.stop();
+  std::string cleanup = std::string("rm -rf ") + sd_root;
+  if (system(cleanup.c_str()) != 0) fprintf(stderr, "could not remove %s\n", sd_root);
+  printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
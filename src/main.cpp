@@ -1,18 +1,305 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <Adafruit_SSD1306.h>
 #include <Wire.h>
 #include <SparkFun_u-blox_GNSS_v3.h>
-#include <WebSocketsServer.h>
 #include <ArduinoJson.h>
 #include <SPI.h>
 #include <SD.h>
+#include <Preferences.h>
+#include <WsOutbox.h>
+#include <EpochHistory.h>
+#include <TrackLog.h>
+#include <RecordLog.h>
+#include <LatencyStats.h>
+#include <Checksum.h>
+#include <BlockCache.h>
+#include <HttpServer.h>
+#include <TelemetryDelta.h>
+#include <SignalTable.h>
+#include <SolutionMonitor.h>
+#include <EventMarks.h>
+#include <SurveyRecords.h>
+#include <CommandTable.h>
+#include <PointIndex.h>
+#include <ConvergenceTracker.h>
+#include <LogRing.h>
+#include "GnssEpoch.h"
 
 SFE_UBLOX_GNSS HAM_GNSS; // ZED-F9P
 SFE_UBLOX_GNSS HAM_GNSS_L_Band; // NEO-D9S
 
-const uint32_t LBand_frequency = 1556290000; //L-Band Frequency in Hz. get updated frequency from u-blox mqtt protocal eventually
+const uint32_t LBand_frequency = 1556290000; //L-Band Frequency in Hz. Default only, the active value lives in the SPARTN key store
+
+// SPARTN key store. Holds the current and next dynamic keys so the ZED-F9P always has the key for the
+// coming validity period loaded before the boundary. Persisted in NVS and optionally in SPARTN_KEY_FILE.
+struct spartn_key_t {
+  char key[33]; // 16 byte key as hex, empty when unset
+  uint16_t valid_from_wno; // GPS week the key becomes valid
+  uint32_t valid_from_tow; // GPS time of week (s)
+};
+
+#define SPARTN_KEY_FILE "/spartn_keys.txt" // lines of "freq <Hz>" and "key <wno> <tow> <hex>", current key first
+#define SPARTN_KEY_WEEKS 4 // validity of a key when no next key is known
+#define SPARTN_KEY_WARN_DAYS 3 // warn this long before the current key runs out without a next key
+
+spartn_key_t spartn_keys[2] = { // [0] current, [1] next
+  {"d8f33f27fc2afd1db1624d5a45817d71", 2294, 0},
+  {"9a5899dc0b6313245219d303f281db77", 2297, 0},
+};
+uint32_t lband_frequency = LBand_frequency;
+unsigned long spartn_check_previousMillis = 0;
+bool spartn_expiry_warned = false;
+
+// GPS-UTC offset for turning the PVT's UTC date into a GPS week. The receiver's own value is taken
+// from each whole-second epoch (GPS time of week against UTC), this is only the fallback until then.
+#define GPS_UTC_LEAP_SECONDS 18 // since 2017-01-01
+int32_t gps_leap_seconds = GPS_UTC_LEAP_SECONDS;
+
+// SPARTN key store functions
+void load_spartn_store();
+void save_spartn_store();
+bool apply_spartn_keys();
+bool apply_lband_frequency(uint32_t frequency);
+bool set_spartn_keys(const spartn_key_t &current, const spartn_key_t &next);
+bool is_valid_spartn_key(const char *key);
+bool is_valid_spartn_start(int32_t wno, int32_t tow);
+void spartn_key_rollover_check();
+bool utc_seconds_since_gps_epoch(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint32_t *seconds);
+bool gps_week_from_utc(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint16_t *wno, uint32_t *tow);
+
+// Receiver configuration tables. Applied with CFG-VALSET to the RAM and BBR layers so the
+// receivers keep them across resets, and hashed so a boot can skip reconfiguring when nothing changed.
+struct ubx_cfg_item_t {
+  uint32_t key;
+  uint64_t value;
+};
+
+// TX-ready: the ZED-F9P raises a PIO while it has I2C output waiting, the ESP32 reads on the edge
+// instead of polling. The NEO-D9S hands its PMP stream to the ZED-F9P over UART2 and is never read
+// by the ESP32, so only the ZED-F9P gets the pin.
+// Neither default has been checked against the board's wiring, set both with build flags
+// (-DGNSS_TXREADY_PIO=n -DTXREADY_GPIO=n) for the actual trace. With a wrong pair no edge ever
+// arrives and reads fall back to polling after TXREADY_SILENT_MS, see ublox_read_due().
+#ifndef GNSS_TXREADY_PIO
+#define GNSS_TXREADY_PIO 6 // receiver PIO brought out as TX_READY, depends on the module, see its integration manual
+#endif
+#ifndef TXREADY_GPIO
+#define TXREADY_GPIO 4 // ESP32 input wired to it, pulled down so an unwired pin stays quiet
+#endif
+
+ubx_cfg_item_t lband_cfg[] = { // NEO-D9S
+  {UBLOX_CFG_PMP_CENTER_FREQUENCY, LBand_frequency}, // Default 1539812500 Hz  32bit val
+  {UBLOX_CFG_PMP_SEARCH_WINDOW, 2200}, // Default 2200 Hz
+  {UBLOX_CFG_PMP_USE_SERVICE_ID, 0}, // Default 1
+  {UBLOX_CFG_PMP_SERVICE_ID, 21845}, //50821
+  {UBLOX_CFG_PMP_DATA_RATE, 2400}, // Default 2400 bps
+  {UBLOX_CFG_PMP_USE_DESCRAMBLER, 1}, // Default 1
+  {UBLOX_CFG_PMP_DESCRAMBLER_INIT, 26969}, // Default 23560
+  {UBLOX_CFG_PMP_USE_PRESCRAMBLING, 0}, // Default 0
+  {UBLOX_CFG_PMP_UNIQUE_WORD, 16238547128276412563ull}, // 0xE15AE893E15AE893
+  // Configure NEO-D9S Baud rate to match ZED-F9P's baud rate
+  {UBLOX_CFG_UART2_BAUDRATE, 38400}, // match baudrate with ZED default
+  {UBLOX_CFG_UART2OUTPROT_UBX, 1}, // Enable UBX output on UART2
+  {UBLOX_CFG_MSGOUT_UBX_RXM_PMP_UART2, 1}, // Output UBX-RXM-PMP on UART2
+};
+
+ubx_cfg_item_t gnss_cfg[] = { // ZED-F9P
+  {UBLOX_CFG_I2CINPROT_UBX, 1}, //Be sure SPARTN input is enabled
+  {UBLOX_CFG_I2CINPROT_NMEA, 1},
+  {UBLOX_CFG_I2CINPROT_RTCM3X, 1},
+  {UBLOX_CFG_I2CINPROT_SPARTN, 1},
+  {UBLOX_CFG_NAVHPG_DGNSSMODE, SFE_UBLOX_DGNSS_MODE_FIXED}, // set the differential mode - ambiguties
+  {UBLOX_CFG_SPARTN_USE_SOURCE, 1}, // use LBAND PMP message
+  {UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1005_I2C, 1}, // enable message output via i2c every second
+  {UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1074_I2C, 1},
+  {UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1094_I2C, 1},
+  {UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1124_I2C, 1},
+  {UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1230_I2C, 10}, // enable message 1230 every 10 seconds
+  {UBLOX_CFG_TXREADY_ENABLED, 1}, // raise TX_READY while I2C output is waiting, see ublox_read_due()
+  {UBLOX_CFG_TXREADY_POLARITY, 0}, // active high
+  {UBLOX_CFG_TXREADY_PIN, GNSS_TXREADY_PIO},
+  {UBLOX_CFG_TXREADY_THRESHOLD, 1}, // 8 bytes
+  {UBLOX_CFG_TXREADY_INTERFACE, 0}, // I2C
+};
+
+#define LBAND_CFG_COUNT (sizeof(lband_cfg) / sizeof(lband_cfg[0]))
+#define GNSS_CFG_COUNT (sizeof(gnss_cfg) / sizeof(gnss_cfg[0]))
+#define RECEIVER_CFG_VERSION 2 // bump to force a reconfiguration on the next boot
+
+// receiver configuration functions
+uint32_t receiver_cfg_hash();
+bool apply_receiver_cfg(SFE_UBLOX_GNSS &receiver, const ubx_cfg_item_t *items, size_t count);
+bool receiver_cfg_matches(SFE_UBLOX_GNSS &receiver, const ubx_cfg_item_t *items, size_t count);
+
+// Epoch stream. NAV-PVT arrives through the auto-PVT callback and is copied into latest_epoch (a
+// gnss_epoch_t, GnssEpoch.h), then handed to each consumer at the consumer's own decimation of the
+// navigation rate.
+enum epoch_consumer_id_t {
+  EPOCH_WS,
+  EPOCH_OLED,
+  EPOCH_LOG,
+  EPOCH_HISTORY,
+  EPOCH_STAKEOUT,
+  EPOCH_CONSUMER_COUNT
+};
+
+struct epoch_consumer_t {
+  const char *name;
+  void (*handle)(const gnss_epoch_t &epoch); // nullptr until the consumer exists
+  uint8_t decimation; // every Nth epoch
+  uint32_t calls;
+  uint32_t busy_us; // time spent in handle() this stats window
+};
+
+// Recent epoch history in RAM. Sent to a client as a binary burst when it connects so tracks and
+// convergence plots show up immediately, and down-sampled on request with the history command.
+#define HISTORY_PSRAM_BYTES (1024 * 1024) // ~140k epochs when the board has PSRAM
+#define HISTORY_DRAM_BYTES (48 * 1024) // ~6.5k epochs otherwise
+#define HISTORY_BURST_BYTES (24 * 1024) // newest blocks sent on connect
+#define HISTORY_CHUNK_BYTES (8 * 1024) // binary message size
+#define HISTORY_QUERY_BYTES (8 * 1024) // scratch for down-sampled query results
+#define HISTORY_MSG_HEADER 10 // u8 'H', u8 type, u16 seq, u32 now_ms, u16 flags (bit0 = last chunk)
+#define HISTORY_MSG_BURST 1
+#define HISTORY_MSG_QUERY 2
+
+EpochHistory *epoch_history = nullptr;
+
+void init_epoch_history();
+void send_history_burst(uint8_t client);
+void send_history_query(uint8_t client, uint32_t from_s, uint32_t to_s, uint32_t step_s);
+void send_history_blocks(uint8_t client, const EpochHistory &history, uint8_t type, size_t skip_bytes);
+
+// Rate profiles. Switched live with the rate_profile websocket command and remembered in NVS.
+struct rate_profile_t {
+  const char *name;
+  uint16_t meas_rate_ms; // CFG-RATE-MEAS, 1/2/5/10/20 Hz
+  uint8_t decimation[EPOCH_CONSUMER_COUNT]; // websocket, OLED, SD log, RAM history, stakeout
+};
+
+const rate_profile_t rate_profiles[] = {
+  {"survey", 1000, {1, 1, 1, 1, 1}},
+  {"rover", 200, {1, 5, 1, 5, 1}},
+  {"stakeout", 100, {2, 5, 1, 10, 1}}, // 10 Hz nav, 5 Hz to the dash, 2 Hz to the OLED, 1 Hz history, 10 Hz offsets
+  {"fast", 50, {4, 10, 1, 20, 1}},
+  {"low_power", 1000, {2, 5, 10, 1, 1}},
+};
+#define RATE_PROFILE_COUNT (sizeof(rate_profiles) / sizeof(rate_profiles[0]))
+#define UBLOX_POLL_LEAD_MS 10 // start polling this long before the next epoch is due
+#define UBLOX_POLL_FAST_MS 5 // poll interval while an epoch is due
+#define RATE_STATS_INTERVAL 5000 // ms
+
+void epoch_ws_telemetry(const gnss_epoch_t &epoch);
+void epoch_oled_status(const gnss_epoch_t &epoch);
+void epoch_history_add(const gnss_epoch_t &epoch);
+void epoch_track_log(const gnss_epoch_t &epoch);
+void epoch_stakeout(const gnss_epoch_t &epoch);
+
+epoch_consumer_t epoch_consumers[EPOCH_CONSUMER_COUNT] = {
+  {"ws", epoch_ws_telemetry, 1, 0, 0},
+  {"oled", epoch_oled_status, 1, 0, 0},
+  {"log", epoch_track_log, 1, 0, 0},
+  {"history", epoch_history_add, 1, 0, 0},
+  {"stakeout", epoch_stakeout, 1, 0, 0},
+};
+
+gnss_epoch_t latest_epoch;
+uint32_t epoch_count = 0;
+uint8_t rate_profile = 0;
+unsigned long ublox_next_poll_ms = 0;
+unsigned long rate_stats_previousMillis = 0;
+uint32_t ublox_polls = 0; // checkUblox() calls this stats window
+uint32_t ublox_bus_us = 0; // time spent in checkUblox()
+uint32_t ublox_callback_us = 0; // time spent in checkCallbacks(), consumers included
+uint32_t ublox_empty_polls = 0; // checkUblox() calls made while TX_READY was low, nothing to read
+uint32_t rate_stats_epochs = 0;
+unsigned long display_hold_until = 0; // event messages on the OLED are not overwritten by the live view before this
+
+// epoch stream functions
+void new_pvt_epoch(UBX_NAV_PVT_data_t *pvt);
+void dispatch_epoch(const gnss_epoch_t &epoch);
+void update_gps_leap_seconds(const gnss_epoch_t &epoch);
+int find_rate_profile(const char *name); // index into rate_profiles, -1 when there is none by that name
+bool set_rate_profile(uint8_t profile);
+bool ublox_poll_due(unsigned long now);
+void send_rate_stats();
+
+// Receiver reads. TXREADY drains the bus when the pin says data is waiting, with a slow safety poll,
+// and falls back to the epoch-timed poll when the pin has been silent (not wired). POLL is the
+// epoch-timed poll alone. The interrupt is attached in both modes, so both measure latency from the
+// first TX_READY edge to the NAV-PVT consumer, and the gain can be compared with the ublox_read command.
+enum ublox_read_mode_t { UBLOX_READ_POLL, UBLOX_READ_TXREADY };
+#define TXREADY_SAFETY_POLL_MS 1000
+#define TXREADY_SILENT_MS 3000 // no edge for this long, poll as if the pin was not there
+
+ublox_read_mode_t ublox_read_mode = UBLOX_READ_TXREADY;
+volatile bool txready_pending = false;
+volatile uint32_t txready_since_us = 0; // first edge since the last read
+volatile uint32_t txready_edges = 0;
+unsigned long txready_last_edge_ms = 0;
+uint32_t ublox_ready_us = 0; // edge time of the data the current read picked up
+bool ublox_ready_valid = false;
+LatencyStats ublox_latency; // TX_READY edge to new_pvt_epoch(), us, per rate stats window
+
+void IRAM_ATTR txready_isr();
+void init_txready();
+bool ublox_read_due(unsigned long now);
+void read_ublox();
+
+// RTK solution monitor (SolutionMonitor.h). Runs on every epoch ahead of the consumers, a drop from
+// fixed to float, to no carrier solution, past the hAcc limit or to stale corrections is pushed to the
+// dash and the OLED on the epoch it happens and kept in the survey log, and restarts batch averaging.
+SolutionMonitor solution_monitor;
+
+void check_solution(const gnss_epoch_t &epoch);
+void report_rtk_event(uint8_t kind, const solution_event_t &event, const gnss_epoch_t &epoch, const String &point);
+void send_rtk_events(uint8_t client_num);
+
+// Boot sequencer. setup() only starts the things that cannot block (display, WiFi, web, SD),
+// the receivers are brought up one stage per loop() pass so the web dash is served meanwhile.
+enum boot_stage_t {
+  BOOT_GNSS_CONNECT,
+  BOOT_LBAND_CONNECT,
+  BOOT_RECEIVER_CONFIG,
+  BOOT_WAIT_TELEMETRY,
+  BOOT_DONE
+};
+
+boot_stage_t boot_stage = BOOT_GNSS_CONNECT;
+unsigned long boot_stage_ms[BOOT_DONE + 1]; // millis() when each stage finished
+unsigned long boot_retry_ms = 0;
+bool boot_cfg_reused = false; // true when the stored fingerprint matched and reconfiguration was skipped
+Preferences prefs; // NVS, namespace "ham_gnss"
+
+void boot_sequencer_step();
+bool gnss_ready();
+void send_boot_report(int client_num);
+
+// Receiver status cache. Page and websocket handlers never query the receivers, each getter can be a
+// blocking poll on the I2C bus. Identity (module, firmware, protocol, firmware type) is read once when
+// the boot sequencer connects a receiver, position and solution come from the last NAV-PVT epoch
+// (latest_epoch), and the NEO-D9S antenna state from the MON-HW it pushes every RECEIVER_STATUS_INTERVAL,
+// picked up from its I2C output by loop() at the same interval.
+#define RECEIVER_STATUS_INTERVAL 10000 // ms
+#define LBAND_MON_HW_EVERY (RECEIVER_STATUS_INTERVAL / 1000) // CFG-MSGOUT rate, the NEO-D9S outputs once a second
+
+struct receiver_identity_t {
+  char module[16];
+  char firmware_type[8];
+  uint8_t firmware_high, firmware_low;
+  uint8_t protocol_high, protocol_low;
+  bool valid; // false until the boot sequencer has read it
+};
+
+receiver_identity_t gnss_identity = {};
+receiver_identity_t lband_identity = {};
+uint8_t lband_antenna_status = 0; // MON-HW aStatus, 0 init .. 4 open
+unsigned long receiver_status_previousMillis = 0;
+
+void read_receiver_identity(SFE_UBLOX_GNSS &receiver, receiver_identity_t &identity);
+void new_lband_mon_hw(UBX_MON_HW_data_t *hw);
+void refresh_receiver_status();
+String receiver_identity_HTML(const char *label, const receiver_identity_t &identity);
 
 // OLED Display Setup
 #define SCREEN_WIDTH 128 // OLED Width in pixels
@@ -38,9 +325,9 @@ const char* password = "pass1234";
 
 // SD functions
 void save_survey_observation(String gcp_index);
+bool survey_file_empty();
 void create_file(String file_name);
 void delete_file(String file_name);
-void write_to_file(String new_file_content);
 void set_save_file(String file_dir);
 
 //Data Logging variables
@@ -48,20 +335,95 @@ String  working_directory = "/test_survey04.txt";
 String  file_view_directory = "/";
 String datum = "WSG : 84\n"; // might want to turn this into an enum also planning to use the NAD83 datum
 
-WebServer server(80); // Create server on port 80
-WebSocketsServer webSocket = WebSocketsServer(81);
+// Pages and the websocket (/ws) share port 80, service() in loop() never blocks on a client
+HttpServer http([]() -> uint32_t { return millis(); });
+static_assert(HTTP_MAX_CONNECTIONS <= WS_OUTBOX_MAX_CLIENTS, "websocket client numbers are connection slots");
 
 /*IP Address details */
 IPAddress local_ip(192,168,1,1);
 IPAddress gateway(192,168,1,1);
 IPAddress subnet(255,255,255,0);
 
-void handle_NotFound();
-void handle_OnConnect();
-void handle_start_survey();
-void handle_view_survey_log();
-void handle_gnss_info();
-void handle_device_files();
+void handle_NotFound(const http_request_t &request);
+void handle_OnConnect(const http_request_t &request);
+void handle_start_survey(const http_request_t &request);
+void handle_view_survey_log(const http_request_t &request);
+void handle_gnss_info(const http_request_t &request);
+void handle_device_files(const http_request_t &request);
+void handle_download(const http_request_t &request);
+void send_page(const http_request_t &request, const String &page);
+
+// Websocket outbound queues. Nothing calls http.ws_send() directly, messages are queued per
+// client and sent from loop() under WS_SERVICE_BUDGET_US so one slow phone cannot stall the rest.
+#define WS_SERVICE_BUDGET_US 3000
+#define WS_STATS_INTERVAL 5000 // ms between per-client lag reports
+
+enum ws_topic_t { // telemetry topics, each coalesces to its latest message
+  WS_TOPIC_POSITION,
+  WS_TOPIC_SURVEY,
+  WS_TOPIC_BATCH,
+  WS_TOPIC_WS_STATS,
+  WS_TOPIC_RATE_STATS,
+  WS_TOPIC_TRACK_LOG,
+  WS_TOPIC_SIGNALS,
+  WS_TOPIC_EVENT_MARKS,
+  WS_TOPIC_STAKEOUT,
+  WS_TOPIC_LOG,
+  WS_TOPIC_COUNT
+};
+static_assert(WS_TOPIC_COUNT <= WS_OUTBOX_TOPICS, "each telemetry topic needs its own outbox slot");
+
+ws_send_result_t ws_transport_send(uint8_t client, const char *data, size_t length, bool binary, void *ctx);
+void ws_transport_evict(uint8_t client, const char *reason, void *ctx);
+uint32_t ws_clock_us();
+WsOutbox ws_outbox(ws_transport_send, ws_transport_evict, ws_clock_us);
+unsigned long ws_stats_previousMillis = 0;
+
+void ws_broadcast(const String &message, ws_priority_t priority = WS_CRITICAL, uint8_t topic = 0);
+void ws_send(uint8_t client, const String &message, ws_priority_t priority = WS_CRITICAL, uint8_t topic = 0);
+
+// Position and survey telemetry only send the fields that changed, see TelemetryDelta.h
+#define TELEMETRY_KEYFRAME_MS 10000
+
+enum position_field_t { POSITION_LATITUDE, POSITION_LONGITUDE, POSITION_ALTITUDE, POSITION_ALTITUDE_MSL, POSITION_HACC, POSITION_FIELDS };
+const char *const position_field_names[POSITION_FIELDS] = {"latitude", "longitude", "altitude", "altitude_msl", "hAcc"};
+
+enum survey_field_t {
+  SURVEY_STATUS, SURVEY_MSG, SURVEY_TIME_ELAPSED, SURVEY_ACCURACY, SURVEY_LAT, SURVEY_LONG, SURVEY_ALTITUDE,
+  SURVEY_ALTITUDE_MSL, SURVEY_MSL, SURVEY_POS_ACCURACY, SURVEY_VERTICAL_ACCURACY, SURVEY_HORIZONTAL_ACCURACY,
+  SURVEY_SIV, SURVEY_FIX_TYPE, SURVEY_RTK, SURVEY_HEADING, SURVEY_PDOP, SURVEY_FIELDS
+};
+const char *const survey_field_names[SURVEY_FIELDS] = {
+  "survey_status", "survey_msg", "survey_time_elapsed", "survey_accuracy", "survey_lat", "survey_long", "survey_altitude",
+  "survey_altitude_msl", "survey_msl", "survey_pos_accuracy", "survey_vertical_accuracy", "survey_horizontal_accuracy",
+  "SIV", "fix_type", "RTK", "heading", "PDOP"
+};
+
+TelemetryDelta position_telemetry(WS_TOPIC_POSITION, position_field_names, POSITION_FIELDS, TELEMETRY_KEYFRAME_MS);
+TelemetryDelta survey_telemetry(WS_TOPIC_SURVEY, survey_field_names, SURVEY_FIELDS, TELEMETRY_KEYFRAME_MS);
+
+void ws_broadcast_telemetry(TelemetryDelta &telemetry);
+void ws_send_keyframe(uint8_t client, const TelemetryDelta &telemetry);
+
+// Satellite and signal table from NAV-SAT/NAV-SIG, streamed as binary 'S' messages (see SignalTable.h)
+// to the clients that sent {signals: "SUBSCRIBE"}. Only changed rows go out, plus a full table now and then.
+#define SIGNAL_STREAM_INTERVAL 1000 // ms
+#define SIGNAL_FULL_INTERVAL 10000 // ms
+#define SIGNAL_MAX_AGE_MS 3500 // a signal not reported for this long is dropped
+
+SignalTable signal_table;
+uint8_t signal_message[SIGNAL_MSG_MAX];
+WsPayloadPool signal_payloads(SIGNAL_MSG_MAX);
+uint8_t signal_subscribers = 0; // bit per websocket client
+unsigned long signal_stream_previousMillis = 0;
+unsigned long signal_full_previousMillis = 0;
+static_assert(WS_OUTBOX_MAX_CLIENTS <= 8, "signal_subscribers has a bit per client");
+
+void new_nav_sat(UBX_NAV_SAT_data_t *sat);
+void new_nav_sig(UBX_NAV_SIG_data_t *sig);
+void stream_signal_table();
+void send_signal_table(uint8_t client);
+void send_ws_client_stats();
 
 // HTML Pages Functions
 String Send_Index_HTML();
@@ -73,6 +435,7 @@ String Send_Device_Files_HTML();
 // Web Script functions
 String Survey_Client_WebSocketJS();
 String Files_Client_WebSocketJS();
+String Signals_Client_WebSocketJS();
 void update_listed_files_WebSocket(const String dirName);
 void show_file_contents(const String dirName);
 
@@ -80,17 +443,316 @@ void show_file_contents(const String dirName);
 String WebsiteBaseCSS();
 
 //Web Socket Functions
-void webSocketEvent(byte num, WStype_t type, uint8_t * payload, size_t length);
+void webSocketEvent(uint8_t num, http_ws_event_t type, uint8_t * payload, size_t length);
+
+// Websocket commands, see ws_commands[]
+#define WS_COMMAND_MAX_LENGTH 384 // longer messages are rejected before parsing, spartn_keys is ~200
+
+typedef void (*ws_command_handler_t)(uint8_t num, JsonObject args);
+struct ws_command_t {
+  uint32_t hash; // command_hash(name), computed at compile time
+  const char *name;
+  const command_arg_t *args;
+  uint8_t arg_count;
+  ws_command_handler_t handler;
+};
+
+void init_ws_commands();
+void ws_dispatch(uint8_t num, uint8_t *payload, size_t length);
+void ws_command_error(uint8_t num, const char *name, const char *error);
+void send_command_stats(uint8_t num);
 
 // surveying functions
-void start_survey_observation();
+bool start_survey_observation();
 void handle_survey_observation_in_progress();
 void stop_survey_observation();
+String get_fix_type(); // from latest_epoch
+String get_RTK_status();
+String get_heading();
 
 // surveying vars
 bool survey_in_progress = false;
 float survey_desired_accuracy = 6.00; // value is in meters
 
+// NAV-SVIN is pushed once a second on the read path (set_rate_profile()), new_nav_svin() keeps the
+// latest and handle_survey_observation_in_progress() reports it, nothing in loop() asks the receiver
+#define SURVEY_SVIN_TIMEOUT_MS 3000 // no NAV-SVIN for this long while surveying is reported as a failed request
+struct survey_svin_t {
+  uint32_t dur_s; // observation time
+  uint32_t mean_acc; // 0.1 mm
+  bool valid;
+  bool active;
+  bool fresh; // not reported yet
+  uint32_t received_ms;
+};
+survey_svin_t survey_svin = {};
+void new_nav_svin(UBX_NAV_SVIN_data_t *svin);
+void reset_survey_svin();
+
+// Batch (rapid-static) survey. Walks a list of planned GCPs: occupation starts once the receiver is
+// stationary, ends when the horizontal accuracy meets the target, and the next GCP comes up by itself.
+#define GCP_PLAN_MAX 100
+#define GCP_STATIONARY_SPEED 50 // mm/s, below this the rover counts as set up on the point
+#define GCP_STATIONARY_EPOCHS 3 // consecutive slow epochs before occupation starts
+#define GCP_MOVING_SPEED 300 // mm/s, the rover has to leave a saved point before the next occupation
+#define GCP_MIN_EPOCHS 5 // epochs averaged per point at minimum
+#define GCP_FLUSH_RECORDS 5 // pending records written to SD in one append
+
+enum batch_state_t {
+  BATCH_IDLE,
+  BATCH_WAIT_STATIONARY,
+  BATCH_OCCUPY,
+  BATCH_WAIT_MOVE
+};
+
+batch_state_t batch_state = BATCH_IDLE;
+String gcp_plan[GCP_PLAN_MAX]; // point names, empty plan numbers points from batch_next_gcp
+float gcp_plan_accuracy[GCP_PLAN_MAX]; // target in meters, 0 uses survey_desired_accuracy
+int gcp_plan_count = 0;
+int gcp_plan_position = 0;
+int batch_next_gcp = 1;
+int batch_stationary_epochs = 0;
+int batch_epochs = 0; // epochs in the average, all within the target accuracy
+int batch_occupy_epochs = 0; // all epochs since occupation started, paces the progress updates
+int64_t batch_sum_lat = 0, batch_sum_lon = 0, batch_sum_alt = 0;
+uint32_t batch_worst_hacc = 0; // mm, saved as the accuracy of the averaged point
+unsigned long batch_start_ms = 0;
+unsigned long batch_point_start_ms = 0;
+int batch_points_done = 0;
+int batch_pending_count = 0;
+String batch_pending_records = ""; // queued "GCP lon lat elev" lines
+
+// batch survey functions
+bool load_gcp_plan(String plan_file);
+void start_batch_survey(int first_gcp);
+String batch_point_name();
+void reset_batch_average();
+void stop_batch_survey();
+void handle_batch_survey_epoch(const gnss_epoch_t &epoch);
+void flush_batch_records();
+void send_batch_status(const char *status);
+void append_to_file(String new_file_content);
+String gcp_plan_file = "";
+
+// Session journal. Everything needed to pick a field session back up after a reset: save file,
+// file view, target accuracy, survey-in and batch state, next GCP number. Kept in NVS in
+// SESSION_SLOTS rotating slots with a sequence number and CRC, the newest valid slot wins, so a
+// write cut off by a brown-out falls back to the previous state instead of the defaults.
+#define SESSION_SLOTS 4
+#define SESSION_VERSION 1
+
+struct session_state_t {
+  uint8_t version;
+  uint8_t survey_in_progress;
+  uint8_t batch_active;
+  uint8_t reserved;
+  float target_accuracy; // m
+  uint16_t next_gcp; // manual saves, prefilled in the dashboard
+  uint16_t batch_next_gcp;
+  uint16_t batch_plan_position;
+  char working_file[48];
+  char view_directory[48];
+  char plan_file[32];
+};
+
+struct session_slot_t {
+  uint32_t seq;
+  session_state_t state;
+  uint32_t crc;
+};
+
+session_state_t session_saved; // last state written, saves are skipped when nothing changed
+uint32_t session_seq = 0;
+int next_gcp_index = 1;
+bool session_resume_pending = false; // a saved survey still to be picked up, retried until it is
+unsigned long session_resume_attempt_ms = 0;
+unsigned long session_resumed_ms = 0;
+#define SESSION_RESUME_RETRY_MS 10000
+
+session_state_t session_snapshot();
+void save_session();
+bool load_session();
+bool resume_session();
+
+// Survey points are first written to a crash-safe record log (RecordLog.h) in a preallocated file,
+// then appended to the text survey file. If a power cut damages the text file, the survey_log
+// REBUILD command writes it again from the log. Record layouts are in SurveyRecords.h, shared with
+// the log_analyze host tool.
+#define SURVEY_LOG_FILE "/survey_log.rec"
+#define SURVEY_LOG_RECORDS 4096 // 256 KB preallocated
+#define RTK_EVENTS_SENT 20 // newest events sent for the rtk_events command
+
+bool survey_log_read(uint32_t offset, uint8_t *data, size_t length, void *ctx);
+bool survey_log_write(uint32_t offset, const uint8_t *data, size_t length, void *ctx);
+bool survey_log_flush(void *ctx);
+
+File survey_log_file;
+record_log_io_t survey_log_io = {survey_log_read, survey_log_write, survey_log_flush, nullptr};
+RecordLog survey_log(survey_log_io, SURVEY_LOG_RECORDS);
+LatencyStats survey_log_latency;
+
+bool open_survey_log();
+bool log_survey_point(const String &name, int32_t lon, int32_t lat, int32_t elevation, uint32_t hAcc);
+bool rebuild_survey_file();
+void send_survey_log_status();
+uint32_t survey_file_id(const String &file);
+
+// Continuous track logging in the binary block format from TrackLog.h, decode on a PC with the
+// track_decode tool. Blocks are written whole, so every SD write is one aligned 512 byte sector.
+#define TRACK_SYNC_BLOCKS 8 // directory entry update every 8 blocks, at most that much is lost on power cut
+#define TRACK_STATUS_INTERVAL 5000
+
+File track_file;
+String track_file_name = "";
+unsigned long track_status_previousMillis = 0;
+uint32_t track_write_max_us = 0;
+
+bool write_track_block(const uint8_t *block, size_t length, void *ctx);
+TrackWriter track_writer(write_track_block);
+
+bool start_track_log();
+void stop_track_log();
+void send_track_status();
+
+// Camera event marks (EventMarks.h). A rising edge on the ZED-F9P EXTINT pin comes in as TIM-TM2 and is
+// queued from the callback, service_event_marks() writes it to a CSV on SD once the next HPPOSLLH
+// epoch lets its position be interpolated. TIM-TM2 carries one edge per navigation epoch, the edge
+// counter shows any missed in between, so 20 marks/s needs a 20 Hz rate profile.
+#define EVENT_MARK_WAIT_MS 2000 // a mark with no epoch after it by then is written without a position
+#define EVENT_STATUS_INTERVAL 1000
+
+EventRing event_ring;
+PositionWindow event_window;
+File event_file;
+String event_file_name = "";
+uint32_t event_marks_logged = 0;
+uint32_t event_marks_unmatched = 0; // written without a position
+uint32_t event_marks_missed = 0; // gaps in the TIM-TM2 edge counter
+uint16_t event_last_count = 0;
+bool event_count_valid = false;
+LatencyStats event_latency; // edge reported to line flushed on SD
+unsigned long event_status_previousMillis = 0;
+
+void new_tim_tm2(UBX_TIM_TM2_data_t *tm2);
+void new_hpposllh(UBX_NAV_HPPOSLLH_data_t *hp);
+bool start_event_marks();
+void stop_event_marks();
+void service_event_marks(bool final);
+void send_event_mark_status();
+
+// Read cache for SD files (BlockCache.h), shared by the file viewer, the survey file checks and the
+// plan and key file loaders, so viewing or checking the active survey file again is served from
+// RAM. Anything that writes, removes or renames a file calls sd_cache_invalidate() for it.
+// Cached files are keyed by their slot in sd_cache_paths, not a hash of the path, so two paths
+// never share blocks.
+#define SD_CACHE_PSRAM_KB 256
+#define SD_CACHE_DRAM_KB 16 // 31 blocks
+#define SD_CACHE_MAX_KB 1024
+#define SD_CACHE_FILES 8 // paths with blocks in the cache, a new path takes the least recently read slot
+#define SD_CACHE_FILE_SHARE 4 // a whole-file read fills at most 1/4 of the cache, the rest is read past it
+
+BlockCache *sd_cache = nullptr;
+uint8_t *sd_cache_memory = nullptr;
+String sd_cache_paths[SD_CACHE_FILES]; // cache file id is the slot + 1
+uint32_t sd_cache_path_used[SD_CACHE_FILES]; // tick of the last read, 0 = free slot
+uint32_t sd_cache_path_tick = 0;
+
+struct sd_cache_source_t { // opened on the first miss, a read served from RAM never touches the card
+  const char *path;
+  File file;
+  bool opened;
+  uint32_t file_id; // 0 without a cache
+};
+
+void init_sd_cache(uint16_t kb);
+uint32_t sd_cache_file_id(const String &path, bool add);
+void sd_cache_clear();
+int32_t sd_cache_read_block(uint32_t block, uint8_t *data, void *ctx);
+int32_t sd_cache_read(sd_cache_source_t &source, uint32_t offset, uint8_t *out, size_t length, bool cache);
+int32_t sd_cache_read(const String &path, uint32_t offset, uint8_t *out, size_t length);
+String sd_cache_read_file(const String &path);
+bool sd_cache_read_line(const String &path, uint32_t &offset, String &line);
+void sd_cache_invalidate(const String &path);
+void send_sd_cache_status();
+
+// Stakeout (PointIndex.h). A point file in the survey file format ("name lon lat elevation" per line,
+// other lines skipped) is loaded into a k-d index, in PSRAM when the board has it. Every epoch the
+// offsets to the nearest point, or to the one the crew selected, go to the dash on WS_TOPIC_STAKEOUT
+// and replace the OLED status. Heights are in the index and names in a table next to it, so a new
+// target is a pointer away, and the message goes out from a pooled payload: once loaded, no epoch
+// reads SD or allocates.
+#define STAKEOUT_PSRAM_POINTS 100000 // 2.6 MB with names
+#define STAKEOUT_DRAM_POINTS 1000 // 26 KB with names
+#define STAKEOUT_NAME_BYTES 10 // name table per point, terminators included, a file of longer names holds fewer points
+#define STAKEOUT_MSG_SIZE 192
+
+index_point_t *stakeout_points = nullptr;
+PointIndex *stakeout_index = nullptr;
+char *stakeout_names = nullptr; // the points' names back to back, a point's ref is the offset of its own
+size_t stakeout_names_size = 0;
+size_t stakeout_names_used = 0;
+String stakeout_file = "";
+uint32_t stakeout_skipped = 0; // lines that were not points, or did not fit
+uint32_t stakeout_build_ms = 0;
+int stakeout_selected = -1; // point the crew picked, -1 follows the nearest
+int stakeout_target = -1; // point the offsets are to
+const char *stakeout_name = ""; // in stakeout_names
+double stakeout_east = 0, stakeout_north = 0, stakeout_up = 0; // m, target from the rover
+uint32_t stakeout_lookup_us = 0;
+char stakeout_message[STAKEOUT_MSG_SIZE];
+WsPayloadPool stakeout_payloads(STAKEOUT_MSG_SIZE);
+
+bool load_stakeout(const String &path);
+void stop_stakeout();
+bool select_stakeout_point(const String &name);
+void set_stakeout_target(int index);
+void send_stakeout_status(const char *status);
+
+// Time to fix (ConvergenceTracker.h). A run is timed from power on, from a receiver reset and from
+// corrections coming back after an outage, through 3D, corrections in use, float and fixed. Each
+// milestone goes to the dash as it is reached, a finished run is appended to CONVERGENCE_FILE with the
+// L-Band frequency, keys and rate profile it ran under, so configurations can be compared across
+// sessions, and the last CONVERGENCE_HISTORY runs stay in RAM for the GNSS info page.
+#define CONVERGENCE_FILE "/convergence.csv"
+#define CONVERGENCE_JSON_SIZE 320
+
+ConvergenceTracker convergence;
+
+convergence_config_t convergence_config();
+void check_convergence(const gnss_epoch_t &epoch);
+String convergence_run_json(const convergence_run_t &run);
+void save_convergence_run(const convergence_run_t &run);
+void send_convergence(uint8_t client_num);
+
+// Logging (LogRing.h). LOG_E/W/I/D only queue a record, service_log() formats and writes them from
+// loop() under LOG_SERVICE_BUDGET_US, to Serial as far as the UART buffer takes without blocking, to
+// LOG_FILE on SD in batches, and to the websocket clients that sent {cmd: log, action: SUBSCRIBE}.
+// Each sink has its own runtime level, levels above the LOG_LEVEL build flag are not compiled in.
+#define LOG_SERVICE_BUDGET_US 1000
+#define LOG_LINE_SIZE 160
+#define LOG_SERIAL_TX_BUFFER 2048 // bytes, the UART drains it in the background, 180 ms at 115200
+#define LOG_FILE "/system.log"
+#define LOG_SD_FLUSH_BYTES 1024
+#define LOG_SD_FLUSH_MS 5000
+#define LOG_WS_INTERVAL_MS 250 // lines batched per message, a client that falls behind loses batches
+#define LOG_WS_MAX_BYTES 4096
+
+LogRing log_ring([]() -> uint32_t { return micros(); });
+uint8_t log_serial_level = LOG_LEVEL_INFO;
+uint8_t log_sd_level = LOG_LEVEL_WARN;
+uint8_t log_ws_level = LOG_LEVEL_INFO;
+uint8_t log_subscribers = 0; // bit per websocket client
+String log_sd_pending = "";
+String log_ws_pending = "";
+uint32_t log_ws_dropped = 0; // lines that did not fit in a batch
+unsigned long log_sd_previousMillis = 0;
+unsigned long log_ws_previousMillis = 0;
+
+void service_log(uint32_t budget_us);
+void flush_log_sd();
+void send_log_status(uint8_t client_num);
+uint8_t log_level_from_name(const char *name);
+
 // surveying callback functions
 
 
@@ -100,6 +762,7 @@ StaticJsonDocument<400> json_doc_rx;
 
 
 void setup() {
+  Serial.setTxBufferSize(LOG_SERIAL_TX_BUFFER); // before begin()
   Serial.begin(115200);
   pinMode(LED_BUILTIN, OUTPUT);
 
@@ -121,101 +784,31 @@ void setup() {
   display_add_info(" Then go to -> 192.168.1.1 in browser");
 
   // Define routes
-  server.on("/", handle_OnConnect);
-  server.onNotFound(handle_NotFound);
-  server.on("/start_survey", handle_start_survey);
-  server.on("/view_survey_log", handle_view_survey_log);
-  server.on("/gnss_info", handle_gnss_info);
-  server.on("/device_files", handle_device_files);
-  server.begin();
+  http.on("/", handle_OnConnect);
+  http.on_not_found(handle_NotFound);
+  http.on("/start_survey", handle_start_survey);
+  http.on("/view_survey_log", handle_view_survey_log);
+  http.on("/gnss_info", handle_gnss_info);
+  http.on("/device_files", handle_device_files);
+  http.on("/download", handle_download);
+  http.on_ws_event("/ws", webSocketEvent);
+  if (!http.begin(80)) LOG_E("http", "HTTP server could not listen on port 80");
 
-  webSocket.begin();
-  webSocket.onEvent(webSocketEvent);
+  LOG_I("http", "HTTP server started");
 
-  Serial.println("HTTP server started");
+  prefs.begin("ham_gnss", false);
 
-  //GNSS - ZED-F9P
+  //GNSS - ZED-F9P and NEO-D9S are connected and configured by boot_sequencer_step() from loop()
   //Wire.begin();
 
   //HAM_GNSS.enableDebugging(Serial);
-  while (HAM_GNSS.begin(0x42) == false) // Connect to the u-blox ZED-F9P module using Wire port
-  {
-    Serial.println("u-blox GNSS not detected at default I2C address. Please check wiring. Freezing.");
-    delay(500);
-  }
-
-  Serial.print("u-blox GNSS module connected");
-
-  // NEO-D9S
-  while (HAM_GNSS_L_Band.begin(0x43) == false) {
-    Serial.println("u-blpx NEO-D9S not detected at default I2C address. Please check wiring.");
-    delay(500);
-  }
-
-  Serial.println("u-blox NEO-D9S connected");
-
-  //NEO-D9S Setup
-  uint8_t ok = HAM_GNSS_L_Band.addCfgValset32(UBLOX_CFG_PMP_CENTER_FREQUENCY, LBand_frequency); // Default 1539812500 Hz  32bit val
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset16(UBLOX_CFG_PMP_SEARCH_WINDOW, 2200); // Default 2200 Hz
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset8(UBLOX_CFG_PMP_USE_SERVICE_ID, 0); // Default 1
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset16(UBLOX_CFG_PMP_SERVICE_ID, 21845); //50821
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset16(UBLOX_CFG_PMP_DATA_RATE, 2400); // Default 2400 bps
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset8(UBLOX_CFG_PMP_USE_DESCRAMBLER, 1); // Default 1
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset16(UBLOX_CFG_PMP_DESCRAMBLER_INIT, 26969); // Default 23560
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset8(UBLOX_CFG_PMP_USE_PRESCRAMBLING, 0); // Default 0
-  if (ok) ok = HAM_GNSS_L_Band.addCfgValset(UBLOX_CFG_PMP_UNIQUE_WORD, 16238547128276412563ull); // 0xE15AE893E15AE893
-
-  // Configure NEO-D9S Baud rate to match ZED-F9P's baud rate
-  if(ok) ok = HAM_GNSS_L_Band.addCfgValset(UBLOX_CFG_UART2_BAUDRATE, 38400); // match baudrate with ZED default
-  if(ok) ok = HAM_GNSS_L_Band.addCfgValset(UBLOX_CFG_UART2OUTPROT_UBX, 1); // Enable UBX output on UART2
-  if(ok) ok = HAM_GNSS_L_Band.addCfgValset(UBLOX_CFG_MSGOUT_UBX_RXM_PMP_UART2, 1); // Output UBX-RXM-PMP on UART2
-
-  Serial.print("L-Band configuration: ");
-  if (ok) {
-    Serial.println("OK");
-    HAM_GNSS_L_Band.sendCfgValset();
-  } else {
-    Serial.println("NOT OK!");
-  }
-
-
-  HAM_GNSS_L_Band.softwareResetGNSSOnly();
-
-  // ZED-F9P Setup
-  ok = HAM_GNSS.setI2CInput(COM_TYPE_UBX | COM_TYPE_NMEA | COM_TYPE_SPARTN | COM_TYPE_RTCM3); //Be sure SPARTN input is enabled
-  if(ok) ok = HAM_GNSS.setDGNSSConfiguration(SFE_UBLOX_DGNSS_MODE_FIXED); // set the differential mode - ambiguties
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_SPARTN_USE_SOURCE, 1); // use LBAND PMP message
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1005_I2C, 1); // enable message output via i2c every second
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1074_I2C, 1);
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1094_I2C, 1);
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1124_I2C, 1);
-  if(ok) ok = HAM_GNSS.addCfgValset8(UBLOX_CFG_MSGOUT_RTCM_3X_TYPE1230_I2C, 10); // enable message 1230 every 10 seconds
-  if (ok) ok = HAM_GNSS.setDynamicSPARTNKeys(16,2294, 0, "d8f33f27fc2afd1db1624d5a45817d71", 16, 2297, 0, "9a5899dc0b6313245219d303f281db77"); // add encryption keys to decript NEO-DS9 messages.
-  
-
-  Serial.print("GNSS: configuration ");
-  if (ok) {
-    Serial.println("OK");
-    HAM_GNSS.sendCfgValset();
-  } else {
-    Serial.println("NOT OK!");
-  }
-    
-  //HAM_GNSS.setAutoPVTcallbackPtr(&printPVTdata); // Enable automativ NAV PVT messages with callback to printPVTdata
-  //HAM_GNSS.setAutoRXMRAWXcallbackPtr(&newRAWX);
-
-  HAM_GNSS.softwareResetGNSSOnly();
-
-  delay(1000); // wait before intializing sd card.
 
   //SD Card
-  Serial.print("Initializing SD Card...");
   if(!SD.begin(0, SPI, 10000000)) {
-    Serial.println("SD Card initialization failed!");
-    return;
+    LOG_E("sd", "SD Card initialization failed!");
   }
   else {
-    Serial.println("SD Card initialized :)");
+    LOG_I("sd", "SD Card initialized");
     //listFiles("/");
     // testing sd writing
     // File write_to_File = SD.open(working_directory,FILE_WRITE);
@@ -226,19 +819,27 @@ void setup() {
     //   Serial.println("Working directory save file does not exist.");
     // }
   }
-}
-
-// testing
-int interval = 1000; // 1 sec
-unsigned long previousMillis = 0;
 
-int ublox_msg_check_interval = 250; // 250ms
-unsigned long ublox_previousMillis = 0;
+  init_sd_cache(prefs.getUShort("sd_cache_kb", 0));
+  session_resume_pending = load_session(); // restores the save file before anything is written
+  open_survey_log();
+  load_spartn_store(); // before the boot sequencer hashes the L-Band configuration
+  solution_monitor.hacc_limit_mm = prefs.getUInt("rtk_hacc", solution_monitor.hacc_limit_mm);
+  solution_monitor.corr_age_limit_s = prefs.getUShort("rtk_age", solution_monitor.corr_age_limit_s);
+  convergence.corr_age_limit_s = solution_monitor.corr_age_limit_s;
+  log_serial_level = prefs.getUChar("log_serial", log_serial_level);
+  log_sd_level = prefs.getUChar("log_sd", log_sd_level);
+  convergence.start(CONVERGENCE_BOOT, millis(), convergence_config());
+  init_epoch_history();
+  init_ws_commands();
+  init_txready();
+}
 
 void loop() {
   // put your main code here, to run repeatedly:
-  server.handleClient();
-  webSocket.loop();
+  http.service();
+  ws_outbox.service(WS_SERVICE_BUDGET_US);
+  service_log(LOG_SERVICE_BUDGET_US);
 
   /*unsigned long now = millis();
   if(now - previousMillis > interval) {
@@ -253,345 +854,1339 @@ void loop() {
 
   unsigned long now = millis();
 
-  if ((now - ublox_previousMillis > ublox_msg_check_interval)) {
-    HAM_GNSS.checkUblox();
-    HAM_GNSS.checkCallbacks();
-    ublox_previousMillis = now;
+  if (now - ws_stats_previousMillis > WS_STATS_INTERVAL) {
+    send_ws_client_stats();
+    ws_stats_previousMillis = now;
+  }
+
+  if (boot_stage != BOOT_DONE) {
+    boot_sequencer_step();
+  }
+
+  if (!gnss_ready()) {
+    return; // receivers are still coming up, keep serving the web dash meanwhile
+  }
+
+  if (ublox_read_due(now)) {
+    read_ublox();
+  }
+
+  if (now - receiver_status_previousMillis > RECEIVER_STATUS_INTERVAL) {
+    refresh_receiver_status();
+    receiver_status_previousMillis = now;
+  }
+
+  if (now - rate_stats_previousMillis > RATE_STATS_INTERVAL) {
+    send_rate_stats();
+    rate_stats_previousMillis = now;
+  }
+
+  if (now - signal_stream_previousMillis >= SIGNAL_STREAM_INTERVAL) {
+    stream_signal_table();
+    signal_stream_previousMillis = now;
+  }
+
+  service_event_marks(false);
+  if (event_file && now - event_status_previousMillis > EVENT_STATUS_INTERVAL) {
+    send_event_mark_status();
+    event_status_previousMillis = now;
   }
 
   handle_survey_observation_in_progress();
+}
 
-  
-  if((now - previousMillis > interval) && !survey_in_progress) { // print values while not in active survey
-    // Testing Request Poll Position
-    if (HAM_GNSS.getPVT() == true && webSocket.connectedClients() != 0) 
-    {
-      String JsonString ="";
-      JsonObject object = json_doc_tx.to<JsonObject>(); 
-
-      float_t latitude = HAM_GNSS.getLatitude() / float_t(10000000);
-      float_t longitude = HAM_GNSS.getLongitude() / float_t(10000000);
-      int32_t altitude = HAM_GNSS.getAltitude();
-      int32_t altitude_msl = HAM_GNSS.getAltitudeMSL();
-
-      object["latitude"] = String(latitude);
-      object["longitude"] = String(longitude);
-      object["altitude"] = String(altitude);
-      object["altitude_msl"] = String(altitude_msl);
-
-      serializeJson(object, JsonString);
-      //Serial.println(JsonString);
-      webSocket.broadcastTXT(JsonString);
-      previousMillis = now;
+// Epoch stream functions
+void new_pvt_epoch(UBX_NAV_PVT_data_t *pvt) {
+  gnss_epoch_t &epoch = latest_epoch;
+  epoch.iTOW = pvt->iTOW;
+  epoch.lat = pvt->lat;
+  epoch.lon = pvt->lon;
+  epoch.height = pvt->height;
+  epoch.hMSL = pvt->hMSL;
+  epoch.hAcc = pvt->hAcc;
+  epoch.vAcc = pvt->vAcc;
+  epoch.gSpeed = pvt->gSpeed;
+  epoch.headMot = pvt->headMot;
+  epoch.pDOP = pvt->pDOP;
+  epoch.fixType = pvt->fixType;
+  epoch.carrSoln = pvt->flags.bits.carrSoln;
+  epoch.numSV = pvt->numSV;
+  epoch.corr_age = pvt->flags3.bits.lastCorrectionAge;
+  epoch.year = pvt->year;
+  epoch.month = pvt->month;
+  epoch.day = pvt->day;
+  epoch.hour = pvt->hour;
+  epoch.minute = pvt->min;
+  epoch.second = pvt->sec;
+  epoch.date_valid = pvt->valid.bits.validDate;
+  epoch.time_valid = pvt->valid.bits.validTime;
+  epoch.received_ms = millis();
+  epoch_count++;
+  rate_stats_epochs++;
+  if (ublox_ready_valid) {
+    ublox_latency.add(micros() - ublox_ready_us);
+    ublox_ready_valid = false; // the rest of this read is not the epoch's first byte
+  }
 
-    }
+  // next epoch is due one measurement period after this one arrived
+  ublox_next_poll_ms = epoch.received_ms + rate_profiles[rate_profile].meas_rate_ms - UBLOX_POLL_LEAD_MS;
+
+  dispatch_epoch(epoch);
+}
+
+void dispatch_epoch(const gnss_epoch_t &epoch) {
+  if (boot_stage == BOOT_WAIT_TELEMETRY) { // first telemetry since power on
+    boot_stage_ms[BOOT_WAIT_TELEMETRY] = millis();
+    boot_stage = BOOT_DONE;
+    if (session_resume_pending) session_resume_pending = !resume_session();
+    session_resume_attempt_ms = epoch.received_ms;
+    send_boot_report(-1);
+  } else if (session_resume_pending && epoch.received_ms - session_resume_attempt_ms >= SESSION_RESUME_RETRY_MS) {
+    session_resume_pending = !resume_session();
+    session_resume_attempt_ms = epoch.received_ms;
+  }
+
+  update_gps_leap_seconds(epoch);
+  if (epoch.received_ms - spartn_check_previousMillis > 60000) {
+    spartn_key_rollover_check();
+    spartn_check_previousMillis = epoch.received_ms;
+  }
+
+  check_solution(epoch); // before the batch survey so a drop never gets averaged into a point
+  check_convergence(epoch);
+
+  if (batch_state != BATCH_IDLE) {
+    handle_batch_survey_epoch(epoch);
+  }
+
+  for (int i = 0; i < EPOCH_CONSUMER_COUNT; i++) {
+    epoch_consumer_t &consumer = epoch_consumers[i];
+    if (consumer.handle == nullptr || epoch_count % consumer.decimation != 0) continue;
+    unsigned long start = micros();
+    consumer.handle(epoch);
+    consumer.busy_us += micros() - start;
+    consumer.calls++;
   }
 }
 
-// Routes
-void handle_OnConnect() {
-  Serial.println("Client Connected to ESP32 Web Server.");
-  display_info_lg("Stand By Mode");
-  server.send(200, "text/html",  Send_Index_HTML());
+// Solution monitor functions
+void check_solution(const gnss_epoch_t &epoch) {
+  solution_event_t event;
+  if (!solution_monitor.update(epoch.fixType, epoch.carrSoln, epoch.hAcc, epoch.corr_age, event)) return;
+
+  bool occupying = batch_state == BATCH_OCCUPY;
+  String point = occupying ? batch_point_name() : "";
+  report_rtk_event(event.degraded ? RTK_EVENT_DEGRADED : RTK_EVENT_RECOVERED, event, epoch, point);
+
+  // averaging across a change mixes two solutions, the point starts over on the new one
+  if (occupying && batch_epochs > 0) {
+    reset_batch_average();
+    batch_point_start_ms = millis();
+    send_batch_status(event.degraded ? "solution_degraded" : "solution_changed");
+  }
 }
 
-void handle_NotFound() {
-  server.send(404, "text/plain", "URL End Point Not found");
+// Alert to the dash and the OLED, then the survey log
+void report_rtk_event(uint8_t kind, const solution_event_t &event, const gnss_epoch_t &epoch, const String &point) {
+  const char *kinds[] = {"degraded", "recovered", "saved_in_alert"};
+  String change = String(solution_state_name(event.from)) + ">" + solution_state_name(event.to);
+  if (event.to_flags & SOLUTION_HACC_HIGH) change += " hAcc";
+  if (event.to_flags & SOLUTION_CORRECTIONS_STALE) change += " old corr";
+  uint16_t corr_age_s = solution_correction_age_s(epoch.corr_age);
+  String on_point = point.length() ? " " + point : String("");
+
+  LOG_W("rtk", "RTK %s: %s, hAcc %lu mm %s", kinds[kind], change.c_str(), (unsigned long)epoch.hAcc, point.c_str());
+
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["rtk_event"] = kinds[kind];
+  object["rtk_from"] = solution_state_name(event.from);
+  object["rtk_to"] = solution_state_name(event.to);
+  object["rtk_hacc_high"] = (event.to_flags & SOLUTION_HACC_HIGH) != 0;
+  object["rtk_corrections_stale"] = (event.to_flags & SOLUTION_CORRECTIONS_STALE) != 0;
+  object["rtk_alert"] = solution_monitor.alert();
+  object["rtk_hacc"] = epoch.hAcc;
+  if (epoch.corr_age) object["rtk_corr_age_s"] = corr_age_s;
+  if (point.length()) object["rtk_point"] = point;
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString);
+
+  if (kind == RTK_EVENT_RECOVERED) display_info("RTK back " + change);
+  else if (kind == RTK_EVENT_DEGRADED) display_info("RTK LOST " + change);
+  else display_info(point + " saved in RTK alert");
+  display_add_info("\nhAcc " + String(epoch.hAcc / 1000.0, 3) + "m" + on_point);
+
+  if (!survey_log_file) return;
+  rtk_event_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.file_id = survey_file_id(working_directory);
+  strlcpy(record.point, point.c_str(), sizeof(record.point));
+  record.uptime_ms = epoch.received_ms;
+  record.iTOW = epoch.iTOW;
+  if (epoch.date_valid && epoch.time_valid) {
+    record.year = epoch.year;
+    record.month = epoch.month;
+    record.day = epoch.day;
+    record.hour = epoch.hour;
+    record.minute = epoch.minute;
+    record.second = epoch.second;
+  }
+  record.kind = kind;
+  record.from_state = event.from;
+  record.to_state = event.to;
+  record.from_flags = event.from_flags;
+  record.to_flags = event.to_flags;
+  record.corr_age = epoch.corr_age && corr_age_s < 0xff ? corr_age_s : 0xff;
+  record.hAcc = epoch.hAcc;
+  if (survey_log.append(SURVEY_RECORD_RTK_EVENT, &record, sizeof(record)) != RECORD_LOG_OK) {
+    LOG_W("survey", "Survey log: RTK event not recorded");
+  }
 }
 
-void handle_start_survey() {
-  display_info_lg("Starting Survey..");
-  server.send(200, "text/html", Send_Start_Survey_HTML());
-  // Testing surveying functionality
-  bool response = HAM_GNSS.getSurveyStatus(2000); //Query module for SVIN status with 2000ms timeout (request can take a long time)
+struct rtk_event_history_t {
+  rtk_event_record_t events[RTK_EVENTS_SENT];
+  uint32_t count;
+};
+
+bool collect_rtk_event(const record_t &record, void *ctx) {
+  rtk_event_history_t &history = *(rtk_event_history_t *)ctx;
+  if (record.type != SURVEY_RECORD_RTK_EVENT || record.length != sizeof(rtk_event_record_t)) return true;
+  memcpy(&history.events[history.count++ % RTK_EVENTS_SENT], record.payload, sizeof(rtk_event_record_t));
+  return true;
 }
 
-void handle_view_survey_log() {
-  display_info_lg("Survey log displaying on web dash");
-  server.send(200, "text/html", Send_Survey_Log_HTML());
+// Newest transitions from the survey log, oldest first
+void send_rtk_events(uint8_t client_num) {
+  static rtk_event_history_t history; // ~1 KB, kept off the loop task stack
+  history.count = 0;
+  survey_log.for_each(collect_rtk_event, &history);
+
+  const char *kinds[] = {"degraded", "recovered", "saved_in_alert"};
+  uint32_t first = history.count > RTK_EVENTS_SENT ? history.count - RTK_EVENTS_SENT : 0;
+  String message = "{\"rtk_events\":[";
+  for (uint32_t i = first; i < history.count; i++) {
+    rtk_event_record_t &e = history.events[i % RTK_EVENTS_SENT];
+    e.point[sizeof(e.point) - 1] = '\0';
+    char time[24] = "";
+    if (e.year) snprintf(time, sizeof(time), "%04u-%02u-%02uT%02u:%02u:%02uZ", e.year, e.month, e.day, e.hour, e.minute, e.second);
+
+    String jsonString = "";
+    JsonObject object = json_doc_tx.to<JsonObject>();
+    object["time"] = time;
+    object["uptime_ms"] = e.uptime_ms;
+    object["kind"] = e.kind < 3 ? kinds[e.kind] : "unknown";
+    object["from"] = solution_state_name((solution_state_t)e.from_state);
+    object["to"] = solution_state_name((solution_state_t)e.to_state);
+    object["flags"] = e.to_flags;
+    object["hAcc"] = e.hAcc;
+    if (e.corr_age != 0xff) object["corr_age_s"] = e.corr_age;
+    if (e.point[0]) object["point"] = e.point;
+    serializeJson(object, jsonString);
+    if (i > first) message += ",";
+    message += jsonString;
+  }
+  message += "]}";
+  ws_send(client_num, message);
 }
 
-void handle_gnss_info() {
-  display_info_lg("GNSS Info displaying on web dash");
-  server.send(200, "text/html", Send_GNSS_Info_HTML());
+// NAV-SAT and NAV-SIG land in the signal table, stream_signal_table() sends what changed
+void new_nav_sat(UBX_NAV_SAT_data_t *sat) {
+  uint32_t now = millis();
+  for (uint16_t i = 0; i < sat->header.numSvs && i < UBX_NAV_SAT_MAX_BLOCKS; i++) {
+    const UBX_NAV_SAT_block_t &b = sat->blocks[i];
+    signal_table.update_satellite(b.gnssId, b.svId, b.cno, b.elev, b.azim, b.flags.bits.qualityInd, b.flags.bits.health, b.flags.bits.svUsed, now);
+  }
 }
 
-void handle_device_files() {
-  display_info_lg("Device files displaying on web dash");
-  server.send(200, "text/html", Send_Device_Files_HTML());
+void new_nav_sig(UBX_NAV_SIG_data_t *sig) {
+  uint32_t now = millis();
+  for (uint16_t i = 0; i < sig->header.numSigs && i < UBX_NAV_SIG_MAX_BLOCKS; i++) {
+    const UBX_NAV_SIG_block_t &b = sig->blocks[i];
+    uint8_t flags = (b.sigFlags.bits.prUsed ? SIGNAL_FLAG_PR_USED : 0) | (b.sigFlags.bits.crUsed ? SIGNAL_FLAG_CR_USED : 0)
+      | (b.sigFlags.bits.doUsed ? SIGNAL_FLAG_DO_USED : 0)
+      | (b.sigFlags.bits.prCorrUsed || b.sigFlags.bits.crCorrUsed || b.sigFlags.bits.doCorrUsed ? SIGNAL_FLAG_CORR_USED : 0);
+    signal_table.update_signal(b.gnssId, b.svId, b.sigId, b.cno, b.qualityInd, b.sigFlags.bits.health, flags, b.corrSource, now);
+  }
 }
 
+void stream_signal_table() {
+  unsigned long now = millis();
+  signal_table.expire(now, SIGNAL_MAX_AGE_MS);
+  if (signal_subscribers == 0) {
+    signal_table.clear_changes(); // the next subscriber starts with a full table
+    return;
+  }
 
+  size_t length;
+  if (now - signal_full_previousMillis >= SIGNAL_FULL_INTERVAL) {
+    signal_table.clear_changes(); // folded into the full table, which then carries the next seq
+    length = signal_table.encode_full(signal_message, sizeof(signal_message));
+    signal_full_previousMillis = now;
+  } else {
+    length = signal_table.encode_changes(signal_message, sizeof(signal_message));
+  }
+  if (length == 0) return;
 
-// Website HTML
-String Send_Index_HTML() {
-  String page = "<!DOCTYPE html> <html>\n";
-  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
-  page += "<title>HAM-GNSS-Reciever</title>\n";
-  page += "</head>\n";
-  page += "<body>\n";
-  page += WebsiteBaseCSS();
-  page += "<h1 style=\"text-align: center; font-weight: bold;\">High Altitude Media GNSS Reciver</h1>\n";
-  page += "<a href=\"start_survey\" class=\"button-link\">Start Survey</a>\n";
-  page += "<a href=\"view_survey_log\" class=\"button-link\">View Survey Log</a>\n";
-  page += "<a href=\"gnss_info\" class=\"button-link\">GNSS Info</a>";
-  page += "<a href=\"device_files\" class=\"button-link\">Device Files</a>\n";
-  page += "<h4 style=\"text-align: center;\">Latitude & Longitude Cordinates: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getLatitude();
-  page += ", ";
-  page += HAM_GNSS_L_Band.getLongitude();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Fix Type : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getFixType();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Heading : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getHeading();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Mean Sea Level : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getMeanSeaLevel();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Measurement rate : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getMeasurementRate();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Elipsoid : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getElipsoid();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Altitude : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += "Altitude: ";
-  page += HAM_GNSS_L_Band.getAltitude();
-  page += ", Mean Sea Level Alitutude: ";
-  page += HAM_GNSS_L_Band.getAltitudeMSL();
-  page += "</p>\n";
-  page += "<p style=\"margin-top:10px;\">Created By Zion Johnson </p> <a href=\"https://github.com/zion379\" class=\"button-link\">Github Portfolio</a>\n";
-  page += "</body>\n";
-  page += "</html>\n";
+  ws_payload_t payload = signal_payloads.make((const char *)signal_message, length);
+  for (uint8_t i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+    if (signal_subscribers & (1 << i)) ws_outbox.send(i, WS_TELEMETRY, WS_TOPIC_SIGNALS, payload, true);
+  }
+}
 
-  return page;
+void send_signal_table(uint8_t client) {
+  size_t length = signal_table.encode_full(signal_message, sizeof(signal_message));
+  if (length > 0) ws_outbox.send(client, WS_TELEMETRY, WS_TOPIC_SIGNALS, (const char *)signal_message, length, true);
 }
 
-String Send_Start_Survey_HTML() {
-  String page = "<!DOCTYPE html> <html>\n";
-  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
-  page += "<title>HAM-GNSS-Reciever</title>\n";
-  page += "</head>\n";
-  page += "<body>\n";
-  page += WebsiteBaseCSS();
-  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
-  page += "<h3 style=\"text-align: center;\"> Start Survey </h3>\n";
-  page += "<h4 style=\"text-align: center;\"> Survey Status: <span id='survey_status'>inactive</span> </h4>\n";
-  page += "<h4 id='survey_msg' style='display: none; text-align: center;'></h4>\n";
-  page += "<h4 id='survey_time' style='display: none; text-align: center;'></h4>\n";
-  page += "<h4 id='survey_accuracy' style='display: none; text-align: center;'></h4>\n";
-  page += "<div style='justify-content: center; display: flex;'\n>";
-  page += " <label id='accuracy_input_label' for='target_accuracy_input'>Enter Target Accuracy:</label>\n";
-  page += " <h5 id='survey_desired_accuracy' style='display: none; text-align: center; font-weight: bold;'></h5>\n";
-  page += " <input type='number' id='target_accuracy_input' name='target_accuracy_input' min='0.08' max='100'>\n";
-  page += " <button type='button' id='set_target_accuracy' style='text-align: center;'> Set Target Accuracy </button>\n";
-  page += "</div>\n";
-  page += "<div style='justify-content: center; display: flex;'>\n";
-  page += " <h5 id='pos_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
-  page += " <h5 id='vert_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
-  page += " <h5 id='horz_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
-  page += "</div>\n";
-  page += "<p style=\"text-align: center;\">Latitude: <span id='latitude'> lat value </span> , Longitude: <span id='longitude'> long val</span></p>\n";
-  page += "<p style=\"text-align: center;\">Altitude : <span id='altitude'> altitude value </span></p>\n";
-  page += "<p style=\"text-align: center;\">Altitude above MSL : <span id='altitude_msl'> MSL Altitude Val</p>\n";
-  page += "<h5 id='mean_sea_lvl' style='display: none; text-align: center; font-weight: bold;'></h5>\n";
-  page += "<div id='reciever_info' style='display: none; justify-content: space-evenly;'>\n";
-  page += " <div style='justify-content: space-evenly;'>\n";
-  page += "   <h4 id='fix_type' style='margin: 5px;'></h4>\n";
-  page += "   <h4 id='RTK' style='margin: 5px;'></h4>\n";
-  page += " </div>\n";
-  page += " <h4 id='heading' style='margin: 5px;'></h4>\n";
-  page += " <h4 id='PDOP' style='margin: 5px;'></h4>\n";
-  page += " <h4 id='SIV_status' style='margin: 5px;'></h4>\n";
-  page += "</div>\n";
-  page += "<div style='text-align: center; margin-top: 15px;'>\n";
-  page += " <button type='button' id='save_survey_btn' style='display: none;'>Save Survey</button>\n";
-  page += " <label id='gcp_index_label' for='gcp_index_input'>GCP Index:</label>\n";
-  page += " <input type='number' id='gcp_index_input' name='gcp_index_input' min='1' max='100'>\n";
-  page += "</div>\n";
-  page += "<button type='button' id='start_survey' disabled> Start Survey </button>\n";
-  page += "<button type='button' id='stop_survey' disabled> Stop Survey </button>\n";
-  page += "<button id='reconnect_web_socket' onclick='reconnect_web_socket' style='display:none;'>Reconnect WebSocket</button>\n";
-  page += Survey_Client_WebSocketJS(); // returns string that is valid HTML
-  page += "<a href=\"/\" class=\"button-link\">Home</a>\n";
-  page += "</body>\n";
-  page += "</html>\n";
+// Poll right before an epoch is due and quickly until it shows up, instead of a fixed 250 ms.
+// Without epochs (no fix yet, receiver busy) fall back to a quarter of the measurement period.
+bool ublox_poll_due(unsigned long now) {
+  static unsigned long last_poll_ms = 0;
+  uint16_t period = rate_profiles[rate_profile].meas_rate_ms;
+  bool epoch_due = (long)(now - ublox_next_poll_ms) >= 0;
+  bool overdue = (long)(now - ublox_next_poll_ms) > period; // missed epoch, stop spinning
+
+  unsigned long interval = epoch_due && !overdue ? UBLOX_POLL_FAST_MS : period / 4;
+  if (now - last_poll_ms < interval) return false;
+  last_poll_ms = now;
+  return true;
+}
 
-  return page;
+void IRAM_ATTR txready_isr() {
+  if (!txready_pending) {
+    txready_since_us = micros();
+    txready_pending = true;
+  }
+  txready_edges++;
 }
 
-String Send_Survey_Log_HTML() {
-  String page = "<!DOCTYPE html> <html>\n";
-  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
-  page += "<title>HAM-GNSS-Reciever</title>\n";
-  page += "</head>\n";
-  page += "<body>\n";
-  page += WebsiteBaseCSS();
-  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
-  page += "<h3 style=\"text-align: center;\"> Survey Log </h3>\n";
-  page += "<p style=\"text-align: center;\">This Functionality is still being created will be avaible soon.</p>\n";
-  page += "<a href=\"/\" class=\"button-link\">Home<\a>\n";
-  page += "</body>\n";
-  page += "</html>\n";
+void init_txready() {
+  pinMode(TXREADY_GPIO, INPUT_PULLDOWN);
+  attachInterrupt(TXREADY_GPIO, txready_isr, RISING);
+  ublox_read_mode = prefs.getUChar("ublox_read", UBLOX_READ_TXREADY) == UBLOX_READ_POLL ? UBLOX_READ_POLL : UBLOX_READ_TXREADY;
+}
 
-  return page;
+bool ublox_read_due(unsigned long now) {
+  static unsigned long last_read_ms = 0;
+  if (ublox_read_mode == UBLOX_READ_TXREADY) {
+    if (txready_pending) txready_last_edge_ms = now;
+    // the pin stays high while output is above the threshold, so a read that left data behind goes again
+    bool ready = txready_pending || digitalRead(TXREADY_GPIO) == HIGH;
+    bool silent = now - txready_last_edge_ms > TXREADY_SILENT_MS;
+    if (ready || (silent ? ublox_poll_due(now) : now - last_read_ms >= TXREADY_SAFETY_POLL_MS)) {
+      last_read_ms = now;
+      return true;
+    }
+    return false;
+  }
+  return ublox_poll_due(now);
 }
 
-String Send_GNSS_Info_HTML() {
-  String page = "<!DOCTYPE html> <html>\n";
-  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
-  page += "<title>HAM-GNSS-Reciever</title>\n";
-  page += "</head>\n";
-  page += "<body>\n";
-  page += WebsiteBaseCSS();
-  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
-  page += "<h3 style=\"text-align: center;\"> GNSS INFO </h3>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Module: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS.getModuleName();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Firmware Version: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS.getFirmwareVersionHigh();
-  page += ".";
-  page += HAM_GNSS.getFirmwareVersionLow();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Protocal version : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS.getProtocolVersionHigh();
-  page += ".";
-  page += HAM_GNSS.getProtocolVersionLow();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Firmware Type: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS.getFirmwareType();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Module 2: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getModuleName();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Firmware Version: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getFirmwareVersionHigh();
-  page += ".";
-  page += HAM_GNSS_L_Band.getFirmwareVersionLow();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">GNSS Reciever Protocal version : </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getProtocolVersionHigh();
-  page += ".";
-  page += HAM_GNSS_L_Band.getProtocolVersionLow();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Firmware Type: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getFirmwareType();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Antenna Status: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getAntennaStatus();
-  page += "</p>\n";
-  page += "<h4 style=\"text-align: center;\">Antenna Heading: </h4>\n";
-  page += "<p style=\"text-align: center;\">";
-  page += HAM_GNSS_L_Band.getHeading();
-  page += "</p>\n";
-  page += "<a href=\"/\" class=\"button-link\" >Home</a>\n";
-  page += "</body>\n";
-  page += "</html>\n";
-  return page;
+void read_ublox() {
+  if (!txready_pending && digitalRead(TXREADY_GPIO) == LOW) ublox_empty_polls++;
+  noInterrupts();
+  ublox_ready_valid = txready_pending;
+  ublox_ready_us = txready_since_us;
+  txready_pending = false; // an edge during the read starts the next one
+  interrupts();
+
+  unsigned long poll_start = micros();
+  HAM_GNSS.checkUblox();
+  unsigned long callbacks_start = micros();
+  HAM_GNSS.checkCallbacks(); // new_pvt_epoch() and the epoch consumers run from here
+  ublox_bus_us += callbacks_start - poll_start;
+  ublox_callback_us += micros() - callbacks_start;
+  ublox_polls++;
+  ublox_ready_valid = false;
 }
 
-String Send_Device_Files_HTML() {
-  String page = "<!DOCTYPE html> <html>\n";
-  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
-  page += "<title>HAM-GNSS-Reciever</title>\n";
-  page += "</head>\n";
-  page += "<body>\n";
-  page += WebsiteBaseCSS();
-  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
-  page += "<h3 style=\"text-align: center;\"> Device Files </h3>\n";
-  page += "<h4 style=\"text-align: center;\">Folders on GNSS Reciever:</h4>\n";
-  page += "<h5 style='text-align: center;'>current directory: <span id='current_directory'>";
-  page += file_view_directory;
-  page += "</span></h5>\n";
-  page += "<div id='file_list_view'>\n";
-  page += listFiles_HTML("/");
-  page += "</div>\n";
-  page += "<div id='file_btn_controls' style='text-align: center; display: none; margin-top: 2em;'>\n";
-  page += " <label for='new_file_name_input'>New File Name:</label>\n";
-  page += " <input type='text' id='new_file_name_input' name='new_file_name_input'></input>\n";
-  page += " <button type='button' id='create_file_btn' disabled>Create File</button>\n";
-  page += " <button type='button' id='delete_file_btn' disabled>Delete File</button>\n";
-  page += "</div>\n";
-  page += "<div id='directory_nav_controls'>\n";
-  page += "<button id='nav_previous_directory'>Navigate to parent folder</button>";
-  page += "</div>\n";
-  page += "<a href=\"/\" class=\"button-link\">Home</a>\n";
-  page += "<button id='reconnect_web_socket' onclick='reconnect_web_socket()' style='display:none;'>Reconnect WebSocket</button>\n";
+int find_rate_profile(const char *name) {
+  for (uint8_t i = 0; i < RATE_PROFILE_COUNT; i++) {
+    if (strcmp(rate_profiles[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+bool set_rate_profile(uint8_t profile) {
+  if (profile >= RATE_PROFILE_COUNT) return false;
+  const rate_profile_t &p = rate_profiles[profile];
+
+  if (gnss_ready()) {
+    // CFG-RATE in RAM only, the profile itself is what gets remembered
+    bool ok = HAM_GNSS.setMeasurementRate(p.meas_rate_ms, VAL_LAYER_RAM);
+    if (ok) ok = HAM_GNSS.setNavigationRate(1, VAL_LAYER_RAM);
+    // NAV-SAT/NAV-SIG once a second whatever the nav rate, they are big and change slowly, NAV-SVIN
+    // too since survey-in reports once a second
+    uint8_t sat_every = p.meas_rate_ms < 1000 ? 1000 / p.meas_rate_ms : 1;
+    if (ok) ok = HAM_GNSS.setVal8(UBLOX_CFG_MSGOUT_UBX_NAV_SAT_I2C, sat_every, VAL_LAYER_RAM);
+    if (ok) ok = HAM_GNSS.setVal8(UBLOX_CFG_MSGOUT_UBX_NAV_SIG_I2C, sat_every, VAL_LAYER_RAM);
+    if (ok) ok = HAM_GNSS.setVal8(UBLOX_CFG_MSGOUT_UBX_NAV_SVIN_I2C, sat_every, VAL_LAYER_RAM);
+    if (!ok) {
+      LOG_E("gnss", "Failed to set CFG-RATE for profile %s", p.name);
+      return false;
+    }
+  }
+
+  rate_profile = profile;
+  for (int i = 0; i < EPOCH_CONSUMER_COUNT; i++) {
+    epoch_consumers[i].decimation = p.decimation[i];
+  }
+  convergence.set_config(convergence_config());
+  prefs.putUChar("rate_profile", profile);
+  LOG_I("gnss", "Rate profile %s: %u Hz", p.name, 1000 / p.meas_rate_ms);
+  return true;
+}
+
+// Share of wall time spent on the I2C bus (checkUblox) and in callbacks/consumers, per profile
+void send_rate_stats() {
+  unsigned long window_ms = millis() - rate_stats_previousMillis;
+  if (window_ms == 0) return;
+
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["rate_profile"] = rate_profiles[rate_profile].name;
+  object["nav_hz"] = 1000 / rate_profiles[rate_profile].meas_rate_ms;
+  object["epochs_per_s"] = rate_stats_epochs * 1000.0 / window_ms;
+  object["bus_polls_per_s"] = ublox_polls * 1000.0 / window_ms;
+  object["bus_empty_polls_per_s"] = ublox_empty_polls * 1000.0 / window_ms;
+  object["bus_load_pct"] = ublox_bus_us / (window_ms * 10.0);
+  object["read_mode"] = ublox_read_mode == UBLOX_READ_TXREADY ? "txready" : "poll";
+  object["txready_edges_per_s"] = txready_edges * 1000.0 / window_ms;
+  object["pvt_latency_p50_us"] = ublox_latency.percentile(50);
+  object["pvt_latency_p99_us"] = ublox_latency.percentile(99);
+  object["pvt_latency_max_us"] = ublox_latency.max();
+  object["cpu_load_pct"] = ublox_callback_us / (window_ms * 10.0);
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString, WS_TELEMETRY, WS_TOPIC_RATE_STATS);
+
+  for (int i = 0; i < EPOCH_CONSUMER_COUNT; i++) {
+    LOG_D("rate", "consumer %s: %lu us in %lu ms", epoch_consumers[i].name, (unsigned long)epoch_consumers[i].busy_us, window_ms);
+    epoch_consumers[i].busy_us = 0;
+  }
+
+  ublox_polls = 0;
+  ublox_empty_polls = 0;
+  ublox_bus_us = 0;
+  ublox_callback_us = 0;
+  rate_stats_epochs = 0;
+  txready_edges = 0;
+  ublox_latency.clear();
+}
+
+void epoch_ws_telemetry(const gnss_epoch_t &epoch) {
+  if (survey_in_progress || http.ws_client_count() == 0) return; // survey-in sends its own values
+
+  float_t latitude = epoch.lat / float_t(10000000);
+  float_t longitude = epoch.lon / float_t(10000000);
+
+  position_telemetry.set(POSITION_LATITUDE, String(latitude).c_str());
+  position_telemetry.set(POSITION_LONGITUDE, String(longitude).c_str());
+  position_telemetry.set(POSITION_ALTITUDE, String(epoch.height).c_str());
+  position_telemetry.set(POSITION_ALTITUDE_MSL, String(epoch.hMSL).c_str());
+  position_telemetry.set(POSITION_HACC, epoch.hAcc);
+  ws_broadcast_telemetry(position_telemetry);
+}
+
+void epoch_oled_status(const gnss_epoch_t &epoch) {
+  if ((long)(millis() - display_hold_until) < 0) return; // an event message is still showing
+
+  const char *carrier[] = {"", " RTK float", " RTK fixed"};
+  display.clearDisplay();
+  display.setCursor(0,0);
+  display.setTextSize(1);
+  display.setTextColor(1);
+  display.setTextWrap(false);
+  if (stakeout_target >= 0) { // offsets from the previous epoch, the stakeout consumer runs after this one
+    display.println("Stake " + String(stakeout_name) + (stakeout_selected >= 0 ? "" : " (near)"));
+    display.println("N " + String(stakeout_north, 3) + " E " + String(stakeout_east, 3));
+    display.println("Dist " + String(sqrt(stakeout_east * stakeout_east + stakeout_north * stakeout_north), 3) + " Up " + String(stakeout_up, 3));
+    display.println("hAcc " + String(epoch.hAcc / 1000.0, 3) + "m" + carrier[epoch.carrSoln < 3 ? epoch.carrSoln : 0]);
+    display.display();
+    return;
+  }
+  display.println(String(ssid) + " 192.168.1.1");
+  display.println("Fix " + String(epoch.fixType) + "D" + carrier[epoch.carrSoln < 3 ? epoch.carrSoln : 0]);
+  display.println("SIV " + String(epoch.numSV) + " hAcc " + String(epoch.hAcc / 1000.0, 3) + "m");
+  display.println(String(epoch.lat / 1e7, 6) + "," + String(epoch.lon / 1e7, 6));
+  display.display();
+}
+
+// Epoch history functions
+void init_epoch_history() {
+  size_t size = HISTORY_PSRAM_BYTES;
+  uint8_t *memory = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+  if (!memory) {
+    size = HISTORY_DRAM_BYTES;
+    memory = (uint8_t *)malloc(size);
+  }
+  if (!memory) {
+    LOG_E("history", "No memory for epoch history.");
+    return;
+  }
+  epoch_history = new EpochHistory(memory, size);
+  LOG_I("history", "Epoch history: %u KB", (unsigned)(size / 1024));
+}
+
+void epoch_history_add(const gnss_epoch_t &epoch) {
+  if (!epoch_history) return;
+  history_point_t point;
+  point.t_ms = epoch.received_ms;
+  point.lat = epoch.lat;
+  point.lon = epoch.lon;
+  point.height = epoch.height;
+  point.hAcc = epoch.hAcc;
+  point.vAcc = epoch.vAcc;
+  point.status = epoch.fixType | epoch.carrSoln << 3;
+  point.numSV = epoch.numSV;
+  epoch_history->add(point);
+}
+
+struct history_send_t {
+  uint8_t client;
+  uint8_t type;
+  uint16_t seq;
+  size_t skip_bytes; // oldest blocks left out to fit the burst
+  std::string chunk;
+};
+
+void flush_history_chunk(history_send_t &send, bool last) {
+  uint8_t header[HISTORY_MSG_HEADER];
+  header[0] = 'H';
+  header[1] = send.type;
+  put_u16le(header + 2, send.seq++);
+  put_u32le(header + 4, millis());
+  put_u16le(header + 8, last ? 1 : 0);
+  if (send.chunk.empty()) send.chunk.resize(HISTORY_MSG_HEADER); // an empty history still ends the burst
+  send.chunk.replace(0, HISTORY_MSG_HEADER, (const char *)header, HISTORY_MSG_HEADER);
+  ws_outbox.send(send.client, WS_CRITICAL, 0, send.chunk.data(), send.chunk.size(), true);
+  send.chunk.clear();
+}
+
+bool add_history_block(const uint8_t *block, size_t length, void *ctx) {
+  history_send_t &send = *(history_send_t *)ctx;
+  if (send.skip_bytes >= length) {
+    send.skip_bytes -= length;
+    return true;
+  }
+  send.skip_bytes = 0;
+  if (!send.chunk.empty() && send.chunk.size() + length > HISTORY_CHUNK_BYTES) {
+    flush_history_chunk(send, false);
+  }
+  if (send.chunk.empty()) {
+    send.chunk.reserve(HISTORY_CHUNK_BYTES);
+    send.chunk.resize(HISTORY_MSG_HEADER); // header is filled in on flush
+  }
+  send.chunk.append((const char *)block, length);
+  return true;
+}
+
+// Blocks go out in their storage format, the browser decodes them with decode_history()
+void send_history_blocks(uint8_t client, const EpochHistory &history, uint8_t type, size_t skip_bytes) {
+  history_send_t send = {client, type, 0, skip_bytes, std::string()};
+  history.for_each_block(add_history_block, &send);
+  flush_history_chunk(send, true);
+}
+
+void send_history_burst(uint8_t client) {
+  if (!epoch_history || epoch_history->points() == 0) return;
+  size_t used = epoch_history->bytes_used();
+  send_history_blocks(client, *epoch_history, HISTORY_MSG_BURST, used > HISTORY_BURST_BYTES ? used - HISTORY_BURST_BYTES : 0);
+}
+
+void add_query_point(const history_point_t &point, void *ctx) {
+  ((EpochHistory *)ctx)->add(point);
+}
+
+// Down-sampled points re-encoded into a scratch history, so query results use the burst format.
+// If the result outgrows the scratch buffer the oldest points fall off, ask with a larger step_s.
+void send_history_query(uint8_t client, uint32_t from_s, uint32_t to_s, uint32_t step_s) {
+  if (!epoch_history) return;
+  uint8_t *scratch = (uint8_t *)malloc(HISTORY_QUERY_BYTES);
+  if (!scratch) return;
+
+  EpochHistory result(scratch, HISTORY_QUERY_BYTES);
+  uint32_t now = millis();
+  epoch_history->query(now - from_s * 1000, now - to_s * 1000, step_s * 1000, add_query_point, &result);
+  send_history_blocks(client, result, HISTORY_MSG_QUERY, 0);
+  free(scratch);
+}
+
+// Boot sequencer functions
+bool gnss_ready() {
+  return boot_stage >= BOOT_WAIT_TELEMETRY;
+}
+
+void boot_sequencer_step() {
+  unsigned long now = millis();
+
+  switch (boot_stage) {
+  case BOOT_GNSS_CONNECT:
+    if (now - boot_retry_ms < 500) break; // retry every 500ms without holding up the loop
+    boot_retry_ms = now;
+    if (HAM_GNSS.begin(0x42) == false) { // Connect to the u-blox ZED-F9P module using Wire port
+      LOG_E("gnss", "u-blox GNSS not detected at default I2C address. Please check wiring.");
+      break;
+    }
+    LOG_I("gnss", "u-blox GNSS module connected");
+    read_receiver_identity(HAM_GNSS, gnss_identity);
+    boot_stage_ms[BOOT_GNSS_CONNECT] = millis();
+    boot_stage = BOOT_LBAND_CONNECT;
+    break;
+
+  case BOOT_LBAND_CONNECT:
+    if (now - boot_retry_ms < 500) break;
+    boot_retry_ms = now;
+    if (HAM_GNSS_L_Band.begin(0x43) == false) {
+      LOG_E("lband", "u-blox NEO-D9S not detected at default I2C address. Please check wiring.");
+      break;
+    }
+    LOG_I("lband", "u-blox NEO-D9S connected");
+    read_receiver_identity(HAM_GNSS_L_Band, lband_identity);
+    boot_stage_ms[BOOT_LBAND_CONNECT] = millis();
+    boot_stage = BOOT_RECEIVER_CONFIG;
+    break;
+
+  case BOOT_RECEIVER_CONFIG: {
+    uint32_t cfg_hash = receiver_cfg_hash();
+    // The receivers have no spare config key to hold the fingerprint, so it lives in NVS and each
+    // table is read back from the receiver's BBR in one VALGET as proof that it still holds the set.
+    // A wiped or partly written BBR misses keys or differs, and the set is applied again.
+    boot_cfg_reused = prefs.getUInt("cfg_hash", 0) == cfg_hash
+      && receiver_cfg_matches(HAM_GNSS_L_Band, lband_cfg, LBAND_CFG_COUNT)
+      && receiver_cfg_matches(HAM_GNSS, gnss_cfg, GNSS_CFG_COUNT);
+
+    // SPARTN keys are not part of the CFG database, they are loaded on every boot.
+    apply_spartn_keys(); // add encryption keys to decript NEO-DS9 messages.
+
+    if (boot_cfg_reused) {
+      LOG_I("boot", "Receiver configuration unchanged, skipping CFG-VALSET and reset.");
+    } else {
+      bool ok = apply_receiver_cfg(HAM_GNSS_L_Band, lband_cfg, LBAND_CFG_COUNT);
+      if (ok) LOG_I("lband", "L-Band configuration OK");
+      else LOG_E("lband", "L-Band configuration NOT OK!");
+      if (ok) HAM_GNSS_L_Band.softwareResetGNSSOnly();
+
+      bool gnss_ok = apply_receiver_cfg(HAM_GNSS, gnss_cfg, GNSS_CFG_COUNT);
+      if (gnss_ok) LOG_I("gnss", "GNSS configuration OK");
+      else LOG_E("gnss", "GNSS configuration NOT OK!");
+      if (gnss_ok) {
+        HAM_GNSS.softwareResetGNSSOnly();
+        if (convergence.start(CONVERGENCE_RESET, millis(), convergence_config())) save_convergence_run(convergence.ended());
+      }
+
+      if (ok && gnss_ok) prefs.putUInt("cfg_hash", cfg_hash); // only remember a set that fully applied
+    }
+
+    // NAV-PVT is pushed every epoch instead of polled, RAM layer only so it is not part of the fingerprint
+    HAM_GNSS.setAutoPVTcallbackPtr(&new_pvt_epoch, VAL_LAYER_RAM);
+    HAM_GNSS.setAutoNAVSATcallbackPtr(&new_nav_sat, VAL_LAYER_RAM);
+    HAM_GNSS.setAutoNAVSIGcallbackPtr(&new_nav_sig, VAL_LAYER_RAM);
+    HAM_GNSS.setAutoNAVSVINcallbackPtr(&new_nav_svin, VAL_LAYER_RAM);
+    //HAM_GNSS.setAutoRXMRAWXcallbackPtr(&newRAWX);
+    HAM_GNSS_L_Band.setAutoMONHWcallbackPtr(&new_lband_mon_hw, VAL_LAYER_RAM);
+    HAM_GNSS_L_Band.setVal8(UBLOX_CFG_MSGOUT_UBX_MON_HW_I2C, LBAND_MON_HW_EVERY, VAL_LAYER_RAM);
+
+    boot_stage_ms[BOOT_RECEIVER_CONFIG] = millis();
+    boot_stage = BOOT_WAIT_TELEMETRY; // loop() finishes the boot on the first PVT
+    set_rate_profile(prefs.getUChar("rate_profile", 0)); // needs gnss_ready() to reach the receiver
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+// FNV-1a over both configuration tables
+uint32_t receiver_cfg_hash() {
+  uint32_t hash = 2166136261u;
+  const ubx_cfg_item_t *tables[] = {lband_cfg, gnss_cfg};
+  const size_t counts[] = {LBAND_CFG_COUNT, GNSS_CFG_COUNT};
+
+  hash = (hash ^ RECEIVER_CFG_VERSION) * 16777619u;
+  for (int t = 0; t < 2; t++) {
+    for (size_t i = 0; i < counts[t]; i++) {
+      uint8_t bytes[12];
+      memcpy(bytes, &tables[t][i].key, 4);
+      memcpy(bytes + 4, &tables[t][i].value, 8);
+      for (int b = 0; b < 12; b++) {
+        hash = (hash ^ bytes[b]) * 16777619u;
+      }
+    }
+  }
+  return hash;
+}
+
+bool apply_receiver_cfg(SFE_UBLOX_GNSS &receiver, const ubx_cfg_item_t *items, size_t count) {
+  bool ok = receiver.newCfgValset(VAL_LAYER_RAM_BBR); // BBR so the set survives a reset
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = receiver.addCfgValset(items[i].key, items[i].value);
+  }
+  if (ok) ok = receiver.sendCfgValset();
+  return ok;
+}
+
+// One CFG-VALGET of the BBR layer for the whole table. The receiver leaves out keys the layer does
+// not hold (NAK when it holds none), so a missing key fails the extraction like a wrong value.
+bool receiver_cfg_matches(SFE_UBLOX_GNSS &receiver, const ubx_cfg_item_t *items, size_t count) {
+  bool ok = receiver.newCfgValget(VAL_LAYER_BBR);
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = receiver.addCfgValget(items[i].key);
+  }
+  if (ok) ok = receiver.sendCfgValget();
+  for (size_t i = 0; ok && i < count; i++) {
+    uint64_t value = 0; // little endian, the key's 1 to 8 bytes land in the low end
+    ok = receiver.extractConfigValueByKey(receiver.getCfgValget(), items[i].key, &value, sizeof(value)) && value == items[i].value;
+  }
+  return ok;
+}
+
+// SPARTN key store functions
+void load_spartn_store() {
+  if (prefs.getBytesLength("spartn_keys") == sizeof(spartn_keys)) {
+    prefs.getBytes("spartn_keys", spartn_keys, sizeof(spartn_keys));
+  }
+  lband_frequency = prefs.getUInt("lband_freq", LBand_frequency);
+
+  // a key file on the SD card takes precedence so keys can be rotated by swapping cards
+  if (SD.exists(SPARTN_KEY_FILE)) {
+    spartn_key_t file_keys[2] = {};
+    uint32_t file_frequency = lband_frequency;
+    int key_count = 0;
+
+    String line;
+    uint32_t offset = 0;
+    while (sd_cache_read_line(SPARTN_KEY_FILE, offset, line)) {
+      line.trim();
+      char hex[65] = "";
+      unsigned int wno = 0;
+      unsigned long tow = 0, frequency = 0;
+      if (sscanf(line.c_str(), "freq %lu", &frequency) == 1) {
+        file_frequency = frequency;
+      } else if (key_count < 2 && sscanf(line.c_str(), "key %u %lu %64s", &wno, &tow, hex) == 3 && is_valid_spartn_key(hex)
+                 && wno <= 0xffff && tow < 604800) {
+        strcpy(file_keys[key_count].key, hex);
+        file_keys[key_count].valid_from_wno = wno;
+        file_keys[key_count].valid_from_tow = tow;
+        key_count++;
+      }
+    }
+
+    if (key_count > 0) memcpy(spartn_keys, file_keys, sizeof(spartn_keys));
+    lband_frequency = file_frequency;
+    LOG_I("keys", "Loaded SPARTN keys from " SPARTN_KEY_FILE);
+    save_spartn_store(); // writes NVS only when the card's keys differ from it
+  }
+
+  lband_cfg[0].value = lband_frequency; // UBLOX_CFG_PMP_CENTER_FREQUENCY
+}
+
+// Only what differs from NVS is written, the key file is read on every boot and flash wears
+void save_spartn_store() {
+  spartn_key_t stored[2];
+  if (prefs.getBytes("spartn_keys", stored, sizeof(stored)) != sizeof(stored) || memcmp(stored, spartn_keys, sizeof(stored)) != 0) {
+    prefs.putBytes("spartn_keys", spartn_keys, sizeof(spartn_keys));
+  }
+  if (prefs.getUInt("lband_freq", 0) != lband_frequency) prefs.putUInt("lband_freq", lband_frequency);
+}
+
+// keep the SD copy in step with NVS so an old card does not roll the keys back on the next boot
+void write_spartn_key_file() {
+  sd_cache_invalidate(SPARTN_KEY_FILE);
+  File key_file = SD.open(SPARTN_KEY_FILE, FILE_WRITE);
+  if (!key_file) return;
+  key_file.print("freq ");
+  key_file.println(lband_frequency);
+  for (int i = 0; i < 2; i++) {
+    if (spartn_keys[i].key[0] == '\0') continue;
+    key_file.print("key ");
+    key_file.print(spartn_keys[i].valid_from_wno);
+    key_file.print(" ");
+    key_file.print(spartn_keys[i].valid_from_tow);
+    key_file.print(" ");
+    key_file.println(spartn_keys[i].key);
+  }
+  key_file.close();
+}
+
+// RXM-SPARTNKEY takes effect immediately, no GNSS reset needed
+bool apply_spartn_keys() {
+  bool ok;
+  if (spartn_keys[1].key[0] != '\0') {
+    ok = HAM_GNSS.setDynamicSPARTNKeys(16, spartn_keys[0].valid_from_wno, spartn_keys[0].valid_from_tow, spartn_keys[0].key,
+                                       16, spartn_keys[1].valid_from_wno, spartn_keys[1].valid_from_tow, spartn_keys[1].key);
+  } else {
+    ok = HAM_GNSS.setDynamicSPARTNKey(16, spartn_keys[0].valid_from_wno, spartn_keys[0].valid_from_tow, spartn_keys[0].key);
+  }
+  if (!ok) LOG_E("keys", "Failed to load SPARTN keys.");
+  return ok;
+}
+
+bool apply_lband_frequency(uint32_t frequency) {
+  // VALSET to RAM and BBR, the PMP receiver retunes without a reset
+  if (!HAM_GNSS_L_Band.setVal32(UBLOX_CFG_PMP_CENTER_FREQUENCY, frequency, VAL_LAYER_RAM_BBR)) {
+    LOG_E("lband", "Failed to set L-Band frequency.");
+    return false;
+  }
+  lband_frequency = frequency;
+  lband_cfg[0].value = frequency;
+  convergence.set_config(convergence_config());
+  save_spartn_store();
+  write_spartn_key_file();
+  prefs.putUInt("cfg_hash", receiver_cfg_hash()); // the receiver now holds this set, keep the next boot fast
+  LOG_I("lband", "L-Band frequency set to %lu", (unsigned long)frequency);
+  return true;
+}
+
+bool set_spartn_keys(const spartn_key_t &current, const spartn_key_t &next) {
+  if (!is_valid_spartn_key(current.key) || (next.key[0] != '\0' && !is_valid_spartn_key(next.key))) {
+    return false;
+  }
+  spartn_keys[0] = current;
+  spartn_keys[1] = next;
+  spartn_expiry_warned = false;
+  convergence.set_config(convergence_config());
+  save_spartn_store();
+  write_spartn_key_file();
+  return !gnss_ready() || apply_spartn_keys(); // applied by the boot sequencer otherwise
+}
+
+// GPS week and time of week (s) a key becomes valid from
+bool is_valid_spartn_start(int32_t wno, int32_t tow) {
+  return wno >= 0 && wno <= 0xffff && tow >= 0 && tow < 604800;
+}
+
+bool is_valid_spartn_key(const char *key) {
+  if (strlen(key) != 32) return false;
+  for (int i = 0; i < 32; i++) {
+    if (!isxdigit((unsigned char)key[i])) return false;
+  }
+  return true;
+}
+
+// Called about once a minute from the epoch stream. The F9P switches to the next key by itself once both are
+// loaded, this promotes it in the store and warns while there is still time to fetch the one after.
+void spartn_key_rollover_check() {
+  uint16_t wno;
+  uint32_t tow;
+  const gnss_epoch_t &epoch = latest_epoch;
+  if (!epoch.date_valid || !epoch.time_valid) return;
+  if (!gps_week_from_utc(epoch.year, epoch.month, epoch.day, epoch.hour, epoch.minute, epoch.second, &wno, &tow)) return;
+
+  uint64_t now_s = (uint64_t)wno * 604800 + tow;
+  spartn_key_t &next = spartn_keys[1];
+  if (next.key[0] != '\0' && now_s >= (uint64_t)next.valid_from_wno * 604800 + next.valid_from_tow) {
+    LOG_I("keys", "SPARTN key rollover, next key is now current.");
+    spartn_keys[0] = next;
+    memset(&next, 0, sizeof(next));
+    save_spartn_store();
+    write_spartn_key_file();
+  }
+
+  uint64_t expires_s = (uint64_t)(spartn_keys[0].valid_from_wno + SPARTN_KEY_WEEKS) * 604800 + spartn_keys[0].valid_from_tow;
+  if (next.key[0] == '\0' && !spartn_expiry_warned && now_s + SPARTN_KEY_WARN_DAYS * 86400ull >= expires_s) {
+    String jsonString = "";
+    JsonObject object = json_doc_tx.to<JsonObject>();
+    object["alert"] = "SPARTN key expires soon and no next key is loaded. Load new keys to avoid losing corrections.";
+    object["spartn_key_expiring"] = (uint32_t)(expires_s > now_s ? expires_s - now_s : 0);
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+    display_info("SPARTN key expiring, load next key");
+    spartn_expiry_warned = true;
+  }
+}
+
+// Seconds from the GPS epoch (1980-01-06) to a UTC time, leap seconds not counted
+bool utc_seconds_since_gps_epoch(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint32_t *seconds) {
+  if (year < 1980 || month < 1 || month > 12) return false;
+  // days since 1970-01-01 (civil calendar), then shift to the GPS epoch 1980-01-06
+  int32_t y = year - (month <= 2);
+  int32_t era = y / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int32_t days = era * 146097 + doe - 719468 - 3657;
+  *seconds = (uint32_t)days * 86400 + hour * 3600 + minute * 60 + second;
+  return true;
+}
+
+bool gps_week_from_utc(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, uint16_t *wno, uint32_t *tow) {
+  uint32_t utc_seconds;
+  if (!utc_seconds_since_gps_epoch(year, month, day, hour, minute, second, &utc_seconds)) return false;
+  uint32_t gps_seconds = utc_seconds + gps_leap_seconds;
+  *wno = gps_seconds / 604800;
+  *tow = gps_seconds % 604800;
+  return true;
+}
+
+// The PVT carries GPS time of week (iTOW) and UTC, their difference on a whole second is the
+// receiver's GPS-UTC offset, no NAV-TIMELS poll needed. Other epochs have a UTC fraction to round.
+void update_gps_leap_seconds(const gnss_epoch_t &epoch) {
+  uint32_t utc_seconds;
+  if (!epoch.date_valid || !epoch.time_valid || epoch.iTOW % 1000 != 0) return;
+  if (!utc_seconds_since_gps_epoch(epoch.year, epoch.month, epoch.day, epoch.hour, epoch.minute, epoch.second, &utc_seconds)) return;
+  int32_t leap = (int32_t)(epoch.iTOW / 1000) - (int32_t)(utc_seconds % 604800);
+  if (leap < -302400) leap += 604800; // GPS already in the next week
+  if (leap < 0 || leap > 60 || leap == gps_leap_seconds) return; // not plausible, or no change
+  LOG_I("gnss", "GPS-UTC offset %ld s from the receiver", (long)leap);
+  gps_leap_seconds = leap;
+}
+
+// client_num < 0 broadcasts the report
+void send_boot_report(int client_num) {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+
+  object["boot_time_ms"] = boot_stage == BOOT_DONE ? boot_stage_ms[BOOT_WAIT_TELEMETRY] : 0;
+  object["boot_gnss_ms"] = boot_stage_ms[BOOT_GNSS_CONNECT];
+  object["boot_lband_ms"] = boot_stage_ms[BOOT_LBAND_CONNECT];
+  object["boot_config_ms"] = boot_stage_ms[BOOT_RECEIVER_CONFIG];
+  object["boot_config"] = boot_cfg_reused ? "reused" : "applied";
+  object["session_resumed_ms"] = session_resumed_ms;
+  object["next_gcp"] = next_gcp_index;
+  serializeJson(object, jsonString);
+
+  if (client_num < 0) {
+    LOG_I("boot", "Boot report: first epoch at %lu ms, receiver configuration %s", (unsigned long)boot_stage_ms[BOOT_WAIT_TELEMETRY], boot_cfg_reused ? "reused" : "applied");
+    ws_broadcast(jsonString);
+  } else {
+    ws_send(client_num, jsonString);
+  }
+}
+
+// Routes
+void send_page(const http_request_t &request, const String &page) {
+  http.send(request, 200, "text/html", page.c_str(), page.length());
+}
+
+void handle_OnConnect(const http_request_t &request) {
+  LOG_D("http", "Client Connected to ESP32 Web Server.");
+  display_info_lg("Stand By Mode");
+  send_page(request, Send_Index_HTML());
+}
+
+void handle_NotFound(const http_request_t &request) {
+  http.send(request, 404, "text/plain", "URL End Point Not found");
+}
+
+void handle_start_survey(const http_request_t &request) {
+  display_info_lg("Starting Survey..");
+  send_page(request, Send_Start_Survey_HTML());
+}
+
+void handle_view_survey_log(const http_request_t &request) {
+  display_info_lg("Survey log displaying on web dash");
+  send_page(request, Send_Survey_Log_HTML());
+}
+
+void handle_gnss_info(const http_request_t &request) {
+  display_info_lg("GNSS Info displaying on web dash");
+  send_page(request, Send_GNSS_Info_HTML());
+}
+
+void handle_device_files(const http_request_t &request) {
+  display_info_lg("Device files displaying on web dash");
+  send_page(request, Send_Device_Files_HTML());
+}
+
+// /download?file=/path streams a file off the SD card a block at a time, however big it is
+void handle_download(const http_request_t &request) {
+  String path = request.arg("file").c_str();
+  if (path.length() == 0 || !SD.exists(path)) {
+    http.send(request, 404, "text/plain", "File not found");
+    return;
+  }
+  std::shared_ptr<File> file = std::make_shared<File>(SD.open(path, FILE_READ));
+  if (!*file || file->isDirectory()) {
+    http.send(request, 404, "text/plain", "File not found");
+    return;
+  }
+  http.send_stream(request, 200, "application/octet-stream", [file](uint8_t *buffer, size_t size) -> size_t {
+    int n = size > 0 ? file->read(buffer, size) : 0;
+    if (n > 0) return n;
+    file->close();
+    return 0;
+  }, file->size());
+}
+
+
+
+// Website HTML
+String Send_Index_HTML() {
+  String page = "<!DOCTYPE html> <html>\n";
+  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
+  page += "<title>HAM-GNSS-Reciever</title>\n";
+  page += "</head>\n";
+  page += "<body>\n";
+  page += WebsiteBaseCSS();
+  page += "<h1 style=\"text-align: center; font-weight: bold;\">High Altitude Media GNSS Reciver</h1>\n";
+  page += "<a href=\"start_survey\" class=\"button-link\">Start Survey</a>\n";
+  page += "<a href=\"view_survey_log\" class=\"button-link\">View Survey Log</a>\n";
+  page += "<a href=\"gnss_info\" class=\"button-link\">GNSS Info</a>";
+  page += "<a href=\"device_files\" class=\"button-link\">Device Files</a>\n";
+  const gnss_epoch_t &epoch = latest_epoch;
+  bool have_epoch = boot_stage == BOOT_DONE;
+  page += "<h4 style=\"text-align: center;\">Latitude & Longitude Cordinates: </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += have_epoch ? String(epoch.lat * 1e-7, 7) + ", " + String(epoch.lon * 1e-7, 7) : String("Waiting for the receiver");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Fix Type : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += have_epoch ? get_fix_type() + ", " + get_RTK_status() : String("-");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Heading : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += have_epoch ? String(epoch.headMot * 1e-5, 1) + " deg " + get_heading() : String("-");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Mean Sea Level : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += have_epoch ? String(epoch.hMSL / 1000.0, 3) + " m" : String("-");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Measurement rate : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += String(rate_profiles[rate_profile].meas_rate_ms) + " ms (" + rate_profiles[rate_profile].name + ")";
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Elipsoid : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += have_epoch ? String(epoch.height / 1000.0, 3) + " m" : String("-");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Altitude : </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += "Altitude: ";
+  page += have_epoch ? String(epoch.height / 1000.0, 3) + " m" : String("-");
+  page += ", Mean Sea Level Alitutude: ";
+  page += have_epoch ? String(epoch.hMSL / 1000.0, 3) + " m" : String("-");
+  page += "</p>\n";
+  page += "<p style=\"margin-top:10px;\">Created By Zion Johnson </p> <a href=\"https://github.com/zion379\" class=\"button-link\">Github Portfolio</a>\n";
   page += "</body>\n";
-  page += Files_Client_WebSocketJS();
   page += "</html>\n";
 
   return page;
 }
 
-// Web scripts
-String Survey_Client_WebSocketJS() {
-  String script = "<script>\n";
-  script += "var Socket;\n";
-  script += "\n";
-  script += "document.getElementById('start_survey').addEventListener('click', start_survey);\n";
-  script += "function start_survey() {\n";
-  script += " var message = {survey: 'START'};\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "\n";
-  script += "document.getElementById('stop_survey').addEventListener('click', stop_survey);\n";
-  script += "function stop_survey() {\n";
-  script += " var message = {survey: 'STOP'};\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "document.getElementById('set_target_accuracy').addEventListener('click', set_target_accuracy);\n";
-  script += "function set_target_accuracy() {\n";
-  script += " var target_accuracy_input = document.getElementById('target_accuracy_input');\n";
-  script += " var message = {set_target_accuracy: target_accuracy_input.value};\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "document.getElementById('save_survey_btn').addEventListener('click', save_survey);\n";
-  script += "function save_survey() {\n";
-  script += " alert('Saving Survey to SD Storage.');\n"; // Left off here working on saving survey to SD functionality
-  script += " current_gcp_index = document.getElementById('gcp_index_input').value;\n";
-  script += " var message = {save: 'survey', gcp_index: current_gcp_index};\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "\n";
-  script += "document.getElementById('reconnect_web_socket').addEventListener('click', reconnect_web_socket);\n";
-  script += "function reconnect_web_socket() {\n";
-  script += " init();\n";
-  script += " alert('Reconnecting WebSocket');\n";
-  script += "}\n";
-  script += "function init() {\n";
-  script += " Socket = new WebSocket('ws://' + window.location.hostname + ':81/');\n";
-  script += " Socket.addEventListener('open', (event) => {\n";
-  script += "   var start_survey_btn = document.getElementById('start_survey');\n";
-  script += "   var stop_survey_btn = document.getElementById('stop_survey');\n";;
-  script += "   start_survey_btn.disabled = false;\n";
-  script += "   stop_survey_btn.disabled = false;\n";
-  script += "   document.getElementById('reconnect_web_socket').style.display = 'none';\n";
-  script += " });\n";
-  script += " Socket.addEventListener('close', (event) => {\n";
+String Send_Start_Survey_HTML() {
+  String page = "<!DOCTYPE html> <html>\n";
+  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
+  page += "<title>HAM-GNSS-Reciever</title>\n";
+  page += "</head>\n";
+  page += "<body>\n";
+  page += WebsiteBaseCSS();
+  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
+  page += "<h3 style=\"text-align: center;\"> Start Survey </h3>\n";
+  page += "<h4 style=\"text-align: center;\"> Survey Status: <span id='survey_status'>inactive</span> </h4>\n";
+  page += "<h4 id='survey_msg' style='display: none; text-align: center;'></h4>\n";
+  page += "<h4 id='survey_time' style='display: none; text-align: center;'></h4>\n";
+  page += "<h4 id='survey_accuracy' style='display: none; text-align: center;'></h4>\n";
+  page += "<div style='text-align: center;'><canvas id='hacc_chart' width='320' height='100' style='border: 1px solid #ccc;'></canvas></div>\n";
+  page += "<div style='justify-content: center; display: flex;'\n>";
+  page += " <label id='accuracy_input_label' for='target_accuracy_input'>Enter Target Accuracy:</label>\n";
+  page += " <h5 id='survey_desired_accuracy' style='display: none; text-align: center; font-weight: bold;'></h5>\n";
+  page += " <input type='number' id='target_accuracy_input' name='target_accuracy_input' min='0.08' max='100'>\n";
+  page += " <button type='button' id='set_target_accuracy' style='text-align: center;'> Set Target Accuracy </button>\n";
+  page += "</div>\n";
+  page += "<div style='justify-content: center; display: flex;'>\n";
+  page += " <h5 id='pos_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
+  page += " <h5 id='vert_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
+  page += " <h5 id='horz_accuracy' style='display: none; text-align: center; font-weight: bold; margin: 2em;'></h5>\n";
+  page += "</div>\n";
+  page += "<p style=\"text-align: center;\">Latitude: <span id='latitude'> lat value </span> , Longitude: <span id='longitude'> long val</span></p>\n";
+  page += "<p style=\"text-align: center;\">Altitude : <span id='altitude'> altitude value </span></p>\n";
+  page += "<p style=\"text-align: center;\">Altitude above MSL : <span id='altitude_msl'> MSL Altitude Val</p>\n";
+  page += "<h5 id='mean_sea_lvl' style='display: none; text-align: center; font-weight: bold;'></h5>\n";
+  page += "<div id='reciever_info' style='display: none; justify-content: space-evenly;'>\n";
+  page += " <div style='justify-content: space-evenly;'>\n";
+  page += "   <h4 id='fix_type' style='margin: 5px;'></h4>\n";
+  page += "   <h4 id='RTK' style='margin: 5px;'></h4>\n";
+  page += " </div>\n";
+  page += " <h4 id='heading' style='margin: 5px;'></h4>\n";
+  page += " <h4 id='PDOP' style='margin: 5px;'></h4>\n";
+  page += " <h4 id='SIV_status' style='margin: 5px;'></h4>\n";
+  page += "</div>\n";
+  page += "<div style='text-align: center; margin-top: 15px;'>\n";
+  page += " <button type='button' id='save_survey_btn' style='display: none;'>Save Survey</button>\n";
+  page += " <label id='gcp_index_label' for='gcp_index_input'>GCP Index:</label>\n";
+  page += " <input type='number' id='gcp_index_input' name='gcp_index_input' min='1' max='100'>\n";
+  page += "</div>\n";
+  page += "<div id='batch_survey' style='text-align: center; margin-top: 15px;'>\n";
+  page += " <h4 style='text-align: center;'>Batch Survey: <span id='batch_status'>inactive</span></h4>\n";
+  page += " <h5 id='batch_progress' style='display: none; text-align: center;'></h5>\n";
+  page += " <div id='rtk_alert' style='display: none; text-align: center; color: red;'>\n";
+  page += "  <h4 id='rtk_alert_text' style='margin: 5px;'></h4>\n";
+  page += "  <button type='button' id='accept_rtk_solution'> Accept Solution </button>\n";
+  page += " </div>\n";
+  page += " <label for='batch_plan_input'>Plan File:</label>\n";
+  page += " <input type='text' id='batch_plan_input' name='batch_plan_input' placeholder='/gcp_plan.txt'>\n";
+  page += " <button type='button' id='start_batch_survey' disabled> Start Batch </button>\n";
+  page += " <button type='button' id='stop_batch_survey' disabled> Stop Batch </button>\n";
+  page += "</div>\n";
+  page += "<div id='track_log' style='text-align: center; margin-top: 15px;'>\n";
+  page += " <h4 style='text-align: center;'>Track Log: <span id='track_log_status'>stopped</span></h4>\n";
+  page += " <button type='button' id='start_track_log' disabled> Start Track </button>\n";
+  page += " <button type='button' id='stop_track_log' disabled> Stop Track </button>\n";
+  page += "</div>\n";
+  page += "<div id='event_marks' style='text-align: center; margin-top: 15px;'>\n";
+  page += " <h4 style='text-align: center;'>Camera Events: <span id='event_marks_status'>stopped</span></h4>\n";
+  page += " <button type='button' id='start_event_marks' disabled> Start Events </button>\n";
+  page += " <button type='button' id='stop_event_marks' disabled> Stop Events </button>\n";
+  page += "</div>\n";
+  page += "<div id='stakeout' style='text-align: center; margin-top: 15px;'>\n";
+  page += " <h4 style='text-align: center;'>Stakeout: <span id='stakeout_status'>stopped</span></h4>\n";
+  page += " <h3 id='stakeout_offsets' style='display: none; text-align: center;'></h3>\n";
+  page += " <label for='stakeout_file_input'>Point File:</label>\n";
+  page += " <input type='text' id='stakeout_file_input' name='stakeout_file_input' placeholder='/test_survey04.txt'>\n";
+  page += " <button type='button' id='load_stakeout' disabled> Load Points </button>\n";
+  page += " <button type='button' id='stop_stakeout' disabled> Stop Stakeout </button>\n";
+  page += " <br><label for='stakeout_point_input'>Point:</label>\n";
+  page += " <input type='text' id='stakeout_point_input' name='stakeout_point_input' placeholder='GCP12'>\n";
+  page += " <button type='button' id='select_stakeout_point' disabled> Go To Point </button>\n";
+  page += " <button type='button' id='nearest_stakeout_point' disabled> Nearest </button>\n";
+  page += "</div>\n";
+  page += "<button type='button' id='start_survey' disabled> Start Survey </button>\n";
+  page += "<button type='button' id='stop_survey' disabled> Stop Survey </button>\n";
+  page += "<button id='reconnect_web_socket' onclick='reconnect_web_socket' style='display:none;'>Reconnect WebSocket</button>\n";
+  page += Survey_Client_WebSocketJS(); // returns string that is valid HTML
+  page += "<a href=\"/\" class=\"button-link\">Home</a>\n";
+  page += "</body>\n";
+  page += "</html>\n";
+
+  return page;
+}
+
+String Send_Survey_Log_HTML() {
+  String page = "<!DOCTYPE html> <html>\n";
+  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
+  page += "<title>HAM-GNSS-Reciever</title>\n";
+  page += "</head>\n";
+  page += "<body>\n";
+  page += WebsiteBaseCSS();
+  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
+  page += "<h3 style=\"text-align: center;\"> Survey Log </h3>\n";
+  page += "<p style=\"text-align: center;\">This Functionality is still being created will be avaible soon.</p>\n";
+  page += "<a href=\"/\" class=\"button-link\">Home<\a>\n";
+  page += "</body>\n";
+  page += "</html>\n";
+
+  return page;
+}
+
+String Send_GNSS_Info_HTML() {
+  String page = "<!DOCTYPE html> <html>\n";
+  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
+  page += "<title>HAM-GNSS-Reciever</title>\n";
+  page += "</head>\n";
+  page += "<body>\n";
+  page += WebsiteBaseCSS();
+  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
+  page += "<h3 style=\"text-align: center;\"> GNSS INFO </h3>\n";
+  const char *antenna_states[] = {"Init", "Unknown", "OK", "Short", "Open"};
+  page += receiver_identity_HTML("GNSS Reciever Module", gnss_identity);
+  page += receiver_identity_HTML("GNSS Reciever Module 2", lband_identity);
+  page += "<h4 style=\"text-align: center;\">Antenna Status: </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += lband_identity.valid && lband_antenna_status <= 4 ? antenna_states[lband_antenna_status] : "-";
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Antenna Heading: </h4>\n";
+  page += "<p style=\"text-align: center;\">";
+  page += boot_stage == BOOT_DONE ? String(latest_epoch.headMot * 1e-5, 1) + " deg" : String("-");
+  page += "</p>\n";
+  page += "<h4 style=\"text-align: center;\">Satellites and Signals: </h4>\n";
+  page += "<p id='signal_summary' style=\"text-align: center;\">Waiting for NAV-SAT/NAV-SIG</p>\n";
+  page += "<div style='text-align: center;'><canvas id='skyplot' width='240' height='240'></canvas></div>\n";
+  page += "<div style='text-align: center;'><canvas id='cno_bars' width='320' height='140' style='border: 1px solid #ccc;'></canvas></div>\n";
+  page += "<h4 style=\"text-align: center;\">Time to Fix: </h4>\n";
+  page += "<p id='convergence_summary' style=\"text-align: center;\">s to 3D / corrections / float / fixed, satellites and hAcc at fixed</p>\n";
+  page += "<table id='convergence_table' style='margin: auto;'></table>\n";
+  page += "<div style='text-align: center;'><button type='button' id='convergence_reset'> Reset GNSS and Time It </button></div>\n";
+  page += "<a href=\"/\" class=\"button-link\" >Home</a>\n";
+  page += Signals_Client_WebSocketJS();
+  page += "</body>\n";
+  page += "</html>\n";
+  return page;
+}
+
+String Send_Device_Files_HTML() {
+  String page = "<!DOCTYPE html> <html>\n";
+  page += "<head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0, user-scalable=no\">\n";
+  page += "<title>HAM-GNSS-Reciever</title>\n";
+  page += "</head>\n";
+  page += "<body>\n";
+  page += WebsiteBaseCSS();
+  page += "<h1 style=\"text-align: center; font-weight: bold\">High Altitude Media GNSS Reciver</h1>\n";
+  page += "<h3 style=\"text-align: center;\"> Device Files </h3>\n";
+  page += "<h4 style=\"text-align: center;\">Folders on GNSS Reciever:</h4>\n";
+  page += "<h5 style='text-align: center;'>current directory: <span id='current_directory'>";
+  page += file_view_directory;
+  page += "</span></h5>\n";
+  page += "<div id='file_list_view'>\n";
+  page += listFiles_HTML("/");
+  page += "</div>\n";
+  page += "<div id='file_btn_controls' style='text-align: center; display: none; margin-top: 2em;'>\n";
+  page += " <label for='new_file_name_input'>New File Name:</label>\n";
+  page += " <input type='text' id='new_file_name_input' name='new_file_name_input'></input>\n";
+  page += " <button type='button' id='create_file_btn' disabled>Create File</button>\n";
+  page += " <button type='button' id='delete_file_btn' disabled>Delete File</button>\n";
+  page += "</div>\n";
+  page += "<div id='directory_nav_controls'>\n";
+  page += "<button id='nav_previous_directory'>Navigate to parent folder</button>";
+  page += "</div>\n";
+  page += "<a href=\"/\" class=\"button-link\">Home</a>\n";
+  page += "<button id='reconnect_web_socket' onclick='reconnect_web_socket()' style='display:none;'>Reconnect WebSocket</button>\n";
+  page += "</body>\n";
+  page += Files_Client_WebSocketJS();
+  page += "</html>\n";
+
+  return page;
+}
+
+// Web scripts
+String Survey_Client_WebSocketJS() {
+  String script = "<script>\n";
+  script += "var Socket;\n";
+  script += "\n";
+  script += "document.getElementById('start_survey').addEventListener('click', start_survey);\n";
+  script += "function start_survey() {\n";
+  script += " var message = {cmd: 'survey', action: 'START'};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "\n";
+  script += "document.getElementById('stop_survey').addEventListener('click', stop_survey);\n";
+  script += "function stop_survey() {\n";
+  script += " var message = {cmd: 'survey', action: 'STOP'};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "document.getElementById('set_target_accuracy').addEventListener('click', set_target_accuracy);\n";
+  script += "function set_target_accuracy() {\n";
+  script += " var target_accuracy_input = document.getElementById('target_accuracy_input');\n";
+  script += " var message = {cmd: 'set_target_accuracy', value: Number(target_accuracy_input.value)};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "var telemetry = {};\n"; // per topic {seq, names, values}, see TelemetryDelta.h
+  script += "function apply_telemetry(msg) {\n"; // returns the merged fields, or null until a keyframe arrived
+  script += " var t = telemetry[msg.t];\n";
+  script += " if (msg.k) {\n";
+  script += "   t = telemetry[msg.t] = {seq: msg.q, names: msg.k, values: msg.v};\n";
+  script += " } else {\n";
+  script += "   if (!t || msg.q != t.seq + 1) Socket.send(JSON.stringify({cmd: 'telemetry_keyframe', topic: msg.t}));\n"; // a patch was lost
+  script += "   if (!t) return null;\n";
+  script += "   for (var i = 0; i + 1 < msg.d.length; i += 2) t.values[msg.d[i]] = msg.d[i + 1];\n";
+  script += "   t.seq = msg.q;\n";
+  script += " }\n";
+  script += " var obj = {};\n";
+  script += " t.names.forEach(function(name, i) { if (t.values[i] !== null) obj[name] = t.values[i]; });\n";
+  script += " return obj;\n";
+  script += "}\n";
+  script += "var history_points = [];\n";
+  script += "function read_varint(bytes, pos) {\n"; // returns [value, next position]
+  script += " var value = 0, shift = 0, b;\n";
+  script += " do { b = bytes[pos++]; value += (b & 0x7f) * Math.pow(2, shift); shift += 7; } while (b & 0x80);\n";
+  script += " return [value, pos];\n";
+  script += "}\n";
+  script += "function zigzag(v) { return (v % 2) ? -(v + 1) / 2 : v / 2; }\n";
+  script += "function decode_history(buffer) {\n"; // see EpochHistory.h for the block layout
+  script += " var view = new DataView(buffer), bytes = new Uint8Array(buffer);\n";
+  script += " if (bytes[0] != 72) return;\n"; // 'H'
+  script += " var now_ms = view.getUint32(4, true), pos = 10, points = [];\n";
+  script += " if (view.getUint16(2, true) == 0) history_points = [];\n";
+  script += " while (pos + 30 <= bytes.length) {\n";
+  script += "   var p = {t: view.getUint32(pos, true), lat: view.getInt32(pos + 4, true), lon: view.getInt32(pos + 8, true), h: view.getInt32(pos + 12, true),\n";
+  script += "            hAcc: view.getUint32(pos + 16, true), vAcc: view.getUint32(pos + 20, true), status: bytes[pos + 24], sv: bytes[pos + 25]};\n";
+  script += "   var count = view.getUint16(pos + 26, true), end = pos + 30 + view.getUint16(pos + 28, true), r;\n";
+  script += "   pos += 30;\n";
+  script += "   points.push(Object.assign({}, p));\n";
+  script += "   for (var i = 1; i < count && pos < end; i++) {\n";
+  script += "     r = read_varint(bytes, pos); pos = r[1]; var head = r[0];\n";
+  script += "     var d = [];\n";
+  script += "     for (var k = 0; k < 5; k++) { r = read_varint(bytes, pos); pos = r[1]; d.push(zigzag(r[0])); }\n";
+  script += "     p.t += Math.floor(head / 4); p.lat += d[0]; p.lon += d[1]; p.h += d[2]; p.hAcc += d[3]; p.vAcc += d[4];\n";
+  script += "     if (head & 1) p.status = bytes[pos++];\n";
+  script += "     if (head & 2) p.sv = bytes[pos++];\n";
+  script += "     points.push(Object.assign({}, p));\n";
+  script += "   }\n";
+  script += "   pos = end;\n";
+  script += " }\n";
+  script += " points.forEach(function(p) { p.t = Date.now() - (now_ms - p.t); });\n"; // device millis to wall clock, same as live points
+  script += " history_points = history_points.concat(points);\n";
+  script += " draw_hacc_chart();\n";
+  script += "}\n";
+  script += "function draw_hacc_chart() {\n"; // horizontal accuracy, log scale, oldest on the left
+  script += " var canvas = document.getElementById('hacc_chart'), ctx = canvas.getContext('2d');\n";
+  script += " ctx.clearRect(0, 0, canvas.width, canvas.height);\n";
+  script += " if (history_points.length < 2) return;\n";
+  script += " var t0 = history_points[0].t, t1 = history_points[history_points.length - 1].t;\n";
+  script += " ctx.beginPath();\n";
+  script += " history_points.forEach(function(p, i) {\n";
+  script += "   var x = (p.t - t0) / Math.max(1, t1 - t0) * canvas.width;\n";
+  script += "   var y = canvas.height - Math.log10(Math.max(1, p.hAcc)) / 5 * canvas.height;\n"; // 1 mm .. 100 m
+  script += "   if (i == 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);\n";
+  script += " });\n";
+  script += " ctx.stroke();\n";
+  script += "}\n";
+  script += "document.getElementById('start_track_log').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'track_log', action: 'START'})); });\n";
+  script += "document.getElementById('stop_track_log').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'track_log', action: 'STOP'})); });\n";
+  script += "document.getElementById('start_event_marks').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'event_marks', action: 'START'})); });\n";
+  script += "document.getElementById('stop_event_marks').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'event_marks', action: 'STOP'})); });\n";
+  script += "document.getElementById('load_stakeout').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'stakeout', action: 'LOAD', file: document.getElementById('stakeout_file_input').value})); });\n";
+  script += "document.getElementById('stop_stakeout').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'stakeout', action: 'STOP'})); });\n";
+  script += "document.getElementById('select_stakeout_point').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'stakeout', action: 'SELECT', point: document.getElementById('stakeout_point_input').value})); });\n";
+  script += "document.getElementById('nearest_stakeout_point').addEventListener('click', function() { Socket.send(JSON.stringify({cmd: 'stakeout', action: 'NEAREST'})); });\n";
+  script += "document.getElementById('start_batch_survey').addEventListener('click', start_batch_survey);\n";
+  script += "function start_batch_survey() {\n";
+  script += " var message = {cmd: 'batch_survey', action: 'START', plan_file: document.getElementById('batch_plan_input').value, gcp_index: parseInt(document.getElementById('gcp_index_input').value) || undefined};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "document.getElementById('stop_batch_survey').addEventListener('click', stop_batch_survey);\n";
+  script += "function stop_batch_survey() {\n";
+  script += " var message = {cmd: 'batch_survey', action: 'STOP'};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "document.getElementById('accept_rtk_solution').addEventListener('click', accept_rtk_solution);\n";
+  script += "function accept_rtk_solution() {\n"; // points held by the RTK alert can complete on the current solution
+  script += " var message = {cmd: 'rtk_alert', action: 'CLEAR'};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += " document.getElementById('rtk_alert').style.display = 'none';\n";
+  script += "}\n";
+  script += "document.getElementById('save_survey_btn').addEventListener('click', save_survey);\n";
+  script += "function save_survey() {\n";
+  script += " alert('Saving Survey to SD Storage.');\n"; // Left off here working on saving survey to SD functionality
+  script += " current_gcp_index = document.getElementById('gcp_index_input').value;\n";
+  script += " var message = {cmd: 'save_survey', gcp_index: parseInt(current_gcp_index)};\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "\n";
+  script += "document.getElementById('reconnect_web_socket').addEventListener('click', reconnect_web_socket);\n";
+  script += "function reconnect_web_socket() {\n";
+  script += " init();\n";
+  script += " alert('Reconnecting WebSocket');\n";
+  script += "}\n";
+  script += "function init() {\n";
+  script += " Socket = new WebSocket('ws://' + window.location.host + '/ws');\n";
+  script += " Socket.binaryType = 'arraybuffer';\n";
+  script += " Socket.addEventListener('open', (event) => {\n";
+  script += "   var start_survey_btn = document.getElementById('start_survey');\n";
+  script += "   var stop_survey_btn = document.getElementById('stop_survey');\n";;
+  script += "   start_survey_btn.disabled = false;\n";
+  script += "   stop_survey_btn.disabled = false;\n";
+  script += "   document.getElementById('start_batch_survey').disabled = false;\n";
+  script += "   document.getElementById('stop_batch_survey').disabled = false;\n";
+  script += "   document.getElementById('start_track_log').disabled = false;\n";
+  script += "   document.getElementById('stop_track_log').disabled = false;\n";
+  script += "   document.getElementById('start_event_marks').disabled = false;\n";
+  script += "   document.getElementById('stop_event_marks').disabled = false;\n";
+  script += "   ['load_stakeout', 'stop_stakeout', 'select_stakeout_point', 'nearest_stakeout_point'].forEach(function(id) { document.getElementById(id).disabled = false; });\n";
+  script += "   document.getElementById('reconnect_web_socket').style.display = 'none';\n";
+  script += " });\n";
+  script += " Socket.addEventListener('close', (event) => {\n";
   script += "   var start_survey_btn = document.getElementById('start_survey');\n";
   script += "   var stop_survey_btn = document.getElementById('stop_survey');\n";
   script += "   start_survey_btn.disabled = true;\n";
   script += "   stop_survey_btn.disabled = true;\n";
+  script += "   document.getElementById('start_batch_survey').disabled = true;\n";
+  script += "   document.getElementById('stop_batch_survey').disabled = true;\n";
+  script += "   document.getElementById('start_track_log').disabled = true;\n";
+  script += "   document.getElementById('stop_track_log').disabled = true;\n";
+  script += "   document.getElementById('start_event_marks').disabled = true;\n";
+  script += "   document.getElementById('stop_event_marks').disabled = true;\n";
+  script += "   ['load_stakeout', 'stop_stakeout', 'select_stakeout_point', 'nearest_stakeout_point'].forEach(function(id) { document.getElementById(id).disabled = true; });\n";
   script += "   document.getElementById('reconnect_web_socket').style.display = 'block';\n";
   script += " });\n";
   script += " Socket.onmessage = function(event) { //callback func\n";
@@ -599,12 +2194,26 @@ String Survey_Client_WebSocketJS() {
   script += " };\n";
   script += "}\n";
   script += "function processCommand(event) {\n"; // update elements with data
+  script += " if (event.data instanceof ArrayBuffer) { decode_history(event.data); return; }\n";
   script += " var obj = JSON.parse(event.data)\n";
+  script += " if (obj.q !== undefined) { obj = apply_telemetry(obj); if (!obj) return; }\n";
+  script += " if (obj.cmd_rejected !== undefined) { alert('Command ' + obj.cmd_rejected + ' rejected: ' + obj.cmd_error); return; }\n";
+  script += " if (obj.stake_point) {\n"; // every epoch while staking out, nothing else in the message
+  script += "   var stakeout_offsets_el = document.getElementById('stakeout_offsets');\n";
+  script += "   stakeout_offsets_el.style.display = 'block';\n";
+  script += "   stakeout_offsets_el.textContent = obj.stake_point + (obj.stake_mode == 'nearest' ? ' (nearest)' : '') + ': ' + obj.stake_dist.toFixed(3) + ' m at ' + obj.stake_bearing.toFixed(1) + ' deg, N ' + obj.stake_n.toFixed(3) + ' E ' + obj.stake_e.toFixed(3) + ' Up ' + obj.stake_u.toFixed(3);\n";
+  script += "   return;\n";
+  script += " }\n";
+  script += " if (obj.stakeout_status) {\n";
+  script += "   document.getElementById('stakeout_status').textContent = obj.stakeout_status + (obj.stakeout_file ? ' ' + obj.stakeout_file : '') + ', points: ' + obj.stakeout_points + (obj.stakeout_skipped ? ', lines skipped: ' + obj.stakeout_skipped : '') + (obj.stakeout_build_ms ? ', loaded in ' + obj.stakeout_build_ms + ' ms' : '');\n";
+  script += "   if (obj.stakeout_status == 'stopped') document.getElementById('stakeout_offsets').style.display = 'none';\n";
+  script += " }\n";
   script += " if (obj.latitude && obj.longitude && obj.altitude && obj.altitude_msl) {\n";
   script += "    document.getElementById('latitude').innerHTML = obj.latitude;\n";
   script += "    document.getElementById('longitude').innerHTML = obj.longitude;\n";
   script += "    document.getElementById('altitude').innerHTML = obj.altitude;\n";
   script += "    document.getElementById('altitude_msl').innerHTML = obj.altitude_msl;\n";
+  script += "    if (obj.hAcc) { history_points.push({t: Date.now(), hAcc: obj.hAcc}); if (history_points.length > 20000) history_points.shift(); draw_hacc_chart(); }\n";
   script += "  }\n";
   script += "\n";
   script += " if (obj.survey_status) {\n";
@@ -708,6 +2317,29 @@ String Survey_Client_WebSocketJS() {
   script += "   survey_vert_accuracy_el.style.display = 'none';\n";
   script += "   survey_horz_accuracy_el.style.display = 'none';\n";
   script += " }\n";
+  script += " if (obj.next_gcp && !document.getElementById('gcp_index_input').value) {\n"; // session restored after a reset
+  script += "   document.getElementById('gcp_index_input').value = obj.next_gcp;\n";
+  script += " }\n";
+  script += " if (obj.event_marks) {\n";
+  script += "   document.getElementById('event_marks_status').textContent = obj.event_marks + (obj.event_file ? ' ' + obj.event_file : '') + ', marks: ' + obj.event_logged + (obj.event_missed || obj.event_dropped ? ', missed: ' + (obj.event_missed + obj.event_dropped) : '') + ', p99 ' + Math.round(obj.event_latency_p99_us / 1000) + ' ms, queue max ' + obj.event_queue_hwm;\n";
+  script += " }\n";
+  script += " if (obj.track_log) {\n";
+  script += "   document.getElementById('track_log_status').textContent = obj.track_log + (obj.track_file ? ' ' + obj.track_file : '') + ', points: ' + obj.track_points + ', ' + Math.round(obj.track_bytes / 1024) + ' KB';\n";
+  script += " }\n";
+  script += " if (obj.batch_status) {\n";
+  script += "   document.getElementById('batch_status').textContent = obj.batch_status + (obj.batch_gcp ? ' - ' + obj.batch_gcp : '');\n";
+  script += "   var batch_progress_el = document.getElementById('batch_progress');\n";
+  script += "   batch_progress_el.style.display = 'block';\n";
+  script += "   batch_progress_el.textContent = 'Points: ' + obj.batch_points_done + ', points/hour: ' + obj.batch_points_per_hour + (obj.batch_epochs ? ', epochs: ' + obj.batch_epochs : '') + (obj.batch_hacc ? ', hAcc: ' + obj.batch_hacc + '(mm)' : '');\n";
+  script += " }\n";
+  script += " if (obj.rtk_event) {\n";
+  script += "   var rtk_alert_el = document.getElementById('rtk_alert');\n";
+  script += "   var reasons = (obj.rtk_hacc_high ? ', hAcc ' + obj.rtk_hacc + '(mm)' : '') + (obj.rtk_corrections_stale ? ', corrections ' + (obj.rtk_corr_age_s || '?') + 's old' : '');\n";
+  script += "   if (obj.rtk_event == 'saved_in_alert') reasons += ', ' + obj.rtk_point + ' saved anyway';\n";
+  script += "   else if (obj.rtk_point) reasons += ', ' + obj.rtk_point + ' averaging restarted';\n";
+  script += "   document.getElementById('rtk_alert_text').textContent = 'RTK ' + obj.rtk_event + ': ' + obj.rtk_from + ' > ' + obj.rtk_to + reasons;\n";
+  script += "   rtk_alert_el.style.display = obj.rtk_alert ? 'block' : 'none';\n";
+  script += " }\n";
   script += " if (obj.alert) {\n";
   script += "   if(obj.update_status == 'target_accuracy_updated') {\n";
   script += "     alert(obj.alert);\n"; // hide input element after this statement
@@ -746,836 +2378,2575 @@ String Survey_Client_WebSocketJS() {
   return script;
 }
 
-String Files_Client_WebSocketJS() {
-  String script = "<script>\n";
-  script += "var Socket;\n";
-  script += "document.getElementById('create_file_btn').addEventListener('click', create_file);\n";
-  script += "function create_file() {\n";
-  script += " var new_file_name = document.getElementById('new_file_name_input').value;\n";
-  script += " var message = {create_file: new_file_name}; \n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += " console.log('creating new file ' + new_file_name);\n";
-  script += " document.getElementById('new_file_name_input').value = '';\n"; // reset input field  will also reset buttons file buttons bc file_name length is less than one.
-  script += "}\n";
-  script += "document.getElementById('delete_file_btn').addEventListener('click', remove_file);\n";
-  script += "function remove_file() {\n";
-  script += " var new_file_name = document.getElementById('new_file_name_input').value;\n";
-  script += " var message = {remove_file: new_file_name}; \n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += " console.log('removing file ' + new_file_name);\n";
-  script += " document.getElementById('new_file_name_input').value = '';\n"; // reset input field  will also reset buttons file buttons bc file_name length is less than one.
-  script += "}\n";
-  script += "document.getElementById('new_file_name_input').addEventListener('input', check_filename_input);\n";
-  script += "function check_filename_input() {\n";
-  script += " var input_el = document.getElementById('new_file_name_input');\n";
-  script += " var input_val = input_el.value;\n";
-  script += " if(input_val.length > 1) {\n";
-  script += " document.getElementById('create_file_btn').disabled = false;\n";
-  script += " document.getElementById('delete_file_btn').disabled = false;\n";
-  script += " } else {\n";
-  script += " document.getElementById('delete_file_btn').disabled = true;\n";
-  script += " document.getElementById('create_file_btn').disabled = true;\n";
-  script += " }\n";
-  script += "}\n";
-  script += "function open_directory(element) {\n";
-  script += " console.log('opening directory :' + element.getAttribute('device_file_path'));\n";
-  script += " var message = {open_dir: element.getAttribute('device_file_path')}; \n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += " document.getElementById('current_directory').innerHTML = element.getAttribute('device_file_path');";
-  script += "}\n";
-  script += "document.getElementById('nav_previous_directory').addEventListener('click', open_previous_directory);\n";
-  script += "function open_previous_directory() {\n";
-  script += " var current_dir = document.getElementById('current_directory').innerHTML.toString();\n";
-  script += " var modified_path = current_dir.replace(/\\/[^\\/]*$/,'/');\n"; // regex expresion to remove the end directory from string and return remaing string
-  script += " var message = {open_dir: modified_path}; \n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += " console.log(current_dir + 'previous dir' + modified_path);\n";
-  script += " }\n";
-  script += "function open_file_contents(element) {\n";
-  script += " console.log('opening file contents for ' + element.getAttribute('device_file_path'));\n";
-  script += " var message = {update_view: 'show_file_content', file_directory: element.getAttribute('device_file_path')}\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "function set_save_file(element) {\n";
-  script += " var message = {set_save_file: element.getAttribute('device_file_path')}\n";
-  script += " Socket.send(JSON.stringify(message));\n";
-  script += "}\n";
-  script += "document.getElementById('reconnect_web_socket').addEventListener('click', reconnect_web_socket);\n";
-  script += "function reconnect_web_socket() {\n";
-  script += " init();\n";
-  script += " alert('Reconnecting WebSocket');\n";
-  script += "}\n";
-  script += "function init() {\n";
-  script += " Socket = new WebSocket('ws://' + window.location.hostname + ':81/');\n";
-  script += " Socket.addEventListener('open', (event) => {\n";
-  script += " console.log('websocket client opened.');\n";
-  script += " document.getElementById('file_btn_controls').style.display = 'block';\n";
-  script += " document.getElementById('reconnect_web_socket').style.display = 'none';\n";
-  script += " var dir_elements = document.getElementsByClassName('folder_btn')\n";
-  script += " for (var i = 0; i < dir_elements.length; i++) {\n";
-  script += "   dir_elements[i].disabled = false;\n";
-  script += " }\n";
-  script += " });\n";
-  script += " Socket.addEventListener('close', (event) => {\n";
-  script += "   console.log('websocket client closed.');\n";
-  script += "   document.getElementById('reconnect_web_socket').style.display = 'block';\n";
-  script += "   var dir_elements = document.getElementsByClassName('folder_btn')\n";
-  script += "   for (var i = 0; i < dir_elements.length; i++) {\n";
-  script += "     dir_elements[i].disabled = true;\n";
-  script += "   }\n";
-  script += " });\n";
-  script += " Socket.onmessage = function(event) { //callback func\n";
-  script += " processCommand(event);\n";
-  script += " };\n";
-  script += "}\n";
-  script += "function processCommand(event) {\n"; // update elements with data
-  script += " var obj = JSON.parse(event.data)\n";
-  script += " if(obj.update_view == 'file_list') {\n";
-  script += "   var parentElement = document.getElementById('file_list_view');\n";
-  script += "   var old_file_list_elements = document.getElementsByClassName('file_list_item');\n";
-  script += "   console.log(obj.files);\n"; // testing, for now print json from websocket. handling updating the file list view here.
-  script += "   console.log(obj.directories);\n";
-  script += "   parentElement.innerHTML = '';\n"; // testing, remove later
-  script += "   document.getElementById('current_directory').innerHTML = obj.file_view_directory;\n";
-  script += "   obj.directories.forEach( function(directory){\n";
-  script += "     var file_item_container = document.createElement('div');\n";
-  script += "     var file_element = document.createElement('p');\n";
-  script += "     var file_btn_element = document.createElement('button')\n";
-  script += "     file_btn_element.innerHTML = 'Open '+ directory;\n";
-  script += "     file_btn_element.setAttribute('device_file_path', '/' + directory);\n";
-  script += "     file_btn_element.setAttribute('onclick', 'open_directory(this)');\n";
-  script += "     file_btn_element.classList.add('folder_btn');\n";
-  script += "     file_element.classList.add('file_list_item');\n";
-  script += "     file_element.textContent = directory;\n";
-  script += "     file_item_container.style.textAlign = 'center';\n";
-  script += "     file_item_container.appendChild(file_element);\n";
-  script += "     file_item_container.appendChild(file_btn_element);\n";
-  script += "     parentElement.appendChild(file_item_container);\n";
-  script += "   });\n";
-  script += "   if(obj.files) {\n";
-  script += "     obj.files.forEach( function(file) {\n";
-  script += "     var file_item_container = document.createElement('div');\n";
-  script += "     var file_element = document.createElement('p');\n";
-  script += "     file_element.classList.add('file_list_item');\n";
-  script += "     file_element.textContent = file;\n";
-  script += "     file_item_container.style.textAlign = 'center';\n";
-  script += "     file_item_container.appendChild(file_element);\n";
-  script += "     var file_name = String(file);\n";
-  script += "     if (file_name.endsWith('.txt')) {\n"; // check for text files
-  script += "       var view_content_btn = document.createElement('button');\n";
-  script += "       view_content_btn.classList.add('view_content_btn');\n";
-  script += "       view_content_btn.setAttribute('device_file_path', obj.file_view_directory + '/' + file);\n";
-  script += "       view_content_btn.setAttribute('onclick', 'open_file_contents(this)');\n"; // create this function
-  script += "       view_content_btn.innerHTML = 'View ' + file + ' Contents';\n";
-  script += "       file_item_container.appendChild(view_content_btn);\n";
-  script += "       var make_save_file_btn = document.createElement('button');\n";
-  script += "       make_save_file_btn.classList.add('set_save_file_btn');\n";
-  script += "       make_save_file_btn.setAttribute('device_file_path', obj.file_view_directory + file);\n";
-  script += "       make_save_file_btn.setAttribute('onclick', 'set_save_file(this)');\n";
-  script += "       make_save_file_btn.innerHTML = 'Make Save File';\n";
-  script += "       file_item_container.appendChild(make_save_file_btn);\n";
-  script += "     }\n";
-  script += "     parentElement.appendChild(file_item_container);\n";
-  script += "    });\n";
-  script += "   }\n";
-  script += " }\n";
-  script += " if (obj.update_view == 'show_file_content') {\n";
-  script += "   var parentElement = document.getElementById('file_list_view');\n";
-  script += "   parentElement.innerHTML = '';\n";
-  script += "   var file_content_el = document.createElement('h4');\n";
-  script += "   file_content_el.textContent = obj.file_content\n";
-  script += "   file_content_el.style.textAlign = 'center';\n";
-  script += "   parentElement.appendChild(file_content_el);\n";
-  script += " }\n";
-  script += " if(obj.file_view_directory) {\n";
-  script += "  document.getElementById('current_directory').innerHTML = obj.file_view_directory;\n";
-  script += "  console.log(obj);\n";
-  script += " }\n";
-  script += "}\n";
-  script += "window.onload = function(event) {\n";
-  script += " init();\n";
-  script += "}\n";
-  script += "</script>\n";
-  return script;
+// Skyplot and C/N0 bars from the binary 'S' messages, see SignalTable.h for the layout
+String Signals_Client_WebSocketJS() {
+  String script = "<script>\n";
+  script += "var Socket;\n";
+  script += "var signals = {}, signal_seq = -1;\n";
+  script += "var gnss_names = ['GPS', 'SBAS', 'GAL', 'BDS', 'IMES', 'QZSS', 'GLO', 'NavIC'];\n";
+  script += "var gnss_colors = ['#1f77b4', '#7f7f7f', '#2ca02c', '#d62728', '#000000', '#9467bd', '#ff7f0e', '#8c564b'];\n";
+  script += "function decode_signals(buffer) {\n";
+  script += " var view = new DataView(buffer), b = new Uint8Array(buffer);\n";
+  script += " if (b[0] != 83) return;\n"; // 'S'
+  script += " var seq = view.getUint16(2, true), rows = view.getUint16(4, true), removed = view.getUint16(6, true), pos;\n";
+  script += " if (b[1] == 1) signals = {};\n";
+  script += " else if (seq != ((signal_seq + 1) & 0xffff)) Socket.send(JSON.stringify({cmd: 'signals', action: 'FULL'}));\n"; // a change message was lost
+  script += " signal_seq = seq;\n";
+  script += " pos = 8 + rows * 10;\n";
+  script += " for (var i = 0; i < removed; i++, pos += 4) delete signals[b[pos] + '/' + b[pos + 1] + '/' + b[pos + 2]];\n";
+  script += " pos = 8;\n";
+  script += " for (var i = 0; i < rows; i++, pos += 10) {\n";
+  script += "   signals[b[pos] + '/' + b[pos + 1] + '/' + b[pos + 2]] = {gnss: b[pos], sv: b[pos + 1], sig: b[pos + 2], cno: b[pos + 3],\n";
+  script += "     elev: view.getInt8(pos + 4), quality: b[pos + 5] & 15, azim: view.getUint16(pos + 6, true), flags: b[pos + 8]};\n";
+  script += " }\n";
+  script += " draw_signals();\n";
+  script += "}\n";
+  script += "function draw_signals() {\n";
+  script += " var list = Object.keys(signals).map(function(k) { return signals[k]; });\n";
+  script += " list.sort(function(a, b) { return a.gnss - b.gnss || a.sv - b.sv || a.sig - b.sig; });\n";
+  script += " var sky = document.getElementById('skyplot'), ctx = sky.getContext('2d'), c = sky.width / 2, R = c - 12, sats = {}, used = 0;\n";
+  script += " ctx.clearRect(0, 0, sky.width, sky.height);\n";
+  script += " ctx.strokeStyle = '#ccc';\n";
+  script += " [0, 30, 60].forEach(function(e) { ctx.beginPath(); ctx.arc(c, c, R * (90 - e) / 90, 0, 2 * Math.PI); ctx.stroke(); });\n";
+  script += " list.forEach(function(s) {\n";
+  script += "   if (s.flags & 2) used++;\n";
+  script += "   var id = s.gnss + '/' + s.sv;\n";
+  script += "   if (sats[id] || s.elev == -128) return;\n";
+  script += "   sats[id] = true;\n";
+  script += "   var r = R * (90 - Math.max(0, s.elev)) / 90, a = s.azim * Math.PI / 180, x = c + r * Math.sin(a), y = c - r * Math.cos(a);\n";
+  script += "   ctx.fillStyle = ctx.strokeStyle = gnss_colors[s.gnss] || '#000';\n";
+  script += "   ctx.beginPath(); ctx.arc(x, y, 6, 0, 2 * Math.PI);\n";
+  script += "   if (s.flags & 1) ctx.fill(); else ctx.stroke();\n"; // filled when used in the fix
+  script += "   ctx.fillText(s.sv, x + 7, y + 3);\n";
+  script += " });\n";
+  script += " var bars = document.getElementById('cno_bars'), bctx = bars.getContext('2d'), w = bars.width / Math.max(list.length, 1);\n";
+  script += " bctx.clearRect(0, 0, bars.width, bars.height);\n";
+  script += " list.forEach(function(s, i) {\n";
+  script += "   var h = Math.min(s.cno, 55) / 55 * bars.height;\n";
+  script += "   bctx.globalAlpha = (s.flags & 2) ? 1 : 0.35;\n"; // faded when the pseudorange is not used
+  script += "   bctx.fillStyle = gnss_colors[s.gnss] || '#000';\n";
+  script += "   bctx.fillRect(i * w + 1, bars.height - h, Math.max(w - 2, 1), h);\n";
+  script += " });\n";
+  script += " bctx.globalAlpha = 1;\n";
+  script += " var per_gnss = {};\n";
+  script += " Object.keys(sats).forEach(function(id) { var g = gnss_names[id.split('/')[0]] || id; per_gnss[g] = (per_gnss[g] || 0) + 1; });\n";
+  script += " document.getElementById('signal_summary').textContent = 'Signals: ' + list.length + ', used: ' + used + ', satellites: '\n";
+  script += "   + Object.keys(per_gnss).map(function(g) { return g + ' ' + per_gnss[g]; }).join(', ');\n";
+  script += "}\n";
+  script += "var convergence_runs = [], convergence_current = null;\n";
+  script += "function convergence_cell(stamp) { return stamp ? (stamp[0] / 1000).toFixed(1) : '-'; }\n";
+  script += "function draw_convergence() {\n";
+  script += " var rows = (convergence_current ? [convergence_current] : []).concat(convergence_runs);\n";
+  script += " var html = '<tr><th>#</th><th>From</th><th>Result</th><th>Profile</th><th>L-Band</th><th>Keys</th><th>3D</th><th>Corr</th><th>Float</th><th>Fixed</th><th>SV</th><th>hAcc</th></tr>';\n";
+  script += " rows.forEach(function(r) {\n";
+  script += "   var from = r.trigger + (r.outage_ms ? ' (' + (r.outage_ms / 1000).toFixed(0) + ' s out)' : '');\n";
+  script += "   html += '<tr><td>' + r.id + '</td><td>' + from + '</td><td>' + r.end + '</td><td>' + r.profile + '</td><td>' + (r.lband_hz / 1e6).toFixed(3)\n";
+  script += "     + '</td><td>' + r.keys_crc + '</td><td>' + convergence_cell(r.fix3d) + '</td><td>' + convergence_cell(r.corrections) + '</td><td>'\n";
+  script += "     + convergence_cell(r.float) + '</td><td>' + convergence_cell(r.fixed) + '</td><td>' + (r.fixed ? r.fixed[1] : '-') + '</td><td>'\n";
+  script += "     + (r.fixed ? (r.fixed[3] / 1000).toFixed(3) : '-') + '</td></tr>';\n";
+  script += " });\n";
+  script += " document.getElementById('convergence_table').innerHTML = html;\n";
+  script += "}\n";
+  script += "document.getElementById('convergence_reset').addEventListener('click', function() {\n";
+  script += " if (confirm('Restart the GNSS receiver? The position is lost until it converges again.')) Socket.send(JSON.stringify({cmd: 'convergence', action: 'RESET'}));\n";
+  script += "});\n";
+  script += "function init() {\n";
+  script += " Socket = new WebSocket('ws://' + window.location.host + '/ws');\n";
+  script += " Socket.binaryType = 'arraybuffer';\n";
+  script += " Socket.addEventListener('open', (event) => {\n";
+  script += "   Socket.send(JSON.stringify({cmd: 'signals', action: 'SUBSCRIBE'}));\n";
+  script += "   Socket.send(JSON.stringify({cmd: 'convergence'}));\n";
+  script += " });\n";
+  script += " Socket.addEventListener('close', (event) => { setTimeout(init, 2000); });\n";
+  script += " Socket.onmessage = function(event) {\n";
+  script += "   if (event.data instanceof ArrayBuffer) { decode_signals(event.data); return; }\n";
+  script += "   var obj;\n";
+  script += "   try { obj = JSON.parse(event.data); } catch (e) { return; }\n";
+  script += "   if (obj.convergence) { convergence_runs = obj.convergence; convergence_current = obj.convergence_current; draw_convergence(); }\n";
+  script += "   if (obj.convergence_run) {\n";
+  script += "     var run = obj.convergence_run;\n";
+  script += "     if (run.end == 'running') convergence_current = run;\n";
+  script += "     else {\n";
+  script += "       if (convergence_current && convergence_current.id == run.id) convergence_current = null;\n";
+  script += "       convergence_runs.unshift(run);\n";
+  script += "       convergence_runs = convergence_runs.slice(0, " + String(CONVERGENCE_HISTORY) + ");\n";
+  script += "     }\n";
+  script += "     draw_convergence();\n";
+  script += "   }\n";
+  script += "   if (obj.convergence_reset == 'busy') alert('Not while a survey is running.');\n";
+  script += " };\n";
+  script += "}\n";
+  script += "window.onload = function(event) {\n";
+  script += " init();\n";
+  script += "}\n";
+  script += "</script>\n";
+  return script;
+}
+
+String Files_Client_WebSocketJS() {
+  String script = "<script>\n";
+  script += "var Socket;\n";
+  script += "document.getElementById('create_file_btn').addEventListener('click', create_file);\n";
+  script += "function create_file() {\n";
+  script += " var new_file_name = document.getElementById('new_file_name_input').value;\n";
+  script += " var message = {cmd: 'create_file', path: new_file_name}; \n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += " console.log('creating new file ' + new_file_name);\n";
+  script += " document.getElementById('new_file_name_input').value = '';\n"; // reset input field  will also reset buttons file buttons bc file_name length is less than one.
+  script += "}\n";
+  script += "document.getElementById('delete_file_btn').addEventListener('click', remove_file);\n";
+  script += "function remove_file() {\n";
+  script += " var new_file_name = document.getElementById('new_file_name_input').value;\n";
+  script += " var message = {cmd: 'remove_file', path: new_file_name}; \n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += " console.log('removing file ' + new_file_name);\n";
+  script += " document.getElementById('new_file_name_input').value = '';\n"; // reset input field  will also reset buttons file buttons bc file_name length is less than one.
+  script += "}\n";
+  script += "document.getElementById('new_file_name_input').addEventListener('input', check_filename_input);\n";
+  script += "function check_filename_input() {\n";
+  script += " var input_el = document.getElementById('new_file_name_input');\n";
+  script += " var input_val = input_el.value;\n";
+  script += " if(input_val.length > 1) {\n";
+  script += " document.getElementById('create_file_btn').disabled = false;\n";
+  script += " document.getElementById('delete_file_btn').disabled = false;\n";
+  script += " } else {\n";
+  script += " document.getElementById('delete_file_btn').disabled = true;\n";
+  script += " document.getElementById('create_file_btn').disabled = true;\n";
+  script += " }\n";
+  script += "}\n";
+  script += "function open_directory(element) {\n";
+  script += " console.log('opening directory :' + element.getAttribute('device_file_path'));\n";
+  script += " var message = {cmd: 'open_dir', path: element.getAttribute('device_file_path')}; \n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += " document.getElementById('current_directory').innerHTML = element.getAttribute('device_file_path');";
+  script += "}\n";
+  script += "document.getElementById('nav_previous_directory').addEventListener('click', open_previous_directory);\n";
+  script += "function open_previous_directory() {\n";
+  script += " var current_dir = document.getElementById('current_directory').innerHTML.toString();\n";
+  script += " var modified_path = current_dir.replace(/\\/[^\\/]*$/,'/');\n"; // regex expresion to remove the end directory from string and return remaing string
+  script += " var message = {cmd: 'open_dir', path: modified_path}; \n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += " console.log(current_dir + 'previous dir' + modified_path);\n";
+  script += " }\n";
+  script += "function open_file_contents(element) {\n";
+  script += " console.log('opening file contents for ' + element.getAttribute('device_file_path'));\n";
+  script += " var message = {cmd: 'show_file', path: element.getAttribute('device_file_path')}\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "function set_save_file(element) {\n";
+  script += " var message = {cmd: 'set_save_file', path: element.getAttribute('device_file_path')}\n";
+  script += " Socket.send(JSON.stringify(message));\n";
+  script += "}\n";
+  script += "document.getElementById('reconnect_web_socket').addEventListener('click', reconnect_web_socket);\n";
+  script += "function reconnect_web_socket() {\n";
+  script += " init();\n";
+  script += " alert('Reconnecting WebSocket');\n";
+  script += "}\n";
+  script += "function init() {\n";
+  script += " Socket = new WebSocket('ws://' + window.location.host + '/ws');\n";
+  script += " Socket.addEventListener('open', (event) => {\n";
+  script += " console.log('websocket client opened.');\n";
+  script += " document.getElementById('file_btn_controls').style.display = 'block';\n";
+  script += " document.getElementById('reconnect_web_socket').style.display = 'none';\n";
+  script += " var dir_elements = document.getElementsByClassName('folder_btn')\n";
+  script += " for (var i = 0; i < dir_elements.length; i++) {\n";
+  script += "   dir_elements[i].disabled = false;\n";
+  script += " }\n";
+  script += " });\n";
+  script += " Socket.addEventListener('close', (event) => {\n";
+  script += "   console.log('websocket client closed.');\n";
+  script += "   document.getElementById('reconnect_web_socket').style.display = 'block';\n";
+  script += "   var dir_elements = document.getElementsByClassName('folder_btn')\n";
+  script += "   for (var i = 0; i < dir_elements.length; i++) {\n";
+  script += "     dir_elements[i].disabled = true;\n";
+  script += "   }\n";
+  script += " });\n";
+  script += " Socket.onmessage = function(event) { //callback func\n";
+  script += " processCommand(event);\n";
+  script += " };\n";
+  script += "}\n";
+  script += "function processCommand(event) {\n"; // update elements with data
+  script += " if (typeof event.data !== 'string') return;\n"; // epoch history bursts are for the survey page
+  script += " var obj = JSON.parse(event.data)\n";
+  script += " if (obj.cmd_rejected !== undefined) { alert('Command ' + obj.cmd_rejected + ' rejected: ' + obj.cmd_error); return; }\n";
+  script += " if(obj.update_view == 'file_list') {\n";
+  script += "   var parentElement = document.getElementById('file_list_view');\n";
+  script += "   var old_file_list_elements = document.getElementsByClassName('file_list_item');\n";
+  script += "   console.log(obj.files);\n"; // testing, for now print json from websocket. handling updating the file list view here.
+  script += "   console.log(obj.directories);\n";
+  script += "   parentElement.innerHTML = '';\n"; // testing, remove later
+  script += "   document.getElementById('current_directory').innerHTML = obj.file_view_directory;\n";
+  script += "   obj.directories.forEach( function(directory){\n";
+  script += "     var file_item_container = document.createElement('div');\n";
+  script += "     var file_element = document.createElement('p');\n";
+  script += "     var file_btn_element = document.createElement('button')\n";
+  script += "     file_btn_element.innerHTML = 'Open '+ directory;\n";
+  script += "     file_btn_element.setAttribute('device_file_path', '/' + directory);\n";
+  script += "     file_btn_element.setAttribute('onclick', 'open_directory(this)');\n";
+  script += "     file_btn_element.classList.add('folder_btn');\n";
+  script += "     file_element.classList.add('file_list_item');\n";
+  script += "     file_element.textContent = directory;\n";
+  script += "     file_item_container.style.textAlign = 'center';\n";
+  script += "     file_item_container.appendChild(file_element);\n";
+  script += "     file_item_container.appendChild(file_btn_element);\n";
+  script += "     parentElement.appendChild(file_item_container);\n";
+  script += "   });\n";
+  script += "   if(obj.files) {\n";
+  script += "     obj.files.forEach( function(file) {\n";
+  script += "     var file_item_container = document.createElement('div');\n";
+  script += "     var file_element = document.createElement('p');\n";
+  script += "     file_element.classList.add('file_list_item');\n";
+  script += "     file_element.textContent = file;\n";
+  script += "     file_item_container.style.textAlign = 'center';\n";
+  script += "     file_item_container.appendChild(file_element);\n";
+  script += "     var file_name = String(file);\n";
+  script += "     if (file_name.endsWith('.txt')) {\n"; // check for text files
+  script += "       var view_content_btn = document.createElement('button');\n";
+  script += "       view_content_btn.classList.add('view_content_btn');\n";
+  script += "       view_content_btn.setAttribute('device_file_path', obj.file_view_directory + '/' + file);\n";
+  script += "       view_content_btn.setAttribute('onclick', 'open_file_contents(this)');\n"; // create this function
+  script += "       view_content_btn.innerHTML = 'View ' + file + ' Contents';\n";
+  script += "       file_item_container.appendChild(view_content_btn);\n";
+  script += "       var make_save_file_btn = document.createElement('button');\n";
+  script += "       make_save_file_btn.classList.add('set_save_file_btn');\n";
+  script += "       make_save_file_btn.setAttribute('device_file_path', obj.file_view_directory + file);\n";
+  script += "       make_save_file_btn.setAttribute('onclick', 'set_save_file(this)');\n";
+  script += "       make_save_file_btn.innerHTML = 'Make Save File';\n";
+  script += "       file_item_container.appendChild(make_save_file_btn);\n";
+  script += "     }\n";
+  script += "     parentElement.appendChild(file_item_container);\n";
+  script += "    });\n";
+  script += "   }\n";
+  script += " }\n";
+  script += " if (obj.update_view == 'show_file_content') {\n";
+  script += "   var parentElement = document.getElementById('file_list_view');\n";
+  script += "   parentElement.innerHTML = '';\n";
+  script += "   var file_content_el = document.createElement('h4');\n";
+  script += "   file_content_el.textContent = obj.file_content\n";
+  script += "   file_content_el.style.textAlign = 'center';\n";
+  script += "   parentElement.appendChild(file_content_el);\n";
+  script += " }\n";
+  script += " if(obj.file_view_directory) {\n";
+  script += "  document.getElementById('current_directory').innerHTML = obj.file_view_directory;\n";
+  script += "  console.log(obj);\n";
+  script += " }\n";
+  script += "}\n";
+  script += "window.onload = function(event) {\n";
+  script += " init();\n";
+  script += "}\n";
+  script += "</script>\n";
+  return script;
+}
+
+// Web CSS
+String WebsiteBaseCSS() {
+  String CSS = "<style>\n";
+  CSS += ".button-link {\n";
+  CSS += "  display: inline-block;\n";
+  CSS += "  padding: 10px 20px;\n";
+  CSS += "  background-color: #4CAF50;\n";
+  CSS += "  color: white;\n";
+  CSS += "  text-align: center;\n";
+  CSS += "  text-decoration: none;\n";
+  CSS += "  font-size: 16px;\n";
+  CSS += "  border-radius: 5px;\n";
+  CSS += "  border: none;\n";
+  CSS += "  cursor: pointer;\n";
+  CSS += "}\n";
+  CSS += "\n";
+  CSS += ".button-link:hover {\n";
+  CSS += "  background-color: #45A049;\n";
+  CSS += "}\n";
+  CSS += "</style>\n";
+
+  return CSS;
+}
+
+
+// Display functions
+void display_info(String message) {
+  display_hold_until = millis() + 5000; // keep event messages up before the live epoch view returns
+  display.clearDisplay();
+  display.setCursor(0,0);
+  display.setTextSize(1);
+  display.setTextColor(1);
+  display.setTextWrap(true);
+  display.print(message);
+  display.display();
+}
+void display_add_info(String message) {
+  display.print(message);
+  display.display();
+}
+
+void display_info_lg(String message) {
+  display_hold_until = millis() + 5000;
+  display.clearDisplay();
+  display.setCursor(0,16);
+  display.setTextSize(1);
+  display.setTextColor(1);
+  display.setTextWrap(true);
+  display.print(message);
+  display.display();
+}
+
+// Web socket functions
+void webSocketEvent(uint8_t num, http_ws_event_t type, uint8_t * payload, size_t length) { // client number, type of event, payload pointer to array of unsigned integers, length of payload array
+  switch (type)
+  {
+  case HTTP_WS_DISCONNECTED:
+    LOG_I("ws", "Client %u disconnected", num);
+    ws_outbox.client_disconnected(num);
+    signal_subscribers &= ~(1 << num);
+    log_subscribers &= ~(1 << num);
+    break;
+  case HTTP_WS_CONNECTED:
+    LOG_I("ws", "Client %u connected", num); // broadcast message to client via json object.
+    ws_outbox.client_connected(num);
+    send_boot_report(num);
+    send_history_burst(num);
+    ws_send_keyframe(num, position_telemetry); // late joiners start from the full state
+    if (survey_in_progress) ws_send_keyframe(num, survey_telemetry);
+    if (survey_in_progress) {
+      String jsonString = "";
+      JsonObject object = json_doc_tx.to<JsonObject>();
+      object["survey_status"] = "in_progress";
+      serializeJson(object, jsonString);
+      ws_broadcast(jsonString);
+    }
+    break;
+  case HTTP_WS_BINARY:
+    break;
+  case HTTP_WS_TEXT:
+    ws_dispatch(num, payload, length);
+    break;
+  }
+}
+
+// Websocket commands, {cmd: name, ...args}. The name is looked up by hash, the args are checked
+// against the command's schema before its handler runs, unknown fields included, so a message
+// runs exactly one handler or none.
+void ws_cmd_message(uint8_t, JsonObject args) { // functionality for test button
+  LOG_I("ws", "Message from client: %s %s", args["message"].as<const char *>(), args["date"].as<const char *>());
+}
+
+void ws_cmd_survey(uint8_t, JsonObject args) {
+  session_resume_pending = false; // the user took over from the saved session
+  if (args["action"] == "START") {
+    LOG_I("survey", "Start survey called");
+    start_survey_observation();
+  } else {
+    LOG_I("survey", "Stopping Survey");
+    stop_survey_observation();
+  }
+}
+
+void ws_cmd_set_target_accuracy(uint8_t num, JsonObject args) {
+  float new_accuracy_val = args["value"];
+  if (new_accuracy_val <= 0) {
+    ws_command_error(num, "set_target_accuracy", "value must be above 0");
+    return;
+  }
+  LOG_I("survey", "Set new target accuracy to %.2f m", new_accuracy_val);
+  survey_desired_accuracy = new_accuracy_val;
+
+  String JsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+
+  object["alert"] = "target accuracy set to new value: " + (String)survey_desired_accuracy;
+  object["update_status"] = "target_accuracy_updated";
+  object["updated_target_acc_val"] = (String)survey_desired_accuracy;
+  serializeJson(object,JsonString);
+  ws_broadcast(JsonString);
+}
+
+void ws_cmd_survey_log(uint8_t, JsonObject args) {
+  if (args["action"] == "REBUILD") {
+    rebuild_survey_file();
+  }
+  send_survey_log_status();
+}
+
+void ws_cmd_rtk_alert(uint8_t num, JsonObject args) {
+  if (args["action"] == "CLEAR") {
+    solution_monitor.clear_alert();
+  }
+  if (args.containsKey("hacc_limit")) { // mm
+    solution_monitor.hacc_limit_mm = args["hacc_limit"];
+    prefs.putUInt("rtk_hacc", solution_monitor.hacc_limit_mm);
+  }
+  if (args.containsKey("corr_age_limit")) { // s
+    solution_monitor.corr_age_limit_s = args["corr_age_limit"];
+    convergence.corr_age_limit_s = solution_monitor.corr_age_limit_s; // same line between fresh and lost corrections
+    prefs.putUShort("rtk_age", solution_monitor.corr_age_limit_s);
+  }
+  send_rtk_events(num);
+}
+
+void ws_cmd_rtk_events(uint8_t num, JsonObject) {
+  send_rtk_events(num);
+}
+
+void ws_cmd_survey_log_flush(uint8_t, JsonObject args) { // records per flush, 1 = every point is durable before the next
+  survey_log.flush_every = args["value"];
+  prefs.putUShort("log_flush", survey_log.flush_every);
+  send_survey_log_status();
+}
+
+void ws_cmd_sd_cache(uint8_t, JsonObject args) {
+  if (args["action"] == "CLEAR" && sd_cache) {
+    sd_cache_clear();
+    sd_cache->reset_stats();
+  }
+  send_sd_cache_status();
+}
+
+void ws_cmd_sd_cache_kb(uint8_t, JsonObject args) { // read cache budget, PSRAM first, 0 = board default
+  uint16_t kb = args["value"];
+  prefs.putUShort("sd_cache_kb", kb);
+  init_sd_cache(kb);
+  send_sd_cache_status();
+}
+
+void ws_cmd_track_log(uint8_t, JsonObject args) {
+  if (args["action"] == "START") {
+    start_track_log();
+  }
+  else if (args["action"] == "STOP") {
+    stop_track_log();
+  }
+  send_track_status();
+}
+
+void ws_cmd_event_marks(uint8_t, JsonObject args) {
+  if (args["action"] == "START") {
+    start_event_marks();
+  }
+  else if (args["action"] == "STOP") {
+    stop_event_marks();
+  }
+  send_event_mark_status();
+}
+
+void ws_cmd_batch_survey(uint8_t, JsonObject args) {
+  session_resume_pending = false; // the user took over from the saved session
+  if (args["action"] == "START") {
+    String plan_file = args["plan_file"] | "";
+    int first_gcp = args["gcp_index"] | 1;
+    if (plan_file.length() == 0 || load_gcp_plan(plan_file)) {
+      if (plan_file.length() == 0) gcp_plan_count = 0;
+      gcp_plan_file = plan_file;
+      start_batch_survey(first_gcp);
+    } else {
+      send_batch_status("plan_load_failed");
+    }
+  }
+  else {
+    stop_batch_survey();
+  }
+}
+
+void ws_cmd_save_survey(uint8_t, JsonObject args) {
+  save_survey_observation(String(args["gcp_index"].as<int>()));
+}
+
+void ws_cmd_create_file(uint8_t, JsonObject args) {
+  create_file(args["path"].as<String>());
+  update_listed_files_WebSocket(file_view_directory); // load root directory but update this to a variable possibly called working_directory
+}
+
+void ws_cmd_remove_file(uint8_t, JsonObject args) {
+  delete_file(args["path"].as<String>());
+  update_listed_files_WebSocket(file_view_directory);
+}
+
+void ws_cmd_open_dir(uint8_t, JsonObject args) {
+  file_view_directory = args["path"].as<String>();
+  update_listed_files_WebSocket(file_view_directory);
+}
+
+void ws_cmd_show_file(uint8_t, JsonObject args) {
+  show_file_contents(args["path"].as<String>());
+}
+
+// {cmd: signals, action: SUBSCRIBE | UNSUBSCRIBE | FULL}, FULL after a gap in the sequence numbers
+void ws_cmd_signals(uint8_t num, JsonObject args) {
+  if (args["action"] == "UNSUBSCRIBE") {
+    signal_subscribers &= ~(1 << num);
+  } else {
+    signal_subscribers |= 1 << num;
+    send_signal_table(num);
+  }
+}
+
+// {cmd: telemetry_keyframe, topic}, the page saw a gap in the sequence numbers
+void ws_cmd_telemetry_keyframe(uint8_t num, JsonObject args) {
+  uint8_t topic = args["topic"];
+  if (topic == WS_TOPIC_POSITION) ws_send_keyframe(num, position_telemetry);
+  if (topic == WS_TOPIC_SURVEY) ws_send_keyframe(num, survey_telemetry);
+}
+
+// {cmd: history, from_s, to_s, step_s}, seconds before now
+void ws_cmd_history(uint8_t num, JsonObject args) {
+  send_history_query(num, args["from_s"] | 600, args["to_s"] | 0, args["step_s"] | 0);
+}
+
+void ws_cmd_rate_profile(uint8_t, JsonObject args) {
+  String profile_name = args["name"].as<String>();
+  int profile = find_rate_profile(profile_name.c_str());
+  bool ok = profile >= 0 && set_rate_profile(profile);
+
+  String JsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["alert"] = ok ? "Rate profile set to " + profile_name : "Unknown rate profile " + profile_name;
+  serializeJson(object,JsonString);
+  ws_broadcast(JsonString);
+}
+
+void ws_cmd_set_lband_frequency(uint8_t, JsonObject args) {
+  uint32_t frequency = args["value"];
+  bool ok = apply_lband_frequency(frequency);
+
+  String JsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["alert"] = ok ? "L-Band frequency set to " + String(frequency) : String("Failed to set L-Band frequency.");
+  serializeJson(object,JsonString);
+  ws_broadcast(JsonString);
+}
+
+// {cmd: spartn_keys, current: {key, wno, tow}, next: {key, wno, tow}}, next is optional
+void ws_cmd_spartn_keys(uint8_t num, JsonObject args) {
+  spartn_key_t keys[2] = {};
+  const char *names[] = {"current", "next"};
+  for (int i = 0; i < 2; i++) {
+    JsonVariant entry = args[names[i]];
+    if (entry.isNull()) continue;
+    int32_t wno = entry["wno"] | -1;
+    int32_t tow = entry["tow"] | -1;
+    if (!is_valid_spartn_start(wno, tow)) {
+      ws_command_error(num, "spartn_keys", "wno must be a GPS week and tow 0 to 604799 s");
+      return;
+    }
+    strlcpy(keys[i].key, entry["key"] | "", sizeof(keys[i].key));
+    keys[i].valid_from_wno = wno;
+    keys[i].valid_from_tow = tow;
+  }
+  bool ok = set_spartn_keys(keys[0], keys[1]);
+
+  String JsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["alert"] = ok ? "SPARTN keys loaded." : "SPARTN keys rejected, expected 32 hex characters per key.";
+  serializeJson(object,JsonString);
+  ws_broadcast(JsonString);
+}
+
+void ws_cmd_set_save_file(uint8_t, JsonObject args) {
+  set_save_file(args["path"].as<String>());
+  String JsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+
+  object["alert"] = "successfully set save file to " + working_directory;
+  serializeJson(object,JsonString);
+  ws_broadcast(JsonString);
+}
+
+// {cmd: ublox_read, mode: TXREADY | POLL}, compare the two in the rate stats
+void ws_cmd_ublox_read(uint8_t, JsonObject args) {
+  ublox_read_mode = args["mode"] == "POLL" ? UBLOX_READ_POLL : UBLOX_READ_TXREADY;
+  prefs.putUChar("ublox_read", ublox_read_mode);
+  ublox_latency.clear();
+}
+
+// {cmd: stakeout, action: LOAD (file) | STOP | SELECT (point) | NEAREST | STATUS}
+void ws_cmd_stakeout(uint8_t, JsonObject args) {
+  if (args["action"] == "LOAD") {
+    if (!load_stakeout(args["file"] | "")) {
+      send_stakeout_status("load_failed");
+      return;
+    }
+  }
+  else if (args["action"] == "STOP") {
+    stop_stakeout();
+  }
+  else if (args["action"] == "SELECT") {
+    if (!select_stakeout_point(args["point"] | "")) {
+      send_stakeout_status("point_not_found");
+      return;
+    }
+  }
+  else if (args["action"] == "NEAREST") {
+    stakeout_selected = -1;
+  }
+  send_stakeout_status(stakeout_index ? "active" : "stopped");
+}
+
+// {cmd: convergence, action: STATUS | RESET}. RESET restarts the F9P's GNSS to time a cold convergence,
+// refused while a survey or a batch survey would lose its epochs to it.
+void ws_cmd_convergence(uint8_t num, JsonObject args) {
+  if (args["action"] == "RESET") {
+    if (survey_in_progress || batch_state != BATCH_IDLE || !gnss_ready()) {
+      ws_send(num, "{\"convergence_reset\":\"busy\"}");
+      return;
+    }
+    HAM_GNSS.softwareResetGNSSOnly();
+    if (convergence.start(CONVERGENCE_RESET, millis(), convergence_config())) save_convergence_run(convergence.ended());
+    LOG_I("conv", "GNSS reset for convergence run %lu", (unsigned long)convergence.current().id);
+  }
+  send_convergence(num);
+}
+
+// {cmd: log, action: SUBSCRIBE | UNSUBSCRIBE | STATUS, serial_level, sd_level, ws_level}
+void ws_cmd_log(uint8_t num, JsonObject args) {
+  if (args["action"] == "SUBSCRIBE") log_subscribers |= 1 << num;
+  else if (args["action"] == "UNSUBSCRIBE") log_subscribers &= ~(1 << num);
+  if (args.containsKey("serial_level")) {
+    log_serial_level = log_level_from_name(args["serial_level"]);
+    prefs.putUChar("log_serial", log_serial_level);
+  }
+  if (args.containsKey("sd_level")) {
+    log_sd_level = log_level_from_name(args["sd_level"]);
+    prefs.putUChar("log_sd", log_sd_level);
+  }
+  if (args.containsKey("ws_level")) log_ws_level = log_level_from_name(args["ws_level"]);
+  send_log_status(num);
+}
+
+void ws_cmd_command_stats(uint8_t num, JsonObject) {
+  send_command_stats(num);
+}
+
+// Schemas: name, type, required, min, max (min > max for no range), choices
+const command_arg_t ws_args_message[] = {{"message", ARG_STRING, true, 0, -1, nullptr}, {"date", ARG_STRING, true, 0, -1, nullptr}};
+const command_arg_t ws_args_start_stop[] = {{"action", ARG_STRING, true, 0, -1, "START|STOP"}};
+const command_arg_t ws_args_start_stop_status[] = {{"action", ARG_STRING, false, 0, -1, "START|STOP"}};
+const command_arg_t ws_args_target_accuracy[] = {{"value", ARG_NUMBER, true, 0, 1000, nullptr}}; // m
+const command_arg_t ws_args_survey_log[] = {{"action", ARG_STRING, false, 0, -1, "REBUILD"}};
+const command_arg_t ws_args_rtk_alert[] = {
+  {"action", ARG_STRING, false, 0, -1, "CLEAR"},
+  {"hacc_limit", ARG_INT, false, 5, 10000, nullptr}, // mm
+  {"corr_age_limit", ARG_INT, false, 1, 120, nullptr} // s
+};
+const command_arg_t ws_args_convergence[] = {{"action", ARG_STRING, false, 0, -1, "STATUS|RESET"}};
+#define LOG_LEVEL_CHOICES "none|error|warn|info|debug"
+const command_arg_t ws_args_log[] = {
+  {"action", ARG_STRING, false, 0, -1, "SUBSCRIBE|UNSUBSCRIBE|STATUS"},
+  {"serial_level", ARG_STRING, false, 0, -1, LOG_LEVEL_CHOICES},
+  {"sd_level", ARG_STRING, false, 0, -1, LOG_LEVEL_CHOICES},
+  {"ws_level", ARG_STRING, false, 0, -1, LOG_LEVEL_CHOICES}
+};
+const command_arg_t ws_args_log_flush[] = {{"value", ARG_INT, true, 1, 64, nullptr}};
+const command_arg_t ws_args_sd_cache[] = {{"action", ARG_STRING, false, 0, -1, "CLEAR"}};
+const command_arg_t ws_args_sd_cache_kb[] = {{"value", ARG_INT, true, 0, SD_CACHE_MAX_KB, nullptr}};
+const command_arg_t ws_args_batch_survey[] = {
+  {"action", ARG_STRING, true, 0, -1, "START|STOP"},
+  {"plan_file", ARG_STRING, false, 0, -1, nullptr},
+  {"gcp_index", ARG_INT, false, 1, 9999, nullptr}
+};
+const command_arg_t ws_args_save_survey[] = {{"gcp_index", ARG_INT, true, 1, 9999, nullptr}};
+const command_arg_t ws_args_path[] = {{"path", ARG_STRING, true, 0, -1, nullptr}};
+const command_arg_t ws_args_signals[] = {{"action", ARG_STRING, true, 0, -1, "SUBSCRIBE|UNSUBSCRIBE|FULL"}};
+const command_arg_t ws_args_keyframe[] = {{"topic", ARG_INT, true, 0, WS_OUTBOX_TOPICS - 1, nullptr}};
+const command_arg_t ws_args_history[] = {
+  {"from_s", ARG_INT, false, 0, 86400, nullptr},
+  {"to_s", ARG_INT, false, 0, 86400, nullptr},
+  {"step_s", ARG_INT, false, 0, 3600, nullptr}
+};
+const command_arg_t ws_args_rate_profile[] = {{"name", ARG_STRING, true, 0, -1, nullptr}};
+const command_arg_t ws_args_lband_frequency[] = {{"value", ARG_INT, true, 1500000001, 1599999999, nullptr}}; // Hz
+const command_arg_t ws_args_ublox_read[] = {{"mode", ARG_STRING, true, 0, -1, "TXREADY|POLL"}};
+const command_arg_t ws_args_stakeout[] = {
+  {"action", ARG_STRING, true, 0, -1, "LOAD|STOP|SELECT|NEAREST|STATUS"},
+  {"file", ARG_STRING, false, 0, -1, nullptr},
+  {"point", ARG_STRING, false, 0, -1, nullptr}
+};
+const command_arg_t ws_args_spartn_keys[] = {{"current", ARG_OBJECT, true, 0, -1, nullptr}, {"next", ARG_OBJECT, false, 0, -1, nullptr}};
+
+#define WS_COMMAND(name, args, handler) {command_hash(name), name, args, sizeof(args) / sizeof(args[0]), handler}
+#define WS_COMMAND_NO_ARGS(name, handler) {command_hash(name), name, nullptr, 0, handler}
+
+const ws_command_t ws_commands[] = {
+  WS_COMMAND("message", ws_args_message, ws_cmd_message),
+  WS_COMMAND("survey", ws_args_start_stop, ws_cmd_survey),
+  WS_COMMAND("set_target_accuracy", ws_args_target_accuracy, ws_cmd_set_target_accuracy),
+  WS_COMMAND("survey_log", ws_args_survey_log, ws_cmd_survey_log),
+  WS_COMMAND("rtk_alert", ws_args_rtk_alert, ws_cmd_rtk_alert),
+  WS_COMMAND_NO_ARGS("rtk_events", ws_cmd_rtk_events),
+  WS_COMMAND("survey_log_flush", ws_args_log_flush, ws_cmd_survey_log_flush),
+  WS_COMMAND("sd_cache", ws_args_sd_cache, ws_cmd_sd_cache),
+  WS_COMMAND("sd_cache_kb", ws_args_sd_cache_kb, ws_cmd_sd_cache_kb),
+  WS_COMMAND("track_log", ws_args_start_stop_status, ws_cmd_track_log),
+  WS_COMMAND("event_marks", ws_args_start_stop_status, ws_cmd_event_marks),
+  WS_COMMAND("batch_survey", ws_args_batch_survey, ws_cmd_batch_survey),
+  WS_COMMAND("save_survey", ws_args_save_survey, ws_cmd_save_survey),
+  WS_COMMAND("create_file", ws_args_path, ws_cmd_create_file),
+  WS_COMMAND("remove_file", ws_args_path, ws_cmd_remove_file),
+  WS_COMMAND("open_dir", ws_args_path, ws_cmd_open_dir),
+  WS_COMMAND("show_file", ws_args_path, ws_cmd_show_file),
+  WS_COMMAND("signals", ws_args_signals, ws_cmd_signals),
+  WS_COMMAND("telemetry_keyframe", ws_args_keyframe, ws_cmd_telemetry_keyframe),
+  WS_COMMAND("history", ws_args_history, ws_cmd_history),
+  WS_COMMAND("rate_profile", ws_args_rate_profile, ws_cmd_rate_profile),
+  WS_COMMAND("set_lband_frequency", ws_args_lband_frequency, ws_cmd_set_lband_frequency),
+  WS_COMMAND("spartn_keys", ws_args_spartn_keys, ws_cmd_spartn_keys),
+  WS_COMMAND("set_save_file", ws_args_path, ws_cmd_set_save_file),
+  WS_COMMAND("ublox_read", ws_args_ublox_read, ws_cmd_ublox_read),
+  WS_COMMAND("stakeout", ws_args_stakeout, ws_cmd_stakeout),
+  WS_COMMAND("convergence", ws_args_convergence, ws_cmd_convergence),
+  WS_COMMAND("log", ws_args_log, ws_cmd_log),
+  WS_COMMAND_NO_ARGS("command_stats", ws_cmd_command_stats),
+};
+#define WS_COMMAND_COUNT (sizeof(ws_commands) / sizeof(ws_commands[0]))
+
+CommandIndex ws_command_index;
+command_stats_t ws_command_stats[WS_COMMAND_COUNT];
+uint32_t ws_commands_malformed = 0; // not JSON, too long, no cmd
+uint32_t ws_commands_unknown = 0;
+
+void init_ws_commands() {
+  for (uint8_t i = 0; i < WS_COMMAND_COUNT; i++) {
+    if (!ws_command_index.add(ws_commands[i].hash, i)) {
+      LOG_E("ws", "Websocket command not registered, hash taken or index full: %s", ws_commands[i].name);
+    }
+  }
+}
+
+// Fields in the message that the schema does not know are an error too, error names the first problem
+bool ws_command_args_ok(const ws_command_t &command, JsonObject args, char *error, size_t error_size) {
+  for (JsonPair field : args) {
+    const char *key = field.key().c_str();
+    if (strcmp(key, "cmd") == 0) continue;
+    bool known = false;
+    for (uint8_t i = 0; i < command.arg_count && !known; i++) known = strcmp(key, command.args[i].name) == 0;
+    if (!known) {
+      snprintf(error, error_size, "unknown field %s", key);
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < command.arg_count; i++) {
+    const command_arg_t &arg = command.args[i];
+    JsonVariant value = args[arg.name];
+    if (value.isNull()) {
+      if (!arg.required) continue;
+      snprintf(error, error_size, "missing %s", arg.name);
+      return false;
+    }
+    bool ranged = arg.min <= arg.max;
+    bool ok;
+    switch (arg.type) {
+    case ARG_STRING:
+      ok = value.is<const char *>() && (!arg.choices || command_choice_ok(arg.choices, value.as<const char *>()));
+      break;
+    case ARG_INT:
+      ok = value.is<long>() && (!ranged || (value.as<long>() >= arg.min && value.as<long>() <= arg.max));
+      break;
+    case ARG_NUMBER:
+      ok = value.is<float>() && (!ranged || (value.as<float>() >= arg.min && value.as<float>() <= arg.max));
+      break;
+    default:
+      ok = value.is<JsonObject>();
+      break;
+    }
+    if (!ok) {
+      snprintf(error, error_size, "bad %s", arg.name);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ws_command_error(uint8_t num, const char *name, const char *error) {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["cmd_rejected"] = name;
+  object["cmd_error"] = error;
+  serializeJson(object, jsonString);
+  ws_send(num, jsonString);
+}
+
+void ws_dispatch(uint8_t num, uint8_t *payload, size_t length) {
+  if (length > WS_COMMAND_MAX_LENGTH) { // nothing we accept is this long, do not spend the parse on it
+    ws_commands_malformed++;
+    ws_command_error(num, "", "too long");
+    return;
+  }
+  DeserializationError error = deserializeJson(json_doc_rx, payload, length);
+  const char *name = error ? nullptr : json_doc_rx["cmd"].as<const char *>();
+  if (!name) {
+    LOG_W("ws", error ? "deserializeJson() failed" : "Websocket message without cmd");
+    ws_commands_malformed++;
+    ws_command_error(num, "", error ? "malformed" : "missing cmd");
+    return;
+  }
+
+  int index = ws_command_index.find(command_hash(name, strlen(name)));
+  if (index < 0 || strcmp(ws_commands[index].name, name) != 0) {
+    ws_commands_unknown++;
+    ws_command_error(num, name, "unknown command");
+    return;
+  }
+
+  const ws_command_t &command = ws_commands[index];
+  JsonObject args = json_doc_rx.as<JsonObject>();
+  char problem[48];
+  if (!ws_command_args_ok(command, args, problem, sizeof(problem))) {
+    ws_command_stats[index].rejected++;
+    ws_command_error(num, command.name, problem);
+    return;
+  }
+
+  uint32_t start = micros();
+  command.handler(num, args);
+  ws_command_stats[index].add(micros() - start);
+  save_session(); // only writes when the command changed session state
+}
+
+// Per-command handler time since boot, {command_stats: [{cmd, calls, rejected, mean_us, max_us}], ...}
+void send_command_stats(uint8_t num) {
+  String message = "{\"command_stats\":[";
+  bool first = true;
+  for (uint8_t i = 0; i < WS_COMMAND_COUNT; i++) {
+    const command_stats_t &stats = ws_command_stats[i];
+    if (stats.calls == 0 && stats.rejected == 0) continue;
+    String jsonString = "";
+    JsonObject object = json_doc_tx.to<JsonObject>();
+    object["cmd"] = ws_commands[i].name;
+    object["calls"] = stats.calls;
+    object["rejected"] = stats.rejected;
+    object["mean_us"] = stats.mean_us();
+    object["max_us"] = stats.max_us;
+    serializeJson(object, jsonString);
+    if (!first) message += ",";
+    message += jsonString;
+    first = false;
+  }
+  message += "],\"cmd_malformed\":" + String(ws_commands_malformed) + ",\"cmd_unknown\":" + String(ws_commands_unknown) + "}";
+  ws_send(num, message);
+}
+
+// Websocket queue functions
+void ws_broadcast(const String &message, ws_priority_t priority, uint8_t topic) {
+  ws_outbox.broadcast(priority, topic, message.c_str(), message.length());
+}
+
+void ws_send(uint8_t client, const String &message, ws_priority_t priority, uint8_t topic) {
+  ws_outbox.send(client, priority, topic, message.c_str(), message.length());
+}
+
+void ws_broadcast_telemetry(TelemetryDelta &telemetry) {
+  std::string message = telemetry.update(millis());
+  if (!message.empty()) ws_outbox.broadcast(WS_TELEMETRY, telemetry.topic(), message.data(), message.size());
+}
+
+void ws_send_keyframe(uint8_t client, const TelemetryDelta &telemetry) {
+  std::string message = telemetry.keyframe();
+  if (!message.empty()) ws_outbox.send(client, WS_TELEMETRY, telemetry.topic(), message.data(), message.size());
+}
+
+ws_send_result_t ws_transport_send(uint8_t client, const char *data, size_t length, bool binary, void *) {
+  // never blocks, a full per-connection queue comes back as BLOCKED and the outbox retries or evicts
+  switch (http.ws_send(client, data, length, binary)) {
+  case HTTP_SEND_OK:
+    return WS_SEND_OK;
+  case HTTP_SEND_BLOCKED:
+    return WS_SEND_BLOCKED;
+  default:
+    return WS_SEND_FAILED;
+  }
+}
+
+void ws_transport_evict(uint8_t client, const char *reason, void *) {
+  LOG_W("ws", "Evicting websocket client %u: %s", client, reason);
+  http.ws_close(client);
+}
+
+uint32_t ws_clock_us() {
+  return micros();
+}
+
+// [client, lag_ms, max_lag_ms, max_send_us, coalesced, pending] per connected client
+void send_ws_client_stats() {
+  String stats = "{\"ws_clients\":[";
+  bool first = true;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (!ws_outbox.connected(i)) continue;
+    const ws_client_stats_t &client = ws_outbox.stats(i);
+    if (!first) stats += ",";
+    stats += "[" + String(i) + "," + String(client.lag_ms) + "," + String(client.max_lag_ms) + "," + String(client.max_send_us)
+      + "," + String(client.coalesced) + "," + String(ws_outbox.pending(i)) + "]";
+    first = false;
+  }
+  stats += "]}";
+  if (!first) ws_broadcast(stats, WS_TELEMETRY, WS_TOPIC_WS_STATS);
+}
+
+// SD Card Functions
+void listFiles(const char *dirName) {
+  File root = SD.open(dirName);
+
+  if(!root) {
+    LOG_E("sd", "Failed to open directory %s", dirName);
+    return;
+  }
+
+  LOG_D("sd", "Files in %s:", dirName);
+
+  while (File entry = root.openNextFile()) {
+    LOG_D("sd", "  %s", entry.name());
+    entry.close();
+  }
+
+  root.close();
+}
+
+String listFiles_HTML(const char *dirName) {
+  File root = SD.open(dirName);
+  String directory_files = "";
+
+  if(!root) {
+    LOG_E("sd", "Failed to open directory %s", dirName);
+    display_info("Attempted to open file directory but failed.");
+  }
+
+  LOG_D("sd", "Listing %s for the web page", dirName);
+  display_info("Displaying Files on Device in Web browser.");
+
+
+  while (File entry = root.openNextFile()) {
+    if (is_directory(entry.name())) { // only list dir if file is a dir
+      LOG_D("sd", "  %s", entry.name());
+      directory_files += "<div id='file_item_container' style=\"text-align: center;\">\n";
+      directory_files += "<p class='file_list_item'>"; // use the class name to handle updating files view
+      directory_files += entry.name();
+      directory_files += "</p>\n";
+      directory_files += "<button class='folder_btn' onclick='open_directory(this)' device_file_path='/";
+      directory_files += entry.name();
+      directory_files += "' disabled>Open ";
+      directory_files += entry.name();
+      directory_files += "</button>\n";
+      directory_files += "</div>\n";
+
+    }
+    else {
+      directory_files += "<div id='file_item_container' style=\"text-align: center;\">\n";
+      directory_files += "<p class='file_list_item'>"; // use the class name to handle updating files view
+      directory_files += entry.name();
+      directory_files += "</p>\n";
+      if(isFileTxt(entry.name())) { // check for txt file name
+        directory_files += "<button class='view_content_btn' device_file_path='/"; // view file contents button
+        directory_files += entry.name();
+        directory_files += "' onclick='open_file_contents(this)'> View ";
+        directory_files += entry.name();
+        directory_files += " Contents</button>\n";
+        directory_files += "<button class='set_save_file_btn' onclick='set_save_file(this)' device_file_path ='/";
+        directory_files += entry.name();
+        directory_files += "'> Make Save File</button>\n"; // onclick, device file path
+      }
+      directory_files += "</div>\n";
+    }
+    entry.close();
+  }
+
+  root.close();
+  return directory_files;
+}
+
+bool isFileTxt(String fileName) {
+  // Get the position of the last dot in the file name
+  int dotIndex = fileName.lastIndexOf('.');
+
+  // Check if the dot is found and the file extension is ".txt"
+  if(dotIndex != -1 && fileName.substring(dotIndex) == ".txt") {
+    return true;
+  } else {
+    return false;
+  }
+}
+
+bool is_directory(const char *dirName) {
+  int i;
+
+  for (i = 0; dirName[i] != '\0'; i++) { // parse string until we reach null char
+    if (dirName[i] == '.') { // check for period in file name
+      return false;
+    }
+  }
+
+  return true; // file is a dir
+}
+
+void set_save_file(String file_dir) {
+  working_directory = file_dir;
+  LOG_I("survey", "Set save file to %s", working_directory.c_str());
+}
+
+// update the listed files for front end view
+void update_listed_files_WebSocket(const String dirName) {
+  File root = SD.open(dirName);
+  String directory_files = "";
+
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+
+  if(!root) {
+    LOG_E("sd", "Failed to open directory %s", dirName.c_str());
+    display_info("Attempted to open file directory but failed.");
+  }
+
+  LOG_D("sd", "Listing %s for the file view", dirName.c_str());
+  display_info("Displaying Files on Device in Web browser.");
+
+  object["file_view_directory"] = file_view_directory;
+  object["update_view"] = "file_list"; // build client side functionality to update the file list view.
+  JsonArray dirs_array = object.createNestedArray("directories");
+  JsonArray files_array = object.createNestedArray("files");
+  while (File entry = root.openNextFile()) {
+    if(is_directory(entry.name())) { // check for dir
+      dirs_array.add((String)entry.name());
+      
+    } else {
+      files_array.add((String)entry.name());
+    }
+    entry.close();
+  }
+
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString);
+  root.close();
+}
+
+void show_file_contents(const String dirName) {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+
+  uint8_t first_byte;
+  if(sd_cache_read(dirName, 0, &first_byte, 1) >= 0) { // file exists, and its first block is now cached
+    display_info("Displaying ");
+    display_add_info(dirName);
+    display_add_info("  file contents on web dash.");
+
+    String file_content = sd_cache_read_file(dirName);
+
+    LOG_D("sd", "Showing %s, %u bytes", dirName.c_str(), file_content.length());
+
+    object["update_view"] = "show_file_content";
+    object["file_content"] =  file_content;
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+  }
+}
+
+void create_file(String file_name) {
+  sd_cache_invalidate("/" + file_name);
+  // check if file exist
+  if(SD.exists("/" + file_name)) {
+    LOG_W("sd", "Attempted to create new file %s but file already exist", file_name.c_str());
+  }
+  else {
+    // Create file
+    File new_file = SD.open("/" + file_name, FILE_WRITE);
+    new_file.close();
+    LOG_I("sd", "Created new File %s", file_name.c_str());
+  }
+}
+
+void delete_file(String file_name) {
+    sd_cache_invalidate("/" + file_name);
+    if(SD.exists("/" + file_name)) {
+      // Delete File
+      LOG_I("sd", "Deleting File %s", file_name.c_str());
+      SD.remove("/" + file_name);
+    } else {
+      LOG_W("sd", "Attempted to remove file %s but file does not exist.", file_name.c_str());
+    }
+}
+
+void append_to_file(String new_file_content) {
+  sd_cache_invalidate(working_directory);
+  File append_file = SD.open(working_directory, FILE_APPEND);
+  if(append_file) {
+    append_file.print(new_file_content);
+    append_file.close();
+    LOG_D("sd", "Appended %u bytes to %s", new_file_content.length(), working_directory.c_str());
+  } else {
+    display_info("Failed to open survey observation save file.");
+    LOG_E("sd", "Failed to open survey observation save file %s", working_directory.c_str());
+  }
+}
+
+// Get Working Directory file contents
+String get_file_contents() {
+  return sd_cache_read_file(working_directory);
+}
+
+// SD read cache functions
+void init_sd_cache(uint16_t kb) {
+  delete sd_cache;
+  sd_cache = nullptr;
+  free(sd_cache_memory); // heap_caps_malloc memory is freed with free() as well
+  sd_cache_clear();
+
+  if (kb && kb < 4) kb = 4;
+  if (kb > SD_CACHE_MAX_KB) kb = SD_CACHE_MAX_KB;
+  size_t size = (kb ? kb : SD_CACHE_PSRAM_KB) * 1024;
+  sd_cache_memory = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+  if (!sd_cache_memory) {
+    if (!kb) size = SD_CACHE_DRAM_KB * 1024;
+    sd_cache_memory = (uint8_t *)malloc(size);
+  }
+  if (!sd_cache_memory) {
+    LOG_W("cache", "No memory for the SD read cache, reading straight from the card.");
+    return;
+  }
+  sd_cache = new BlockCache(sd_cache_memory, size);
+  LOG_I("cache", "SD read cache: %u KB, %u blocks", (unsigned)(size / 1024), (unsigned)sd_cache->capacity_blocks());
+}
+
+// Cache id of a path, 0 when it has none and add is false (or there is no cache)
+uint32_t sd_cache_file_id(const String &path, bool add) {
+  if (!sd_cache) return 0;
+  int slot = 0;
+  for (int i = 0; i < SD_CACHE_FILES; i++) {
+    if (sd_cache_path_used[i] && sd_cache_paths[i] == path) {
+      sd_cache_path_used[i] = ++sd_cache_path_tick;
+      return i + 1;
+    }
+    if (sd_cache_path_used[i] < sd_cache_path_used[slot]) slot = i; // free slots (0) win
+  }
+  if (!add) return 0;
+  if (sd_cache_path_used[slot]) sd_cache->invalidate(slot + 1); // the old path's blocks would pass as the new one's
+  sd_cache_paths[slot] = path;
+  sd_cache_path_used[slot] = ++sd_cache_path_tick;
+  return slot + 1;
+}
+
+void sd_cache_clear() {
+  if (sd_cache) sd_cache->clear();
+  for (int i = 0; i < SD_CACHE_FILES; i++) {
+    sd_cache_paths[i] = "";
+    sd_cache_path_used[i] = 0;
+  }
+}
+
+bool sd_cache_open(sd_cache_source_t &source) {
+  if (!source.opened) {
+    source.file = SD.open(source.path, FILE_READ);
+    source.opened = true;
+  }
+  return source.file;
+}
+
+int32_t sd_cache_read_block(uint32_t block, uint8_t *data, void *ctx) {
+  sd_cache_source_t &source = *(sd_cache_source_t *)ctx;
+  if (!sd_cache_open(source)) return -1;
+  uint32_t offset = block * BLOCK_CACHE_BLOCK_SIZE;
+  if (offset >= source.file.size()) return 0; // end of file
+  if (!source.file.seek(offset)) return -1;
+  return source.file.read(data, BLOCK_CACHE_BLOCK_SIZE); // whole sectors, one card transaction
+}
+
+// Bytes read, -1 when the file does not exist or cannot be read. Loops over one file share the
+// source, so the file is opened once; cache false reads straight from the card and adds nothing.
+int32_t sd_cache_read(sd_cache_source_t &source, uint32_t offset, uint8_t *out, size_t length, bool cache) {
+  if (cache && source.file_id) return sd_cache->read(source.file_id, offset, out, length, sd_cache_read_block, &source);
+  if (!sd_cache_open(source)) return -1;
+  return source.file.seek(offset) ? source.file.read(out, length) : -1;
+}
+
+int32_t sd_cache_read(const String &path, uint32_t offset, uint8_t *out, size_t length) {
+  sd_cache_source_t source = {path.c_str(), File(), false, sd_cache_file_id(path, true)};
+  int32_t read = sd_cache_read(source, offset, out, length, true);
+  source.file.close();
+  return read;
+}
+
+// The head of a large file is cached, the rest goes past so one big read cannot flush everything else
+String sd_cache_read_file(const String &path) {
+  String content = "";
+  sd_cache_source_t source = {path.c_str(), File(), false, sd_cache_file_id(path, true)};
+  uint32_t cached_bytes = sd_cache ? sd_cache->capacity_blocks() / SD_CACHE_FILE_SHARE * BLOCK_CACHE_BLOCK_SIZE : 0;
+  char chunk[BLOCK_CACHE_BLOCK_SIZE];
+  int32_t read;
+  for (uint32_t offset = 0; (read = sd_cache_read(source, offset, (uint8_t *)chunk, sizeof(chunk), offset < cached_bytes)) > 0; offset += read) {
+    content.concat(chunk, read);
+  }
+  source.file.close();
+  return content;
+}
+
+// Line at offset without the newline, offset moves to the next line. False at the end of the file.
+bool sd_cache_read_line(const String &path, uint32_t &offset, String &line) {
+  line = "";
+  sd_cache_source_t source = {path.c_str(), File(), false, sd_cache_file_id(path, true)};
+  char chunk[64];
+  int32_t read;
+  bool found = false;
+  while (!found && (read = sd_cache_read(source, offset, (uint8_t *)chunk, sizeof(chunk), true)) > 0) {
+    char *newline = (char *)memchr(chunk, '\n', read);
+    size_t length = newline ? newline - chunk : read;
+    line.concat(chunk, length);
+    offset += newline ? length + 1 : length;
+    found = newline != nullptr;
+  }
+  source.file.close();
+  return found || line.length() > 0; // last line without a newline
+}
+
+void sd_cache_invalidate(const String &path) {
+  uint32_t file_id = sd_cache_file_id(path, false);
+  if (file_id) sd_cache->invalidate(file_id);
+}
+
+void send_sd_cache_status() {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["sd_cache_kb"] = sd_cache ? sd_cache->capacity_blocks() * BLOCK_CACHE_BLOCK_SIZE / 1024 : 0;
+  object["sd_cache_blocks_used"] = sd_cache ? sd_cache->blocks_used() : 0;
+  object["sd_cache_hits"] = sd_cache ? sd_cache->hits() : 0;
+  object["sd_cache_misses"] = sd_cache ? sd_cache->misses() : 0;
+  object["sd_cache_evictions"] = sd_cache ? sd_cache->evictions() : 0;
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString);
+}
+
+bool survey_file_empty() {
+  uint8_t first_byte;
+  return sd_cache_read(working_directory, 0, &first_byte, 1) <= 0; // missing or empty
+}
+
+void init_survey_file() {
+  // open survey file and set datum type
+  // Check if file has already been intiated
+  if(!survey_file_empty()) {
+    LOG_D("survey", "Survey File already configured");
+    display_info("Survey File already configured");
+  } else {
+    // configure survey file with datum
+    append_to_file(datum);
+  }
+
 }
 
-// Web CSS
-String WebsiteBaseCSS() {
-  String CSS = "<style>\n";
-  CSS += ".button-link {\n";
-  CSS += "  display: inline-block;\n";
-  CSS += "  padding: 10px 20px;\n";
-  CSS += "  background-color: #4CAF50;\n";
-  CSS += "  color: white;\n";
-  CSS += "  text-align: center;\n";
-  CSS += "  text-decoration: none;\n";
-  CSS += "  font-size: 16px;\n";
-  CSS += "  border-radius: 5px;\n";
-  CSS += "  border: none;\n";
-  CSS += "  cursor: pointer;\n";
-  CSS += "}\n";
-  CSS += "\n";
-  CSS += ".button-link:hover {\n";
-  CSS += "  background-color: #45A049;\n";
-  CSS += "}\n";
-  CSS += "</style>\n";
+void save_survey_observation(String gcp_index) {
+  LOG_I("survey", "Saving Survey Observation");
+  display_info("Saving Survey Observation");
 
-  return CSS;
+  String GCP_name = "GCP" + gcp_index;
+  if (gcp_index.toInt() > 0) next_gcp_index = gcp_index.toInt() + 1;
+  int32_t longitude = latest_epoch.lon; // deg * 1e-7, the same value the high precision getters return
+  int32_t latitude = latest_epoch.lat;
+  int32_t elevation = latest_epoch.height;
+  LOG_D("survey", "Writing survey observation to file.");
+
+  log_survey_point(GCP_name, longitude, latitude, elevation, latest_epoch.hAcc);
+  if (solution_monitor.alert()) { // saved by hand, but not silently
+    solution_event_t event = {solution_monitor.alert_from(), solution_monitor.state(), 0, solution_monitor.flags(), true};
+    report_rtk_event(RTK_EVENT_SAVED_IN_ALERT, event, latest_epoch, GCP_name);
+  }
+
+  String file_content = GCP_name + " " + String(longitude) + " " + String(latitude) + " " + String(elevation) + "\n";
+
+  // check if survey file has been initiated
+  if (survey_file_empty()){
+    init_survey_file(); // config survey file
+  }
+
+  append_to_file(file_content);
 }
 
+// Surveying Functions. False when the receiver could not be asked or did not start the survey, the
+// failure has been reported on the OLED and the websocket by then.
+bool start_survey_observation() {
+  // dashboard send data json object
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
 
-// Display functions
-void display_info(String message) {
-  display.clearDisplay();
-  display.setCursor(0,0);
-  display.setTextSize(1);
-  display.setTextColor(1);
-  display.setTextWrap(true);
-  display.print(message);
-  display.display();
+  display_info("starting survey observation.");
+  if (!gnss_ready()) {
+    object["survey_status"] = "failed_to_get_status";
+    object["survey_msg"] = "GNSS receivers are still starting up.";
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+    return false;
+  }
+  // check if there already is a survey in progress
+  bool response = HAM_GNSS.getSurveyStatus(2000);
+  
+  if (response ==  false) {
+    LOG_E("survey", "Failed to get Survey In status.");
+    display_info("Failed to get Survey In status.");
+    // Send Survey Status
+    object["survey_status"] = "failed_to_get_status";
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+    return false;
+  }
+
+  if (HAM_GNSS.getSurveyInActive() == false && survey_in_progress) {
+    LOG_W("survey", "Survey already in progress.");
+    display_info("Survey already in progress");
+    // Send Survey Status
+    object["survey_status"] = "in_progress";
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+  }
+  else {
+    // Start Survey
+    LOG_I("survey", "Initiating Survey");
+    display_info("Initiating Survey");
+
+    // Send Survey Status
+    object["survey_status"] = "started";
+    object["survey_desired_accuracy"] = survey_desired_accuracy;
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+
+    // Start Survey
+    response = HAM_GNSS.enableSurveyMode(60, survey_desired_accuracy, VAL_LAYER_RAM); // Enable Survey in, 60 secoonds 5m of accuracy Save setting in RAM layer only (not BBR)
+    if(response == false) {
+      LOG_E("survey", "Survey Start Failed");
+      display_info("Survey Start Failed");
+      // Send Survey Status
+      object["survey_status"] = "survey_start_failed";
+      serializeJson(object, jsonString);
+      ws_broadcast(jsonString);
+      return false;
+    }
+    else {
+      survey_in_progress = true; // set global survey variable
+      reset_survey_svin();
+    }
+  }
+  return true;
 }
-void display_add_info(String message) {
-  display.print(message);
-  display.display();
+
+// Survey data helper functions
+String get_fix_type() {
+  String fixType_str = "";
+  byte fixType = latest_epoch.fixType;
+  if(fixType == 0) fixType_str = "No fix";
+  else if(fixType == 1) fixType_str = "Dead Reckoning";
+  else if(fixType == 2) fixType_str = "2D";
+  else if(fixType == 3) fixType_str = "3D";
+  else if(fixType == 4) fixType_str = "GNSS + Dead Reckoning";
+  else if(fixType == 5) fixType_str = "Time only";
+  return fixType_str;
+}
+
+String get_RTK_status() {
+  String RTK_str = "";
+  byte RTK = latest_epoch.carrSoln;
+  if(RTK == 0) RTK_str = "No Solution";
+  else if (RTK == 1) RTK_str = "High precision floating fix";
+  else if (RTK == 2) RTK_str = "High precision fix";
+  return RTK_str;
 }
 
-void display_info_lg(String message) {
-  display.clearDisplay();
-  display.setCursor(0,16);
-  display.setTextSize(1);
-  display.setTextColor(1);
-  display.setTextWrap(true);
-  display.print(message);
-  display.display();
-}
+String get_heading() {
+  String heading_str = "";
+  float heading_f = latest_epoch.headMot * 1e-5;
 
-// Web socket functions
-void webSocketEvent(byte num, WStype_t type, uint8_t * payload, size_t length) { // client number, type of event, payload pointer to array of unsigned integers, length of payload array
-  switch (type)
-  {
-  case WStype_DISCONNECTED:
-    Serial.println("Client Disconnected");
-    break;
-  case WStype_CONNECTED:
-    Serial.println("Client Connected"); // broadcast message to client via json object.
-    if (HAM_GNSS.getSurveyInValid() == false) {
-      String jsonString = "";
-      JsonObject object = json_doc_tx.to<JsonObject>();
-      object["survey_status"] = "in_progress";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
-    }
-    break;
-  case WStype_TEXT:
-    DeserializationError error =  deserializeJson(json_doc_rx, payload);
-    if(error) {
-      Serial.println("deserializeJson() failed");
-      return;
-    }
-    else {
-      // functionality for test button
-      if(json_doc_rx["message"] && json_doc_rx["date"]) {
-        const char* message = json_doc_rx["message"];
-        const char* date = json_doc_rx["date"];
+  if (heading_f < 10.0) {
+    // North
+    heading_str += "N";
+  } else if (heading_f >= 10 && heading_f < 85) {
+    // North East
+    heading_str += "NE";
+  } else if  (heading_f >= 85 && heading_f < 95) {
+    // East
+    heading_str += "E";
+  } else if (heading_f >= 95 && heading_f < 175 ) {
+    // South East
+    heading_str += "SE";
+  } else if  (heading_f >= 175 && heading_f < 185) {
+    // South
+    heading_str += "S";
+  } else if (heading_f >= 185 && heading_f < 265) {
+    // South West
+    heading_str += "SW";
+  } else if (heading_f >= 265 && heading_f < 275) {
+    // West
+    heading_str += "W";
+  } else if (heading_f >= 275 && heading_f < 360) {
+    // North West
+    heading_str += "NW";
+  }
+  heading_str += " - ";
+  heading_str += (String)heading_f;
+  heading_str += "deg from North";
 
-        Serial.println("Message from client : " + String(message) + String(date));
-      }
+  
+  return heading_str;
+}
 
-      if(json_doc_rx["survey"]) {
-        if (json_doc_rx["survey"] == "START") {
-          Serial.println("Start survey called");
-          start_survey_observation();
-        }
-        else if (json_doc_rx["survey"] == "STOP") {
-          // Call stop survey
-          Serial.print("Stopping Survey");
-          stop_survey_observation();
-        }
-      }
+void new_nav_svin(UBX_NAV_SVIN_data_t *svin) {
+  survey_svin.dur_s = svin->dur;
+  survey_svin.mean_acc = svin->meanAcc;
+  survey_svin.valid = svin->valid;
+  survey_svin.active = svin->active;
+  survey_svin.fresh = true;
+  survey_svin.received_ms = millis();
+}
 
-      if(json_doc_rx["set_target_accuracy"]) {
-        Serial.print("Set new target accuracy to: ");
-        float new_accuracy_val = json_doc_rx["set_target_accuracy"];
-        Serial.println(new_accuracy_val);
-        survey_desired_accuracy = new_accuracy_val;
+// A survey just started or resumed: forget the last one's NAV-SVIN, the timeout runs from now
+void reset_survey_svin() {
+  survey_svin = {};
+  survey_svin.received_ms = millis();
+}
 
-        String JsonString = "";
-        JsonObject object = json_doc_tx.to<JsonObject>();
+void handle_survey_observation_in_progress() {
+  if (!survey_in_progress) return;
 
-        object["alert"] = "target accuracy set to new value: " + (String)survey_desired_accuracy;
-        object["update_status"] = "target_accuracy_updated";
-        object["updated_target_acc_val"] = (String)survey_desired_accuracy;
-        serializeJson(object,JsonString);
-        webSocket.broadcastTXT(JsonString);
-      }
+  if (!survey_svin.fresh) {
+    uint32_t now = millis();
+    if (now - survey_svin.received_ms < SURVEY_SVIN_TIMEOUT_MS) return;
+    survey_svin.received_ms = now; // and again after another timeout
 
-      if(json_doc_rx["save"]) {
-        if(json_doc_rx["save"] == "survey") {
-          save_survey_observation(json_doc_rx["gcp_index"].as<String>());
-        }
-      }
+    survey_telemetry.clear_all(); // the page hides the values it has no fresh copy of
+    survey_telemetry.set(SURVEY_STATUS, "in_progress");
+    survey_telemetry.set(SURVEY_MSG, "SVIN request failed");
+    ws_broadcast_telemetry(survey_telemetry);
 
-      if(json_doc_rx["create_file"]) {
-        create_file(json_doc_rx["create_file"]);
-        update_listed_files_WebSocket(file_view_directory); // load root directory but update this to a variable possibly called working_directory
-      }
+    display_info("SVIN request failed");
+    return;
+  }
+  survey_svin.fresh = false;
+
+  if (!survey_svin.valid) {
+    float mean_accuracy = survey_svin.mean_acc / 10000.0; // m
+    uint32_t position_accuracy = sqrt((double)latest_epoch.hAcc * latest_epoch.hAcc + (double)latest_epoch.vAcc * latest_epoch.vAcc); // 3D, mm
+    survey_telemetry.set(SURVEY_STATUS, "in_progress");
+    survey_telemetry.clear(SURVEY_MSG);
+    survey_telemetry.set(SURVEY_TIME_ELAPSED, String(survey_svin.dur_s).c_str());
+    survey_telemetry.set(SURVEY_ACCURACY, String(mean_accuracy).c_str());
+    survey_telemetry.set(SURVEY_LAT, String(latest_epoch.lat).c_str());
+    survey_telemetry.set(SURVEY_LONG, String(latest_epoch.lon).c_str());
+    survey_telemetry.set(SURVEY_ALTITUDE, String(latest_epoch.height).c_str());
+    survey_telemetry.set(SURVEY_ALTITUDE_MSL, String(latest_epoch.hMSL).c_str());
+    survey_telemetry.set(SURVEY_MSL, String(latest_epoch.hMSL).c_str());
+    survey_telemetry.set(SURVEY_POS_ACCURACY, String(position_accuracy).c_str());
+    survey_telemetry.set(SURVEY_VERTICAL_ACCURACY, String(latest_epoch.vAcc).c_str());
+    survey_telemetry.set(SURVEY_HORIZONTAL_ACCURACY, String(latest_epoch.hAcc).c_str());
+    survey_telemetry.set(SURVEY_SIV, String(latest_epoch.numSV).c_str());
+    survey_telemetry.set(SURVEY_FIX_TYPE, get_fix_type().c_str());
+    survey_telemetry.set(SURVEY_RTK, get_RTK_status().c_str());
+    survey_telemetry.set(SURVEY_HEADING, get_heading().c_str());
+    survey_telemetry.set(SURVEY_PDOP, latest_epoch.pDOP / 100.0); // Convert pDOP scaling from 0.01 to 1
+    ws_broadcast_telemetry(survey_telemetry);
+
+    display_info("Survey in Progress");
+    display_add_info(" time: ");
+    display_add_info((String)survey_svin.dur_s);
+    display_add_info(" accuracy: " );
+    display_add_info((String)mean_accuracy);
+  } else {
+    // dashboard send data json object
+    String jsonString = "";
+    JsonObject object = json_doc_tx.to<JsonObject>();
 
-      if(json_doc_rx["remove_file"]) {
-        delete_file(json_doc_rx["remove_file"]);
-        update_listed_files_WebSocket(file_view_directory);
-      }
+    object["survey_status"] = "finished";
+    object["survey_msg"] = "Transmitting RTCM";
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
 
-      if(json_doc_rx["open_dir"]) {
-        // update UI
-        file_view_directory = json_doc_rx["open_dir"].as<String>();
-        update_listed_files_WebSocket(file_view_directory);
-      }
+    display_info("Survey Finished Transmitting RTCM");
+    stop_survey_observation();
+    save_session();
+  }
+}
 
-      if(json_doc_rx["update_view"] == "show_file_content") {
-        show_file_contents(json_doc_rx["file_directory"].as<String>());
-      }
+void stop_survey_observation() {
+  // dashboard send data json object
+    String jsonString = "";
+    JsonObject object = json_doc_tx.to<JsonObject>();
 
-      if(json_doc_rx["set_save_file"]) {
-        set_save_file(json_doc_rx["set_save_file"].as<String>());
-        String JsonString = "";
-        JsonObject object = json_doc_tx.to<JsonObject>();
+  // check if survey is already going
+  if(!HAM_GNSS.getSurveyInValid() || survey_in_progress) {
+    bool response = HAM_GNSS.disableSurveyMode(); // disable survey mode.
+    if(response) {
+      display_info("Survey Observation Stopped.");
+      object["survey_status"] = "finished";
+      object["survey_msg"] = "Survey Successfully Finished";
+      serializeJson(object, jsonString);
+      ws_broadcast(jsonString);
+      survey_in_progress = false;
+    } else {
+      display_info("Attempted to stop survey. but failed");
 
-        object["alert"] = "successfully set save file to " + working_directory;
-        serializeJson(object,JsonString);
-        webSocket.broadcastTXT(JsonString);
-      }
+      object["survey_status"] = "stop_failed";
+      object["survey_msg"] = "Attempted to stop survey. but failded.";
+      serializeJson(object, jsonString);
+      ws_broadcast(jsonString);
+      survey_in_progress = false;
     }
-    break;
+  } else {
+    display_info("Attempted to stop survey but there are no survey in progress.");
+
+    object["survey_status"] = "stopped";
+    object["survey_msg"] = "Attempted  to stop survey but there was no survey in progress.";
+    serializeJson(object, jsonString);
+    ws_broadcast(jsonString);
+    survey_in_progress = false;
   }
+  survey_telemetry.reset(); // the next survey starts with a keyframe
 }
 
-// SD Card Functions
-void listFiles(const char *dirName) {
-  File root = SD.open(dirName);
+// Batch survey functions
+// Plan file: one point name per line, optionally followed by a target accuracy in meters ("GCP12 0.05").
+bool load_gcp_plan(String plan_file) {
+  if (!SD.exists(plan_file)) {
+    LOG_E("batch", "Failed to open GCP plan %s", plan_file.c_str());
+    return false;
+  }
 
-  if(!root) {
-    Serial.println("Failed to open directory");
-    return;
+  gcp_plan_count = 0;
+  String line;
+  uint32_t offset = 0;
+  while (gcp_plan_count < GCP_PLAN_MAX && sd_cache_read_line(plan_file, offset, line)) {
+    line.trim();
+    if (line.length() == 0) continue;
+
+    int space = line.indexOf(' ');
+    gcp_plan[gcp_plan_count] = space == -1 ? line : line.substring(0, space);
+    gcp_plan_accuracy[gcp_plan_count] = space == -1 ? 0 : line.substring(space + 1).toFloat();
+    gcp_plan_count++;
   }
 
-  Serial.println("Files in root directory:");
+  LOG_I("batch", "Loaded %d planned GCPs from %s", gcp_plan_count, plan_file.c_str());
+  return gcp_plan_count > 0;
+}
 
-  while (File entry = root.openNextFile()) {
-    Serial.println(entry.name());
-    entry.close();
+void start_batch_survey(int first_gcp) {
+  if (survey_in_progress) { // survey-in and rover averaging both drive the receiver
+    send_batch_status("survey_in_progress");
+    return;
   }
-
-  root.close();
+  batch_next_gcp = first_gcp;
+  gcp_plan_position = 0;
+  batch_points_done = 0;
+  batch_stationary_epochs = 0;
+  batch_start_ms = millis();
+  batch_state = BATCH_WAIT_STATIONARY;
+
+  display_info("Batch survey started, set up on");
+  display_add_info(batch_point_name());
+  send_batch_status("waiting_stationary");
 }
 
-String listFiles_HTML(const char *dirName) {
-  File root = SD.open(dirName);
-  String directory_files = "";
+void stop_batch_survey() {
+  flush_batch_records();
+  batch_state = BATCH_IDLE;
+  save_session();
+  display_info("Batch survey stopped. ");
+  display_add_info(String(batch_points_done) + " points saved.");
+  send_batch_status("stopped");
+}
 
-  if(!root) {
-    Serial.println("Failed to open directory");
-    display_info("Attempted to open file directory but failed.");
+// Called once per new PVT while a batch is running
+void handle_batch_survey_epoch(const gnss_epoch_t &epoch) {
+  int32_t ground_speed = epoch.gSpeed;
+  uint32_t target_mm = survey_desired_accuracy * 1000;
+  if (gcp_plan_count > 0 && gcp_plan_accuracy[gcp_plan_position] > 0) {
+    target_mm = gcp_plan_accuracy[gcp_plan_position] * 1000;
   }
 
-  Serial.println("Files in root directory:");
-  display_info("Displaying Files on Device in Web browser.");
+  switch (batch_state) {
+  case BATCH_WAIT_MOVE:
+    if (ground_speed > GCP_MOVING_SPEED) {
+      batch_state = BATCH_WAIT_STATIONARY;
+      batch_stationary_epochs = 0;
+      send_batch_status("waiting_stationary");
+    }
+    break;
 
+  case BATCH_WAIT_STATIONARY:
+    batch_stationary_epochs = ground_speed < GCP_STATIONARY_SPEED ? batch_stationary_epochs + 1 : 0;
+    if (batch_stationary_epochs >= GCP_STATIONARY_EPOCHS) {
+      batch_state = BATCH_OCCUPY;
+      batch_occupy_epochs = 0;
+      reset_batch_average();
+      batch_point_start_ms = millis();
+      send_batch_status("occupying");
+    }
+    break;
 
-  while (File entry = root.openNextFile()) {
-    if (is_directory(entry.name())) { // only list dir if file is a dir
-      Serial.println(entry.name());
-      directory_files += "<div id='file_item_container' style=\"text-align: center;\">\n";
-      directory_files += "<p class='file_list_item'>"; // use the class name to handle updating files view
-      directory_files += entry.name();
-      directory_files += "</p>\n";
-      directory_files += "<button class='folder_btn' onclick='open_directory(this)' device_file_path='/";
-      directory_files += entry.name();
-      directory_files += "' disabled>Open ";
-      directory_files += entry.name();
-      directory_files += "</button>\n";
-      directory_files += "</div>\n";
+  case BATCH_OCCUPY: {
+    if (ground_speed > GCP_MOVING_SPEED) { // rover was picked up before the point converged
+      batch_state = BATCH_WAIT_STATIONARY;
+      batch_stationary_epochs = 0;
+      send_batch_status("moved_restarting");
+      break;
+    }
 
+    // PVT carries the same 1e-7 deg resolution as getHighResLatitude() without an extra HPPOSLLH poll
+    // only epochs within the target are averaged, one above it starts the average over
+    uint32_t h_acc = epoch.hAcc;
+    batch_occupy_epochs++;
+    if (h_acc > target_mm) {
+      reset_batch_average();
+    } else {
+      batch_sum_lat += epoch.lat;
+      batch_sum_lon += epoch.lon;
+      batch_sum_alt += epoch.height;
+      if (h_acc > batch_worst_hacc) batch_worst_hacc = h_acc;
+      batch_epochs++;
     }
-    else {
-      directory_files += "<div id='file_item_container' style=\"text-align: center;\">\n";
-      directory_files += "<p class='file_list_item'>"; // use the class name to handle updating files view
-      directory_files += entry.name();
-      directory_files += "</p>\n";
-      if(isFileTxt(entry.name())) { // check for txt file name
-        directory_files += "<button class='view_content_btn' device_file_path='/"; // view file contents button
-        directory_files += entry.name();
-        directory_files += "' onclick='open_file_contents(this)'> View ";
-        directory_files += entry.name();
-        directory_files += " Contents</button>\n";
-        directory_files += "<button class='set_save_file_btn' onclick='set_save_file(this)' device_file_path ='/";
-        directory_files += entry.name();
-        directory_files += "'> Make Save File</button>\n"; // onclick, device file path
-      }
-      directory_files += "</div>\n";
+
+    // held while the RTK alert is up, the rtk_alert CLEAR command accepts the solution as it is
+    if (batch_epochs < GCP_MIN_EPOCHS || solution_monitor.alert()) {
+      if (batch_occupy_epochs % 5 == 0) send_batch_status("occupying");
+      break;
     }
-    entry.close();
+
+    // same record layout as save_survey_observation()
+    String GCP_name = batch_point_name();
+    int32_t lon = batch_sum_lon / batch_epochs;
+    int32_t lat = batch_sum_lat / batch_epochs;
+    int32_t alt = batch_sum_alt / batch_epochs;
+    log_survey_point(GCP_name, lon, lat, alt, batch_worst_hacc); // durable now, the text file catches up on the next flush
+    batch_pending_records += GCP_name + " " + String(lon) + " " + String(lat) + " " + String(alt) + "\n";
+    batch_pending_count++;
+    batch_points_done++;
+    LOG_I("batch", "Batch survey saved %s after %u epochs", GCP_name.c_str(), batch_epochs);
+
+    if (batch_pending_count >= GCP_FLUSH_RECORDS) flush_batch_records();
+
+    batch_next_gcp++;
+    gcp_plan_position++;
+    if (gcp_plan_count > 0 && gcp_plan_position >= gcp_plan_count) {
+      send_batch_status("point_saved");
+      stop_batch_survey(); // plan complete
+      break;
+    }
+    batch_state = BATCH_WAIT_MOVE;
+    save_session();
+    send_batch_status("point_saved");
+    display_info(GCP_name + " saved. Next point");
+    display_add_info(batch_point_name());
+    break;
   }
 
-  root.close();
-  return directory_files;
+  default:
+    break;
+  }
 }
 
-bool isFileTxt(String fileName) {
-  // Get the position of the last dot in the file name
-  int dotIndex = fileName.lastIndexOf('.');
+// Name of the point being occupied: the plan name as written, GCP<n> when there is no plan
+String batch_point_name() {
+  if (gcp_plan_count == 0) return "GCP" + String(batch_next_gcp);
+  return gcp_plan_position < gcp_plan_count ? gcp_plan[gcp_plan_position] : String("");
+}
 
-  // Check if the dot is found and the file extension is ".txt"
-  if(dotIndex != -1 && fileName.substring(dotIndex) == ".txt") {
-    return true;
-  } else {
-    return false;
+void reset_batch_average() {
+  batch_epochs = 0;
+  batch_sum_lat = batch_sum_lon = batch_sum_alt = 0;
+  batch_worst_hacc = 0;
+}
+
+// One append for all queued records instead of a file rewrite per point
+void flush_batch_records() {
+  if (batch_pending_count == 0) return;
+
+  if (survey_file_empty()) {
+    init_survey_file(); // config survey file
   }
+  append_to_file(batch_pending_records);
+  batch_pending_records = "";
+  batch_pending_count = 0;
 }
 
-bool is_directory(const char *dirName) {
-  int i;
+// Session journal functions
+session_state_t session_snapshot() {
+  session_state_t state;
+  memset(&state, 0, sizeof(state));
+  state.version = SESSION_VERSION;
+  state.survey_in_progress = survey_in_progress;
+  state.batch_active = batch_state != BATCH_IDLE;
+  state.target_accuracy = survey_desired_accuracy;
+  state.next_gcp = next_gcp_index;
+  state.batch_next_gcp = batch_next_gcp;
+  state.batch_plan_position = gcp_plan_position;
+  strlcpy(state.working_file, working_directory.c_str(), sizeof(state.working_file));
+  strlcpy(state.view_directory, file_view_directory.c_str(), sizeof(state.view_directory));
+  strlcpy(state.plan_file, gcp_plan_file.c_str(), sizeof(state.plan_file));
+  return state;
+}
 
-  for (i = 0; dirName[i] != '\0'; i++) { // parse string until we reach null char
-    if (dirName[i] == '.') { // check for period in file name
-      return false;
+void save_session() {
+  if (session_resume_pending) return; // would overwrite the saved survey before it was picked up
+  session_state_t state = session_snapshot();
+  if (memcmp(&state, &session_saved, sizeof(state)) == 0) return;
+
+  session_slot_t slot;
+  slot.seq = ++session_seq;
+  slot.state = state;
+  slot.crc = crc32_update(0, (const uint8_t *)&slot, offsetof(session_slot_t, crc));
+  char key[12];
+  snprintf(key, sizeof(key), "session%u", (unsigned)(slot.seq % SESSION_SLOTS));
+  if (prefs.putBytes(key, &slot, sizeof(slot)) == sizeof(slot)) {
+    session_saved = state;
+  }
+}
+
+// Restores the newest valid slot into the globals. Survey and batch state are resumed later by
+// resume_session(), once the receiver is up.
+bool load_session() {
+  session_slot_t best;
+  bool found = false;
+  for (int i = 0; i < SESSION_SLOTS; i++) {
+    session_slot_t slot;
+    char key[12];
+    snprintf(key, sizeof(key), "session%d", i);
+    if (prefs.getBytes(key, &slot, sizeof(slot)) != sizeof(slot)) continue;
+    if (slot.crc != crc32_update(0, (const uint8_t *)&slot, offsetof(session_slot_t, crc))) continue;
+    if (slot.state.version != SESSION_VERSION) continue;
+    if (!found || (int32_t)(slot.seq - best.seq) > 0) {
+      best = slot;
+      found = true;
     }
   }
+  if (!found) return false;
+
+  session_seq = best.seq;
+  session_saved = best.state;
+  best.state.working_file[sizeof(best.state.working_file) - 1] = '\0';
+  best.state.view_directory[sizeof(best.state.view_directory) - 1] = '\0';
+  best.state.plan_file[sizeof(best.state.plan_file) - 1] = '\0';
+  if (best.state.working_file[0]) working_directory = best.state.working_file;
+  if (best.state.view_directory[0]) file_view_directory = best.state.view_directory;
+  gcp_plan_file = best.state.plan_file;
+  survey_desired_accuracy = best.state.target_accuracy;
+  next_gcp_index = best.state.next_gcp;
+
+  LOG_I("session", "Session restored: save file %s, target %.2f m", working_directory.c_str(), survey_desired_accuracy);
+  return best.state.survey_in_progress || best.state.batch_active;
+}
 
-  return true; // file is a dir
+// Picks the survey back up where the reset left it. Survey-in runs on the receiver, so ask it
+// (NAV-SVIN) first: if the ZED-F9P kept power it is still averaging and only our flag was lost.
+// False when the receiver did not answer or refused the survey, dispatch_epoch() tries again
+// SESSION_RESUME_RETRY_MS later and the saved session is kept until then.
+bool resume_session() {
+  const session_state_t &state = session_saved;
+
+  if (state.survey_in_progress && !survey_in_progress) {
+    if (!HAM_GNSS.getSurveyStatus(2000)) {
+      LOG_W("session", "No survey status from the receiver, resume retried in %u s", SESSION_RESUME_RETRY_MS / 1000);
+      display_info("Survey resume failed, retrying");
+      String jsonString = "";
+      JsonObject object = json_doc_tx.to<JsonObject>();
+      object["survey_status"] = "failed_to_get_status";
+      object["survey_msg"] = "Resuming the saved survey, retrying.";
+      serializeJson(object, jsonString);
+      ws_broadcast(jsonString);
+      return false;
+    }
+    if (HAM_GNSS.getSurveyInActive() || HAM_GNSS.getSurveyInValid()) {
+      survey_in_progress = true;
+      reset_survey_svin();
+      LOG_I("session", "Resumed survey-in, %lu s observed", (unsigned long)HAM_GNSS.getSurveyInObservationTime());
+      display_info("Survey resumed");
+    } else if (start_survey_observation()) { // receiver lost it too, start over with the saved target
+      LOG_I("session", "Survey-in restarted after reset");
+    } else {
+      LOG_W("session", "Survey-in restart failed, retried in %u s", SESSION_RESUME_RETRY_MS / 1000);
+      return false;
+    }
+  } else if (state.batch_active) {
+    if (gcp_plan_file.length() == 0 || load_gcp_plan(gcp_plan_file)) {
+      if (gcp_plan_file.length() == 0) gcp_plan_count = 0;
+      start_batch_survey(state.batch_next_gcp);
+      gcp_plan_position = state.batch_plan_position;
+      LOG_I("session", "Resumed batch survey at GCP %s", (gcp_plan_count > 0 && gcp_plan_position < gcp_plan_count ? gcp_plan[gcp_plan_position] : String(batch_next_gcp)).c_str());
+    }
+  }
+  session_resumed_ms = millis();
+  session_resume_pending = false; // so the save below goes through
+  save_session();
+  return true;
 }
 
-void set_save_file(String file_dir) {
-  working_directory = file_dir;
-  Serial.println("Set save file to " + working_directory);
+// Survey log functions
+bool survey_log_read(uint32_t offset, uint8_t *data, size_t length, void *) {
+  return survey_log_file.seek(offset) && survey_log_file.read(data, length) == length;
 }
 
-// update the listed files for front end view
-void update_listed_files_WebSocket(const String dirName) {
-  File root = SD.open(dirName);
-  String directory_files = "";
+bool survey_log_write(uint32_t offset, const uint8_t *data, size_t length, void *) {
+  sd_cache_invalidate(SURVEY_LOG_FILE);
+  return survey_log_file.seek(offset) && survey_log_file.write(data, length) == length;
+}
 
-  String jsonString = "";
-  JsonObject object = json_doc_tx.to<JsonObject>();
+bool survey_log_flush(void *) {
+  survey_log_file.flush();
+  return true;
+}
 
-  if(!root) {
-    Serial.println("Failed to open directory");
-    display_info("Attempted to open file directory but failed.");
+// Zero fill the whole log once so later writes never allocate clusters or grow the file
+bool preallocate_survey_log(const char *path) {
+  sd_cache_invalidate(path);
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) return false;
+  uint8_t zeros[512];
+  memset(zeros, 0, sizeof(zeros));
+  for (uint32_t written = 0; written < SURVEY_LOG_RECORDS * RECORD_SIZE; written += sizeof(zeros)) {
+    if (file.write(zeros, sizeof(zeros)) != sizeof(zeros)) {
+      file.close();
+      return false;
+    }
   }
+  file.close();
+  return true;
+}
 
-  Serial.println("Files in root directory:");
-  display_info("Displaying Files on Device in Web browser.");
-
-  object["file_view_directory"] = file_view_directory;
-  object["update_view"] = "file_list"; // build client side functionality to update the file list view.
-  JsonArray dirs_array = object.createNestedArray("directories");
-  JsonArray files_array = object.createNestedArray("files");
-  while (File entry = root.openNextFile()) {
-    if(is_directory(entry.name())) { // check for dir
-      dirs_array.add((String)entry.name());
-      
-    } else {
-      files_array.add((String)entry.name());
-    }
-    entry.close();
+bool open_survey_log() {
+  if (survey_log_file) survey_log_file.close();
+  File existing = SD.open(SURVEY_LOG_FILE, FILE_READ);
+  bool ready = existing && existing.size() >= SURVEY_LOG_RECORDS * RECORD_SIZE;
+  existing.close();
+  if (!ready && !preallocate_survey_log(SURVEY_LOG_FILE)) {
+    LOG_E("survey", "Failed to create survey log.");
+    return false;
   }
 
-  serializeJson(object, jsonString);
-  webSocket.broadcastTXT(jsonString);
-  root.close();
+  survey_log_file = SD.open(SURVEY_LOG_FILE, "r+"); // overwrite in place, FILE_WRITE would truncate
+  if (!survey_log_file) return false;
+  survey_log.flush_every = prefs.getUShort("log_flush", 1);
+  if (survey_log.recover() != RECORD_LOG_OK) {
+    LOG_E("survey", "Survey log unreadable.");
+    return false;
+  }
+  LOG_I("survey", "Survey log: %lu of %lu records", (unsigned long)survey_log.count(), (unsigned long)survey_log.capacity());
+  return true;
 }
 
-void show_file_contents(const String dirName) {
-  String jsonString = "";
-  JsonObject object = json_doc_tx.to<JsonObject>();
+uint32_t survey_file_id(const String &file) {
+  return survey_file_id(file.c_str(), file.length());
+}
 
-  File file_to_open = SD.open(dirName);
-  if(file_to_open) {
-    display_info("Displaying ");
-    display_add_info(dirName);
-    display_add_info("  file contents on web dash.");
+bool log_survey_point(const String &name, int32_t lon, int32_t lat, int32_t elevation, uint32_t hAcc) {
+  if (!survey_log_file) return false;
+
+  survey_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.file_id = survey_file_id(working_directory);
+  strlcpy(record.name, name.c_str(), sizeof(record.name));
+  record.lon = lon;
+  record.lat = lat;
+  record.elevation = elevation;
+  record.hAcc = hAcc;
+
+  unsigned long start = micros();
+  record_log_result_t result = survey_log.append(SURVEY_RECORD_POINT, &record, sizeof(record));
+  if (result == RECORD_LOG_FULL) { // keep the full log next to the new one, numbering restarts
+    survey_log_file.close();
+    sd_cache_invalidate(SURVEY_LOG_FILE);
+    SD.rename(SURVEY_LOG_FILE, "/survey_log_" + String(survey_log.next_seq()) + ".rec");
+    if (open_survey_log()) result = survey_log.append(SURVEY_RECORD_POINT, &record, sizeof(record));
+  }
+  survey_log_latency.add(micros() - start);
 
-    String file_content = "";
-    while(file_to_open.available()) {
-      unsigned char file_byte = file_to_open.read();
-      file_content += (char)file_byte; // convert byte to ASCII char
-    }
+  if (result != RECORD_LOG_OK) {
+    LOG_E("survey", "Survey log write failed: %d", result);
+    display_info("Survey log write failed");
+    return false;
+  }
+  return true;
+}
 
-    Serial.println("file content: " + file_content);
+struct survey_rebuild_t {
+  uint32_t file_id;
+  File *file;
+  uint32_t points;
+};
+
+bool rebuild_survey_point(const record_t &record, void *ctx) {
+  survey_rebuild_t &rebuild = *(survey_rebuild_t *)ctx;
+  if (record.type != SURVEY_RECORD_POINT || record.length != sizeof(survey_record_t)) return true;
+  survey_record_t point;
+  memcpy(&point, record.payload, sizeof(point));
+  if (point.file_id != rebuild.file_id) return true;
+  point.name[sizeof(point.name) - 1] = '\0';
+  rebuild.file->print(String(point.name) + " " + String(point.lon) + " " + String(point.lat) + " " + String(point.elevation) + "\n");
+  rebuild.points++;
+  return true;
+}
 
-    object["update_view"] = "show_file_content";
-    object["file_content"] =  file_content;
-    serializeJson(object, jsonString);
-    webSocket.broadcastTXT(jsonString);
+// Rewrites the current survey file from the record log, for when the text file was cut off
+bool rebuild_survey_file() {
+  survey_log.sync();
+  sd_cache_invalidate(working_directory);
+  File file = SD.open(working_directory, FILE_WRITE);
+  if (!file) return false;
+  file.print(datum);
+  survey_rebuild_t rebuild = {survey_file_id(working_directory), &file, 0};
+  survey_log.for_each(rebuild_survey_point, &rebuild);
+  file.close();
+  LOG_I("survey", "Rebuilt %s with %lu points", working_directory.c_str(), (unsigned long)rebuild.points);
+  display_info("Rebuilt survey file");
+  return true;
+}
 
-    file_to_open.close();
-  }
+// Device side of the write latency numbers from the record_log_bench host tool
+void send_survey_log_status() {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["survey_log_records"] = survey_log.count();
+  object["survey_log_capacity"] = survey_log.capacity();
+  object["survey_log_flush"] = survey_log.flush_every;
+  object["survey_log_p50_us"] = survey_log_latency.percentile(50);
+  object["survey_log_p99_us"] = survey_log_latency.percentile(99);
+  object["survey_log_max_us"] = survey_log_latency.max();
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString);
 }
 
-void create_file(String file_name) {
-  // check if file exist
-  if(SD.exists("/" + file_name)) {
-    Serial.println("Attempted to create new file " + file_name + "but file already exist");
+// Track log functions
+bool start_track_log() {
+  if (track_file) return true;
+  char name[32];
+  if (latest_epoch.date_valid && latest_epoch.time_valid) {
+    snprintf(name, sizeof(name), "/track_%04d%02d%02d_%02d%02d%02d.trk", latest_epoch.year, latest_epoch.month, latest_epoch.day,
+             latest_epoch.hour, latest_epoch.minute, latest_epoch.second);
+  } else {
+    snprintf(name, sizeof(name), "/track_%lu.trk", millis());
   }
-  else {
-    // Create file
-    File new_file = SD.open("/" + file_name, FILE_WRITE);
-    new_file.close();
-    Serial.println("Created new File " + file_name);
+  // always a new file, appending to one cut off mid-block would misalign every block after it
+  track_file = SD.open(name, FILE_WRITE);
+  if (!track_file) {
+    LOG_E("track", "Failed to create track log %s", name);
+    display_info("Track log failed");
+    return false;
   }
+  track_file_name = name;
+  track_writer.reset();
+  track_write_max_us = 0;
+  LOG_I("track", "Track log started: %s", track_file_name.c_str());
+  display_info("Track log started");
+  return true;
 }
 
-void delete_file(String file_name) {
-    if(SD.exists("/" + file_name)) {
-      // Delete File
-      Serial.println("Deleting File " + file_name);
-      SD.remove("/" + file_name);
-    } else {
-      Serial.println("Attempted to remove file " + file_name + " but file does not exist.");
-    }
+void stop_track_log() {
+  if (!track_file) return;
+  track_writer.flush();
+  track_file.close();
+  LOG_I("track", "Track log stopped: %lu points in %lu blocks", (unsigned long)track_writer.points(), (unsigned long)track_writer.blocks_written());
+  display_info("Track log stopped");
 }
 
-void write_to_file(String new_file_content) {
-  File write_to_file = SD.open(working_directory, FILE_READ);
-  if(write_to_file) {
-    Serial.println("Reading file contents.");
-    // read file
-    String file_content = "";
-    while(write_to_file.available()) {
-      unsigned char file_byte = write_to_file.read();
-      file_content += (char)file_byte; // convert byte to ASCII char
-      Serial.println("File Content: " + file_content);
-    }
-    write_to_file.close();
-    // append file content to new content
-    file_content += new_file_content;
-    write_to_file = SD.open(working_directory, FILE_WRITE);
-    write_to_file.print(file_content);
-    write_to_file.close();
-    Serial.println("Successfully wrote to file.");
-    // send websocket status msg
-  } else {
-    display_info("Failed to open survey observation save file.");
-    Serial.println("Failed to open survey obervation save file");
-    // send websocket status msg
+void epoch_track_log(const gnss_epoch_t &epoch) {
+  if (!track_file || epoch.fixType == 0 || !epoch.date_valid || !epoch.time_valid) return;
+
+  track_point_t point;
+  uint32_t tow;
+  if (!gps_week_from_utc(epoch.year, epoch.month, epoch.day, epoch.hour, epoch.minute, epoch.second, &point.week, &tow)) return;
+  point.tow_ms = epoch.iTOW;
+  point.lat = epoch.lat;
+  point.lon = epoch.lon;
+  point.height = epoch.height;
+  point.hAcc = epoch.hAcc;
+  point.status = epoch.fixType | epoch.carrSoln << 3;
+  point.numSV = epoch.numSV;
+  track_writer.add(point);
+
+  if (epoch.received_ms - track_status_previousMillis > TRACK_STATUS_INTERVAL) {
+    send_track_status();
+    track_status_previousMillis = epoch.received_ms;
   }
 }
 
-// Get Working Directory file contents
-String get_file_contents() {
-  String file_contents = "";
-  File file = SD.open(working_directory, FILE_READ);
-  while(file.available()) {
-    unsigned char file_byte = file.read();
-    file_contents  += (char)file_byte;
+bool write_track_block(const uint8_t *block, size_t length, void *) {
+  unsigned long start = micros();
+  sd_cache_invalidate(track_file_name);
+  bool ok = track_file.write(block, length) == length;
+  if (ok && track_writer.blocks_written() % TRACK_SYNC_BLOCKS == 0) { // counts the block being written
+    track_file.flush();
   }
-  file.close();
+  uint32_t took = micros() - start;
+  if (took > track_write_max_us) track_write_max_us = took;
+  return ok;
+}
 
-  return file_contents;
+// Event mark functions
+void new_tim_tm2(UBX_TIM_TM2_data_t *tm2) {
+  if (!tm2->flags.bits.newRisingEdge) return;
+  event_mark_t mark;
+  mark.count = tm2->count;
+  mark.week = tm2->wnR;
+  mark.tow_ms = tm2->towMsR;
+  mark.tow_sub_ns = tm2->towSubMsR;
+  mark.acc_ns = tm2->accEst;
+  mark.time_base = tm2->flags.bits.timeBase;
+  mark.time_valid = tm2->flags.bits.time;
+  mark.captured_us = micros();
+  event_ring.push(mark); // a full ring counts the drop, the SD write never holds up the callback
 }
 
-void init_survey_file() {
-  // open survey file and set datum type
-  // Check if file has already been intiated
-  if(get_file_contents().indexOf(datum) != -1) {
-    // pattern found
-    Serial.println("Survey File already configured");
-    display_info("Survey File already configured");
+void new_hpposllh(UBX_NAV_HPPOSLLH_data_t *hp) {
+  if (hp->flags.bits.invalidLlh) return;
+  position_sample_t sample;
+  sample.tow_ms = hp->iTOW;
+  sample.lat = (int64_t)hp->lat * 100 + hp->latHp;
+  sample.lon = (int64_t)hp->lon * 100 + hp->lonHp;
+  sample.height = (int64_t)hp->height * 10 + hp->heightHp;
+  sample.h_acc = hp->hAcc;
+  sample.v_acc = hp->vAcc;
+  event_window.add(sample);
+}
+
+bool start_event_marks() {
+  if (event_file) return true;
+  if (!gnss_ready()) return false;
+  char name[32];
+  if (latest_epoch.date_valid && latest_epoch.time_valid) {
+    snprintf(name, sizeof(name), "/events_%04d%02d%02d_%02d%02d%02d.csv", latest_epoch.year, latest_epoch.month, latest_epoch.day,
+             latest_epoch.hour, latest_epoch.minute, latest_epoch.second);
   } else {
-    // configure survey file with datum
-    write_to_file(datum);
+    snprintf(name, sizeof(name), "/events_%lu.csv", millis());
   }
-
+  event_file = SD.open(name, FILE_WRITE);
+  if (!event_file) {
+    LOG_E("events", "Failed to create event log %s", name);
+    display_info("Event log failed");
+    return false;
+  }
+  event_file.print("count,week,tow_s,lat_deg,lon_deg,height_m,hacc_m,vacc_m,time_acc_ns,status\n");
+  event_file_name = name;
+
+  // the callback setters also turn the messages on, once per navigation epoch
+  event_window.clear();
+  HAM_GNSS.setAutoHPPOSLLHcallbackPtr(&new_hpposllh, VAL_LAYER_RAM);
+  HAM_GNSS.setAutoTIMTM2callbackPtr(&new_tim_tm2, VAL_LAYER_RAM);
+  event_marks_logged = event_marks_unmatched = event_marks_missed = 0;
+  event_count_valid = false;
+  event_latency.clear();
+  event_ring.reset_stats();
+  LOG_I("events", "Event marks started: %s", event_file_name.c_str());
+  display_info("Event marks started");
+  return true;
 }
 
-void save_survey_observation(String gcp_index) {
-  Serial.println("Saving Survey Observation");
-  display_info("Saving Survey Observation");
+void stop_event_marks() {
+  if (!event_file) return;
+  HAM_GNSS.setVal8(UBLOX_CFG_MSGOUT_UBX_TIM_TM2_I2C, 0, VAL_LAYER_RAM);
+  HAM_GNSS.setVal8(UBLOX_CFG_MSGOUT_UBX_NAV_HPPOSLLH_I2C, 0, VAL_LAYER_RAM);
+  service_event_marks(true); // marks still waiting for an epoch go out without a position
+  event_file.close();
+  sd_cache_invalidate(event_file_name);
+  LOG_I("events", "Event marks stopped: %lu marks in %s", (unsigned long)event_marks_logged, event_file_name.c_str());
+  display_info("Event marks stopped");
+}
 
-  String GCP_name = "GCP" + gcp_index;
-  String longitude = (String)HAM_GNSS.getHighResLongitude();
-  String latitude = (String)HAM_GNSS.getHighResLatitude();
-  String elevation = (String)HAM_GNSS.getAltitude();
-  Serial.println("Writing survey observation to file.");
+// Writes every queued mark that can be placed, one SD write and flush per pass
+void service_event_marks(bool final) {
+  if (!event_file) return;
+
+  String lines = "";
+  uint32_t captured_us[EVENT_RING_SIZE];
+  uint8_t count = 0;
+  const event_mark_t *mark;
+  while ((mark = event_ring.front()) != nullptr) {
+    position_sample_t position;
+    event_match_t match = mark->time_valid ? event_window.match(*mark, position) : EVENT_UNMATCHED;
+    if (match == EVENT_WAIT && !final && micros() - mark->captured_us < EVENT_MARK_WAIT_MS * 1000) break;
+
+    uint16_t gap = mark->count - event_last_count;
+    if (event_count_valid && gap > 1) event_marks_missed += gap - 1;
+    event_last_count = mark->count;
+    event_count_valid = true;
+
+    char line[192];
+    int length = snprintf(line, sizeof(line), "%u,%u,%lu.%09lu,", mark->count, mark->week, (unsigned long)(mark->tow_ms / 1000),
+                          (unsigned long)(mark->tow_ms % 1000 * 1000000 + mark->tow_sub_ns));
+    if (match == EVENT_MATCHED) {
+      snprintf(line + length, sizeof(line) - length, "%.9f,%.9f,%.4f,%.4f,%.4f,%lu,%s\n", position.lat * 1e-9, position.lon * 1e-9,
+               position.height * 1e-4, position.h_acc * 1e-4, position.v_acc * 1e-4, (unsigned long)mark->acc_ns, mark->time_base == 1 ? "ok" : "time_base");
+    } else {
+      snprintf(line + length, sizeof(line) - length, ",,,,,%lu,%s\n", (unsigned long)mark->acc_ns, mark->time_valid ? "no_position" : "time_invalid");
+      event_marks_unmatched++;
+    }
+    lines += line;
+    captured_us[count++] = mark->captured_us;
+    event_ring.pop();
+  }
+  if (count == 0) return;
 
-  String file_content = GCP_name + " " + longitude + " " + latitude + " " + elevation + "\n";
+  event_file.print(lines);
+  event_file.flush();
+  uint32_t now = micros();
+  for (uint8_t i = 0; i < count; i++) event_latency.add(now - captured_us[i]);
+  event_marks_logged += count;
+}
 
-  // check if survey file has been initiated
-  if (get_file_contents() == ""){
-    init_survey_file(); // config survey file
-  }
+void send_event_mark_status() {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["event_marks"] = event_file ? "logging" : "stopped";
+  object["event_file"] = event_file_name;
+  object["event_logged"] = event_marks_logged;
+  object["event_unmatched"] = event_marks_unmatched;
+  object["event_missed"] = event_marks_missed;
+  object["event_dropped"] = event_ring.dropped();
+  object["event_queue_hwm"] = event_ring.high_water();
+  object["event_latency_p50_us"] = event_latency.percentile(50);
+  object["event_latency_p99_us"] = event_latency.percentile(99);
+  object["event_latency_max_us"] = event_latency.max();
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString, WS_TELEMETRY, WS_TOPIC_EVENT_MARKS);
+}
 
-  write_to_file(file_content);
+void send_track_status() {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["track_log"] = track_file ? "logging" : "stopped";
+  object["track_file"] = track_file_name;
+  object["track_points"] = track_writer.points();
+  object["track_bytes"] = track_writer.blocks_written() * TRACK_BLOCK_SIZE;
+  object["track_write_max_us"] = track_write_max_us;
+  object["track_failed_writes"] = track_writer.failed_writes();
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString, WS_TELEMETRY, WS_TOPIC_TRACK_LOG);
 }
 
-// Surveying Functions
-void start_survey_observation() {
-  // dashboard send data json object
+void send_batch_status(const char *status) {
   String jsonString = "";
   JsonObject object = json_doc_tx.to<JsonObject>();
 
-  display_info("starting survey observation.");
-  // check if there already is a survey in progress
-  bool response = HAM_GNSS.getSurveyStatus(2000);
-  
-  if (response ==  false) {
-    Serial.println("Failed to get Survey In status.");
-    display_info("Failed to get Survey In status.");
-    // Send Survey Status
-    object["survey_status"] = "failed_to_get_status";
-    serializeJson(object, jsonString);
-    webSocket.broadcastTXT(jsonString);
-    while(1); // freeze
+  float hours = (millis() - batch_start_ms) / 3600000.0;
+  object["batch_status"] = status;
+  object["batch_gcp"] = batch_point_name();
+  object["batch_points_done"] = batch_points_done;
+  object["batch_points_per_hour"] = hours > 0 ? batch_points_done / hours : 0;
+  if (batch_state == BATCH_OCCUPY) {
+    object["batch_epochs"] = batch_epochs;
+    object["batch_hacc"] = latest_epoch.hAcc;
+    object["batch_rtk_alert"] = solution_monitor.alert();
   }
+  serializeJson(object, jsonString);
+  // progress updates coalesce, transitions such as point_saved must arrive
+  bool progress = strcmp(status, "occupying") == 0 || strcmp(status, "waiting_stationary") == 0;
+  ws_broadcast(jsonString, progress ? WS_TELEMETRY : WS_CRITICAL, WS_TOPIC_BATCH);
+}
 
-  if (HAM_GNSS.getSurveyInActive() == false && survey_in_progress) {
-    Serial.print("Survey already in progress.");
-    display_info("Survey already in progress");
-    // Send Survey Status
-    object["survey_status"] = "in_progress";
-    serializeJson(object, jsonString);
-    webSocket.broadcastTXT(jsonString);
-  }
-  else {
-    // Start Survey
-    Serial.println("Initiating Survey");
-    display_info("Initiating Survey");
+// working on call back functionality need to update zed-f9p chip to firmware 1.3 HPG or greater.
+void pushRXMPMP(UBX_RXM_PMP_message_data_t *pmpData) {
+  // Extract raw message payload
+  uint16_t payloadLen = ((u_int16_t)pmpData->lengthMSB << 8) | (u_int16_t)pmpData->lengthLSB;
+  LOG_D("lband", "RXM-PMP %u bytes pushed to the GNSS", payloadLen);
+  HAM_GNSS.pushRawData(&pmpData->sync1, (size_t)payloadLen + 6); // Push the sync chars, class, ID, length and payload
+  HAM_GNSS.pushRawData(&pmpData->checksumA, (size_t)2);
+}
 
-    // Send Survey Status
-    object["survey_status"] = "started";
-    object["survey_desired_accuracy"] = survey_desired_accuracy;
-    serializeJson(object, jsonString);
-    webSocket.broadcastTXT(jsonString);
+void printRXMCOR(UBX_RXM_COR_data_t *ubxDataStruct)
+{
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  const char *protocol = "Unknown";
+  if (ubxDataStruct->statusInfo.bits.protocol == 1) protocol = "RTCM3";
+  else if (ubxDataStruct->statusInfo.bits.protocol == 2) protocol = "SPARTN";
+  else if (ubxDataStruct->statusInfo.bits.protocol == 29) protocol = "PMP (SPARTN)";
+  else if (ubxDataStruct->statusInfo.bits.protocol == 30) protocol = "QZSSL6";
+  const char *used[] = {"Unknown", "Not used", "Used", "Unknown"};
+
+  // errStatus, msgEncrypted and msgDecrypted stay in statusInfo, 1 no / 2 yes each
+  LOG_D("lband", "RXM-COR %s ebno %.3f dB, %s, statusInfo 0x%08lx", protocol, (double)ubxDataStruct->ebno / 8, used[ubxDataStruct->statusInfo.bits.msgUsed],
+        (unsigned long)ubxDataStruct->statusInfo.all);
+#else
+  (void)ubxDataStruct; // RXM-COR is only logged at debug level
+#endif
+}
 
-    // Start Survey
-    response = HAM_GNSS.enableSurveyMode(60, survey_desired_accuracy, VAL_LAYER_RAM); // Enable Survey in, 60 secoonds 5m of accuracy Save setting in RAM layer only (not BBR)
-    if(response == false) {
-      display_info("Survey Start Failed");
-      // Send Survey Status
-      object["survey_status"] = "survey_start_failed";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
-      while (1);
-    }
-    else {
-      survey_in_progress = true; // set global survey variable
+
+// Stakeout functions
+// Calls fn for each line of the file with the line's byte offset, until fn returns false. Lines are
+// cut at 95 characters, the survey file format is far shorter.
+bool for_each_stakeout_line(const String &path, bool (*fn)(const char *line, uint32_t offset, void *ctx), void *ctx) {
+  File file = SD.open(path, FILE_READ);
+  if (!file) return false;
+  uint8_t buffer[512];
+  char line[96];
+  size_t line_length = 0;
+  uint32_t offset = 0, line_start = 0;
+  bool more = true;
+  size_t n;
+  while (more && (n = file.read(buffer, sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < n && more; i++) {
+      offset++;
+      if (buffer[i] == '\n') {
+        line[line_length] = '\0';
+        more = fn(line, line_start, ctx);
+        line_length = 0;
+        line_start = offset;
+      } else if (line_length < sizeof(line) - 1) {
+        line[line_length++] = buffer[i];
+      }
     }
   }
+  if (more && line_length > 0) { // last line without a newline
+    line[line_length] = '\0';
+    fn(line, line_start, ctx);
+  }
+  file.close();
+  return true;
 }
 
-// Survey data helper functions
-String get_fix_type() {
-  String fixType_str = "";
-  byte fixType = HAM_GNSS.getFixType();
-  if(fixType == 0) fixType_str = "No fix";
-  else if(fixType == 1) fixType_str = "Dead Reckoning";
-  else if(fixType == 2) fixType_str = "2D";
-  else if(fixType == 3) fixType_str = "3D";
-  else if(fixType == 4) fixType_str = "GNSS + Dead Reckoning";
-  else if(fixType == 5) fixType_str = "Time only";
-  return fixType_str;
+// "name lon lat elevation", lon/lat in deg * 1e-7, elevation in mm above the ellipsoid
+bool parse_stakeout_line(const char *line, char *name, size_t name_size, int32_t &lat, int32_t &lon, int32_t &height) {
+  char format[24];
+  long lon_value, lat_value, height_value;
+  snprintf(format, sizeof(format), "%%%us %%ld %%ld %%ld", (unsigned)name_size - 1);
+  if (sscanf(line, format, name, &lon_value, &lat_value, &height_value) != 4) return false;
+  if (lat_value < -900000000 || lat_value > 900000000 || lon_value < -1800000000 || lon_value > 1800000000) return false;
+  lat = lat_value;
+  lon = lon_value;
+  height = height_value;
+  return true;
 }
 
-String get_RTK_status() {
-  String RTK_str = "";
-  byte RTK = HAM_GNSS.getCarrierSolutionType();
-  if(RTK == 0) RTK_str = "No Solution";
-  else if (RTK == 1) RTK_str = "High precision floating fix";
-  else if (RTK == 2) RTK_str = "High precision fix";
-  return RTK_str;
+bool add_stakeout_line(const char *line, uint32_t, void *) {
+  char name[24];
+  int32_t lat, lon, height;
+  if (!parse_stakeout_line(line, name, sizeof(name), lat, lon, height)) {
+    stakeout_skipped++;
+    return true;
+  }
+  size_t length = strlen(name) + 1;
+  if (stakeout_names_size - stakeout_names_used < length || !stakeout_index->add(lat, lon, height, stakeout_names_used)) {
+    stakeout_skipped++;
+    return true;
+  }
+  for (char *c = name; *c; c++) {
+    if (*c == '"' || *c == '\\') *c = '_'; // the name goes into JSON as is
+  }
+  memcpy(stakeout_names + stakeout_names_used, name, length);
+  stakeout_names_used += length;
+  return true;
 }
 
-String get_heading() {
-  String heading_str = "";
-  float heading_f = HAM_GNSS.getHeading() * 1e-5;
+bool load_stakeout(const String &path) {
+  if (path.length() == 0 || !SD.exists(path)) {
+    LOG_E("stakeout", "Failed to open stakeout file %s", path.c_str());
+    return false;
+  }
+  stop_stakeout();
+
+  size_t capacity = STAKEOUT_PSRAM_POINTS;
+  stakeout_points = (index_point_t *)heap_caps_malloc(capacity * sizeof(index_point_t), MALLOC_CAP_SPIRAM);
+  stakeout_names = (char *)heap_caps_malloc(capacity * STAKEOUT_NAME_BYTES, MALLOC_CAP_SPIRAM);
+  if (!stakeout_points || !stakeout_names) {
+    free(stakeout_points);
+    free(stakeout_names);
+    capacity = STAKEOUT_DRAM_POINTS;
+    stakeout_points = (index_point_t *)malloc(capacity * sizeof(index_point_t));
+    stakeout_names = (char *)malloc(capacity * STAKEOUT_NAME_BYTES);
+  }
+  if (!stakeout_points || !stakeout_names) {
+    LOG_E("stakeout", "No memory for stakeout points.");
+    stop_stakeout();
+    return false;
+  }
+  stakeout_names_size = capacity * STAKEOUT_NAME_BYTES;
+  stakeout_index = new PointIndex(stakeout_points, capacity);
+
+  unsigned long start = millis();
+  for_each_stakeout_line(path, add_stakeout_line, nullptr);
+  stakeout_index->build();
+  stakeout_build_ms = millis() - start;
+  stakeout_file = path;
+
+  LOG_I("stakeout", "Stakeout: %u points from %s in %lu ms, %lu lines skipped", (unsigned)stakeout_index->size(), path.c_str(),
+        (unsigned long)stakeout_build_ms, (unsigned long)stakeout_skipped);
+  if (stakeout_index->size() == 0) {
+    stop_stakeout();
+    return false;
+  }
+  return true;
+}
 
-  if (heading_f < 10.0) {
-    // North
-    heading_str += "N";
-  } else if (heading_f >= 10 && heading_f < 85) {
-    // North East
-    heading_str += "NE";
-  } else if  (heading_f >= 85 && heading_f < 95) {
-    // East
-    heading_str += "E";
-  } else if (heading_f >= 95 && heading_f < 175 ) {
-    // South East
-    heading_str += "SE";
-  } else if  (heading_f >= 175 && heading_f < 185) {
-    // South
-    heading_str += "S";
-  } else if (heading_f >= 185 && heading_f < 265) {
-    // South West
-    heading_str += "SW";
-  } else if (heading_f >= 265 && heading_f < 275) {
-    // West
-    heading_str += "W";
-  } else if (heading_f >= 275 && heading_f < 360) {
-    // North West
-    heading_str += "NW";
+void stop_stakeout() {
+  delete stakeout_index;
+  stakeout_index = nullptr;
+  free(stakeout_points); // heap_caps_malloc memory is freed with free() as well
+  stakeout_points = nullptr;
+  free(stakeout_names);
+  stakeout_names = nullptr;
+  stakeout_names_size = 0;
+  stakeout_names_used = 0;
+  stakeout_file = "";
+  stakeout_skipped = 0;
+  stakeout_build_ms = 0;
+  stakeout_selected = -1;
+  stakeout_target = -1;
+  stakeout_name = "";
+}
+
+// A linear pass over the name table, once per selection
+bool select_stakeout_point(const String &name) {
+  if (!stakeout_index || name.length() == 0) return false;
+  for (size_t i = 0; i < stakeout_index->size(); i++) {
+    if (strcmp(stakeout_names + stakeout_index->point(i).ref, name.c_str()) != 0) continue;
+    set_stakeout_target(i);
+    stakeout_selected = i;
+    return true;
   }
-  heading_str += " - ";
-  heading_str += (String)heading_f;
-  heading_str += "deg from North";
+  return false;
+}
 
-  
-  return heading_str;
+void set_stakeout_target(int index) {
+  stakeout_name = stakeout_names + stakeout_index->point(index).ref;
+  stakeout_target = index;
 }
 
-void handle_survey_observation_in_progress() {
-  if(HAM_GNSS.getSurveyInValid() == false  && survey_in_progress) { // check if survey is in progress
+void epoch_stakeout(const gnss_epoch_t &epoch) {
+  if (!stakeout_index || epoch.fixType < 2) return;
+
+  unsigned long start = micros();
+  int target = stakeout_selected >= 0 ? stakeout_selected : stakeout_index->nearest(epoch.lat, epoch.lon);
+  stakeout_lookup_us = micros() - start;
+  if (target < 0) return;
+  if (target != stakeout_target) set_stakeout_target(target);
+
+  const index_point_t &point = stakeout_index->point(target);
+  point_offset(epoch.lat, epoch.lon, epoch.height, point.lat, point.lon, point.height, stakeout_east, stakeout_north, stakeout_up);
+  double distance = sqrt(stakeout_east * stakeout_east + stakeout_north * stakeout_north);
+  double bearing = atan2(stakeout_east, stakeout_north) * 180 / M_PI;
+  if (bearing < 0) bearing += 360;
+
+  int length = snprintf(stakeout_message, sizeof(stakeout_message),
+                        "{\"stake_point\":\"%s\",\"stake_mode\":\"%s\",\"stake_e\":%.3f,\"stake_n\":%.3f,\"stake_u\":%.3f,\"stake_dist\":%.3f,"
+                        "\"stake_bearing\":%.1f,\"stake_hacc\":%lu,\"stake_lookup_us\":%lu}",
+                        stakeout_name, stakeout_selected >= 0 ? "selected" : "nearest", stakeout_east, stakeout_north, stakeout_up, distance, bearing,
+                        (unsigned long)epoch.hAcc, (unsigned long)stakeout_lookup_us);
+  if (length > 0 && length < (int)sizeof(stakeout_message)) {
+    ws_outbox.broadcast(WS_TELEMETRY, WS_TOPIC_STAKEOUT, stakeout_payloads.make(stakeout_message, length));
+  }
+}
 
-    // dashboard send data json object
-    String jsonString = "";
-    JsonObject object = json_doc_tx.to<JsonObject>();
+void send_stakeout_status(const char *status) {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["stakeout_status"] = status;
+  object["stakeout_file"] = stakeout_file;
+  object["stakeout_points"] = stakeout_index ? (uint32_t)stakeout_index->size() : 0;
+  object["stakeout_capacity"] = stakeout_index ? (uint32_t)stakeout_index->capacity() : 0;
+  object["stakeout_skipped"] = stakeout_skipped;
+  object["stakeout_build_ms"] = stakeout_build_ms;
+  if (stakeout_selected >= 0) object["stakeout_selected"] = stakeout_name;
+  serializeJson(object, jsonString);
+  ws_broadcast(jsonString);
+}
 
-    bool response = HAM_GNSS.getSurveyStatus(2000); // Query module for SVIN status with 2000ms timeout (req can take a long time)
-    delay(100); // give time for survey to start
-    if(response == true) {
-      object["survey_status"] = "in_progress";
-      object["survey_time_elapsed"] = (String)HAM_GNSS.getSurveyInObservationTime();
-      object["survey_accuracy"] = (String)HAM_GNSS.getSurveyInMeanAccuracy();
-      object["survey_lat"] = (String)HAM_GNSS.getHighResLatitude();
-      object["survey_long"] = (String)HAM_GNSS.getHighResLongitude();
-      object["survey_altitude"] = (String)HAM_GNSS.getAltitude(); // create js func from here down
-      object["survey_altitude_msl"] = (String)HAM_GNSS.getAltitudeMSL();
-      object["survey_msl"] = (String)HAM_GNSS.getMeanSeaLevel();
-      object["survey_pos_accuracy"] = (String)HAM_GNSS.getPositionAccuracy();
-      object["survey_vertical_accuracy"] = (String)HAM_GNSS.getVerticalAccuracy();
-      object["survey_horizontal_accuracy"] = (String)HAM_GNSS.getHorizontalAccuracy();
-      object["SIV"] = (String)HAM_GNSS.getSIV();;// create js functionality for this here  down
-      object["fix_type"] = get_fix_type();
-      object["RTK"] = get_RTK_status();
-      object["heading"] = get_heading();
-      object["PDOP"] = HAM_GNSS.getPDOP() / 100.0; // Convert pDOP scaling from 0.01 to 1
+// Convergence functions
+convergence_config_t convergence_config() {
+  convergence_config_t config;
+  config.lband_frequency = lband_frequency;
+  config.keys_crc = 0;
+  for (int i = 0; i < 2; i++) {
+    config.keys_crc = crc32_update(config.keys_crc, (const uint8_t *)spartn_keys[i].key, strlen(spartn_keys[i].key));
+  }
+  config.rate_profile = rate_profile;
+  return config;
+}
 
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
+void check_convergence(const gnss_epoch_t &epoch) {
+  bool ended = convergence.update(epoch.received_ms, epoch.fixType, epoch.carrSoln, epoch.corr_age, epoch.numSV, epoch.hAcc);
+  if (ended) {
+    const convergence_run_t &run = convergence.ended();
+    LOG_I("conv", "Convergence run %lu (%s) %s, %.1f s to fixed", (unsigned long)run.id, convergence_trigger_name(run.trigger), convergence_end_name(run.end),
+          run.reached(MILESTONE_FIXED) ? run.milestones[MILESTONE_FIXED].t_ms / 1000.0 : -1.0);
+    save_convergence_run(run);
+    ws_broadcast("{\"convergence_run\":" + convergence_run_json(run) + "}");
+  }
+  if (convergence.running() && convergence.new_milestones()) {
+    ws_broadcast("{\"convergence_run\":" + convergence_run_json(convergence.current()) + "}");
+  }
+}
 
-      display_info("Survey in Progress");
-      display_add_info(" time: ");
-      display_add_info((String)HAM_GNSS.getSurveyInObservationTime());
-      display_add_info(" accuracy: " );
-      display_add_info((String)HAM_GNSS.getSurveyInMeanAccuracy());
-    } else {
-      object["survey_status"] = "in_progress";
-      object["survey_msg"] = "SVIN request failed";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
+// One run as {"id", "trigger", "end", "start_ms", "outage_ms", "profile", "lband_hz", "keys_crc", and per
+// milestone [t_ms, sv, age_s, hacc_mm] or null}
+String convergence_run_json(const convergence_run_t &run) {
+  char json[CONVERGENCE_JSON_SIZE];
+  int n = snprintf(json, sizeof(json), "{\"id\":%lu,\"trigger\":\"%s\",\"end\":\"%s\",\"start_ms\":%lu,\"outage_ms\":%lu,\"profile\":\"%s\",\"lband_hz\":%lu,\"keys_crc\":\"%08lx\"",
+                   (unsigned long)run.id, convergence_trigger_name(run.trigger), convergence_end_name(run.end), (unsigned long)run.start_ms,
+                   (unsigned long)run.outage_ms, rate_profiles[run.config.rate_profile].name, (unsigned long)run.config.lband_frequency,
+                   (unsigned long)run.config.keys_crc);
+  for (int i = 0; i < MILESTONE_COUNT && n < (int)sizeof(json); i++) {
+    const convergence_stamp_t &stamp = run.milestones[i];
+    const char *name = convergence_milestone_name((convergence_milestone_t)i);
+    if (!run.reached((convergence_milestone_t)i)) n += snprintf(json + n, sizeof(json) - n, ",\"%s\":null", name);
+    else n += snprintf(json + n, sizeof(json) - n, ",\"%s\":[%lu,%u,%u,%lu]", name, (unsigned long)stamp.t_ms, stamp.num_sv, stamp.corr_age_s,
+                  (unsigned long)stamp.h_acc);
+  }
+  if (n < (int)sizeof(json)) snprintf(json + n, sizeof(json) - n, "}");
+  return String(json);
+}
 
-      display_info("SVIN request failed");
+// One CSV line per finished run, the header goes in when the file is new
+void save_convergence_run(const convergence_run_t &run) {
+  bool exists = SD.exists(CONVERGENCE_FILE);
+  sd_cache_invalidate(CONVERGENCE_FILE);
+  File file = SD.open(CONVERGENCE_FILE, FILE_APPEND);
+  if (!file) {
+    LOG_E("conv", "Failed to open " CONVERGENCE_FILE);
+    return;
+  }
+  if (!exists) {
+    file.print("utc,id,trigger,end,start_ms,outage_ms,profile,lband_hz,keys_crc");
+    for (int i = 0; i < MILESTONE_COUNT; i++) {
+      String name = convergence_milestone_name((convergence_milestone_t)i);
+      file.print("," + name + "_ms," + name + "_sv," + name + "_age_s," + name + "_hacc_mm");
     }
+    file.println();
+  }
 
-  } else if(HAM_GNSS.getSurveyInValid() && survey_in_progress) { // survey is invalid
+  char line[CONVERGENCE_JSON_SIZE];
+  const gnss_epoch_t &epoch = latest_epoch;
+  int n = 0;
+  if (epoch.date_valid && epoch.time_valid) {
+    n = snprintf(line, sizeof(line), "%04u-%02u-%02uT%02u:%02u:%02uZ", epoch.year, epoch.month, epoch.day, epoch.hour, epoch.minute, epoch.second);
+  }
+  n += snprintf(line + n, sizeof(line) - n, ",%lu,%s,%s,%lu,%lu,%s,%lu,%08lx", (unsigned long)run.id, convergence_trigger_name(run.trigger),
+                convergence_end_name(run.end), (unsigned long)run.start_ms, (unsigned long)run.outage_ms, rate_profiles[run.config.rate_profile].name,
+                (unsigned long)run.config.lband_frequency, (unsigned long)run.config.keys_crc);
+  for (int i = 0; i < MILESTONE_COUNT && n < (int)sizeof(line); i++) {
+    const convergence_stamp_t &stamp = run.milestones[i];
+    if (!run.reached((convergence_milestone_t)i)) n += snprintf(line + n, sizeof(line) - n, ",,,,");
+    else n += snprintf(line + n, sizeof(line) - n, ",%lu,%u,%u,%lu", (unsigned long)stamp.t_ms, stamp.num_sv, stamp.corr_age_s, (unsigned long)stamp.h_acc);
+  }
+  file.println(line);
+  file.close();
+}
 
-      // dashboard send data json object
-      String jsonString = "";
-      JsonObject object = json_doc_tx.to<JsonObject>();
+// {"convergence": [runs, newest first], "convergence_current": run or null}
+void send_convergence(uint8_t client_num) {
+  String message = "{\"convergence\":[";
+  for (size_t i = 0; i < convergence.count(); i++) {
+    if (i > 0) message += ",";
+    message += convergence_run_json(convergence.run(i));
+  }
+  message += "],\"convergence_current\":";
+  message += convergence.running() ? convergence_run_json(convergence.current()) : String("null");
+  message += "}";
+  ws_send(client_num, message);
+}
 
-      object["survey_status"] = "finished";
-      object["survey_msg"] = "Transmitting RTCM";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
+// Logging functions
+void service_log(uint32_t budget_us) {
+  unsigned long start = micros();
+  char line[LOG_LINE_SIZE];
+  while (micros() - start < budget_us) {
+    const log_record_t *record = log_ring.front();
+    if (!record) break;
+    size_t length = log_format(*record, line, sizeof(line));
+    if (record->level <= log_serial_level) {
+      if (Serial.availableForWrite() < (int)length + 2) break; // UART still busy, this line goes out on a later pass
+      Serial.write((const uint8_t *)line, length);
+      Serial.write((const uint8_t *)"\r\n", 2);
+    }
+    if (record->level <= log_sd_level) {
+      log_sd_pending += line;
+      log_sd_pending += '\n';
+    }
+    if (record->level <= log_ws_level && log_subscribers) {
+      if (log_ws_pending.length() + length + 8 > LOG_WS_MAX_BYTES) log_ws_dropped++;
+      else {
+        log_ws_pending += log_ws_pending.length() ? ",\"" : "\"";
+        for (size_t i = 0; i < length; i++) {
+          char c = line[i];
+          if (c == '"' || c == '\\') log_ws_pending += '\\';
+          log_ws_pending += (uint8_t)c < 0x20 ? ' ' : c;
+        }
+        log_ws_pending += '"';
+      }
+    }
+    log_ring.pop();
+  }
 
-      display_info("Survey Finished Transmitting RTCM");
-      stop_survey_observation();
+  unsigned long now = millis();
+  if (log_sd_pending.length() >= LOG_SD_FLUSH_BYTES || (log_sd_pending.length() && now - log_sd_previousMillis > LOG_SD_FLUSH_MS)) {
+    flush_log_sd();
+  }
+  if (log_ws_pending.length() && now - log_ws_previousMillis >= LOG_WS_INTERVAL_MS) {
+    String message = "{\"log\":[" + log_ws_pending + "]}";
+    for (uint8_t i = 0; i < WS_OUTBOX_MAX_CLIENTS; i++) {
+      if (log_subscribers & (1 << i)) ws_send(i, message, WS_TELEMETRY, WS_TOPIC_LOG);
     }
+    log_ws_pending = "";
+    log_ws_previousMillis = now;
+  }
 }
 
-void stop_survey_observation() {
-  // dashboard send data json object
-    String jsonString = "";
-    JsonObject object = json_doc_tx.to<JsonObject>();
-
-  // check if survey is already going
-  if(!HAM_GNSS.getSurveyInValid() || survey_in_progress) {
-    bool response = HAM_GNSS.disableSurveyMode(); // disable survey mode.
-    if(response) {
-      display_info("Survey Observation Stopped.");
-      object["survey_status"] = "finished";
-      object["survey_msg"] = "Survey Successfully Finished";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
-      survey_in_progress = false;
-    } else {
-      display_info("Attempted to stop survey. but failed");
+// One append per batch, the card sees a write every few seconds instead of one per line
+void flush_log_sd() {
+  sd_cache_invalidate(LOG_FILE);
+  File file = SD.open(LOG_FILE, FILE_APPEND);
+  if (file) {
+    file.print(log_sd_pending);
+    file.close();
+  }
+  log_sd_pending = ""; // without a card the lines are dropped, Serial still had them
+  log_sd_previousMillis = millis();
+}
 
-      object["survey_status"] = "stop_failed";
-      object["survey_msg"] = "Attempted to stop survey. but failded.";
-      serializeJson(object, jsonString);
-      webSocket.broadcastTXT(jsonString);
-      survey_in_progress = false;
-    }
-  } else {
-    display_info("Attempted to stop survey but there are no survey in progress.");
+void send_log_status(uint8_t client_num) {
+  String jsonString = "";
+  JsonObject object = json_doc_tx.to<JsonObject>();
+  object["log_subscribed"] = (log_subscribers & (1 << client_num)) != 0;
+  object["log_serial_level"] = log_level_name(log_serial_level);
+  object["log_sd_level"] = log_level_name(log_sd_level);
+  object["log_ws_level"] = log_level_name(log_ws_level);
+  object["log_compiled_level"] = log_level_name(LOG_LEVEL);
+  object["log_written"] = log_ring.written();
+  object["log_dropped"] = log_ring.dropped();
+  object["log_ws_dropped"] = log_ws_dropped;
+  object["log_high_water"] = log_ring.high_water();
+  serializeJson(object, jsonString);
+  ws_send(client_num, jsonString);
+}
 
-    object["survey_status"] = "stopped";
-    object["survey_msg"] = "Attempted  to stop survey but there was no survey in progress.";
-    serializeJson(object, jsonString);
-    webSocket.broadcastTXT(jsonString);
-    survey_in_progress = false;
+uint8_t log_level_from_name(const char *name) {
+  for (uint8_t level = LOG_LEVEL_NONE; level <= LOG_LEVEL_DEBUG; level++) {
+    if (strcmp(name, log_level_name(level)) == 0) return level;
   }
+  return LOG_LEVEL_INFO;
 }
 
-// working on call back functionality need to update zed-f9p chip to firmware 1.3 HPG or greater.
-void pushRXMPMP(UBX_RXM_PMP_message_data_t *pmpData) {
-  // Extract raw message payload
-  uint16_t payloadLen = ((u_int16_t)pmpData->lengthMSB << 8) | (u_int16_t)pmpData->lengthLSB;
-  Serial.print("New RXM-PMP data received. Message payload length is ");
-  Serial.println(payloadLen);
-  Serial.println(" Bytes. Pushing it to the GNSS...");
-  HAM_GNSS.pushRawData(&pmpData->sync1, (size_t)payloadLen + 6); // Push the sync chars, class, ID, length and payload
-  HAM_GNSS.pushRawData(&pmpData->checksumA, (size_t)2);
+// Receiver status functions
+// One MON-VER poll, the getters after the first one read the library's copy of it
+void read_receiver_identity(SFE_UBLOX_GNSS &receiver, receiver_identity_t &identity) {
+  strlcpy(identity.module, receiver.getModuleName(), sizeof(identity.module));
+  strlcpy(identity.firmware_type, receiver.getFirmwareType(), sizeof(identity.firmware_type));
+  identity.firmware_high = receiver.getFirmwareVersionHigh();
+  identity.firmware_low = receiver.getFirmwareVersionLow();
+  identity.protocol_high = receiver.getProtocolVersionHigh();
+  identity.protocol_low = receiver.getProtocolVersionLow();
+  identity.valid = true;
+  LOG_I("gnss", "%s firmware %s %u.%02u", identity.module, identity.firmware_type, identity.firmware_high, identity.firmware_low);
 }
 
-void printRXMCOR(UBX_RXM_COR_data_t *ubxDataStruct)
-{
-  Serial.print(F("UBX-RXM-COR:  ebno: "));
-  Serial.print((double)ubxDataStruct->ebno / 8, 3); //Convert ebno to dB
-
-  Serial.print(F("  protocol: "));
-  if (ubxDataStruct->statusInfo.bits.protocol == 1)
-    Serial.print(F("RTCM3"));
-  else if (ubxDataStruct->statusInfo.bits.protocol == 2)
-    Serial.print(F("SPARTN"));
-  else if (ubxDataStruct->statusInfo.bits.protocol == 29)
-    Serial.print(F("PMP (SPARTN)"));
-  else if (ubxDataStruct->statusInfo.bits.protocol == 30)
-    Serial.print(F("QZSSL6"));
-  else
-    Serial.print(F("Unknown"));
-
-  Serial.print(F("  errStatus: "));
-  if (ubxDataStruct->statusInfo.bits.errStatus == 1)
-    Serial.print(F("Error-free"));
-  else if (ubxDataStruct->statusInfo.bits.errStatus == 2)
-    Serial.print(F("Erroneous"));
-  else
-    Serial.print(F("Unknown"));
-
-  Serial.print(F("  msgUsed: "));
-  if (ubxDataStruct->statusInfo.bits.msgUsed == 1)
-    Serial.print(F("Not used"));
-  else if (ubxDataStruct->statusInfo.bits.msgUsed == 2)
-    Serial.print(F("Used"));
-  else
-    Serial.print(F("Unknown"));
-
-  Serial.print(F("  msgEncrypted: "));
-  if (ubxDataStruct->statusInfo.bits.msgEncrypted == 1)
-    Serial.print(F("Not encrypted"));
-  else if (ubxDataStruct->statusInfo.bits.msgEncrypted == 2)
-    Serial.print(F("Encrypted"));
-  else
-    Serial.print(F("Unknown"));
-
-  Serial.print(F("  msgDecrypted: "));
-  if (ubxDataStruct->statusInfo.bits.msgDecrypted == 1)
-    Serial.print(F("Not decrypted"));
-  else if (ubxDataStruct->statusInfo.bits.msgDecrypted == 2)
-    Serial.print(F("Successfully decrypted"));
-  else
-    Serial.print(F("Unknown"));
-
-  Serial.println();
+void new_lband_mon_hw(UBX_MON_HW_data_t *hw) {
+  lband_antenna_status = hw->aStatus;
+}
+
+// Reads whatever the NEO-D9S has pushed, new_lband_mon_hw() takes the antenna state from it. Counted
+// in the bus stats with the ZED-F9P's reads.
+void refresh_receiver_status() {
+  unsigned long start = micros();
+  HAM_GNSS_L_Band.checkUblox();
+  HAM_GNSS_L_Band.checkCallbacks();
+  ublox_bus_us += micros() - start;
+  ublox_polls++;
 }
 
+String receiver_identity_HTML(const char *label, const receiver_identity_t &identity) {
+  String html = "<h4 style=\"text-align: center;\">" + String(label) + ": </h4>\n";
+  html += "<p style=\"text-align: center;\">";
+  html += identity.valid ? identity.module : "Not connected yet";
+  html += "</p>\n";
+  if (!identity.valid) return html;
+  html += "<h4 style=\"text-align: center;\">GNSS Reciever Firmware Version: </h4>\n";
+  html += "<p style=\"text-align: center;\">" + String(identity.firmware_high) + "." + String(identity.firmware_low) + "</p>\n";
+  html += "<h4 style=\"text-align: center;\">GNSS Reciever Protocal version : </h4>\n";
+  html += "<p style=\"text-align: center;\">" + String(identity.protocol_high) + "." + String(identity.protocol_low) + "</p>\n";
+  html += "<h4 style=\"text-align: center;\">Firmware Type: </h4>\n";
+  html += "<p style=\"text-align: center;\">" + String(identity.firmware_type) + "</p>\n";
+  return html;
+}